@@ -5,17 +5,19 @@
 
 #include <addrman.h>
 
+#include <crypto/common.h>
 #include <hash.h>
 #include <logging.h>
 #include <netaddress.h>
 #include <serialize.h>
 #include <util/check.h>
 
+#include <algorithm>
 #include <cmath>
 #include <optional>
 
 int CAddrInfo::GetTriedBucket(const uint256 &nKey,
-                              const std::vector<bool> &asmap) const {
+                              const CompiledAsmap &asmap) const {
     uint64_t hash1 =
         (CHashWriter(SER_GETHASH, 0) << nKey << GetKey()).GetCheapHash();
     uint64_t hash2 = (CHashWriter(SER_GETHASH, 0)
@@ -23,14 +25,16 @@ int CAddrInfo::GetTriedBucket(const uint256 &nKey,
                       << (hash1 % ADDRMAN_TRIED_BUCKETS_PER_GROUP))
                          .GetCheapHash();
     int tried_bucket = hash2 % ADDRMAN_TRIED_BUCKET_COUNT;
-    uint32_t mapped_as = GetMappedAS(asmap);
-    LogPrint(BCLog::NET, "IP %s mapped to AS%i belongs to tried bucket %i\n",
-             ToStringIP(), mapped_as, tried_bucket);
+    // Only look the AS up again when it is logged.
+    if (LogAcceptCategory(BCLog::NET)) {
+        LogPrintf("IP %s mapped to AS%i belongs to tried bucket %i\n",
+                  ToStringIP(), GetMappedAS(asmap), tried_bucket);
+    }
     return tried_bucket;
 }
 
 int CAddrInfo::GetNewBucket(const uint256 &nKey, const CNetAddr &src,
-                            const std::vector<bool> &asmap) const {
+                            const CompiledAsmap &asmap) const {
     std::vector<uint8_t> vchSourceGroupKey = src.GetGroup(asmap);
     uint64_t hash1 = (CHashWriter(SER_GETHASH, 0)
                       << nKey << GetGroup(asmap) << vchSourceGroupKey)
@@ -40,9 +44,11 @@ int CAddrInfo::GetNewBucket(const uint256 &nKey, const CNetAddr &src,
                       << (hash1 % ADDRMAN_NEW_BUCKETS_PER_SOURCE_GROUP))
                          .GetCheapHash();
     int new_bucket = hash2 % ADDRMAN_NEW_BUCKET_COUNT;
-    uint32_t mapped_as = GetMappedAS(asmap);
-    LogPrint(BCLog::NET, "IP %s mapped to AS%i belongs to new bucket %i\n",
-             ToStringIP(), mapped_as, new_bucket);
+    // Only look the AS up again when it is logged.
+    if (LogAcceptCategory(BCLog::NET)) {
+        LogPrintf("IP %s mapped to AS%i belongs to new bucket %i\n",
+                  ToStringIP(), GetMappedAS(asmap), new_bucket);
+    }
     return new_bucket;
 }
 
@@ -100,6 +106,61 @@ double CAddrInfo::GetChance(int64_t nNow) const {
     return fChance;
 }
 
+AddrManOccupancy::AddrManOccupancy(int bucket_count)
+    : m_bitmaps(bucket_count), m_tree(bucket_count + 1) {
+    while (m_top_step * 2 <= m_bitmaps.size()) {
+        m_top_step *= 2;
+    }
+}
+
+void AddrManOccupancy::Clear() {
+    std::fill(m_bitmaps.begin(), m_bitmaps.end(), 0);
+    std::fill(m_tree.begin(), m_tree.end(), 0);
+    m_count = 0;
+}
+
+void AddrManOccupancy::Update(int bucket, int delta) {
+    for (size_t i = bucket + 1; i < m_tree.size(); i += i & -i) {
+        m_tree[i] += delta;
+    }
+    m_count += delta;
+}
+
+void AddrManOccupancy::Set(int bucket, int pos) {
+    const uint64_t bit = uint64_t{1} << pos;
+    assert(!(m_bitmaps[bucket] & bit));
+    m_bitmaps[bucket] |= bit;
+    Update(bucket, 1);
+}
+
+void AddrManOccupancy::Unset(int bucket, int pos) {
+    const uint64_t bit = uint64_t{1} << pos;
+    assert(m_bitmaps[bucket] & bit);
+    m_bitmaps[bucket] &= ~bit;
+    Update(bucket, -1);
+}
+
+std::pair<int, int> AddrManOccupancy::Get(int n) const {
+    assert(n >= 0 && n < m_count);
+
+    // Descend the tree to the bucket holding the n-th occupied position.
+    size_t bucket = 0;
+    for (size_t step = m_top_step; step > 0; step /= 2) {
+        if (bucket + step < m_tree.size() && m_tree[bucket + step] <= n) {
+            bucket += step;
+            n -= m_tree[bucket];
+        }
+    }
+
+    // Then to the position, dropping the lower occupied ones.
+    uint64_t bits = m_bitmaps[bucket];
+    for (; n > 0; --n) {
+        bits &= bits - 1;
+    }
+    assert(bits != 0);
+    return {int(bucket), int(CountBits(bits & ~(bits - 1))) - 1};
+}
+
 CAddrInfo *CAddrMan::Find(const CNetAddr &addr, int *pnId) {
     std::map<CNetAddr, int>::iterator it = mapAddr.find(addr);
     if (it == mapAddr.end()) {
@@ -128,6 +189,34 @@ CAddrInfo *CAddrMan::Create(const CAddress &addr, const CNetAddr &addrSource,
     return &mapInfo[nId];
 }
 
+void CAddrMan::SetTried(int nKBucket, int nKBucketPos, int nId) {
+    int &entry = vvTried[nKBucket][nKBucketPos];
+    if (entry == -1 && nId != -1) {
+        m_tried_occupancy.Set(nKBucket, nKBucketPos);
+    } else if (entry != -1 && nId == -1) {
+        m_tried_occupancy.Unset(nKBucket, nKBucketPos);
+    }
+    entry = nId;
+}
+
+void CAddrMan::SetNew(int nUBucket, int nUBucketPos, int nId) {
+    int &entry = vvNew[nUBucket][nUBucketPos];
+    if (entry == -1 && nId != -1) {
+        m_new_occupancy.Set(nUBucket, nUBucketPos);
+    } else if (entry != -1 && nId == -1) {
+        m_new_occupancy.Unset(nUBucket, nUBucketPos);
+    }
+    entry = nId;
+}
+
+std::pair<int, int> CAddrMan::GetNewPosition(const uint256 &key,
+                                             const CAddress &addr,
+                                             const CNetAddr &source) const {
+    const CAddrInfo info(addr, source);
+    const int nUBucket = info.GetNewBucket(key, m_asmap);
+    return {nUBucket, info.GetBucketPosition(key, true, nUBucket)};
+}
+
 void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2) {
     if (nRndPos1 == nRndPos2) {
         return;
@@ -168,7 +257,7 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos) {
         CAddrInfo &infoDelete = mapInfo[nIdDelete];
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
-        vvNew[nUBucket][nUBucketPos] = -1;
+        SetNew(nUBucket, nUBucketPos, -1);
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
         }
@@ -182,7 +271,7 @@ void CAddrMan::MakeTried(CAddrInfo &info, int nId) {
         const int bucket{(start_bucket + n) % ADDRMAN_NEW_BUCKET_COUNT};
         const int pos{info.GetBucketPosition(nKey, true, bucket)};
         if (vvNew[bucket][pos] == nId) {
-            vvNew[bucket][pos] = -1;
+            SetNew(bucket, pos, -1);
             info.nRefCount--;
             if (info.nRefCount == 0) {
                 break;
@@ -207,7 +296,7 @@ void CAddrMan::MakeTried(CAddrInfo &info, int nId) {
 
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
-        vvTried[nKBucket][nKBucketPos] = -1;
+        SetTried(nKBucket, nKBucketPos, -1);
         nTried--;
 
         // find which new bucket it belongs to
@@ -218,12 +307,12 @@ void CAddrMan::MakeTried(CAddrInfo &info, int nId) {
 
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
-        vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        SetNew(nUBucket, nUBucketPos, nIdEvict);
         nNew++;
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
-    vvTried[nKBucket][nKBucketPos] = nId;
+    SetTried(nKBucket, nKBucketPos, nId);
     nTried++;
     info.fInTried = true;
 }
@@ -294,7 +383,7 @@ void CAddrMan::Good_(const CService &addr, bool test_before_evict,
 }
 
 bool CAddrMan::Add_(const CAddress &addr, const CNetAddr &source,
-                    int64_t nTimePenalty) {
+                    int64_t nTimePenalty, std::pair<int, int> new_position) {
     if (!addr.IsRoutable()) {
         return false;
     }
@@ -354,8 +443,12 @@ bool CAddrMan::Add_(const CAddress &addr, const CNetAddr &source,
         fNew = true;
     }
 
-    int nUBucket = pinfo->GetNewBucket(nKey, source, m_asmap);
-    int nUBucketPos = pinfo->GetBucketPosition(nKey, true, nUBucket);
+    // The position depends on the port, which may differ from the one of the
+    // entry found for this address.
+    if (!fNew && static_cast<const CService &>(*pinfo) != addr) {
+        new_position = GetNewPosition(nKey, *pinfo, source);
+    }
+    const auto [nUBucket, nUBucketPos] = new_position;
     if (vvNew[nUBucket][nUBucketPos] != nId) {
         bool fInsert = vvNew[nUBucket][nUBucketPos] == -1;
         if (!fInsert) {
@@ -369,7 +462,7 @@ bool CAddrMan::Add_(const CAddress &addr, const CNetAddr &source,
         if (fInsert) {
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
-            vvNew[nUBucket][nUBucketPos] = nId;
+            SetNew(nUBucket, nUBucketPos, nId);
         } else if (pinfo->nRefCount == 0) {
             Delete(nId);
         }
@@ -412,53 +505,24 @@ CAddrInfo CAddrMan::Select_(bool newOnly) {
     }
 
     // Use a 50% chance for choosing between tried and new table entries.
-    if (!newOnly &&
-        (nTried > 0 && (nNew == 0 || insecure_rand.randbool() == 0))) {
-        // use a tried node
-        double fChanceFactor = 1.0;
-        while (1) {
-            int nKBucket = insecure_rand.randrange(ADDRMAN_TRIED_BUCKET_COUNT);
-            int nKBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
-            while (vvTried[nKBucket][nKBucketPos] == -1) {
-                nKBucket = (nKBucket + insecure_rand.randbits(
-                                           ADDRMAN_TRIED_BUCKET_COUNT_LOG2)) %
-                           ADDRMAN_TRIED_BUCKET_COUNT;
-                nKBucketPos = (nKBucketPos + insecure_rand.randbits(
-                                                 ADDRMAN_BUCKET_SIZE_LOG2)) %
-                              ADDRMAN_BUCKET_SIZE;
-            }
-            int nId = vvTried[nKBucket][nKBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo &info = mapInfo[nId];
-            if (insecure_rand.randbits(30) <
-                fChanceFactor * info.GetChance() * (1 << 30)) {
-                return info;
-            }
-            fChanceFactor *= 1.2;
-        }
-    } else {
-        // use a new node
-        double fChanceFactor = 1.0;
-        while (1) {
-            int nUBucket = insecure_rand.randrange(ADDRMAN_NEW_BUCKET_COUNT);
-            int nUBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
-            while (vvNew[nUBucket][nUBucketPos] == -1) {
-                nUBucket = (nUBucket + insecure_rand.randbits(
-                                           ADDRMAN_NEW_BUCKET_COUNT_LOG2)) %
-                           ADDRMAN_NEW_BUCKET_COUNT;
-                nUBucketPos = (nUBucketPos + insecure_rand.randbits(
-                                                 ADDRMAN_BUCKET_SIZE_LOG2)) %
-                              ADDRMAN_BUCKET_SIZE;
-            }
-            int nId = vvNew[nUBucket][nUBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo &info = mapInfo[nId];
-            if (insecure_rand.randbits(30) <
-                fChanceFactor * info.GetChance() * (1 << 30)) {
-                return info;
-            }
-            fChanceFactor *= 1.2;
+    // Either way, an occupied position is picked uniformly at random.
+    const bool use_tried{!newOnly && nTried > 0 &&
+                         (nNew == 0 || insecure_rand.randbool() == 0)};
+    const AddrManOccupancy &occupancy{use_tried ? m_tried_occupancy
+                                                : m_new_occupancy};
+    double fChanceFactor = 1.0;
+    while (1) {
+        const auto [nBucket, nBucketPos] =
+            occupancy.Get(insecure_rand.randrange(occupancy.Count()));
+        int nId = use_tried ? vvTried[nBucket][nBucketPos]
+                            : vvNew[nBucket][nBucketPos];
+        assert(mapInfo.count(nId) == 1);
+        CAddrInfo &info = mapInfo[nId];
+        if (insecure_rand.randbits(30) <
+            fChanceFactor * info.GetChance() * (1 << 30)) {
+            return info;
         }
+        fChanceFactor *= 1.2;
     }
 }
 
@@ -549,6 +613,25 @@ int CAddrMan::Check_() {
         }
     }
 
+    int nTriedOccupied = 0;
+    for (int n = 0; n < ADDRMAN_TRIED_BUCKET_COUNT; n++) {
+        for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+            nTriedOccupied += vvTried[n][i] != -1;
+        }
+    }
+    if (nTriedOccupied != m_tried_occupancy.Count()) {
+        return -20;
+    }
+    int nNewOccupied = 0;
+    for (int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; n++) {
+        for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+            nNewOccupied += vvNew[n][i] != -1;
+        }
+    }
+    if (nNewOccupied != m_new_occupancy.Count()) {
+        return -21;
+    }
+
     if (setTried.size()) {
         return -13;
     }
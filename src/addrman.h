@@ -16,6 +16,7 @@
 #include <streams.h>
 #include <sync.h>
 #include <timedata.h>
+#include <util/asmap.h>
 #include <util/system.h>
 
 #include <tinyformat.h>
@@ -25,6 +26,8 @@
 #include <map>
 #include <optional>
 #include <set>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 /**
@@ -71,18 +74,16 @@ public:
     CAddrInfo() : CAddress(), source() {}
 
     //! Calculate in which "tried" bucket this entry belongs
-    int GetTriedBucket(const uint256 &nKey,
-                       const std::vector<bool> &asmap) const;
+    int GetTriedBucket(const uint256 &nKey, const CompiledAsmap &asmap) const;
 
     //! Calculate in which "new" bucket this entry belongs, given a certain
     //! source
     int GetNewBucket(const uint256 &nKey, const CNetAddr &src,
-                     const std::vector<bool> &asmap) const;
+                     const CompiledAsmap &asmap) const;
 
     //! Calculate in which "new" bucket this entry belongs, using its default
     //! source
-    int GetNewBucket(const uint256 &nKey,
-                     const std::vector<bool> &asmap) const {
+    int GetNewBucket(const uint256 &nKey, const CompiledAsmap &asmap) const {
         return GetNewBucket(nKey, source, asmap);
     }
 
@@ -185,6 +186,39 @@ public:
 //! seconds (40 minutes)
 static const int64_t ADDRMAN_TEST_WINDOW = 40 * 60;
 
+/**
+ * The occupied positions of the buckets of an addrman table, so that one of
+ * them can be picked uniformly at random without probing the empty ones.
+ */
+class AddrManOccupancy {
+    static_assert(ADDRMAN_BUCKET_SIZE == 64,
+                  "the positions of a bucket must fit in a uint64_t");
+
+    //! One bit per position of each bucket
+    std::vector<uint64_t> m_bitmaps;
+    //! Fenwick tree of the number of occupied positions per bucket
+    std::vector<int> m_tree;
+    //! Largest power of two not above the number of buckets
+    size_t m_top_step{1};
+    int m_count{0};
+
+    void Update(int bucket, int delta);
+
+public:
+    explicit AddrManOccupancy(int bucket_count);
+
+    void Clear();
+    void Set(int bucket, int pos);
+    void Unset(int bucket, int pos);
+
+    //! Number of occupied positions in the table
+    int Count() const { return m_count; }
+
+    //! Return the bucket and position of the n-th occupied position, counted
+    //! in table order from 0.
+    std::pair<int, int> Get(int n) const;
+};
+
 /**
  * Stochastical (IP) address manager
  */
@@ -206,6 +240,8 @@ private:
         V2_ASMAP = 2,
         //! same as V2_ASMAP plus addresses are in BIP155 format
         V3_BIP155 = 3,
+        //! same as V3_BIP155 plus the positions of the tried entries
+        V4_POSITIONS = 4,
     };
 
     //! The maximum format this software knows it can unserialize. Also, we
@@ -213,7 +249,7 @@ private:
     //! serialized stream) can be higher than this and still this software may
     //! be able to unserialize the file - if the second byte (see
     //! `lowest_compatible` in `Unserialize()`) is less or equal to this.
-    static constexpr Format FILE_FORMAT = Format::V3_BIP155;
+    static constexpr Format FILE_FORMAT = Format::V4_POSITIONS;
 
     //! The initial value of a field that is incremented every time an
     //! incompatible format change is made (such that old software versions
@@ -241,12 +277,19 @@ private:
     //! list of "tried" buckets
     int vvTried[ADDRMAN_TRIED_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE] GUARDED_BY(cs);
 
+    //! occupied positions of vvTried
+    AddrManOccupancy m_tried_occupancy GUARDED_BY(cs){
+        ADDRMAN_TRIED_BUCKET_COUNT};
+
     //! number of (unique) "new" entries
     int nNew GUARDED_BY(cs);
 
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE] GUARDED_BY(cs);
 
+    //! occupied positions of vvNew
+    AddrManOccupancy m_new_occupancy GUARDED_BY(cs){ADDRMAN_NEW_BUCKET_COUNT};
+
     //! last time Good was called (memory only)
     int64_t nLastGood GUARDED_BY(cs);
 
@@ -270,6 +313,20 @@ protected:
     CAddrInfo *Create(const CAddress &addr, const CNetAddr &addrSource,
                       int *pnId = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    //! Set a position of the "tried" or "new" table, keeping track of the
+    //! occupied ones. nId is -1 to clear it.
+    void SetTried(int nKBucket, int nKBucketPos, int nId)
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void SetNew(int nUBucket, int nUBucketPos, int nId)
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Calculate the bucket and position of addr in the "new" table when
+    //! learnt from source. Only reads nKey and m_asmap, so that it can run
+    //! without holding cs for a key read beforehand.
+    std::pair<int, int> GetNewPosition(const uint256 &key,
+                                       const CAddress &addr,
+                                       const CNetAddr &source) const;
+
     //! Swap two elements in vRandom.
     void SwapRandom(unsigned int nRandomPos1, unsigned int nRandomPos2)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -288,9 +345,11 @@ protected:
     void Good_(const CService &addr, bool test_before_evict, int64_t time)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
 
-    //! Add an entry to the "new" table.
+    //! Add an entry to the "new" table, at the position calculated by
+    //! GetNewPosition() with the current nKey.
     bool Add_(const CAddress &addr, const CNetAddr &source,
-              int64_t nTimePenalty) EXCLUSIVE_LOCKS_REQUIRED(cs);
+              int64_t nTimePenalty, std::pair<int, int> new_position)
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     //! Mark an entry as attempted to connect.
     void Attempt_(const CService &addr, bool fCountFailure, int64_t nTime)
@@ -363,7 +422,7 @@ public:
     //
     // If a new asmap was provided, the existing records
     // would be re-bucketed accordingly.
-    std::vector<bool> m_asmap;
+    CompiledAsmap m_asmap;
 
     /**
      * Serialized format.
@@ -381,22 +440,36 @@ public:
      * * nKey
      * * nNew
      * * nTried
-     * * number of "new" buckets XOR 2**30
+     * * number of "new" buckets, plus one for the tried positions, XOR 2**30
      * * all nNew addrinfos in vvNew
      * * all nTried addrinfos in vvTried
      * * for each bucket:
      *   * number of elements
      *   * for each element: index
+     * * the tried positions, written as one more bucket:
+     *   * nTried
+     *   * the position in vvTried of each tried addrinfo, in the same order
+     *   (bucket * ADDRMAN_BUCKET_SIZE + position)
+     * * asmap version
      *
      * 2**30 is xorred with the number of buckets to make addrman deserializer
      * v0 detect it as incompatible. This is necessary because it did not check
      * the version number on deserialization.
      *
-     * Notice that vvTried, mapAddr and vVector are never encoded explicitly;
-     * they are instead reconstructed from the other information.
+     * Notice that mapAddr and vVector are never encoded explicitly; they are
+     * instead reconstructed from the other information.
+     *
+     * The buckets in vvTried and vvNew are only used if the asmap and, for
+     * vvNew, ADDRMAN_NEW_BUCKET_COUNT didn't change, otherwise they are
+     * reconstructed as well. Reusing the tried buckets saves hashing the
+     * addresses into their bucket again when loading peers.dat. The positions
+     * within the buckets are always recomputed from nKey, which is stored in
+     * the same file, and an entry whose stored position doesn't match is
+     * bucketed again.
      *
-     * vvNew is serialized, but only used if ADDRMAN_UNKNOWN_BUCKET_COUNT didn't
-     * change, otherwise it is reconstructed as well.
+     * Since the tried positions look like one more bucket of the new table,
+     * the format=3 deserializer can parse the file: it finds an unexpected
+     * number of buckets, ignores them and buckets the new entries again.
      *
      * This format is more complex, but significantly smaller (at most 1.5 MiB),
      * and supports changes to the ADDRMAN_ parameters without breaking the
@@ -424,7 +497,7 @@ public:
         s << nNew;
         s << nTried;
 
-        int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
+        int nUBuckets = (ADDRMAN_NEW_BUCKET_COUNT + 1) ^ (1 << 30);
         s << nUBuckets;
         std::map<int, int> mapUnkIds;
         int nIds = 0;
@@ -439,13 +512,14 @@ public:
             }
         }
         nIds = 0;
-        for (const auto &entry : mapInfo) {
-            const CAddrInfo &info = entry.second;
-            if (info.fInTried) {
-                // this means nTried was wrong, oh ow
-                assert(nIds != nTried);
-                s << info;
-                nIds++;
+        for (int bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
+            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+                if (vvTried[bucket][i] != -1) {
+                    // this means nTried was wrong, oh ow
+                    assert(nIds != nTried);
+                    s << mapInfo.at(vvTried[bucket][i]);
+                    nIds++;
+                }
             }
         }
         for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
@@ -461,11 +535,19 @@ public:
                 }
             }
         }
+        s << nTried;
+        for (int bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
+            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+                if (vvTried[bucket][i] != -1) {
+                    s << bucket * ADDRMAN_BUCKET_SIZE + i;
+                }
+            }
+        }
         // Store asmap version after bucket entries so that it
         // can be ignored by older clients for backward compatibility.
         uint256 asmap_version;
-        if (m_asmap.size() != 0) {
-            asmap_version = SerializeHash(m_asmap);
+        if (!m_asmap.empty()) {
+            asmap_version = SerializeHash(m_asmap.GetBits());
         }
         s << asmap_version;
     }
@@ -529,32 +611,21 @@ public:
         }
         nIdCount = nNew;
 
-        // Deserialize entries from the tried table.
-        int nLost = 0;
-        for (int n = 0; n < nTried; n++) {
-            CAddrInfo info;
+        // Deserialize entries from the tried table. They are placed once their
+        // positions and the asmap version are known.
+        std::vector<CAddrInfo> tried_entries(nTried);
+        for (CAddrInfo &info : tried_entries) {
             s >> info;
-            int nKBucket = info.GetTriedBucket(nKey, m_asmap);
-            int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
-            if (vvTried[nKBucket][nKBucketPos] == -1) {
-                info.nRandomPos = vRandom.size();
-                info.fInTried = true;
-                vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
-                mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
-                nIdCount++;
-            } else {
-                nLost++;
-            }
         }
-        nTried -= nLost;
 
-        // Store positions in the new table buckets to apply later (if
-        // possible). Represents which entry belonged to which bucket when
-        // serializing
-        std::map<int, int> entryToBucket;
+        // The last bucket holds the tried positions.
+        if (format >= Format::V4_POSITIONS) {
+            nUBuckets--;
+        }
 
+        // Index and bucket of all the references to new entries, as they
+        // were when serializing.
+        std::vector<std::pair<int, int>> new_references;
         for (int bucket = 0; bucket < nUBuckets; bucket++) {
             int nSize = 0;
             s >> nSize;
@@ -562,49 +633,106 @@ public:
                 int nIndex = 0;
                 s >> nIndex;
                 if (nIndex >= 0 && nIndex < nNew) {
-                    entryToBucket[nIndex] = bucket;
+                    new_references.emplace_back(nIndex, bucket);
                 }
             }
         }
 
+        std::vector<int> tried_positions;
+        if (format >= Format::V4_POSITIONS) {
+            int nSize = 0;
+            s >> nSize;
+            if (nSize != nTried) {
+                throw std::ios_base::failure(
+                    "Corrupt CAddrMan serialization, tried positions count "
+                    "mismatch.");
+            }
+            tried_positions.resize(nSize);
+            for (int &position : tried_positions) {
+                s >> position;
+            }
+        }
+
         uint256 supplied_asmap_version;
-        if (m_asmap.size() != 0) {
-            supplied_asmap_version = SerializeHash(m_asmap);
+        if (!m_asmap.empty()) {
+            supplied_asmap_version = SerializeHash(m_asmap.GetBits());
         }
         uint256 serialized_asmap_version;
         if (format >= Format::V2_ASMAP) {
             s >> serialized_asmap_version;
         }
+        const bool same_asmap =
+            serialized_asmap_version == supplied_asmap_version;
 
-        for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
-            int bucket = entryToBucket[n];
-            int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
-            if (format >= Format::V2_ASMAP &&
-                nUBuckets == ADDRMAN_NEW_BUCKET_COUNT &&
-                vvNew[bucket][nUBucketPos] == -1 &&
-                info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS &&
-                serialized_asmap_version == supplied_asmap_version) {
-                // Bucketing has not changed, using existing bucket positions
-                // for the new table
-                vvNew[bucket][nUBucketPos] = n;
-                info.nRefCount++;
+        int nLost = 0;
+        for (size_t n = 0; n < tried_entries.size(); n++) {
+            CAddrInfo &info = tried_entries[n];
+            int nKBucket = -1;
+            int nKBucketPos = -1;
+            if (same_asmap && !tried_positions.empty() &&
+                tried_positions[n] >= 0 &&
+                tried_positions[n] <
+                    ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE) {
+                nKBucket = tried_positions[n] / ADDRMAN_BUCKET_SIZE;
+                nKBucketPos = tried_positions[n] % ADDRMAN_BUCKET_SIZE;
+                if (info.GetBucketPosition(nKey, false, nKBucket) !=
+                    nKBucketPos) {
+                    nKBucket = -1;
+                }
+            }
+            if (nKBucket == -1) {
+                nKBucket = info.GetTriedBucket(nKey, m_asmap);
+                nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
+            }
+            if (vvTried[nKBucket][nKBucketPos] == -1) {
+                info.nRandomPos = vRandom.size();
+                info.fInTried = true;
+                vRandom.push_back(nIdCount);
+                mapAddr[info] = nIdCount;
+                mapInfo[nIdCount] = std::move(info);
+                SetTried(nKBucket, nKBucketPos, nIdCount);
+                nIdCount++;
             } else {
-                // In case the new table data cannot be used (format unknown,
-                // bucket count wrong or new asmap), try to give them a
-                // reference based on their primary source address.
-                LogPrint(BCLog::ADDRMAN,
-                         "Bucketing method was updated, re-bucketing addrman "
-                         "entries from disk\n");
-                bucket = info.GetNewBucket(nKey, m_asmap);
-                nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
-                if (vvNew[bucket][nUBucketPos] == -1) {
-                    vvNew[bucket][nUBucketPos] = n;
+                nLost++;
+            }
+        }
+        nTried -= nLost;
+
+        if (format >= Format::V2_ASMAP &&
+            nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && same_asmap) {
+            // Bucketing has not changed, restore the references to the new
+            // entries in the buckets they were in.
+            for (const auto &[nIndex, bucket] : new_references) {
+                CAddrInfo &info = mapInfo[nIndex];
+                const int nUBucketPos =
+                    info.GetBucketPosition(nKey, true, bucket);
+                if (vvNew[bucket][nUBucketPos] == -1 &&
+                    info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
+                    SetNew(bucket, nUBucketPos, nIndex);
                     info.nRefCount++;
                 }
             }
         }
 
+        for (int n = 0; n < nNew; n++) {
+            CAddrInfo &info = mapInfo[n];
+            if (info.nRefCount > 0) {
+                continue;
+            }
+            // In case the new table data cannot be used (format unknown,
+            // bucket count wrong, new asmap or collision), try to give them a
+            // reference based on their primary source address.
+            LogPrint(BCLog::ADDRMAN,
+                     "Bucketing method was updated, re-bucketing addrman "
+                     "entries from disk\n");
+            const int bucket = info.GetNewBucket(nKey, m_asmap);
+            const int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
+            if (vvNew[bucket][nUBucketPos] == -1) {
+                SetNew(bucket, nUBucketPos, n);
+                info.nRefCount++;
+            }
+        }
+
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
         for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin();
@@ -641,6 +769,8 @@ public:
                 vvTried[bucket][entry] = -1;
             }
         }
+        m_new_occupancy.Clear();
+        m_tried_occupancy.Clear();
 
         nIdCount = 0;
         nTried = 0;
@@ -678,10 +808,18 @@ public:
     //! Add a single address.
     bool Add(const CAddress &addr, const CNetAddr &source,
              int64_t nTimePenalty = 0) {
+        // Hash the address into the new table before taking the lock, so
+        // that Select and GetAddr are not held up by it.
+        const uint256 key = WITH_LOCK(cs, return nKey);
+        std::pair<int, int> new_position = GetNewPosition(key, addr, source);
+
         LOCK(cs);
+        if (nKey != key) {
+            new_position = GetNewPosition(nKey, addr, source);
+        }
         bool fRet = false;
         Check();
-        fRet |= Add_(addr, source, nTimePenalty);
+        fRet |= Add_(addr, source, nTimePenalty, new_position);
         Check();
         if (fRet) {
             LogPrint(BCLog::ADDRMAN, "Added %s from %s: %i tried, %i new\n",
@@ -693,11 +831,24 @@ public:
     //! Add multiple addresses.
     bool Add(const std::vector<CAddress> &vAddr, const CNetAddr &source,
              int64_t nTimePenalty = 0) {
+        // Hash the addresses into the new table before taking the lock, so
+        // that Select and GetAddr are not held up by it.
+        const uint256 key = WITH_LOCK(cs, return nKey);
+        std::vector<std::pair<int, int>> new_positions;
+        new_positions.reserve(vAddr.size());
+        for (const CAddress &a : vAddr) {
+            new_positions.push_back(GetNewPosition(key, a, source));
+        }
+
         LOCK(cs);
         int nAdd = 0;
         Check();
-        for (const CAddress &a : vAddr) {
-            nAdd += Add_(a, source, nTimePenalty) ? 1 : 0;
+        for (size_t i = 0; i < vAddr.size(); ++i) {
+            if (nKey != key) {
+                new_positions[i] = GetNewPosition(nKey, vAddr[i], source);
+            }
+            nAdd += Add_(vAddr[i], source, nTimePenalty, new_positions[i]) ? 1
+                                                                          : 0;
         }
         Check();
         if (nAdd) {
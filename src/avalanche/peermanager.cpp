@@ -7,6 +7,7 @@
 #include <avalanche/avalanche.h>
 #include <avalanche/delegation.h>
 #include <avalanche/validation.h>
+#include <primitives/block.h>
 #include <random.h>
 #include <validation.h> // For ChainstateActive()
 
@@ -416,39 +417,101 @@ NodeId PeerManager::selectNode() {
     return NO_NODE;
 }
 
-void PeerManager::updatedBlockTip() {
+std::vector<ProofRef>
+PeerManager::rejectInvalidProofs(const std::vector<ProofRef> &proofs) {
     std::vector<ProofId> invalidProofIds;
     std::vector<ProofRef> newOrphans;
 
-    {
+    for (size_t i = 0; i < proofs.size();) {
         LOCK(cs_main);
 
         const CCoinsViewCache &coins = ::ChainstateActive().CoinsTip();
-        for (const auto &p : peers) {
+        const size_t end = std::min(proofs.size(), i + PROOF_RESCAN_BATCH_SIZE);
+        for (; i < end; i++) {
             ProofValidationState state;
-            if (!p.proof->verify(state, coins)) {
+            if (!proofs[i]->verify(state, coins)) {
                 if (isOrphanState(state)) {
-                    newOrphans.push_back(p.proof);
+                    newOrphans.push_back(proofs[i]);
                 }
-                invalidProofIds.push_back(p.getProofId());
+                invalidProofIds.push_back(proofs[i]->getId());
             }
         }
     }
 
-    // Remove the invalid proofs before the orphans rescan. This makes it
-    // possible to pull back proofs with utxos that conflicted with these
-    // invalid proofs.
+    // Remove the invalid proofs before the orphans are registered again. This
+    // makes it possible to pull back proofs with utxos that conflicted with
+    // these invalid proofs.
     for (const ProofId &invalidProofId : invalidProofIds) {
         rejectProof(invalidProofId, RejectionMode::INVALIDATE);
     }
 
-    orphanProofPool.rescan(*this);
+    return newOrphans;
+}
 
-    for (auto &p : newOrphans) {
+void PeerManager::registerOrphans(const std::vector<ProofRef> &orphans) {
+    for (const ProofRef &p : orphans) {
         orphanProofPool.addProofIfPreferred(p);
     }
 }
 
+void PeerManager::updatedBlockTip() {
+    std::vector<ProofRef> proofs;
+    proofs.reserve(peers.size());
+    for (const auto &p : peers) {
+        proofs.push_back(p.proof);
+    }
+
+    const std::vector<ProofRef> newOrphans = rejectInvalidProofs(proofs);
+
+    orphanProofPool.rescan(*this);
+
+    registerOrphans(newOrphans);
+}
+
+void PeerManager::blockConnected(const CBlock &block) {
+    std::vector<ProofRef> spendingProofs;
+    std::vector<ProofRef> fundedOrphans;
+
+    for (const CTransactionRef &tx : block.vtx) {
+        if (validProofPool.size() > 0 && !tx->IsCoinBase()) {
+            for (const CTxIn &in : tx->vin) {
+                ProofRef proof = validProofPool.getProof(in.prevout);
+                if (proof) {
+                    spendingProofs.push_back(std::move(proof));
+                }
+            }
+        }
+
+        if (orphanProofPool.size() > 0) {
+            for (uint32_t i = 0; i < tx->vout.size(); i++) {
+                ProofRef proof =
+                    orphanProofPool.getProof(COutPoint(tx->GetId(), i));
+                // Removing the proof from the pool also makes sure it is only
+                // registered again once.
+                if (proof && orphanProofPool.removeProof(proof->getId())) {
+                    fundedOrphans.push_back(std::move(proof));
+                }
+            }
+        }
+    }
+
+    // A proof staking several outpoints spent by the block is only verified
+    // once.
+    std::sort(spendingProofs.begin(), spendingProofs.end());
+    spendingProofs.erase(
+        std::unique(spendingProofs.begin(), spendingProofs.end()),
+        spendingProofs.end());
+
+    const std::vector<ProofRef> newOrphans =
+        rejectInvalidProofs(spendingProofs);
+
+    for (const ProofRef &proof : fundedOrphans) {
+        registerProof(proof);
+    }
+
+    registerOrphans(newOrphans);
+}
+
 ProofRef PeerManager::getProof(const ProofId &proofid) const {
     ProofRef proof = nullptr;
 
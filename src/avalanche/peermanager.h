@@ -28,6 +28,8 @@
 #include <unordered_set>
 #include <vector>
 
+class CBlock;
+
 namespace avalanche {
 
 class Delegation;
@@ -192,6 +194,12 @@ class PeerManager {
     static constexpr int SELECT_PEER_MAX_RETRY = 3;
     static constexpr int SELECT_NODE_MAX_RETRY = 3;
 
+    /**
+     * Number of proofs verified against the UTXO set per cs_main lock when
+     * rescanning the peers, so the rescan doesn't stall block validation.
+     */
+    static constexpr size_t PROOF_RESCAN_BATCH_SIZE = 1000;
+
     /**
      * Track proof ids to broadcast
      */
@@ -305,10 +313,19 @@ public:
     }
 
     /**
-     * Update the peer set when a new block is connected.
+     * Rescan all the proofs against the UTXO set. This is needed when the
+     * coins of any stake may have changed, e.g. after a block is disconnected.
      */
     void updatedBlockTip();
 
+    /**
+     * Update the proofs affected by a block connected to the tip, using the
+     * stake outpoints index of the proof pools: the peers staking an outpoint
+     * spent by the block are no longer valid, and the orphan proofs staking
+     * an outpoint created by the block may now be.
+     */
+    void blockConnected(const CBlock &block);
+
     /**
      * Proof broadcast API.
      */
@@ -358,6 +375,13 @@ public:
 
 private:
     void moveToConflictingPool(const ProofRef &proof);
+    /**
+     * Reject the proofs that are no longer valid against the UTXO set, and
+     * return the ones that became orphans.
+     */
+    std::vector<ProofRef>
+    rejectInvalidProofs(const std::vector<ProofRef> &proofs);
+    void registerOrphans(const std::vector<ProofRef> &orphans);
     bool addOrUpdateNode(const PeerSet::iterator &it, NodeId nodeid);
     bool addNodeToPeer(const PeerSet::iterator &it);
     bool removeNodeFromPeer(const PeerSet::iterator &it, uint32_t count = 1);
@@ -128,8 +128,17 @@ public:
             m_processor->peerManager->addUnbroadcastProof(
                 m_processor->peerData->proof->getId());
         }
+    }
+
+    void blockConnected(const CBlock &block, int height) override {
+        LOCK(m_processor->cs_peerManager);
+        m_processor->peerManager->blockConnected(block);
+    }
 
-        m_processor->peerManager->updatedBlockTip();
+    void blockDisconnected(const CBlock &block, int height) override {
+        // Any stake may have changed, leave it to the event loop to rescan the
+        // proofs.
+        m_processor->proofRescanPending = true;
     }
 };
 
@@ -145,8 +154,8 @@ Processor::Processor(const ArgsManager &argsman, interfaces::Chain &chain,
       minQuorumScore(minQuorumTotalScoreIn),
       minQuorumConnectedScoreRatio(minQuorumConnectedScoreRatioIn) {
     // Make sure we get notified of chain state changes.
-    chainNotificationsHandler =
-        chain.handleNotifications(std::make_shared<NotificationsHandler>(this));
+    chainNotificationsHandler = chain.handleNotifications(
+        std::make_shared<NotificationsHandler>(this), "avalanche");
 }
 
 Processor::~Processor() {
@@ -698,6 +707,13 @@ void Processor::clearTimedoutRequests() {
 }
 
 void Processor::runEventLoop() {
+    // The full rescan of the proofs is done here rather than from the chain
+    // notifications, so it doesn't hold up the other subscribers.
+    if (proofRescanPending.exchange(false)) {
+        LOCK(cs_peerManager);
+        peerManager->updatedBlockTip();
+    }
+
     // Don't do Avalanche while node is IBD'ing
     if (::ChainstateActive().IsInitialBlockDownload()) {
         return;
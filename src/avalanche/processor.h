@@ -113,6 +113,11 @@ class Processor {
     mutable Mutex cs_peerManager;
     std::unique_ptr<PeerManager> peerManager GUARDED_BY(cs_peerManager);
 
+    /**
+     * Set when a block is disconnected, so the event loop rescans the proofs.
+     */
+    std::atomic<bool> proofRescanPending{false};
+
     struct Query {
         NodeId nodeid;
         uint64_t round;
@@ -574,6 +574,80 @@ BOOST_AUTO_TEST_CASE(node_binding_reorg) {
     BOOST_CHECK(pm.verify());
 }
 
+BOOST_AUTO_TEST_CASE(block_connected) {
+    avalanche::PeerManager pm;
+
+    auto key = CKey::MakeCompressedKey();
+    const CScript script = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const Amount amount = 1 * COIN;
+    const int height = 1234;
+
+    // The stake of this proof is created by a transaction of the block
+    CMutableTransaction fundingTx;
+    fundingTx.vin.resize(1);
+    fundingTx.vin[0].prevout = COutPoint(TxId(GetRandHash()), 0);
+    fundingTx.vout.emplace_back(amount, script);
+    const COutPoint fundedUtxo(fundingTx.GetId(), 0);
+
+    ProofBuilder pbFunded(0, 0, CKey::MakeCompressedKey());
+    BOOST_CHECK(pbFunded.addUTXO(fundedUtxo, amount, height, false, key));
+    auto fundedProof = pbFunded.build();
+
+    // The stake of this proof is spent by a transaction of the block
+    const COutPoint spentUtxo(TxId(GetRandHash()), 0);
+    ProofBuilder pbSpent(0, 0, CKey::MakeCompressedKey());
+    BOOST_CHECK(pbSpent.addUTXO(spentUtxo, amount, height, false, key));
+    auto spentProof = pbSpent.build();
+
+    // This proof is not affected by the block
+    auto otherProof = buildRandomProof(MIN_VALID_PROOF_SCORE);
+
+    {
+        LOCK(cs_main);
+        CCoinsViewCache &coins = ::ChainstateActive().CoinsTip();
+        coins.AddCoin(spentUtxo, Coin(CTxOut(amount, script), height, false),
+                      false);
+    }
+
+    BOOST_CHECK(!pm.registerProof(fundedProof));
+    BOOST_CHECK(pm.isOrphan(fundedProof->getId()));
+    BOOST_CHECK(pm.registerProof(spentProof));
+    BOOST_CHECK(pm.registerProof(otherProof));
+
+    CMutableTransaction spendingTx;
+    spendingTx.vin.resize(1);
+    spendingTx.vin[0].prevout = spentUtxo;
+    spendingTx.vout.emplace_back(amount, script);
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(fundingTx));
+    block.vtx.push_back(MakeTransactionRef(spendingTx));
+
+    // Update the UTXO set as if the block was connected
+    {
+        LOCK(cs_main);
+        CCoinsViewCache &coins = ::ChainstateActive().CoinsTip();
+        coins.AddCoin(fundedUtxo, Coin(CTxOut(amount, script), height, false),
+                      false);
+        coins.SpendCoin(spentUtxo);
+    }
+
+    pm.blockConnected(block);
+    BOOST_CHECK(pm.isBoundToPeer(fundedProof->getId()));
+    BOOST_CHECK(!pm.isOrphan(fundedProof->getId()));
+    BOOST_CHECK(!pm.isBoundToPeer(spentProof->getId()));
+    BOOST_CHECK(pm.isOrphan(spentProof->getId()));
+    BOOST_CHECK(pm.isBoundToPeer(otherProof->getId()));
+    BOOST_CHECK(pm.verify());
+
+    // A full rescan agrees with the incremental update
+    pm.updatedBlockTip();
+    BOOST_CHECK(pm.isBoundToPeer(fundedProof->getId()));
+    BOOST_CHECK(pm.isOrphan(spentProof->getId()));
+    BOOST_CHECK(pm.isBoundToPeer(otherProof->getId()));
+    BOOST_CHECK(pm.verify());
+}
+
 BOOST_AUTO_TEST_CASE(proof_conflict) {
     auto key = CKey::MakeCompressedKey();
     const CScript script = GetScriptForDestination(PKHash(key.GetPubKey()));
@@ -4,7 +4,10 @@
 
 #include <addrman.h>
 #include <bench/bench.h>
+#include <clientversion.h>
 #include <random.h>
+#include <streams.h>
+#include <util/asmap.h>
 #include <util/time.h>
 
 #include <optional>
@@ -61,6 +64,83 @@ static void AddAddressesToAddrMan(CAddrMan &addrman) {
     }
 }
 
+/*
+ * A synthetic asmap with a lookup depth similar to a real one: the first
+ * ASMAP_DEPTH bits of the address select a default AS, and the next 8 bits
+ * a more specific one.
+ */
+
+static constexpr int ASMAP_DEPTH = 16;
+static constexpr uint32_t ASMAP_ASNS = 5000;
+
+static CompiledAsmap g_asmap;
+
+//! Inverse of the bit decoding in util/asmap.cpp
+static void EncodeBits(std::vector<bool> &bits, uint32_t val, uint32_t minval,
+                       const std::vector<uint8_t> &bit_sizes) {
+    val -= minval;
+    for (size_t i = 0; i < bit_sizes.size(); ++i) {
+        const uint8_t bit_size = bit_sizes[i];
+        if (i + 1 < bit_sizes.size()) {
+            if (val >= (1U << bit_size)) {
+                bits.push_back(true);
+                val -= 1U << bit_size;
+                continue;
+            }
+            bits.push_back(false);
+        }
+        for (int b = bit_size - 1; b >= 0; --b) {
+            bits.push_back((val >> b) & 1);
+        }
+        return;
+    }
+}
+
+static void EncodeType(std::vector<bool> &bits, uint32_t type) {
+    EncodeBits(bits, type, 0, {0, 0, 1});
+}
+
+static void EncodeASN(std::vector<bool> &bits, uint32_t asn) {
+    EncodeBits(bits, asn, 1, {15, 16, 17, 18, 19, 20, 21, 22, 23, 24});
+}
+
+static std::vector<bool> EncodeAsmapTree(FastRandomContext &rng, int depth) {
+    std::vector<bool> bits;
+    if (depth == ASMAP_DEPTH) {
+        // DEFAULT, MATCH and RETURN
+        EncodeType(bits, 3);
+        EncodeASN(bits, 1 + rng.randrange(ASMAP_ASNS));
+        EncodeType(bits, 2);
+        EncodeBits(bits, 0x100 | rng.randbits(8), 2, {1, 2, 3, 4, 5, 6, 7, 8});
+        EncodeType(bits, 0);
+        EncodeASN(bits, 1 + rng.randrange(ASMAP_ASNS));
+        return bits;
+    }
+
+    const std::vector<bool> left = EncodeAsmapTree(rng, depth + 1);
+    const std::vector<bool> right = EncodeAsmapTree(rng, depth + 1);
+    // JUMP over the left subtree when the bit is set.
+    EncodeType(bits, 1);
+    EncodeBits(bits, left.size(), 17,
+               {5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15, 16, 17,
+                18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30});
+    bits.insert(bits.end(), left.begin(), left.end());
+    bits.insert(bits.end(), right.begin(), right.end());
+    return bits;
+}
+
+static void CreateAsmap() {
+    // already created
+    if (!g_asmap.empty()) {
+        return;
+    }
+
+    FastRandomContext rng(uint256(std::vector<uint8_t>(32, 42)));
+    std::vector<bool> asmap = EncodeAsmapTree(rng, 0);
+    assert(SanityCheckASMap(asmap, 128));
+    g_asmap = CompiledAsmap(std::move(asmap));
+}
+
 static void FillAddrMan(CAddrMan &addrman) {
     CreateAddresses();
 
@@ -69,10 +149,14 @@ static void FillAddrMan(CAddrMan &addrman) {
 
 /* Benchmarks */
 
-static void AddrManAdd(benchmark::Bench &bench) {
+static void RunAddrManAdd(benchmark::Bench &bench, bool asmap) {
     CreateAddresses();
 
     CAddrMan addrman;
+    if (asmap) {
+        CreateAsmap();
+        addrman.m_asmap = g_asmap;
+    }
 
     bench.run([&] {
         AddAddressesToAddrMan(addrman);
@@ -80,6 +164,14 @@ static void AddrManAdd(benchmark::Bench &bench) {
     });
 }
 
+static void AddrManAdd(benchmark::Bench &bench) {
+    RunAddrManAdd(bench, false);
+}
+
+static void AddrManAddAsmap(benchmark::Bench &bench) {
+    RunAddrManAdd(bench, true);
+}
+
 static void AddrManSelect(benchmark::Bench &bench) {
     CAddrMan addrman;
 
@@ -91,6 +183,19 @@ static void AddrManSelect(benchmark::Bench &bench) {
     });
 }
 
+static void AddrManSelectSparse(benchmark::Bench &bench) {
+    CreateAddresses();
+
+    // A table filled to a fraction of a percent, as after a fresh start.
+    CAddrMan addrman;
+    addrman.Add(g_addresses[0], g_sources[0]);
+
+    bench.run([&] {
+        const auto &address = addrman.Select();
+        assert(address.GetPort() > 0);
+    });
+}
+
 static void AddrManGetAddr(benchmark::Bench &bench) {
     CAddrMan addrman;
 
@@ -104,7 +209,7 @@ static void AddrManGetAddr(benchmark::Bench &bench) {
     });
 }
 
-static void AddrManGood(benchmark::Bench &bench) {
+static void RunAddrManGood(benchmark::Bench &bench, bool asmap) {
     /*
      * Create many CAddrMan objects - one to be modified at each loop iteration.
      * This is necessary because the CAddrMan::Good() method modifies the
@@ -115,7 +220,13 @@ static void AddrManGood(benchmark::Bench &bench) {
     bench.epochs(5).epochIterations(1);
 
     std::vector<CAddrMan> addrmans(bench.epochs() * bench.epochIterations());
+    if (asmap) {
+        CreateAsmap();
+    }
     for (auto &addrman : addrmans) {
+        if (asmap) {
+            addrman.m_asmap = g_asmap;
+        }
         FillAddrMan(addrman);
     }
 
@@ -137,7 +248,76 @@ static void AddrManGood(benchmark::Bench &bench) {
     });
 }
 
+static void AddrManGood(benchmark::Bench &bench) {
+    RunAddrManGood(bench, false);
+}
+
+static void AddrManGoodAsmap(benchmark::Bench &bench) {
+    RunAddrManGood(bench, true);
+}
+
+static void AddrManDeserialize(benchmark::Bench &bench) {
+    CAddrMan addrman;
+    FillAddrMan(addrman);
+    for (size_t source_i = 0; source_i < NUM_SOURCES; ++source_i) {
+        for (size_t addr_i = 0; addr_i < NUM_ADDRESSES_PER_SOURCE;
+             addr_i += 16) {
+            addrman.Good(g_addresses[source_i][addr_i]);
+        }
+    }
+
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << addrman;
+    const CDataStream serialized(stream);
+
+    bench.batch(addrman.size()).unit("addr").run([&] {
+        CDataStream s(serialized);
+        s >> addrman;
+        assert(s.empty());
+    });
+}
+
+static void RunAsmapLookup(benchmark::Bench &bench, bool compiled) {
+    CreateAddresses();
+    CreateAsmap();
+
+    std::vector<std::vector<uint8_t>> ips;
+    std::vector<std::vector<bool>> ips_bits;
+    for (const CAddress &addr : g_sources) {
+        ips.push_back(addr.GetAddrBytes());
+        assert(ips.back().size() == ADDR_IPV6_SIZE);
+        std::vector<bool> bits(128);
+        for (int bit = 0; bit < 128; ++bit) {
+            bits[bit] = (ips.back()[bit / 8] >> (7 - bit % 8)) & 1;
+        }
+        ips_bits.push_back(std::move(bits));
+    }
+
+    bench.batch(ips.size()).unit("lookup").run([&] {
+        for (size_t i = 0; i < ips.size(); ++i) {
+            const uint32_t asn =
+                compiled ? g_asmap.Lookup(ips[i])
+                         : Interpret(g_asmap.GetBits(), ips_bits[i]);
+            assert(asn != 0);
+        }
+    });
+}
+
+static void AsmapInterpret(benchmark::Bench &bench) {
+    RunAsmapLookup(bench, false);
+}
+
+static void AsmapCompiledLookup(benchmark::Bench &bench) {
+    RunAsmapLookup(bench, true);
+}
+
 BENCHMARK(AddrManAdd);
+BENCHMARK(AddrManAddAsmap);
 BENCHMARK(AddrManSelect);
+BENCHMARK(AddrManSelectSparse);
 BENCHMARK(AddrManGetAddr);
 BENCHMARK(AddrManGood);
+BENCHMARK(AddrManGoodAsmap);
+BENCHMARK(AddrManDeserialize);
+BENCHMARK(AsmapInterpret);
+BENCHMARK(AsmapCompiledLookup);
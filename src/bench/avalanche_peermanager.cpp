@@ -0,0 +1,118 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <avalanche/peermanager.h>
+#include <avalanche/proofbuilder.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <script/standard.h>
+#include <validation.h>
+
+#include <test/util/setup_common.h>
+
+#include <cassert>
+#include <vector>
+
+/* Number of transactions of the connected block */
+static constexpr size_t BLOCK_TX_COUNT = 1000;
+
+/**
+ * Register numProofs proofs, each with a single stake, and return a block
+ * spending none of the stakes.
+ */
+static CBlock RegisterProofs(avalanche::PeerManager &pm, size_t numProofs) {
+    const CKey key = CKey::MakeCompressedKey();
+    const CScript script = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const Amount amount = 100 * COIN;
+    const int height = 100;
+
+    for (size_t i = 0; i < numProofs; i++) {
+        const COutPoint utxo(TxId(GetRandHash()), 0);
+        {
+            LOCK(cs_main);
+            CCoinsViewCache &coins = ::ChainstateActive().CoinsTip();
+            coins.AddCoin(utxo, Coin(CTxOut(amount, script), height, false),
+                          false);
+        }
+
+        avalanche::ProofBuilder pb(0, 0, CKey::MakeCompressedKey());
+        bool added = pb.addUTXO(utxo, amount, height, false, key);
+        assert(added);
+        bool registered = pm.registerProof(pb.build());
+        assert(registered);
+    }
+
+    CBlock block;
+    for (size_t i = 0; i < BLOCK_TX_COUNT; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(2);
+        tx.vin[0].prevout = COutPoint(TxId(GetRandHash()), 0);
+        tx.vin[1].prevout = COutPoint(TxId(GetRandHash()), 1);
+        tx.vout.resize(2, CTxOut(amount, script));
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+
+    return block;
+}
+
+/**
+ * The update of the avalanche peers when a block is connected, as the number
+ * of registered proofs grows.
+ */
+static void AvalancheBlockConnected(benchmark::Bench &bench,
+                                    size_t numProofs) {
+    const TestingSetup test_setup{CBaseChainParams::REGTEST,
+                                  {"-nodebuglogfile", "-nodebug"}};
+    avalanche::PeerManager pm;
+    const CBlock block = RegisterProofs(pm, numProofs);
+
+    bench.unit("block").minEpochIterations(10).run(
+        [&] { pm.blockConnected(block); });
+}
+
+/**
+ * The full rescan of the proofs, which used to run for each block and is now
+ * only needed when a block is disconnected.
+ */
+static void AvalancheProofsRescan(benchmark::Bench &bench, size_t numProofs) {
+    const TestingSetup test_setup{CBaseChainParams::REGTEST,
+                                  {"-nodebuglogfile", "-nodebug"}};
+    avalanche::PeerManager pm;
+    RegisterProofs(pm, numProofs);
+
+    bench.unit("rescan").run([&] { pm.updatedBlockTip(); });
+}
+
+static void AvalancheBlockConnected100Proofs(benchmark::Bench &bench) {
+    AvalancheBlockConnected(bench, 100);
+}
+
+static void AvalancheBlockConnected1000Proofs(benchmark::Bench &bench) {
+    AvalancheBlockConnected(bench, 1000);
+}
+
+static void AvalancheBlockConnected10000Proofs(benchmark::Bench &bench) {
+    AvalancheBlockConnected(bench, 10000);
+}
+
+static void AvalancheProofsRescan100Proofs(benchmark::Bench &bench) {
+    AvalancheProofsRescan(bench, 100);
+}
+
+static void AvalancheProofsRescan1000Proofs(benchmark::Bench &bench) {
+    AvalancheProofsRescan(bench, 1000);
+}
+
+static void AvalancheProofsRescan10000Proofs(benchmark::Bench &bench) {
+    AvalancheProofsRescan(bench, 10000);
+}
+
+BENCHMARK(AvalancheBlockConnected100Proofs);
+BENCHMARK(AvalancheBlockConnected1000Proofs);
+BENCHMARK(AvalancheBlockConnected10000Proofs);
+BENCHMARK(AvalancheProofsRescan100Proofs);
+BENCHMARK(AvalancheProofsRescan1000Proofs);
+BENCHMARK(AvalancheProofsRescan10000Proofs);
@@ -32,6 +32,8 @@ void GenerateTemplateResults(
 
 } // namespace
 
+std::string benchmark::g_block_replay_file;
+
 benchmark::BenchRunner::BenchmarkMap &benchmark::BenchRunner::benchmarks() {
     static std::map<std::string, BenchFunction> benchmarks_map;
     return benchmarks_map;
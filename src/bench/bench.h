@@ -46,6 +46,9 @@ struct Args {
     std::string output_json;
 };
 
+//! File written by the dumpblockreplay RPC for the block replay benchmarks
+extern std::string g_block_replay_file;
+
 class BenchRunner {
     typedef std::map<std::string, BenchFunction> BenchmarkMap;
     static BenchmarkMap &benchmarks();
@@ -4,6 +4,8 @@
 
 #include <bench/bench.h>
 
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
 #include <crypto/sha256.h>
 #include <util/strencodings.h>
 #include <util/system.h>
@@ -15,6 +17,10 @@ static const char *DEFAULT_BENCH_FILTER = ".*";
 static void SetupBenchArgs(ArgsManager &argsman) {
     SetupHelpOptions(argsman);
 
+    argsman.AddArg("-blockreplay=<file>",
+                   "Replay the blocks written by the dumpblockreplay RPC in "
+                   "the BlockReplay benchmarks instead of generated blocks",
+                   ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-list", "List benchmarks without executing them",
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-filter=<regex>",
@@ -52,6 +58,8 @@ int main(int argc, char **argv) {
     ArgsManager argsman;
     SetupBenchArgs(argsman);
     SHA256AutoDetect();
+    ChaCha20AutoDetect();
+    Poly1305AutoDetect();
     std::string error;
     if (!argsman.ParseParameters(argc, argv, error)) {
         tfm::format(std::cerr, "Error parsing command line arguments: %s\n",
@@ -70,6 +78,7 @@ int main(int argc, char **argv) {
     args.asymptote = parseAsymptote(argsman.GetArg("-asymptote", ""));
     args.output_csv = argsman.GetArg("-output_csv", "");
     args.output_json = argsman.GetArg("-output_json", "");
+    benchmark::g_block_replay_file = argsman.GetArg("-blockreplay", "");
 
     benchmark::BenchRunner::RunAll(args);
 
@@ -0,0 +1,167 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <config.h>
+#include <consensus/params.h>
+#include <key.h>
+#include <node/blockreplay.h>
+#include <primitives/transaction.h>
+#include <script/interpreter.h>
+#include <script/script.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <validation.h>
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+
+//! Number of blocks in the generated range
+static constexpr int REPLAY_BLOCKS = 10;
+//! Number of outputs created by the fan out transaction of each block
+static constexpr int REPLAY_FANOUT = 100;
+//! Number of inputs of each consolidation transaction
+static constexpr int REPLAY_FANIN = 5;
+
+static void SignInput(CMutableTransaction &mtx, unsigned int nIn,
+                      const CKey &key, const CScript &scriptCode,
+                      const Amount amount, uint32_t flags, bool p2pkh) {
+    const SigHashType sigHashType = SigHashType().withForkId();
+    const uint256 hash = SignatureHash(scriptCode, CTransaction(mtx), nIn,
+                                       sigHashType, amount, nullptr, flags);
+    std::vector<uint8_t> sig;
+    bool ok = key.SignECDSA(hash, sig);
+    assert(ok);
+    sig.push_back(uint8_t(sigHashType.getRawSigHashType()));
+    mtx.vin[nIn].scriptSig = CScript() << sig;
+    if (p2pkh) {
+        mtx.vin[nIn].scriptSig << ToByteVector(key.GetPubKey());
+    }
+}
+
+/**
+ * Mine REPLAY_BLOCKS blocks on top of the test chain and export them. Each
+ * block fans a mature coinbase out to P2PKH outputs and consolidates the
+ * outputs created by the previous block.
+ */
+static BlockReplayData GenerateReplayData(TestChain100Setup &setup) {
+    const CKey &key = setup.coinbaseKey;
+    const CScript coinbaseScript = CScript() << ToByteVector(key.GetPubKey())
+                                             << OP_CHECKSIG;
+    const CScript p2pkh = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const Consensus::Params &params = Params().GetConsensus();
+
+    const int start_height =
+        WITH_LOCK(cs_main, return ::ChainActive().Height()) + 1;
+    CTransactionRef prev_fanout;
+    for (int i = 0; i < REPLAY_BLOCKS; ++i) {
+        // Sign the way the next block will verify.
+        uint32_t flags = SCRIPT_ENABLE_SIGHASH_FORKID;
+        if (WITH_LOCK(cs_main,
+                      return ::ChainActive().Tip()->GetMedianTimePast()) >=
+            params.jeffersonActivationTime) {
+            flags |= SCRIPT_ENABLE_REPLAY_PROTECTION;
+        }
+
+        std::vector<CMutableTransaction> txns;
+        const CTransactionRef &coinbase = setup.m_coinbase_txns[i];
+        CMutableTransaction fanout;
+        fanout.vin.emplace_back(COutPoint(coinbase->GetId(), 0));
+        const Amount fanout_value =
+            (coinbase->vout[0].nValue - 10000 * SATOSHI) / REPLAY_FANOUT;
+        fanout.vout.assign(REPLAY_FANOUT, CTxOut(fanout_value, p2pkh));
+        SignInput(fanout, 0, key, coinbaseScript, coinbase->vout[0].nValue,
+                  flags, false);
+        txns.push_back(fanout);
+
+        for (int j = 0; prev_fanout && j < REPLAY_FANOUT; j += REPLAY_FANIN) {
+            CMutableTransaction consolidation;
+            Amount value = Amount::zero();
+            for (int k = j; k < j + REPLAY_FANIN; ++k) {
+                consolidation.vin.emplace_back(
+                    COutPoint(prev_fanout->GetId(), k));
+                value += prev_fanout->vout[k].nValue;
+            }
+            consolidation.vout.emplace_back(value - 1000 * SATOSHI, p2pkh);
+            for (int k = 0; k < REPLAY_FANIN; ++k) {
+                SignInput(consolidation, k, key, p2pkh,
+                          prev_fanout->vout[j + k].nValue, flags, true);
+            }
+            txns.push_back(consolidation);
+        }
+
+        setup.CreateAndProcessBlock(txns, coinbaseScript);
+        prev_fanout = MakeTransactionRef(fanout);
+    }
+
+    assert(WITH_LOCK(cs_main, return ::ChainActive().Height()) ==
+           start_height + REPLAY_BLOCKS - 1);
+    BlockReplayData data;
+    std::string error;
+    bool ok = ExportBlockReplay(::ChainActive(), Params(), start_height,
+                                start_height + REPLAY_BLOCKS - 1, data, error);
+    assert(ok);
+    return data;
+}
+
+static void RunBlockReplay(benchmark::Bench &bench,
+                           const BasicTestingSetup &setup,
+                           BlockReplayData data, bool warm_cache) {
+    BlockReplay replay(std::move(data), Params(),
+                       setup.m_path_root / "replay");
+    const size_t blocks = replay.GetData().blocks.size();
+
+    BlockReplayOptions options;
+    options.warm_cache = warm_cache;
+    BlockReplayTimings timings;
+    bench.batch(blocks).unit("block").run([&] {
+        LOCK(cs_main);
+        std::string error;
+        bool ok = replay.Run(GetConfig(), ::ChainstateActive(), options,
+                             timings, error);
+        assert(ok);
+    });
+
+    const double blocks_total = timings.blocks * 1000.0;
+    std::cout << strprintf(
+        "%s phases (ms/block): fetch inputs %.3f, connect %.3f, undo write "
+        "%.3f, flush %.3f, disconnect %.3f (%u blocks, %u base coins)\n",
+        bench.name(), timings.fetch_inputs / blocks_total,
+        timings.connect / blocks_total, timings.undo_write / blocks_total,
+        timings.flush / blocks_total, timings.disconnect / blocks_total,
+        blocks, replay.GetBaseCoinsCount());
+}
+
+static void BlockReplayBench(benchmark::Bench &bench, bool warm_cache) {
+    if (!benchmark::g_block_replay_file.empty()) {
+        const fs::path path =
+            fs::PathFromString(benchmark::g_block_replay_file);
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        assert(!file.IsNull());
+        BlockReplayData data;
+        file >> data;
+        const TestingSetup setup{data.chain, {"-nodebuglogfile", "-nodebug"}};
+        RunBlockReplay(bench, setup, std::move(data), warm_cache);
+        return;
+    }
+
+    TestChain100Setup setup;
+    RunBlockReplay(bench, setup, GenerateReplayData(setup), warm_cache);
+}
+
+static void BlockReplayColdCache(benchmark::Bench &bench) {
+    BlockReplayBench(bench, false);
+}
+
+static void BlockReplayWarmCache(benchmark::Bench &bench) {
+    BlockReplayBench(bench, true);
+}
+
+BENCHMARK(BlockReplayColdCache);
+BENCHMARK(BlockReplayWarmCache);
@@ -4,6 +4,11 @@
 
 #include <bench/bench.h>
 #include <cashaddr.h>
+#include <cashaddrenc.h>
+#include <chainparams.h>
+#include <config.h>
+#include <crypto/common.h>
+#include <key_io.h>
 
 #include <string>
 #include <vector>
@@ -28,5 +33,77 @@ static void CashAddrDecode(benchmark::Bench &bench) {
     });
 }
 
+/**
+ * The destinations of a batch of outputs, half of them paying to a few hot
+ * addresses as in the blocks returned by verbose RPCs, and the other half to
+ * addresses that are not seen again in later batches.
+ */
+class OutputDestinations {
+private:
+    static constexpr int OUTPUTS = 1000;
+    static constexpr int HOT_DESTINATIONS = 50;
+
+    uint32_t m_batch{0};
+
+    static CTxDestination MakeDestination(int n, uint32_t batch) {
+        uint160 hash;
+        WriteLE32(hash.begin(), n);
+        WriteLE32(hash.begin() + 4, batch);
+        if (n % 3) {
+            return PKHash(hash);
+        }
+        return ScriptHash(hash);
+    }
+
+public:
+    std::vector<CTxDestination> dests;
+
+    OutputDestinations() {
+        for (int i = 0; i < OUTPUTS; ++i) {
+            dests.push_back(
+                MakeDestination(i % 2 ? i % HOT_DESTINATIONS : i, 0));
+        }
+    }
+
+    void NextBatch() {
+        ++m_batch;
+        for (int i = 0; i < OUTPUTS; i += 2) {
+            dests[i] = MakeDestination(i, m_batch);
+        }
+    }
+};
+
+static void CashAddrEncodeDestinations(benchmark::Bench &bench) {
+    SelectParams(CBaseChainParams::MAIN);
+    OutputDestinations outputs;
+    bench.batch(outputs.dests.size())
+        .unit("address")
+        .minEpochIterations(100)
+        .run([&] {
+            outputs.NextBatch();
+            for (const CTxDestination &dest : outputs.dests) {
+                EncodeCashAddr(dest, Params());
+            }
+        });
+}
+
+static void CashAddrEncodeDestinationsCached(benchmark::Bench &bench) {
+    SelectParams(CBaseChainParams::MAIN);
+    GlobalConfig config;
+    config.SetCashAddrEncoding(true);
+    OutputDestinations outputs;
+    bench.batch(outputs.dests.size())
+        .unit("address")
+        .minEpochIterations(100)
+        .run([&] {
+            outputs.NextBatch();
+            for (const CTxDestination &dest : outputs.dests) {
+                EncodeDestination(dest, config);
+            }
+        });
+}
+
 BENCHMARK(CashAddrEncode);
 BENCHMARK(CashAddrDecode);
+BENCHMARK(CashAddrEncodeDestinations);
+BENCHMARK(CashAddrEncodeDestinationsCached);
@@ -0,0 +1,114 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <hash.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <uint256.h>
+
+#include <cassert>
+#include <memory>
+
+//! Number of entries in the benchmark database
+static constexpr uint32_t DB_BENCH_ENTRIES = 100000;
+//! Roughly the serialized size of a coin
+static constexpr size_t DB_BENCH_VALUE_SIZE = 40;
+
+/** A chainstate-like key: a prefix and a random looking hash. */
+static std::pair<char, uint256> BenchKey(uint32_t i) {
+    return std::make_pair('c', (CHashWriter(SER_GETHASH, 0) << i).GetHash());
+}
+
+static std::unique_ptr<CDBWrapper> MakeBenchDB(const BasicTestingSetup &setup,
+                                               DBEngineType engine) {
+    auto db = std::make_unique<CDBWrapper>(
+        setup.m_path_root / ("bench_" + DBEngineTypeName(engine)), 64 << 20,
+        /* fMemory */ false, /* fWipe */ true, /* obfuscate */ true, engine);
+    const std::vector<uint8_t> value(DB_BENCH_VALUE_SIZE, 0x42);
+    CDBBatch batch(*db);
+    for (uint32_t i = 0; i < DB_BENCH_ENTRIES; ++i) {
+        batch.Write(BenchKey(i), value);
+        if (batch.SizeEstimate() > (1 << 20)) {
+            db->WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+    db->WriteBatch(batch);
+    return db;
+}
+
+static void DBPointLookup(benchmark::Bench &bench, DBEngineType engine) {
+    const BasicTestingSetup setup{CBaseChainParams::REGTEST, {"-nodebug"}};
+    const auto db = MakeBenchDB(setup, engine);
+    FastRandomContext rng(true);
+    std::vector<uint8_t> value;
+    bench.run([&] {
+        bool found = db->Read(BenchKey(rng.randrange(DB_BENCH_ENTRIES)), value);
+        assert(found);
+    });
+}
+
+/** Add 1000 entries and remove the 1000 oldest ones, like a coins flush. */
+static void DBBatchWrite(benchmark::Bench &bench, DBEngineType engine) {
+    const BasicTestingSetup setup{CBaseChainParams::REGTEST, {"-nodebug"}};
+    const auto db = MakeBenchDB(setup, engine);
+    const std::vector<uint8_t> value(DB_BENCH_VALUE_SIZE, 0x42);
+    uint32_t next = DB_BENCH_ENTRIES;
+    bench.run([&] {
+        CDBBatch batch(*db);
+        for (int i = 0; i < 1000; ++i, ++next) {
+            batch.Write(BenchKey(next), value);
+            batch.Erase(BenchKey(next - DB_BENCH_ENTRIES));
+        }
+        db->WriteBatch(batch);
+    });
+}
+
+static void DBFullScan(benchmark::Bench &bench, DBEngineType engine) {
+    const BasicTestingSetup setup{CBaseChainParams::REGTEST, {"-nodebug"}};
+    const auto db = MakeBenchDB(setup, engine);
+    std::vector<uint8_t> value;
+    bench.run([&] {
+        std::unique_ptr<CDBIterator> it(db->NewIterator());
+        uint32_t count = 0;
+        for (it->Seek('c'); it->Valid(); it->Next()) {
+            bool ok = it->GetValue(value);
+            assert(ok);
+            ++count;
+        }
+        assert(count == DB_BENCH_ENTRIES);
+    });
+}
+
+static void LevelDBPointLookup(benchmark::Bench &bench) {
+    DBPointLookup(bench, DBEngineType::LEVELDB);
+}
+static void LevelDBBatchWrite(benchmark::Bench &bench) {
+    DBBatchWrite(bench, DBEngineType::LEVELDB);
+}
+static void LevelDBFullScan(benchmark::Bench &bench) {
+    DBFullScan(bench, DBEngineType::LEVELDB);
+}
+
+BENCHMARK(LevelDBPointLookup);
+BENCHMARK(LevelDBBatchWrite);
+BENCHMARK(LevelDBFullScan);
+
+#ifndef WIN32
+static void BTreePointLookup(benchmark::Bench &bench) {
+    DBPointLookup(bench, DBEngineType::BTREE);
+}
+static void BTreeBatchWrite(benchmark::Bench &bench) {
+    DBBatchWrite(bench, DBEngineType::BTREE);
+}
+static void BTreeFullScan(benchmark::Bench &bench) {
+    DBFullScan(bench, DBEngineType::BTREE);
+}
+
+BENCHMARK(BTreePointLookup);
+BENCHMARK(BTreeBatchWrite);
+BENCHMARK(BTreeFullScan);
+#endif
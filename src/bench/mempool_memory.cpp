@@ -0,0 +1,62 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <tinyformat.h>
+#include <txmempool.h>
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+//! Memory usage the mempool is filled up to
+static constexpr size_t MEMPOOL_MEMORY_USAGE = 4 << 20;
+static constexpr size_t MEMPOOL_MEMORY_MAX_TXS = 20000;
+
+/**
+ * Fill a mempool up to a given memory usage with small transactions, half of
+ * them spending an output of the previous one, and report how many entries
+ * fit in a MB.
+ */
+static void MempoolEntriesPerMB(benchmark::Bench &bench) {
+    FastRandomContext rng(true);
+    std::vector<CTransactionRef> txs;
+    for (size_t i = 0; i < MEMPOOL_MEMORY_MAX_TXS; ++i) {
+        CMutableTransaction mtx;
+        if (!txs.empty() && rng.randbool()) {
+            mtx.vin.emplace_back(COutPoint(txs.back()->GetId(), 1));
+        } else {
+            mtx.vin.emplace_back(COutPoint(TxId(rng.rand256()), 0));
+        }
+        mtx.vin[0].scriptSig = CScript() << std::vector<uint8_t>(72)
+                                         << std::vector<uint8_t>(33);
+        for (int j = 0; j < 2; ++j) {
+            mtx.vout.emplace_back(1000 * SATOSHI,
+                                  CScript() << OP_DUP << OP_HASH160
+                                            << rng.randbytes(20)
+                                            << OP_EQUALVERIFY << OP_CHECKSIG);
+        }
+        txs.push_back(MakeTransactionRef(mtx));
+    }
+
+    const TestingSetup test_setup;
+    size_t entries = 0;
+    bench.batch(MEMPOOL_MEMORY_USAGE >> 20).unit("MB").run([&] {
+        CTxMemPool pool;
+        LOCK2(cs_main, pool.cs);
+        entries = 0;
+        while (pool.DynamicMemoryUsage() < MEMPOOL_MEMORY_USAGE) {
+            assert(entries < txs.size());
+            pool.addUnchecked(CTxMemPoolEntry(txs[entries++], 1000 * SATOSHI,
+                                              0, 1, false, 1, LockPoints()));
+        }
+    });
+
+    std::cout << strprintf("%s: %u entries per MB\n", bench.name(),
+                           entries / (MEMPOOL_MEMORY_USAGE >> 20));
+}
+
+BENCHMARK(MempoolEntriesPerMB);
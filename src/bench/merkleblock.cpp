@@ -0,0 +1,94 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/data.h>
+
+#include <bloom.h>
+#include <merkleblock.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <script/script.h>
+#include <streams.h>
+#include <version.h>
+
+#include <cassert>
+#include <vector>
+
+static constexpr size_t FILTERED_PEERS = 100;
+//! Elements of each filter, a couple of them matching the block
+static constexpr size_t FILTER_ELEMENTS = 20;
+static constexpr size_t FILTER_MATCHING_ELEMENTS = 2;
+
+/**
+ * Serve a block as a merkleblock to many SPV peers, each with its own BIP37
+ * filter, either extracting the elements of the transactions for each peer or
+ * once for all of them.
+ */
+static void RunMerkleBlockFilteredPeers(benchmark::Bench &bench, bool shared) {
+    CDataStream stream(benchmark::data::block413567, SER_NETWORK,
+                       PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    // Data pushed by the output scripts of the block, for the filters to
+    // match some transactions.
+    std::vector<std::vector<uint8_t>> block_elements;
+    for (const auto &tx : block.vtx) {
+        for (const CTxOut &txout : tx->vout) {
+            CScript::const_iterator pc = txout.scriptPubKey.begin();
+            opcodetype opcode;
+            std::vector<uint8_t> data;
+            while (txout.scriptPubKey.GetOp(pc, opcode, data)) {
+                if (data.size() == 20) {
+                    block_elements.push_back(data);
+                }
+            }
+        }
+    }
+    assert(!block_elements.empty());
+
+    FastRandomContext rng(true);
+    std::vector<CBloomFilter> filters;
+    for (size_t i = 0; i < FILTERED_PEERS; ++i) {
+        CBloomFilter filter(FILTER_ELEMENTS, 0.0001, rng.rand32(),
+                            BLOOM_UPDATE_ALL);
+        for (size_t j = 0; j < FILTER_ELEMENTS; ++j) {
+            filter.insert(
+                j < FILTER_MATCHING_ELEMENTS
+                    ? block_elements[rng.randrange(block_elements.size())]
+                    : rng.randbytes(20));
+        }
+        filters.push_back(std::move(filter));
+    }
+
+    bench.unit("block").run([&] {
+        // Matching updates the filters, start from the same ones every time.
+        std::vector<CBloomFilter> peer_filters = filters;
+        std::vector<CBloomTxElements> elements;
+        if (shared) {
+            elements = GetBlockBloomElements(block);
+        }
+
+        size_t matched = 0;
+        for (CBloomFilter &filter : peer_filters) {
+            const CMerkleBlock merkle_block =
+                shared ? CMerkleBlock(block, filter, elements)
+                       : CMerkleBlock(block, filter);
+            matched += merkle_block.vMatchedTxn.size();
+        }
+        assert(matched >= FILTERED_PEERS);
+    });
+}
+
+static void MerkleBlockFilteredPeers(benchmark::Bench &bench) {
+    RunMerkleBlockFilteredPeers(bench, false);
+}
+
+static void MerkleBlockFilteredPeersShared(benchmark::Bench &bench) {
+    RunMerkleBlockFilteredPeers(bench, true);
+}
+
+BENCHMARK(MerkleBlockFilteredPeers);
+BENCHMARK(MerkleBlockFilteredPeersShared);
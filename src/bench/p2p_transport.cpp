@@ -0,0 +1,127 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <config.h>
+#include <net.h>
+#include <protocol.h>
+#include <version.h>
+
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+/* Number of message bytes to send per iteration */
+static constexpr size_t MESSAGE_SIZE_SMALL = 256;
+static constexpr size_t MESSAGE_SIZE_LARGE = 1024 * 1024;
+/* Size of a large block message, and of the socket reads it arrives in */
+static constexpr size_t BLOCK_MESSAGE_SIZE = 32 * 1024 * 1024;
+static constexpr size_t SOCKET_READ_SIZE = 0x10000;
+
+static const uint8_t k1[32] = {0};
+static const uint8_t k2[32] = {0};
+
+/**
+ * Prepare a message for the transport and read it back, as the sending and
+ * the receiving nodes would.
+ */
+static void TransportRoundTrip(benchmark::Bench &bench, size_t size,
+                               TransportSerializer &serializer,
+                               TransportDeserializer &deserializer) {
+    const Config &config = GetConfig();
+    const std::vector<uint8_t> data(size, 0x42);
+    bench.batch(size).unit("byte").run([&] {
+        CSerializedNetMsg msg;
+        msg.m_type = NetMsgType::BLOCK;
+        msg.data = data;
+        std::vector<uint8_t> header;
+        serializer.prepareForTransport(config, msg, header);
+
+        for (const std::vector<uint8_t> *bytes : {&header, &msg.data}) {
+            Span<const uint8_t> span(*bytes);
+            while (!span.empty()) {
+                const int ret = deserializer.Read(config, span);
+                assert(ret >= 0);
+            }
+        }
+        assert(deserializer.Complete());
+        CNetMessage received = deserializer.GetMessage(config, {});
+        assert(received.m_valid_checksum &&
+               received.m_message_size == size);
+    });
+}
+
+static void P2PTransportV1(benchmark::Bench &bench, size_t size) {
+    SelectParams(CBaseChainParams::REGTEST);
+    V1TransportSerializer serializer;
+    V1TransportDeserializer deserializer(Params().NetMagic(), SER_NETWORK,
+                                         INIT_PROTO_VERSION);
+    TransportRoundTrip(bench, size, serializer, deserializer);
+}
+
+static void P2PTransportV2(benchmark::Bench &bench, size_t size) {
+    SelectParams(CBaseChainParams::REGTEST);
+    V2TransportSerializer serializer(k1, sizeof(k1), k2, sizeof(k2));
+    V2TransportDeserializer deserializer(k1, sizeof(k1), k2, sizeof(k2),
+                                         SER_NETWORK, INIT_PROTO_VERSION);
+    TransportRoundTrip(bench, size, serializer, deserializer);
+}
+
+static void P2P_TRANSPORT_V1_256BYTES(benchmark::Bench &bench) {
+    P2PTransportV1(bench, MESSAGE_SIZE_SMALL);
+}
+
+static void P2P_TRANSPORT_V2_256BYTES(benchmark::Bench &bench) {
+    P2PTransportV2(bench, MESSAGE_SIZE_SMALL);
+}
+
+static void P2P_TRANSPORT_V1_1MB(benchmark::Bench &bench) {
+    P2PTransportV1(bench, MESSAGE_SIZE_LARGE);
+}
+
+static void P2P_TRANSPORT_V2_1MB(benchmark::Bench &bench) {
+    P2PTransportV2(bench, MESSAGE_SIZE_LARGE);
+}
+
+/**
+ * Receive a large block message in socket sized reads, until the message is
+ * ready to be processed.
+ */
+static void P2P_TRANSPORT_V1_RECEIVE_32MB(benchmark::Bench &bench) {
+    SelectParams(CBaseChainParams::REGTEST);
+    const Config &config = GetConfig();
+
+    CSerializedNetMsg msg;
+    msg.m_type = NetMsgType::BLOCK;
+    msg.data.assign(BLOCK_MESSAGE_SIZE, 0x42);
+    std::vector<uint8_t> wire;
+    V1TransportSerializer().prepareForTransport(config, msg, wire);
+    wire.insert(wire.end(), msg.data.begin(), msg.data.end());
+
+    V1TransportDeserializer deserializer(Params().NetMagic(), SER_NETWORK,
+                                         INIT_PROTO_VERSION);
+    bench.batch(BLOCK_MESSAGE_SIZE).unit("byte").run([&] {
+        Span<const uint8_t> bytes(wire);
+        while (!bytes.empty()) {
+            Span<const uint8_t> read =
+                bytes.first(std::min(bytes.size(), SOCKET_READ_SIZE));
+            while (!read.empty()) {
+                const int ret = deserializer.Read(config, read);
+                assert(ret >= 0);
+            }
+            bytes = bytes.subspan(std::min(bytes.size(), SOCKET_READ_SIZE));
+        }
+        assert(deserializer.Complete());
+        CNetMessage received = deserializer.GetMessage(config, {});
+        assert(received.m_valid_checksum);
+    });
+}
+
+BENCHMARK(P2P_TRANSPORT_V1_256BYTES);
+BENCHMARK(P2P_TRANSPORT_V2_256BYTES);
+BENCHMARK(P2P_TRANSPORT_V1_1MB);
+BENCHMARK(P2P_TRANSPORT_V2_1MB);
+BENCHMARK(P2P_TRANSPORT_V1_RECEIVE_32MB);
@@ -4,9 +4,14 @@
 
 #include <bench/bench.h>
 #include <bloom.h>
+#include <random.h>
+#include <uint256.h>
 
-static void RollingBloom(benchmark::Bench &bench) {
-    CRollingBloomFilter filter(120000, 0.000001);
+#include <vector>
+
+template <typename Filter>
+static void RollingBloomInsertContains(benchmark::Bench &bench) {
+    Filter filter(120000, 0.000001);
     std::vector<uint8_t> data(32);
     uint32_t count = 0;
     bench.run([&] {
@@ -25,10 +30,69 @@ static void RollingBloom(benchmark::Bench &bench) {
     });
 }
 
-static void RollingBloomReset(benchmark::Bench &bench) {
-    CRollingBloomFilter filter(120000, 0.000001);
+template <typename Filter>
+static void RollingBloomResetFilter(benchmark::Bench &bench) {
+    Filter filter(120000, 0.000001);
     bench.run([&] { filter.reset(); });
 }
 
+/**
+ * The per peer inventory tracking: the announced txids are looked up in the
+ * filter of the peer, and inserted when they are not already known. Each
+ * iteration processes a batch of txids against the filters of 125 peers.
+ */
+template <typename Filter>
+static void RollingBloomInventory(benchmark::Bench &bench) {
+    static constexpr size_t NUM_PEERS = 125;
+    static constexpr size_t BATCH_SIZE = 100;
+
+    std::vector<Filter> filters(NUM_PEERS, Filter(50000, 0.000001));
+    FastRandomContext rng(true);
+    std::vector<uint256> txids(BATCH_SIZE);
+    bench.batch(NUM_PEERS * BATCH_SIZE)
+        .unit("lookup")
+        .minEpochIterations(10)
+        .run([&] {
+            for (uint256 &txid : txids) {
+                txid = rng.rand256();
+            }
+            for (Filter &filter : filters) {
+                for (const uint256 &txid : txids) {
+                    if (!filter.contains(txid)) {
+                        filter.insert(txid);
+                    }
+                }
+            }
+        });
+}
+
+static void RollingBloom(benchmark::Bench &bench) {
+    RollingBloomInsertContains<CRollingBloomFilter>(bench);
+}
+
+static void RollingBloomReset(benchmark::Bench &bench) {
+    RollingBloomResetFilter<CRollingBloomFilter>(bench);
+}
+
+static void RollingBloomBlocked(benchmark::Bench &bench) {
+    RollingBloomInsertContains<CBlockedRollingBloomFilter>(bench);
+}
+
+static void RollingBloomBlockedReset(benchmark::Bench &bench) {
+    RollingBloomResetFilter<CBlockedRollingBloomFilter>(bench);
+}
+
+static void RollingBloomInventoryTracking(benchmark::Bench &bench) {
+    RollingBloomInventory<CRollingBloomFilter>(bench);
+}
+
+static void RollingBloomBlockedInventoryTracking(benchmark::Bench &bench) {
+    RollingBloomInventory<CBlockedRollingBloomFilter>(bench);
+}
+
 BENCHMARK(RollingBloom);
 BENCHMARK(RollingBloomReset);
+BENCHMARK(RollingBloomBlocked);
+BENCHMARK(RollingBloomBlockedReset);
+BENCHMARK(RollingBloomInventoryTracking);
+BENCHMARK(RollingBloomBlockedInventoryTracking);
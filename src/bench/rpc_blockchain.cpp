@@ -5,30 +5,57 @@
 #include <bench/bench.h>
 #include <bench/data.h>
 
+#include <chainparams.h>
 #include <rpc/blockchain.h>
 #include <streams.h>
 #include <validation.h>
 
 #include <univalue.h>
 
+namespace {
+
+struct TestBlockAndIndex {
+    CBlock block{};
+    BlockHash blockHash{};
+    CBlockIndex blockindex{};
+
+    TestBlockAndIndex() {
+        // The block is from the main chain, encode its addresses accordingly.
+        SelectParams(CBaseChainParams::MAIN);
+
+        CDataStream stream(benchmark::data::block413567, SER_NETWORK,
+                           PROTOCOL_VERSION);
+        char a = '\0';
+        // Prevent compaction
+        stream.write(&a, 1);
+
+        stream >> block;
+
+        blockHash = block.GetHash();
+        blockindex.phashBlock = &blockHash;
+        blockindex.nBits = 403014710;
+    }
+};
+
+} // namespace
+
 static void BlockToJsonVerbose(benchmark::Bench &bench) {
-    CDataStream stream(benchmark::data::block413567, SER_NETWORK,
-                       PROTOCOL_VERSION);
-    char a = '\0';
-    // Prevent compaction
-    stream.write(&a, 1);
-
-    CBlock block;
-    stream >> block;
-
-    CBlockIndex blockindex;
-    const auto blockHash = block.GetHash();
-    blockindex.phashBlock = &blockHash;
-    blockindex.nBits = 403014710;
-
-    bench.run([&] {
-        (void)blockToJSON(block, &blockindex, &blockindex, /*verbose*/ true);
+    TestBlockAndIndex data;
+    bench.batch(data.block.vtx.size()).unit("tx").run([&] {
+        (void)blockToJSON(data.block, &data.blockindex, &data.blockindex,
+                          /*verbose*/ true);
+    });
+}
+
+static void BlockToJsonVerboseWrite(benchmark::Bench &bench) {
+    TestBlockAndIndex data;
+    bench.batch(data.block.vtx.size()).unit("tx").run([&] {
+        const UniValue univalue = blockToJSON(
+            data.block, &data.blockindex, &data.blockindex, /*verbose*/ true);
+        const std::string str = univalue.write();
+        ankerl::nanobench::doNotOptimizeAway(str);
     });
 }
 
 BENCHMARK(BlockToJsonVerbose);
+BENCHMARK(BlockToJsonVerboseWrite);
@@ -0,0 +1,70 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <key.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/sighashtype.h>
+#include <script/sign.h>
+#include <script/signingprovider.h>
+#include <script/standard.h>
+
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+//! Number of keys the spent P2PKH outputs are paid to
+static constexpr int SIGN_TRANSACTION_KEYS = 16;
+
+/** Sign a transaction spending many P2PKH outputs, as in a consolidation. */
+static void RunSignTransaction(benchmark::Bench &bench, size_t n_inputs) {
+    const ECCVerifyHandle verify_handle;
+    ECC_Start();
+
+    FillableSigningProvider keystore;
+    std::vector<CScript> scripts;
+    for (int i = 0; i < SIGN_TRANSACTION_KEYS; ++i) {
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        scripts.push_back(GetScriptForDestination(PKHash(key.GetPubKey())));
+    }
+
+    FastRandomContext rng(true);
+    CMutableTransaction mtx;
+    std::map<COutPoint, Coin> coins;
+    for (size_t i = 0; i < n_inputs; ++i) {
+        const COutPoint outpoint(TxId(rng.rand256()), 0);
+        mtx.vin.emplace_back(outpoint);
+        coins.emplace(outpoint,
+                      Coin(CTxOut(10000 * SATOSHI, scripts[i % scripts.size()]),
+                           1, false));
+    }
+    mtx.vout.emplace_back(int64_t(n_inputs) * 9000 * SATOSHI, scripts[0]);
+
+    bench.batch(n_inputs).unit("input").run([&] {
+        CMutableTransaction tx = mtx;
+        std::map<int, std::string> input_errors;
+        bool complete = SignTransaction(tx, &keystore, coins,
+                                        SigHashType().withForkId(),
+                                        input_errors);
+        assert(complete);
+    });
+
+    ECC_Stop();
+}
+
+static void SignTransaction1kInputs(benchmark::Bench &bench) {
+    RunSignTransaction(bench, 1000);
+}
+
+static void SignTransaction10kInputs(benchmark::Bench &bench) {
+    RunSignTransaction(bench, 10000);
+}
+
+BENCHMARK(SignTransaction1kInputs);
+BENCHMARK(SignTransaction10kInputs);
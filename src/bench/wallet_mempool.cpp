@@ -0,0 +1,86 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <config.h>
+#include <interfaces/chain.h>
+#include <node/context.h>
+#include <random.h>
+#include <script/standard.h>
+#include <wallet/wallet.h>
+
+#include <test/util/setup_common.h>
+
+#include <cassert>
+#include <vector>
+
+/* Number of transactions of the stream */
+static constexpr size_t STREAM_TX_COUNT = 1000;
+
+/**
+ * Notify a wallet holding numKeys keys of a stream of mempool transactions,
+ * none of which is involved with the wallet as for most of the transactions
+ * relayed on the network. Each transaction spends 2 outputs and creates 2
+ * P2PKH outputs.
+ */
+static void WalletMempoolStream(benchmark::Bench &bench,
+                                unsigned int numKeys) {
+    const TestingSetup test_setup{
+        CBaseChainParams::REGTEST,
+        /* extra_args */
+        {
+            "-nodebuglogfile",
+            "-nodebug",
+        },
+    };
+
+    const Config &config = GetConfig();
+
+    NodeContext node;
+    std::unique_ptr<interfaces::Chain> chain =
+        interfaces::MakeChain(node, config.GetChainParams());
+    CWallet wallet{chain.get(), "", CreateMockWalletDatabase()};
+    {
+        wallet.SetupLegacyScriptPubKeyMan();
+        bool first_run;
+        if (wallet.LoadWallet(first_run) != DBErrors::LOAD_OK) {
+            assert(false);
+        }
+        LegacyScriptPubKeyMan *spk_man = wallet.GetLegacyScriptPubKeyMan();
+        bool topped_up = spk_man->TopUp(numKeys);
+        assert(topped_up);
+    }
+
+    FastRandomContext rng(true);
+    std::vector<CTransactionRef> txs;
+    for (size_t i = 0; i < STREAM_TX_COUNT; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(2);
+        tx.vin[0].prevout = COutPoint(TxId(rng.rand256()), 0);
+        tx.vin[1].prevout = COutPoint(TxId(rng.rand256()), 1);
+        for (int n = 0; n < 2; ++n) {
+            const PKHash dest(uint160(rng.randbytes(20)));
+            tx.vout.emplace_back(COIN, GetScriptForDestination(dest));
+        }
+        txs.push_back(MakeTransactionRef(tx));
+    }
+
+    bench.batch(txs.size()).unit("tx").minEpochIterations(10).run([&] {
+        for (const CTransactionRef &tx : txs) {
+            wallet.transactionAddedToMempool(tx, 0 /* mempool_sequence */);
+        }
+    });
+    assert(WITH_LOCK(wallet.cs_wallet, return wallet.mapWallet.empty()));
+}
+
+static void WalletMempoolStream1000Keys(benchmark::Bench &bench) {
+    WalletMempoolStream(bench, 1000);
+}
+
+static void WalletMempoolStream10000Keys(benchmark::Bench &bench) {
+    WalletMempoolStream(bench, 10000);
+}
+
+BENCHMARK(WalletMempoolStream1000Keys);
+BENCHMARK(WalletMempoolStream10000Keys);
@@ -0,0 +1,164 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <config.h>
+#include <consensus/consensus.h>
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <node/blockreplay.h>
+#include <node/context.h>
+#include <pow/pow.h>
+#include <primitives/block.h>
+#include <test/util/mining.h>
+#include <test/util/setup_common.h>
+#include <test/util/workload.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+
+//! Size of the transactions accepted to the mempool by each epoch
+static constexpr size_t WORKLOAD_MEMPOOL_BATCH_SIZE = 500000;
+static constexpr size_t WORKLOAD_MEMPOOL_EPOCHS = 3;
+//! Size of the transactions of the replayed block
+static constexpr size_t WORKLOAD_BLOCK_SIZE = 2000000;
+//! Rough average size of the generated transactions per coin they spend
+static constexpr size_t WORKLOAD_BYTES_PER_COIN = 200;
+
+/**
+ * Mine a block with the given transactions, bypassing the mempool so that
+ * the script caches are left untouched.
+ */
+static void MineWorkloadBlock(const TestingSetup &setup,
+                              const WorkloadGenerator &gen,
+                              const std::vector<CTransactionRef> &txs) {
+    const Config &config = GetConfig();
+    auto block = PrepareBlock(config, setup.m_node, gen.GetCoinbaseScript());
+    block->vtx.insert(block->vtx.end(), txs.begin(), txs.end());
+    // Canonical transaction ordering.
+    std::sort(block->vtx.begin() + 1, block->vtx.end(),
+              [](const CTransactionRef &a, const CTransactionRef &b) {
+                  return a->GetId() < b->GetId();
+              });
+    block->hashMerkleRoot = BlockMerkleRoot(*block);
+    while (!CheckProofOfWork(block->GetHash(), block->nBits,
+                             config.GetChainParams().GetConsensus())) {
+        ++block->nNonce;
+    }
+
+    bool processed = setup.m_node.chainman->ProcessNewBlock(config, block,
+                                                            true, nullptr);
+    assert(processed);
+    assert(WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash()) ==
+           block->GetHash());
+}
+
+/** Fund the generator with at least n coins. */
+static void FundWorkload(const TestingSetup &setup, WorkloadGenerator &gen,
+                         size_t n) {
+    // Enough mature coinbases to split into n coins.
+    const int coinbases = n / 1000 + 2;
+    std::vector<CTransactionRef> coinbase_txs;
+    for (int i = 0; i < COINBASE_MATURITY + coinbases; ++i) {
+        auto block =
+            PrepareBlock(GetConfig(), setup.m_node, gen.GetCoinbaseScript());
+        while (!CheckProofOfWork(block->GetHash(), block->nBits,
+                                 Params().GetConsensus())) {
+            ++block->nNonce;
+        }
+        bool processed = setup.m_node.chainman->ProcessNewBlock(
+            GetConfig(), block, true, nullptr);
+        assert(processed);
+        coinbase_txs.push_back(block->vtx[0]);
+    }
+    for (int i = 0; i < coinbases; ++i) {
+        gen.AddCoins(*coinbase_txs[i]);
+    }
+
+    while (gen.GetCoinsCount() < n) {
+        const std::vector<CTransactionRef> txs = gen.Fanout(n);
+        assert(!txs.empty());
+        MineWorkloadBlock(setup, gen, txs);
+        gen.ConfirmPending();
+    }
+}
+
+/**
+ * Accept batches of generated transactions to the mempool, as received from
+ * peers. Every epoch submits new transactions so the script caches are cold.
+ */
+static void WorkloadMempoolAccept(benchmark::Bench &bench) {
+    const TestingSetup setup{CBaseChainParams::REGTEST,
+                             {"-nodebuglogfile", "-nodebug"}};
+    WorkloadGenerator gen(WorkloadMix{});
+    FundWorkload(setup, gen,
+                 WORKLOAD_MEMPOOL_EPOCHS * WORKLOAD_MEMPOOL_BATCH_SIZE /
+                     WORKLOAD_BYTES_PER_COIN);
+
+    std::vector<std::vector<CTransactionRef>> batches;
+    size_t total_txs = 0;
+    for (size_t i = 0; i < WORKLOAD_MEMPOOL_EPOCHS; ++i) {
+        batches.push_back(gen.Generate(WORKLOAD_MEMPOOL_BATCH_SIZE));
+        total_txs += batches.back().size();
+    }
+
+    CTxMemPool &mempool = *setup.m_node.mempool;
+    size_t epoch = 0;
+    bench.epochs(WORKLOAD_MEMPOOL_EPOCHS)
+        .epochIterations(1)
+        .batch(total_txs / WORKLOAD_MEMPOOL_EPOCHS)
+        .unit("tx")
+        .run([&] {
+            LOCK(cs_main);
+            for (const CTransactionRef &tx : batches.at(epoch)) {
+                TxValidationState state;
+                bool accepted =
+                    AcceptToMemoryPool(::ChainstateActive(), GetConfig(),
+                                       mempool, state, tx,
+                                       /* bypass_limits */ false);
+                assert(accepted);
+            }
+            ++epoch;
+        });
+}
+
+/** Connect and disconnect a block made of generated transactions. */
+static void WorkloadBlockReplay(benchmark::Bench &bench) {
+    const TestingSetup setup{CBaseChainParams::REGTEST,
+                             {"-nodebuglogfile", "-nodebug"}};
+    WorkloadGenerator gen(WorkloadMix{});
+    FundWorkload(setup, gen, WORKLOAD_BLOCK_SIZE / WORKLOAD_BYTES_PER_COIN);
+
+    const std::vector<CTransactionRef> txs =
+        gen.Generate(WORKLOAD_BLOCK_SIZE);
+    MineWorkloadBlock(setup, gen, txs);
+
+    BlockReplayData data;
+    {
+        const int height = WITH_LOCK(cs_main, return ::ChainActive().Height());
+        std::string error;
+        bool ok = ExportBlockReplay(::ChainActive(), Params(), height, height,
+                                    data, error);
+        assert(ok);
+    }
+
+    BlockReplay replay(std::move(data), Params(),
+                       setup.m_path_root / "replay");
+    BlockReplayTimings timings;
+    bench.batch(txs.size()).unit("tx").run([&] {
+        LOCK(cs_main);
+        std::string error;
+        bool ok = replay.Run(GetConfig(), ::ChainstateActive(), {}, timings,
+                             error);
+        assert(ok);
+    });
+}
+
+BENCHMARK(WorkloadMempoolAccept);
+BENCHMARK(WorkloadBlockReplay);
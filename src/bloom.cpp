@@ -4,17 +4,25 @@
 
 #include <bloom.h>
 
+#include <crypto/common.h>
+#include <crypto/siphash.h>
 #include <hash.h>
+#include <memusage.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <script/script.h>
 #include <script/standard.h>
-#include <streams.h>
 
 #include <cmath>
 #include <cstdlib>
 
 #include <algorithm>
+#include <array>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define LN2SQUARED 0.4804530139182014246671025263266649717305529515945455
 #define LN2 0.6931471805599453094172321214581765680755001343602552
@@ -41,16 +49,64 @@ CBloomFilter::CBloomFilter(const uint32_t nElements, const double nFPRate,
                                     MAX_HASH_FUNCS)),
       nTweak(nTweakIn), nFlags(nFlagsIn) {}
 
-inline uint32_t
-CBloomFilter::Hash(uint32_t nHashNum,
-                   const std::vector<uint8_t> &vDataToHash) const {
+//! The serialization of an outpoint, without going through a stream
+static std::array<uint8_t, 36> SerializeOutPoint(const COutPoint &outpoint) {
+    std::array<uint8_t, 36> data;
+    std::copy(outpoint.GetTxId().begin(), outpoint.GetTxId().end(),
+              data.begin());
+    WriteLE32(data.data() + 32, outpoint.GetN());
+    return data;
+}
+
+CBloomTxElements::CBloomTxElements(const CTransaction &tx)
+    : m_txid(tx.GetId()) {
+    std::vector<uint8_t> data;
+    for (const CTxOut &txout : tx.vout) {
+        // Only the data pushed before a parsing error is matched.
+        CScript::const_iterator pc = txout.scriptPubKey.begin();
+        opcodetype opcode;
+        while (pc < txout.scriptPubKey.end() &&
+               txout.scriptPubKey.GetOp(pc, opcode, data)) {
+            if (data.size() != 0) {
+                AddElement(data);
+            }
+        }
+        m_output_ends.push_back(m_element_ends.size());
+    }
+
+    for (const CTxIn &txin : tx.vin) {
+        AddElement(SerializeOutPoint(txin.prevout));
+        CScript::const_iterator pc = txin.scriptSig.begin();
+        opcodetype opcode;
+        while (pc < txin.scriptSig.end() &&
+               txin.scriptSig.GetOp(pc, opcode, data)) {
+            if (data.size() != 0) {
+                AddElement(data);
+            }
+        }
+    }
+}
+
+void CBloomTxElements::AddElement(Span<const uint8_t> element) {
+    m_data.insert(m_data.end(), element.begin(), element.end());
+    m_element_ends.push_back(m_data.size());
+}
+
+size_t CBloomTxElements::DynamicMemoryUsage() const {
+    return memusage::DynamicUsage(m_data) +
+           memusage::DynamicUsage(m_element_ends) +
+           memusage::DynamicUsage(m_output_ends);
+}
+
+inline uint32_t CBloomFilter::Hash(uint32_t nHashNum,
+                                   Span<const uint8_t> vDataToHash) const {
     // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between
     // nHashNum values.
     return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) %
            (vData.size() * 8);
 }
 
-void CBloomFilter::insert(const std::vector<uint8_t> &vKey) {
+void CBloomFilter::insert(Span<const uint8_t> vKey) {
     if (vData.empty()) {
         // Avoid divide-by-zero (CVE-2013-5700)
         return;
@@ -64,18 +120,14 @@ void CBloomFilter::insert(const std::vector<uint8_t> &vKey) {
 }
 
 void CBloomFilter::insert(const COutPoint &outpoint) {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<uint8_t> data(stream.begin(), stream.end());
-    insert(data);
+    insert(SerializeOutPoint(outpoint));
 }
 
 void CBloomFilter::insert(const uint256 &hash) {
-    std::vector<uint8_t> data(hash.begin(), hash.end());
-    insert(data);
+    insert(Span<const uint8_t>(hash.begin(), hash.end()));
 }
 
-bool CBloomFilter::contains(const std::vector<uint8_t> &vKey) const {
+bool CBloomFilter::contains(Span<const uint8_t> vKey) const {
     if (vData.empty()) {
         // Avoid divide-by-zero (CVE-2013-5700)
         return true;
@@ -91,15 +143,11 @@ bool CBloomFilter::contains(const std::vector<uint8_t> &vKey) const {
 }
 
 bool CBloomFilter::contains(const COutPoint &outpoint) const {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<uint8_t> data(stream.begin(), stream.end());
-    return contains(data);
+    return contains(SerializeOutPoint(outpoint));
 }
 
 bool CBloomFilter::contains(const uint256 &hash) const {
-    std::vector<uint8_t> data(hash.begin(), hash.end());
-    return contains(data);
+    return contains(Span<const uint8_t>(hash.begin(), hash.end()));
 }
 
 bool CBloomFilter::IsWithinSizeConstraints() const {
@@ -107,7 +155,8 @@ bool CBloomFilter::IsWithinSizeConstraints() const {
            nHashFuncs <= MAX_HASH_FUNCS;
 }
 
-bool CBloomFilter::MatchAndInsertOutputs(const CTransaction &tx) {
+bool CBloomFilter::MatchAndInsertOutputs(const CTransaction &tx,
+                                         const CBloomTxElements &elements) {
     bool fFound = false;
     // Match if the filter contains the hash of tx for finding tx when they
     // appear in a block
@@ -116,34 +165,29 @@ bool CBloomFilter::MatchAndInsertOutputs(const CTransaction &tx) {
         return true;
     }
 
-    const TxId &txid = tx.GetId();
+    const TxId &txid = elements.m_txid;
     if (contains(txid)) {
         fFound = true;
     }
 
-    for (size_t i = 0; i < tx.vout.size(); i++) {
-        const CTxOut &txout = tx.vout[i];
+    size_t element = 0;
+    for (size_t i = 0; i < elements.m_output_ends.size(); i++) {
         // Match if the filter contains any arbitrary script data element in any
         // scriptPubKey in tx. If this matches, also add the specific output
         // that was matched. This means clients don't have to update the filter
         // themselves when a new relevant tx is discovered in order to find
         // spending transactions, which avoids round-tripping and race
         // conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        std::vector<uint8_t> data;
-        while (pc < txout.scriptPubKey.end()) {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data)) {
-                break;
-            }
-            if (data.size() != 0 && contains(data)) {
+        for (; element < elements.m_output_ends[i]; element++) {
+            if (contains(elements.GetElement(element))) {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL) {
                     insert(COutPoint(txid, i));
                 } else if ((nFlags & BLOOM_UPDATE_MASK) ==
                            BLOOM_UPDATE_P2PUBKEY_ONLY) {
                     std::vector<std::vector<uint8_t>> vSolutions;
-                    TxoutType type = Solver(txout.scriptPubKey, vSolutions);
+                    const TxoutType type =
+                        Solver(tx.vout[i].scriptPubKey, vSolutions);
                     if (type == TxoutType::PUBKEY ||
                         type == TxoutType::MULTISIG) {
                         insert(COutPoint(txid, i));
@@ -152,31 +196,23 @@ bool CBloomFilter::MatchAndInsertOutputs(const CTransaction &tx) {
                 break;
             }
         }
+        element = elements.m_output_ends[i];
     }
 
     return fFound;
 }
 
-bool CBloomFilter::MatchInputs(const CTransaction &tx) {
-    for (const CTxIn &txin : tx.vin) {
-        // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout)) {
+bool CBloomFilter::MatchInputs(const CBloomTxElements &elements) const {
+    // Match if the filter contains an outpoint tx spends, or any arbitrary
+    // script data element in any scriptSig in tx. These are all the elements
+    // following the ones of the outputs.
+    const size_t begin =
+        elements.m_output_ends.empty() ? 0 : elements.m_output_ends.back();
+    for (size_t element = begin; element < elements.m_element_ends.size();
+         element++) {
+        if (contains(elements.GetElement(element))) {
             return true;
         }
-
-        // Match if the filter contains any arbitrary script data element in any
-        // scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        std::vector<uint8_t> data;
-        while (pc < txin.scriptSig.end()) {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data)) {
-                break;
-            }
-            if (data.size() != 0 && contains(data)) {
-                return true;
-            }
-        }
     }
 
     return false;
@@ -221,7 +257,7 @@ CRollingBloomFilter::CRollingBloomFilter(const uint32_t nElements,
 /* Similar to CBloomFilter::Hash */
 static inline uint32_t
 RollingBloomHash(uint32_t nHashNum, uint32_t nTweak,
-                 const std::vector<uint8_t> &vDataToHash) {
+                 Span<const uint8_t> vDataToHash) {
     return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash);
 }
 
@@ -297,3 +333,156 @@ void CRollingBloomFilter::reset() {
     nGeneration = 1;
     std::fill(data.begin(), data.end(), 0);
 }
+
+/**
+ * The false positive rate of a blocked bloom filter of nBlocks blocks holding
+ * nElements elements. The number of elements in a block follows a Poisson
+ * distribution, so the rate is the average over it of the false positive rate
+ * of a bloom filter of the size of a block.
+ */
+static double BlockedBloomFPRate(double nElements, uint32_t nBlocks,
+                                 int nHashFuncs, int nBlockBits) {
+    const double lambda = nElements / nBlocks;
+    const double spread = 12 * sqrt(lambda) + 20;
+    const int first = std::max<int>(0, floor(lambda - spread));
+    const int last = ceil(lambda + spread);
+    double fpRate = 0;
+    for (int n = first; n <= last; n++) {
+        const double logProbability =
+            n * log(lambda) - lambda - std::lgamma(n + 1.0);
+        const double bitUnset =
+            pow(1.0 - 1.0 / nBlockBits, double(nHashFuncs) * n);
+        fpRate += exp(logProbability) * pow(1.0 - bitUnset, nHashFuncs);
+    }
+    return fpRate;
+}
+
+CBlockedRollingBloomFilter::CBlockedRollingBloomFilter(
+    const uint32_t nElements, const double fpRate) {
+    double logFpRate = log(fpRate);
+    nHashFuncs = std::max(1, std::min<int>(round(logFpRate / log(0.5)), 50));
+    nEntriesPerGeneration = (nElements + 1) / 2;
+    uint32_t nMaxElements = nEntriesPerGeneration * 3;
+    /* Start from the size of the equivalent CRollingBloomFilter, and grow it
+     * until the blocks are sparse enough for the false positive rate. */
+    uint32_t nFilterBits =
+        uint32_t(ceil(-1.0 * nHashFuncs * nMaxElements /
+                      log(1.0 - exp(logFpRate / nHashFuncs))));
+    uint32_t nBlocks = (nFilterBits + BLOCK_BITS - 1) / BLOCK_BITS;
+    while (BlockedBloomFPRate(nMaxElements, nBlocks, nHashFuncs, BLOCK_BITS) >
+           fpRate) {
+        nBlocks += nBlocks / 32 + 1;
+    }
+    blocks.resize(nBlocks);
+    reset();
+}
+
+size_t CBlockedRollingBloomFilter::GetBlockIndex(uint64_t hash) const {
+    return FastMod(hash >> 32, blocks.size());
+}
+
+/**
+ * The positions of the probes are the bytes of 64 bits values mixed from the
+ * hash, 8 probes per value. Double hashing is not used, as with only 256
+ * positions it makes the probes of the elements of a block too correlated.
+ */
+void CBlockedRollingBloomFilter::GetProbeMask(
+    uint64_t hash, uint64_t mask[BLOCK_WORDS]) const {
+    static_assert(BLOCK_BITS == 256, "A probe position is 8 bits");
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+        mask[i] = 0;
+    }
+    uint64_t v = hash;
+    for (int n = 0; n < nHashFuncs; n++) {
+        if (n % 8 == 0) {
+            v = (v ^ (v >> 32)) * 0xd6e8feb86659fd93;
+        }
+        const uint8_t pos = v >> (8 * (n % 8));
+        mask[pos >> 6] |= uint64_t(1) << (pos & 63);
+    }
+}
+
+void CBlockedRollingBloomFilter::insertHash(uint64_t hash) {
+    if (nEntriesThisGeneration == nEntriesPerGeneration) {
+        nEntriesThisGeneration = 0;
+        nGeneration++;
+        if (nGeneration == 4) {
+            nGeneration = 1;
+        }
+        uint64_t nGenerationMask1 = 0 - uint64_t(nGeneration & 1);
+        uint64_t nGenerationMask2 = 0 - uint64_t(nGeneration >> 1);
+        /* Wipe old entries that used this generation number. */
+        for (Block &block : blocks) {
+            for (int i = 0; i < BLOCK_WORDS; i++) {
+                uint64_t p1 = block.gen1[i], p2 = block.gen2[i];
+                uint64_t mask =
+                    (p1 ^ nGenerationMask1) | (p2 ^ nGenerationMask2);
+                block.gen1[i] = p1 & mask;
+                block.gen2[i] = p2 & mask;
+            }
+        }
+    }
+    nEntriesThisGeneration++;
+
+    Block &block = blocks[GetBlockIndex(hash)];
+    uint64_t mask[BLOCK_WORDS];
+    GetProbeMask(hash, mask);
+    const uint64_t gen1 = 0 - uint64_t(nGeneration & 1);
+    const uint64_t gen2 = 0 - uint64_t(nGeneration >> 1);
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+        block.gen1[i] = (block.gen1[i] & ~mask[i]) | (gen1 & mask[i]);
+        block.gen2[i] = (block.gen2[i] & ~mask[i]) | (gen2 & mask[i]);
+    }
+}
+
+bool CBlockedRollingBloomFilter::containsHash(uint64_t hash) const {
+    const Block &block = blocks[GetBlockIndex(hash)];
+    alignas(16) uint64_t mask[BLOCK_WORDS];
+    GetProbeMask(hash, mask);
+#if defined(__SSE2__)
+    /* A probe is missing if its bit is set in neither generation word. */
+    const __m128i missing = _mm_or_si128(
+        _mm_andnot_si128(
+            _mm_or_si128(_mm_load_si128((const __m128i *)block.gen1),
+                         _mm_load_si128((const __m128i *)block.gen2)),
+            _mm_load_si128((const __m128i *)mask)),
+        _mm_andnot_si128(
+            _mm_or_si128(_mm_load_si128((const __m128i *)(block.gen1 + 2)),
+                         _mm_load_si128((const __m128i *)(block.gen2 + 2))),
+            _mm_load_si128((const __m128i *)(mask + 2))));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) ==
+           0xffff;
+#else
+    uint64_t missing = 0;
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+        missing |= mask[i] & ~(block.gen1[i] | block.gen2[i]);
+    }
+    return missing == 0;
+#endif
+}
+
+void CBlockedRollingBloomFilter::insert(Span<const uint8_t> vKey) {
+    insertHash(CSipHasher(k0, k1).Write(vKey.data(), vKey.size()).Finalize());
+}
+
+void CBlockedRollingBloomFilter::insert(const uint256 &hash) {
+    // Same as hashing the bytes of the hash, so both overloads agree.
+    insertHash(SipHashUint256(k0, k1, hash));
+}
+
+bool CBlockedRollingBloomFilter::contains(Span<const uint8_t> vKey) const {
+    return containsHash(
+        CSipHasher(k0, k1).Write(vKey.data(), vKey.size()).Finalize());
+}
+
+bool CBlockedRollingBloomFilter::contains(const uint256 &hash) const {
+    return containsHash(SipHashUint256(k0, k1, hash));
+}
+
+void CBlockedRollingBloomFilter::reset() {
+    k0 = GetRand(std::numeric_limits<uint64_t>::max());
+    k1 = GetRand(std::numeric_limits<uint64_t>::max());
+    nEntriesThisGeneration = 0;
+    nGeneration = 1;
+    std::fill(blocks.begin(), blocks.end(), Block{});
+}
@@ -5,7 +5,9 @@
 #ifndef BITCOIN_BLOOM_H
 #define BITCOIN_BLOOM_H
 
+#include <primitives/txid.h>
 #include <serialize.h>
+#include <span.h>
 
 #include <cstdint>
 #include <vector>
@@ -31,6 +33,46 @@ enum bloomflags {
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * The data elements of a transaction that BIP37 filters are matched against:
+ * its txid, the data pushed by its output scripts, and the outpoints spent and
+ * data pushed by its inputs.
+ *
+ * Extracting them means parsing all the scripts and serializing the outpoints.
+ * Since that doesn't depend on the filter, it is done once per transaction and
+ * the result shared by the filters of all the peers it is matched against.
+ * The hashes of the elements can't be shared, as each filter seeds them with
+ * its own tweak. The output script types, only needed when an output matches
+ * a BLOOM_UPDATE_P2PUBKEY_ONLY filter, are left to the filter.
+ */
+class CBloomTxElements {
+private:
+    TxId m_txid;
+    //! The elements, back to back
+    std::vector<uint8_t> m_data;
+    //! End of each element in m_data
+    std::vector<uint32_t> m_element_ends;
+    //! End of the elements of each output in m_element_ends
+    std::vector<uint32_t> m_output_ends;
+    // The elements of the inputs follow the ones of the outputs. The first
+    // element of each input is the outpoint it spends.
+
+    void AddElement(Span<const uint8_t> element);
+
+    Span<const uint8_t> GetElement(size_t n) const {
+        const uint32_t begin = n == 0 ? 0 : m_element_ends[n - 1];
+        return Span<const uint8_t>(m_data).subspan(begin,
+                                                   m_element_ends[n] - begin);
+    }
+
+    friend class CBloomFilter;
+
+public:
+    explicit CBloomTxElements(const CTransaction &tx);
+
+    size_t DynamicMemoryUsage() const;
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide so that we
  * can filter the transactions we send them.
@@ -49,8 +91,7 @@ private:
     uint32_t nTweak;
     uint8_t nFlags;
 
-    uint32_t Hash(uint32_t nHashNum,
-                  const std::vector<uint8_t> &vDataToHash) const;
+    uint32_t Hash(uint32_t nHashNum, Span<const uint8_t> vDataToHash) const;
 
 public:
     /**
@@ -72,11 +113,11 @@ public:
         READWRITE(obj.vData, obj.nHashFuncs, obj.nTweak, obj.nFlags);
     }
 
-    void insert(const std::vector<uint8_t> &vKey);
+    void insert(Span<const uint8_t> vKey);
     void insert(const COutPoint &outpoint);
     void insert(const uint256 &hash);
 
-    bool contains(const std::vector<uint8_t> &vKey) const;
+    bool contains(Span<const uint8_t> vKey) const;
     bool contains(const COutPoint &outpoint) const;
     bool contains(const uint256 &hash) const;
 
@@ -87,18 +128,29 @@ public:
 
     //! Scans output scripts for matches and adds those outpoints to the filter
     //! for spend detection. Returns true if any output matched, or the txid
-    //! matches.
-    bool MatchAndInsertOutputs(const CTransaction &tx);
+    //! matches. The elements must be the ones of tx.
+    bool MatchAndInsertOutputs(const CTransaction &tx,
+                               const CBloomTxElements &elements);
+    bool MatchAndInsertOutputs(const CTransaction &tx) {
+        return MatchAndInsertOutputs(tx, CBloomTxElements(tx));
+    }
 
     //! Scan inputs to see if the spent outpoints are a match, or the input
     //! scripts contain matching elements.
-    bool MatchInputs(const CTransaction &tx);
+    bool MatchInputs(const CBloomTxElements &elements) const;
+    bool MatchInputs(const CTransaction &tx) const {
+        return MatchInputs(CBloomTxElements(tx));
+    }
 
     //! Check if the transaction is relevant for any reason.
     //! Also adds any outputs which match the filter to the filter (to match
     //! their spending txes)
+    bool IsRelevantAndUpdate(const CTransaction &tx,
+                             const CBloomTxElements &elements) {
+        return MatchAndInsertOutputs(tx, elements) || MatchInputs(elements);
+    }
     bool IsRelevantAndUpdate(const CTransaction &tx) {
-        return MatchAndInsertOutputs(tx) || MatchInputs(tx);
+        return IsRelevantAndUpdate(tx, CBloomTxElements(tx));
     }
 };
 
@@ -136,4 +188,59 @@ private:
     int nHashFuncs;
 };
 
+/**
+ * A CRollingBloomFilter where all the bits of an element are in a single 64
+ * bytes block, so an insert or a lookup touches one cache line instead of one
+ * per hash function.
+ *
+ * A single SipHash of the element selects the block, and the positions of the
+ * nHashFuncs probes within it are derived from the same hash. The probes are
+ * then set or tested as a 256 bits mask, a few words at a time.
+ *
+ * Grouping the bits in blocks makes the false positive rate worse for a given
+ * size, as some blocks get more elements than the average. The filter is made
+ * large enough to keep the requested false positive rate, which takes around
+ * 20% more memory at 0.1% and 80% more at 0.0001%.
+ */
+class CBlockedRollingBloomFilter {
+public:
+    CBlockedRollingBloomFilter(const uint32_t nElements, const double nFPRate);
+
+    void insert(Span<const uint8_t> vKey);
+    void insert(const uint256 &hash);
+    bool contains(Span<const uint8_t> vKey) const;
+    bool contains(const uint256 &hash) const;
+
+    void reset();
+
+    //! Number of bytes allocated for the filter data
+    size_t GetMemoryUsage() const { return blocks.size() * sizeof(Block); }
+
+private:
+    static constexpr int BLOCK_BITS = 256;
+    static constexpr int BLOCK_WORDS = BLOCK_BITS / 64;
+
+    /**
+     * As in CRollingBloomFilter, each position is stored as 2 bits: the bit in
+     * gen1 is the lowest bit of the generation it was set in and the bit in
+     * gen2 the highest bit.
+     */
+    struct alignas(64) Block {
+        uint64_t gen1[BLOCK_WORDS];
+        uint64_t gen2[BLOCK_WORDS];
+    };
+
+    void insertHash(uint64_t hash);
+    bool containsHash(uint64_t hash) const;
+    size_t GetBlockIndex(uint64_t hash) const;
+    void GetProbeMask(uint64_t hash, uint64_t mask[BLOCK_WORDS]) const;
+
+    int nEntriesPerGeneration;
+    int nEntriesThisGeneration;
+    int nGeneration;
+    std::vector<Block> blocks;
+    uint64_t k0, k1;
+    int nHashFuncs;
+};
+
 #endif // BITCOIN_BLOOM_H
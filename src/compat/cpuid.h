@@ -22,5 +22,33 @@ void static inline GetCPUID(uint32_t leaf, uint32_t subleaf, uint32_t &a,
 #endif
 }
 
+/** Whether the CPU supports SSE4.1. */
+bool static inline HaveSSE41() {
+    uint32_t a, b, c, d;
+    GetCPUID(1, 0, a, b, c, d);
+    return (c >> 19) & 1;
+}
+
+/**
+ * Whether the CPU supports AVX2 and the OS saves the AVX registers across
+ * context switches.
+ */
+bool static inline HaveAVX2() {
+    uint32_t a, b, c, d;
+    GetCPUID(1, 0, a, b, c, d);
+    const bool have_xsave = (c >> 27) & 1;
+    const bool have_avx = (c >> 28) & 1;
+    if (!have_xsave || !have_avx) {
+        return false;
+    }
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 6) != 6) {
+        return false;
+    }
+    GetCPUID(7, 0, a, b, c, d);
+    return (b >> 5) & 1;
+}
+
 #endif // defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
 #endif // BITCOIN_COMPAT_CPUID_H
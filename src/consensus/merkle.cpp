@@ -74,3 +74,30 @@ uint256 BlockMerkleRoot(const CBlock &block, bool *mutated) {
     }
     return ComputeMerkleRoot(std::move(leaves), mutated);
 }
+
+std::vector<uint256> ComputeMerkleBranch(std::vector<uint256> hashes,
+                                         uint32_t position) {
+    std::vector<uint256> branch;
+    if (position >= hashes.size()) {
+        return branch;
+    }
+    while (hashes.size() > 1) {
+        if (hashes.size() & 1) {
+            hashes.push_back(hashes.back());
+        }
+        branch.push_back(hashes[position ^ 1]);
+        SHA256D64(hashes[0].begin(), hashes[0].begin(), hashes.size() / 2);
+        hashes.resize(hashes.size() / 2);
+        position >>= 1;
+    }
+    return branch;
+}
+
+std::vector<uint256> BlockMerkleBranch(const CBlock &block, uint32_t position) {
+    std::vector<uint256> leaves;
+    leaves.resize(block.vtx.size());
+    for (size_t s = 0; s < block.vtx.size(); s++) {
+        leaves[s] = block.vtx[s]->GetId();
+    }
+    return ComputeMerkleBranch(std::move(leaves), position);
+}
@@ -18,4 +18,18 @@ uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool *mutated = nullptr);
  */
 uint256 BlockMerkleRoot(const CBlock &block, bool *mutated = nullptr);
 
+/**
+ * Compute the Merkle branch for the leaf at the given position, i.e. the list
+ * of sibling hashes needed to recompute the root from that leaf. The branch
+ * is empty if the position is not the one of a leaf.
+ */
+std::vector<uint256> ComputeMerkleBranch(std::vector<uint256> hashes,
+                                         uint32_t position);
+
+/**
+ * Compute the Merkle branch for the transaction at the given position in a
+ * block.
+ */
+std::vector<uint256> BlockMerkleBranch(const CBlock &block, uint32_t position);
+
 #endif // BITCOIN_CONSENSUS_MERKLE_H
@@ -102,6 +102,8 @@ std::string SighashToStr(uint8_t sighash_type) {
 std::string ScriptToAsmStr(const CScript &script,
                            const bool fAttemptSighashDecode) {
     std::string str;
+    // Pushed data is the bulk of most scripts, and doubles in size as hex.
+    str.reserve(script.size() * 2);
     opcodetype opcode;
     std::vector<uint8_t> vch;
     CScript::const_iterator pc = script.begin();
@@ -122,7 +124,7 @@ std::string ScriptToAsmStr(const CScript &script,
                 // the IsUnspendable check makes sure not to try to decode
                 // OP_RETURN data that may match the format of a signature
                 if (fAttemptSighashDecode && !script.IsUnspendable()) {
-                    std::string strSigHashDecode;
+                    const std::string *strSigHashDecode = nullptr;
                     // goal: only attempt to decode a defined sighash type from
                     // data that looks like a signature within a scriptSig. This
                     // won't decode correctly formatted public keys in Pubkey or
@@ -142,16 +144,21 @@ std::string ScriptToAsmStr(const CScript &script,
                         const uint8_t chSigHashType = vch.back();
                         const auto it = mapSigHashTypes.find(chSigHashType);
                         if (it != mapSigHashTypes.end()) {
-                            strSigHashDecode = "[" + it->second + "]";
+                            strSigHashDecode = &it->second;
                             // remove the sighash type byte. it will be replaced
                             // by the decode.
                             vch.pop_back();
                         }
                     }
 
-                    str += HexStr(vch) + strSigHashDecode;
+                    AppendHexStr(str, vch);
+                    if (strSigHashDecode) {
+                        str += "[";
+                        str += *strSigHashDecode;
+                        str += "]";
+                    }
                 } else {
-                    str += HexStr(vch);
+                    AppendHexStr(str, vch);
                 }
             }
         } else {
@@ -189,6 +196,7 @@ void ScriptPubKeyToUniv(const CScript &scriptPubKey, UniValue &out,
     std::vector<CTxDestination> addresses;
     int nRequired;
 
+    out.reserve(5);
     out.pushKV("asm", ScriptToAsmStr(scriptPubKey));
     if (fIncludeHex) {
         out.pushKV("hex", HexStr(scriptPubKey));
@@ -204,14 +212,20 @@ void ScriptPubKeyToUniv(const CScript &scriptPubKey, UniValue &out,
     out.pushKV("type", GetTxnOutputType(type));
 
     UniValue a(UniValue::VARR);
+    a.reserve(addresses.size());
+    const Config &config = GetConfig();
     for (const CTxDestination &addr : addresses) {
-        a.push_back(EncodeDestination(addr, GetConfig()));
+        a.push_back(EncodeDestination(addr, config));
     }
-    out.pushKV("addresses", a);
+    out.pushKV("addresses", std::move(a));
 }
 
 void TxToUniv(const CTransaction &tx, const uint256 &hashBlock, UniValue &entry,
               bool include_hex, int serialize_flags) {
+    // Every value is moved into its parent rather than copied along with all
+    // its children, and the keys of the objects created here are known to be
+    // unique so they are appended without looking for an existing one.
+    entry.reserve(9);
     entry.pushKV("txid", tx.GetId().GetHex());
     entry.pushKV("hash", tx.GetHash().GetHex());
     // Transaction version is actually unsigned in consensus checks, just
@@ -222,42 +236,47 @@ void TxToUniv(const CTransaction &tx, const uint256 &hashBlock, UniValue &entry,
     entry.pushKV("locktime", (int64_t)tx.nLockTime);
 
     UniValue vin(UniValue::VARR);
+    vin.reserve(tx.vin.size());
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
         const CTxIn &txin = tx.vin[i];
         UniValue in(UniValue::VOBJ);
+        in.reserve(4);
         if (tx.IsCoinBase()) {
-            in.pushKV("coinbase", HexStr(txin.scriptSig));
+            in.__pushKV("coinbase", HexStr(txin.scriptSig));
         } else {
-            in.pushKV("txid", txin.prevout.GetTxId().GetHex());
-            in.pushKV("vout", int64_t(txin.prevout.GetN()));
+            in.__pushKV("txid", txin.prevout.GetTxId().GetHex());
+            in.__pushKV("vout", int64_t(txin.prevout.GetN()));
             UniValue o(UniValue::VOBJ);
-            o.pushKV("asm", ScriptToAsmStr(txin.scriptSig, true));
-            o.pushKV("hex", HexStr(txin.scriptSig));
-            in.pushKV("scriptSig", o);
+            o.reserve(2);
+            o.__pushKV("asm", ScriptToAsmStr(txin.scriptSig, true));
+            o.__pushKV("hex", HexStr(txin.scriptSig));
+            in.__pushKV("scriptSig", std::move(o));
         }
 
-        in.pushKV("sequence", (int64_t)txin.nSequence);
-        vin.push_back(in);
+        in.__pushKV("sequence", (int64_t)txin.nSequence);
+        vin.push_back(std::move(in));
     }
 
-    entry.pushKV("vin", vin);
+    entry.pushKV("vin", std::move(vin));
 
     UniValue vout(UniValue::VARR);
+    vout.reserve(tx.vout.size());
     for (unsigned int i = 0; i < tx.vout.size(); i++) {
         const CTxOut &txout = tx.vout[i];
 
         UniValue out(UniValue::VOBJ);
+        out.reserve(3);
 
-        out.pushKV("value", txout.nValue);
-        out.pushKV("n", int64_t(i));
+        out.__pushKV("value", txout.nValue);
+        out.__pushKV("n", int64_t(i));
 
         UniValue o(UniValue::VOBJ);
         ScriptPubKeyToUniv(txout.scriptPubKey, o, true);
-        out.pushKV("scriptPubKey", o);
-        vout.push_back(out);
+        out.__pushKV("scriptPubKey", std::move(o));
+        vout.push_back(std::move(out));
     }
 
-    entry.pushKV("vout", vout);
+    entry.pushKV("vout", std::move(vout));
 
     if (!hashBlock.IsNull()) {
         entry.pushKV("blockhash", hashBlock.GetHex());
@@ -6,9 +6,77 @@
 // See https://cr.yp.to/chacha.html.
 
 #include <crypto/chacha20.h>
+
+#include <compat/cpuid.h>
 #include <crypto/common.h>
 
 #include <cstring>
+#include <limits>
+
+namespace chacha20_sse41 {
+void Crypt_4way(const uint32_t *input, const uint8_t *m, uint8_t *c,
+                size_t blocks);
+}
+
+namespace chacha20_avx2 {
+void Crypt_8way(const uint32_t *input, const uint8_t *m, uint8_t *c,
+                size_t blocks);
+}
+
+namespace {
+/**
+ * Vectorized implementations, if supported by the CPU. They process a multiple
+ * of 4 (resp. 8) blocks starting at the block counter input[12], XORing the
+ * keystream with m unless it is null, but leave the counter to the caller.
+ */
+typedef void (*CryptBlocksFn)(const uint32_t *input, const uint8_t *m,
+                              uint8_t *c, size_t blocks);
+CryptBlocksFn CryptBlocks_4way = nullptr;
+CryptBlocksFn CryptBlocks_8way = nullptr;
+
+size_t CryptBlocksWith(CryptBlocksFn crypt_blocks, size_t width,
+                       uint32_t *input, const uint8_t *m, uint8_t *c,
+                       size_t bytes) {
+    const size_t blocks = bytes / 64 / width * width;
+    // The vectorized implementations don't carry the block counter into
+    // input[13], let the scalar code deal with the wraparound.
+    if (!crypt_blocks || !blocks ||
+        input[12] > std::numeric_limits<uint32_t>::max() - blocks) {
+        return 0;
+    }
+    crypt_blocks(input, m, c, blocks);
+    input[12] += blocks;
+    return blocks * 64;
+}
+
+/** Returns the number of bytes processed by the vectorized implementations. */
+size_t CryptBlocks(uint32_t *input, const uint8_t *m, uint8_t *c,
+                   size_t bytes) {
+    size_t done = CryptBlocksWith(CryptBlocks_8way, 8, input, m, c, bytes);
+    done += CryptBlocksWith(CryptBlocks_4way, 4, input, m ? m + done : nullptr,
+                            c + done, bytes - done);
+    return done;
+}
+} // namespace
+
+std::string ChaCha20AutoDetect() {
+    std::string ret = "standard";
+#if defined(HAVE_GETCPUID) && !defined(BUILD_BITCOIN_INTERNAL)
+#if defined(ENABLE_SSE41)
+    if (HaveSSE41()) {
+        CryptBlocks_4way = chacha20_sse41::Crypt_4way;
+        ret = "sse41(4way)";
+    }
+#endif
+#if defined(ENABLE_AVX2)
+    if (HaveAVX2()) {
+        CryptBlocks_8way = chacha20_avx2::Crypt_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
+#endif
+    return ret;
+}
 
 constexpr static inline uint32_t rotl32(uint32_t v, int c) {
     return (v << c) | (v >> (32 - c));
@@ -85,6 +153,10 @@ void ChaCha20::Keystream(uint8_t *c, size_t bytes) {
     uint8_t tmp[64];
     unsigned int i;
 
+    const size_t done = CryptBlocks(input, nullptr, c, bytes);
+    c += done;
+    bytes -= done;
+
     if (!bytes) {
         return;
     }
@@ -200,6 +272,11 @@ void ChaCha20::Crypt(const uint8_t *m, uint8_t *c, size_t bytes) {
     uint8_t tmp[64];
     unsigned int i;
 
+    const size_t done = CryptBlocks(input, m, c, bytes);
+    m += done;
+    c += done;
+    bytes -= done;
+
     if (!bytes) {
         return;
     }
@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <string>
 
 /**
  * A class for ChaCha20 256-bit stream cipher developed by Daniel J. Bernstein
@@ -36,4 +37,10 @@ public:
     void Crypt(const uint8_t *input, uint8_t *output, size_t bytes);
 };
 
+/**
+ * Autodetect the best available ChaCha20 implementation.
+ * Returns the name of the implementation.
+ */
+std::string ChaCha20AutoDetect();
+
 #endif // BITCOIN_CRYPTO_CHACHA20_H
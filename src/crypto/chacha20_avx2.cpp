@@ -0,0 +1,125 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace chacha20_avx2 {
+namespace {
+
+    __m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+    __m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+    template <int N> __m256i inline RotL(__m256i x) {
+        return _mm256_or_si256(_mm256_slli_epi32(x, N),
+                               _mm256_srli_epi32(x, 32 - N));
+    }
+    // Rotations by a multiple of 8 bits are byte shuffles.
+    template <> __m256i inline RotL<16>(__m256i x) {
+        return _mm256_shuffle_epi8(
+            x, _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15,
+                                12, 13, 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9,
+                                14, 15, 12, 13));
+    }
+    template <> __m256i inline RotL<8>(__m256i x) {
+        return _mm256_shuffle_epi8(
+            x, _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12,
+                                13, 14, 3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10,
+                                15, 12, 13, 14));
+    }
+
+    void inline __attribute__((always_inline))
+    QuarterRound(__m256i &a, __m256i &b, __m256i &c, __m256i &d) {
+        a = Add(a, b);
+        d = RotL<16>(Xor(d, a));
+        c = Add(c, d);
+        b = RotL<12>(Xor(b, c));
+        a = Add(a, b);
+        d = RotL<8>(Xor(d, a));
+        c = Add(c, d);
+        b = RotL<7>(Xor(b, c));
+    }
+
+    /** Write 32 bytes of keystream, XORed with the message if any. */
+    void inline Write(uint8_t *out, const uint8_t *in, __m256i v) {
+        if (in) {
+            v = Xor(v, _mm256_loadu_si256((const __m256i *)in));
+        }
+        _mm256_storeu_si256((__m256i *)out, v);
+    }
+
+} // namespace
+
+/**
+ * Process 8 ChaCha20 blocks at a time, each lane of the vectors holding the
+ * state of one block.
+ */
+void Crypt_8way(const uint32_t *input, const uint8_t *m, uint8_t *c,
+                size_t blocks) {
+    __m256i j[16];
+    for (int i = 0; i < 16; ++i) {
+        j[i] = _mm256_set1_epi32(input[i]);
+    }
+    j[12] = Add(j[12], _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    for (; blocks >= 8; blocks -= 8) {
+        __m256i x[16];
+        for (int i = 0; i < 16; ++i) {
+            x[i] = j[i];
+        }
+        for (int i = 0; i < 10; ++i) {
+            QuarterRound(x[0], x[4], x[8], x[12]);
+            QuarterRound(x[1], x[5], x[9], x[13]);
+            QuarterRound(x[2], x[6], x[10], x[14]);
+            QuarterRound(x[3], x[7], x[11], x[15]);
+            QuarterRound(x[0], x[5], x[10], x[15]);
+            QuarterRound(x[1], x[6], x[11], x[12]);
+            QuarterRound(x[2], x[7], x[8], x[13]);
+            QuarterRound(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; ++i) {
+            x[i] = Add(x[i], j[i]);
+        }
+
+        // Transpose each group of 4 words within the 128 bits halves: v[g][b]
+        // holds the words 4g to 4g+3 of the block b in its lower half and of
+        // the block b+4 in its upper half.
+        __m256i v[4][4];
+        for (int g = 0; g < 4; ++g) {
+            const __m256i t0 = _mm256_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+            const __m256i t1 =
+                _mm256_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+            const __m256i t2 = _mm256_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+            const __m256i t3 =
+                _mm256_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+            v[g][0] = _mm256_unpacklo_epi64(t0, t1);
+            v[g][1] = _mm256_unpackhi_epi64(t0, t1);
+            v[g][2] = _mm256_unpacklo_epi64(t2, t3);
+            v[g][3] = _mm256_unpackhi_epi64(t2, t3);
+        }
+        for (int b = 0; b < 4; ++b) {
+            const size_t lo = 64 * b;
+            const size_t hi = 64 * (b + 4);
+            Write(c + lo, m ? m + lo : nullptr,
+                  _mm256_permute2x128_si256(v[0][b], v[1][b], 0x20));
+            Write(c + lo + 32, m ? m + lo + 32 : nullptr,
+                  _mm256_permute2x128_si256(v[2][b], v[3][b], 0x20));
+            Write(c + hi, m ? m + hi : nullptr,
+                  _mm256_permute2x128_si256(v[0][b], v[1][b], 0x31));
+            Write(c + hi + 32, m ? m + hi + 32 : nullptr,
+                  _mm256_permute2x128_si256(v[2][b], v[3][b], 0x31));
+        }
+
+        j[12] = Add(j[12], _mm256_set1_epi32(8));
+        c += 512;
+        if (m) {
+            m += 512;
+        }
+    }
+}
+} // namespace chacha20_avx2
+
+#endif
@@ -0,0 +1,109 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_SSE41
+
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace chacha20_sse41 {
+namespace {
+
+    __m128i inline Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+    __m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+    template <int N> __m128i inline RotL(__m128i x) {
+        return _mm_or_si128(_mm_slli_epi32(x, N), _mm_srli_epi32(x, 32 - N));
+    }
+    // Rotations by a multiple of 8 bits are byte shuffles.
+    template <> __m128i inline RotL<16>(__m128i x) {
+        return _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10,
+                                                 11, 8, 9, 14, 15, 12, 13));
+    }
+    template <> __m128i inline RotL<8>(__m128i x) {
+        return _mm_shuffle_epi8(x, _mm_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8,
+                                                 9, 10, 15, 12, 13, 14));
+    }
+
+    void inline __attribute__((always_inline))
+    QuarterRound(__m128i &a, __m128i &b, __m128i &c, __m128i &d) {
+        a = Add(a, b);
+        d = RotL<16>(Xor(d, a));
+        c = Add(c, d);
+        b = RotL<12>(Xor(b, c));
+        a = Add(a, b);
+        d = RotL<8>(Xor(d, a));
+        c = Add(c, d);
+        b = RotL<7>(Xor(b, c));
+    }
+
+    /** Write 16 bytes of keystream, XORed with the message if any. */
+    void inline Write(uint8_t *out, const uint8_t *in, __m128i v) {
+        if (in) {
+            v = Xor(v, _mm_loadu_si128((const __m128i *)in));
+        }
+        _mm_storeu_si128((__m128i *)out, v);
+    }
+
+} // namespace
+
+/**
+ * Process 4 ChaCha20 blocks at a time, each lane of the vectors holding the
+ * state of one block.
+ */
+void Crypt_4way(const uint32_t *input, const uint8_t *m, uint8_t *c,
+                size_t blocks) {
+    __m128i j[16];
+    for (int i = 0; i < 16; ++i) {
+        j[i] = _mm_set1_epi32(input[i]);
+    }
+    j[12] = Add(j[12], _mm_setr_epi32(0, 1, 2, 3));
+
+    for (; blocks >= 4; blocks -= 4) {
+        __m128i x[16];
+        for (int i = 0; i < 16; ++i) {
+            x[i] = j[i];
+        }
+        for (int i = 0; i < 10; ++i) {
+            QuarterRound(x[0], x[4], x[8], x[12]);
+            QuarterRound(x[1], x[5], x[9], x[13]);
+            QuarterRound(x[2], x[6], x[10], x[14]);
+            QuarterRound(x[3], x[7], x[11], x[15]);
+            QuarterRound(x[0], x[5], x[10], x[15]);
+            QuarterRound(x[1], x[6], x[11], x[12]);
+            QuarterRound(x[2], x[7], x[8], x[13]);
+            QuarterRound(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; ++i) {
+            x[i] = Add(x[i], j[i]);
+        }
+
+        // Transpose each group of 4 words so a vector holds 16 contiguous
+        // bytes of a block.
+        for (int g = 0; g < 4; ++g) {
+            const __m128i t0 = _mm_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+            const __m128i t1 = _mm_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+            const __m128i t2 = _mm_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+            const __m128i t3 = _mm_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+            const size_t offset = 16 * g;
+            Write(c + offset, m ? m + offset : nullptr,
+                  _mm_unpacklo_epi64(t0, t1));
+            Write(c + 64 + offset, m ? m + 64 + offset : nullptr,
+                  _mm_unpackhi_epi64(t0, t1));
+            Write(c + 128 + offset, m ? m + 128 + offset : nullptr,
+                  _mm_unpacklo_epi64(t2, t3));
+            Write(c + 192 + offset, m ? m + 192 + offset : nullptr,
+                  _mm_unpackhi_epi64(t2, t3));
+        }
+
+        j[12] = Add(j[12], _mm_set1_epi32(4));
+        c += 256;
+        if (m) {
+            m += 256;
+        }
+    }
+}
+} // namespace chacha20_sse41
+
+#endif
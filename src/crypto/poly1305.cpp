@@ -5,13 +5,78 @@
 // Based on the public domain implementation by Andrew Moon
 // poly1305-donna-unrolled.c from https://github.com/floodyberry/poly1305-donna
 
-#include <crypto/common.h>
 #include <crypto/poly1305.h>
 
+#include <compat/cpuid.h>
+#include <crypto/common.h>
+
 #include <cstring>
 
 #define mul32x32_64(a, b) ((uint64_t)(a) * (b))
 
+namespace poly1305_avx2 {
+void Blocks_4way(uint32_t h[5], const uint32_t rpow[4][5], const uint8_t *m,
+                 size_t blocks);
+}
+
+namespace {
+/**
+ * Vectorized implementation, if supported by the CPU. It absorbs a multiple of
+ * 4 blocks, given the powers r to r^4 of the key.
+ */
+void (*Blocks_4way)(uint32_t h[5], const uint32_t rpow[4][5],
+                    const uint8_t *m, size_t blocks) = nullptr;
+
+/**
+ * Below this length, computing the powers of r costs more than the vectorized
+ * implementation saves.
+ */
+constexpr size_t MIN_VECTORIZED_BYTES = 256;
+
+/** out = a * b modulo 2^130 - 5, on 26 bits limbs. */
+void MulMod(uint32_t out[5], const uint32_t a[5], const uint32_t b[5]) {
+    const uint32_t s1 = b[1] * 5, s2 = b[2] * 5, s3 = b[3] * 5, s4 = b[4] * 5;
+    uint64_t t0 = mul32x32_64(a[0], b[0]) + mul32x32_64(a[1], s4) +
+                  mul32x32_64(a[2], s3) + mul32x32_64(a[3], s2) +
+                  mul32x32_64(a[4], s1);
+    uint64_t t1 = mul32x32_64(a[0], b[1]) + mul32x32_64(a[1], b[0]) +
+                  mul32x32_64(a[2], s4) + mul32x32_64(a[3], s3) +
+                  mul32x32_64(a[4], s2);
+    uint64_t t2 = mul32x32_64(a[0], b[2]) + mul32x32_64(a[1], b[1]) +
+                  mul32x32_64(a[2], b[0]) + mul32x32_64(a[3], s4) +
+                  mul32x32_64(a[4], s3);
+    uint64_t t3 = mul32x32_64(a[0], b[3]) + mul32x32_64(a[1], b[2]) +
+                  mul32x32_64(a[2], b[1]) + mul32x32_64(a[3], b[0]) +
+                  mul32x32_64(a[4], s4);
+    uint64_t t4 = mul32x32_64(a[0], b[4]) + mul32x32_64(a[1], b[3]) +
+                  mul32x32_64(a[2], b[2]) + mul32x32_64(a[3], b[1]) +
+                  mul32x32_64(a[4], b[0]);
+
+    t1 += t0 >> 26;
+    t2 += t1 >> 26;
+    t3 += t2 >> 26;
+    t4 += t3 >> 26;
+    t0 = (t0 & 0x3ffffff) + (t4 >> 26) * 5;
+    out[0] = t0 & 0x3ffffff;
+    out[1] = (t1 & 0x3ffffff) + (t0 >> 26);
+    out[2] = t2 & 0x3ffffff;
+    out[3] = t3 & 0x3ffffff;
+    out[4] = t4 & 0x3ffffff;
+}
+} // namespace
+
+std::string Poly1305AutoDetect() {
+    std::string ret = "standard";
+#if defined(HAVE_GETCPUID) && defined(ENABLE_AVX2) &&                          \
+    !defined(BUILD_BITCOIN_INTERNAL)
+    if (HaveAVX2()) {
+        Blocks_4way = poly1305_avx2::Blocks_4way;
+        ret = "avx2(4way)";
+    }
+#endif
+    return ret;
+}
+
 void poly1305_auth(uint8_t out[POLY1305_TAGLEN], const uint8_t *m, size_t inlen,
                    const uint8_t key[POLY1305_KEYLEN]) {
     uint32_t t0, t1, t2, t3;
@@ -58,6 +123,24 @@ void poly1305_auth(uint8_t out[POLY1305_TAGLEN], const uint8_t *m, size_t inlen,
     h3 = 0;
     h4 = 0;
 
+    /* absorb the bulk of the message 4 blocks at a time */
+    if (Blocks_4way && inlen >= MIN_VECTORIZED_BYTES) {
+        uint32_t rpow[4][5] = {{r0, r1, r2, r3, r4}};
+        for (int i = 1; i < 4; i++) {
+            MulMod(rpow[i], rpow[i - 1], rpow[0]);
+        }
+        uint32_t h[5] = {h0, h1, h2, h3, h4};
+        const size_t blocks = inlen / 64 * 4;
+        Blocks_4way(h, rpow, m, blocks);
+        h0 = h[0];
+        h1 = h[1];
+        h2 = h[2];
+        h3 = h[3];
+        h4 = h[4];
+        m += blocks * 16;
+        inlen -= blocks * 16;
+    }
+
     /* full blocks */
     if (inlen < 16) {
         goto poly1305_donna_atmost15bytes;
@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <string>
 
 #define POLY1305_KEYLEN 32
 #define POLY1305_TAGLEN 16
@@ -14,4 +15,10 @@
 void poly1305_auth(uint8_t out[POLY1305_TAGLEN], const uint8_t *m, size_t inlen,
                    const uint8_t key[POLY1305_KEYLEN]);
 
+/**
+ * Autodetect the best available Poly1305 implementation.
+ * Returns the name of the implementation.
+ */
+std::string Poly1305AutoDetect();
+
 #endif // BITCOIN_CRYPTO_POLY1305_H
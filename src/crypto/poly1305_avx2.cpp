@@ -0,0 +1,144 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace poly1305_avx2 {
+namespace {
+
+    __m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+    __m256i inline Mul(__m256i x, __m256i y) { return _mm256_mul_epu32(x, y); }
+    __m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+    __m256i inline ShR(__m256i x, int n) { return _mm256_srli_epi64(x, n); }
+
+    __m256i inline Mask26() { return _mm256_set1_epi64x(0x3ffffff); }
+
+    /**
+     * Multiply the 26 bits limbs of h by r modulo 2^130 - 5, s being 5 * r.
+     * Each of the 4 lanes is an independent product.
+     */
+    void inline __attribute__((always_inline))
+    MulMod(__m256i h[5], const __m256i r[5], const __m256i s[5]) {
+        __m256i t0 = Add(Add(Mul(h[0], r[0]), Mul(h[1], s[4])),
+                         Add(Add(Mul(h[2], s[3]), Mul(h[3], s[2])),
+                             Mul(h[4], s[1])));
+        __m256i t1 = Add(Add(Mul(h[0], r[1]), Mul(h[1], r[0])),
+                         Add(Add(Mul(h[2], s[4]), Mul(h[3], s[3])),
+                             Mul(h[4], s[2])));
+        __m256i t2 = Add(Add(Mul(h[0], r[2]), Mul(h[1], r[1])),
+                         Add(Add(Mul(h[2], r[0]), Mul(h[3], s[4])),
+                             Mul(h[4], s[3])));
+        __m256i t3 = Add(Add(Mul(h[0], r[3]), Mul(h[1], r[2])),
+                         Add(Add(Mul(h[2], r[1]), Mul(h[3], r[0])),
+                             Mul(h[4], s[4])));
+        __m256i t4 = Add(Add(Mul(h[0], r[4]), Mul(h[1], r[3])),
+                         Add(Add(Mul(h[2], r[2]), Mul(h[3], r[1])),
+                             Mul(h[4], r[0])));
+
+        t1 = Add(t1, ShR(t0, 26));
+        h[0] = And(t0, Mask26());
+        t2 = Add(t2, ShR(t1, 26));
+        h[1] = And(t1, Mask26());
+        t3 = Add(t3, ShR(t2, 26));
+        h[2] = And(t2, Mask26());
+        t4 = Add(t4, ShR(t3, 26));
+        h[3] = And(t3, Mask26());
+        const __m256i c = ShR(t4, 26);
+        h[4] = And(t4, Mask26());
+        h[0] = Add(h[0], Add(c, _mm256_slli_epi64(c, 2)));
+        h[1] = Add(h[1], ShR(h[0], 26));
+        h[0] = And(h[0], Mask26());
+    }
+
+    uint64_t inline Sum(__m256i x) {
+        return uint64_t(_mm256_extract_epi64(x, 0)) +
+               uint64_t(_mm256_extract_epi64(x, 1)) +
+               uint64_t(_mm256_extract_epi64(x, 2)) +
+               uint64_t(_mm256_extract_epi64(x, 3));
+    }
+
+} // namespace
+
+/**
+ * Absorb blocks (a multiple of 4) full 16 bytes message blocks into the
+ * accumulator h, as the scalar loop would: h = (h + m_0) * r^n + m_1 * r^(n-1)
+ * + ... + m_(n-1) * r.
+ *
+ * Each lane accumulates every fourth block with Horner's rule in r^4, and the
+ * lanes are multiplied by the remaining power of r before being summed. rpow[i]
+ * holds the 26 bits limbs of r^(i+1).
+ */
+void Blocks_4way(uint32_t h[5], const uint32_t rpow[4][5], const uint8_t *m,
+                 size_t blocks) {
+    const __m256i hibit = _mm256_set1_epi64x(1 << 24);
+
+    __m256i r4[5], s4[5];
+    for (int i = 0; i < 5; ++i) {
+        r4[i] = _mm256_set1_epi64x(rpow[3][i]);
+        s4[i] = _mm256_set1_epi64x(5 * uint64_t(rpow[3][i]));
+    }
+
+    // The unpacks below put the blocks 0, 2, 1 and 3 of each group in the
+    // lanes 0 to 3.
+    __m256i acc[5];
+    for (int i = 0; i < 5; ++i) {
+        acc[i] = _mm256_setr_epi64x(h[i], 0, 0, 0);
+    }
+
+    for (;;) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)m);
+        const __m256i b = _mm256_loadu_si256((const __m256i *)(m + 32));
+        const __m256i lo = _mm256_unpacklo_epi64(a, b);
+        const __m256i hi = _mm256_unpackhi_epi64(a, b);
+
+        acc[0] = Add(acc[0], And(lo, Mask26()));
+        acc[1] = Add(acc[1], And(ShR(lo, 26), Mask26()));
+        acc[2] = Add(acc[2], And(_mm256_or_si256(ShR(lo, 52),
+                                                 _mm256_slli_epi64(hi, 12)),
+                                 Mask26()));
+        acc[3] = Add(acc[3], And(ShR(hi, 14), Mask26()));
+        acc[4] = Add(acc[4], _mm256_or_si256(ShR(hi, 40), hibit));
+
+        m += 64;
+        blocks -= 4;
+        if (blocks < 4) {
+            break;
+        }
+        MulMod(acc, r4, s4);
+    }
+
+    // Multiply the lanes by r^4, r^2, r^3 and r^1 respectively.
+    __m256i r[5], s[5];
+    for (int i = 0; i < 5; ++i) {
+        r[i] = _mm256_setr_epi64x(rpow[3][i], rpow[1][i], rpow[2][i],
+                                  rpow[0][i]);
+        s[i] = _mm256_setr_epi64x(5 * uint64_t(rpow[3][i]),
+                                  5 * uint64_t(rpow[1][i]),
+                                  5 * uint64_t(rpow[2][i]),
+                                  5 * uint64_t(rpow[0][i]));
+    }
+    MulMod(acc, r, s);
+
+    uint64_t t[5];
+    for (int i = 0; i < 5; ++i) {
+        t[i] = Sum(acc[i]);
+    }
+    t[1] += t[0] >> 26;
+    t[2] += t[1] >> 26;
+    t[3] += t[2] >> 26;
+    t[4] += t[3] >> 26;
+    t[0] = (t[0] & 0x3ffffff) + (t[4] >> 26) * 5;
+    h[0] = t[0] & 0x3ffffff;
+    h[1] = (t[1] & 0x3ffffff) + (t[0] >> 26);
+    h[2] = t[2] & 0x3ffffff;
+    h[3] = t[3] & 0x3ffffff;
+    h[4] = t[4] & 0x3ffffff;
+}
+} // namespace poly1305_avx2
+
+#endif
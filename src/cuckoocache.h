@@ -10,7 +10,9 @@
 #include <atomic>
 #include <cmath>
 #include <cstring>
+#include <functional>
 #include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -115,6 +117,22 @@ public:
     }
 };
 
+/**
+ * cache_stats holds the counters returned by @ref cache::get_stats.
+ */
+struct cache_stats {
+    /** Number of slots of the table */
+    uint32_t size;
+    /** Number of slots of the table still being migrated after a resize */
+    uint32_t migrating_size;
+    /** Lookups which found, or did not find, the element */
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    /** Elements dropped by insert after running out of depth */
+    uint64_t evictions;
+};
+
 /**
  * @ref cache implements a cache with properties similar to a cuckoo-set.
  *
@@ -123,6 +141,7 @@ public:
  *  Read Operations:
  *      - contains() for `erase=false`
  *      - get() for `erase=false`
+ *      - get_stats()
  *
  *  Read+Erase Operations:
  *      - contains() for `erase=true`
@@ -134,6 +153,8 @@ public:
  *  Write Operations:
  *      - setup()
  *      - setup_bytes()
+ *      - resize()
+ *      - resize_bytes()
  *      - insert()
  *      - please_keep()
  *
@@ -205,6 +226,55 @@ private:
      */
     uint8_t depth_limit;
 
+    /**
+     * While the cache is being resized, old_table holds the elements of the
+     * table it had before, along with their collection and epoch flags. They
+     * are moved to the new table a few at a time by each insert, starting at
+     * index migrate_pos, and lookups search both tables in the meantime.
+     */
+    std::vector<Element> old_table;
+    uint32_t old_size;
+    mutable bit_packed_atomic_flags old_collection_flags;
+    std::vector<bool> old_epoch_flags;
+    uint32_t migrate_pos;
+
+    /**
+     * Number of slots of the old table migrated by each insert, so a resize
+     * completes after inserting a sixteenth of the old size.
+     */
+    static constexpr uint32_t MIGRATE_STEP = 16;
+
+    /**
+     * Maximum number of slots of the old table migrated by resize() when a
+     * previous migration is still in progress. The elements past it are
+     * dropped, so that resize() doesn't hold the exclusive lock of the cache
+     * for a whole migration.
+     */
+    static constexpr uint32_t RESIZE_MIGRATE_LIMIT = 4096;
+
+    /**
+     * The lookups may run concurrently on the script check threads, so they
+     * are counted in shards each on its own cache line, the threads updating
+     * the shard they hash to rather than one shared counter.
+     */
+    struct alignas(64) lookup_counters {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+    };
+    static constexpr size_t COUNTER_SHARDS = 16;
+    mutable std::array<lookup_counters, COUNTER_SHARDS> lookups;
+
+    lookup_counters &thread_counters() const {
+        static thread_local const size_t shard =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) %
+            COUNTER_SHARDS;
+        return lookups[shard];
+    }
+
+    /** Counters reported by get_stats, inserts are externally synchronized. */
+    uint64_t inserts;
+    uint64_t evictions;
+
     /**
      * hash_function is a const instance of the hash function. It cannot be
      * static or initialized at call time as it may have internal state (such as
@@ -257,34 +327,36 @@ private:
      * high 32 bits of a 32*32->64 multiply, which means the operation is
      * reasonably fast even on a typical 32-bit processor.
      *
-     * @param e The element whose hashes will be returned
-     * @returns Deterministic hashes derived from `e` uniformly mapped onto the
-     * range [0, size)
+     * @param k The key whose hashes will be returned
+     * @param n The size of the table the hashes index into
+     * @returns Deterministic hashes derived from `k` uniformly mapped onto the
+     * range [0, n)
      */
-    inline std::array<uint32_t, 8> compute_hashes(const Key &k) const {
+    inline std::array<uint32_t, 8> compute_hashes(const Key &k,
+                                                  uint32_t n) const {
         return {{uint32_t(uint64_t(hash_function.template operator()<0>(k)) *
-                              uint64_t(size) >>
+                              uint64_t(n) >>
                           32),
                  uint32_t(uint64_t(hash_function.template operator()<1>(k)) *
-                              uint64_t(size) >>
+                              uint64_t(n) >>
                           32),
                  uint32_t(uint64_t(hash_function.template operator()<2>(k)) *
-                              uint64_t(size) >>
+                              uint64_t(n) >>
                           32),
                  uint32_t(uint64_t(hash_function.template operator()<3>(k)) *
-                              uint64_t(size) >>
+                              uint64_t(n) >>
                           32),
                  uint32_t(uint64_t(hash_function.template operator()<4>(k)) *
-                              uint64_t(size) >>
+                              uint64_t(n) >>
                           32),
                  uint32_t(uint64_t(hash_function.template operator()<5>(k)) *
-                              uint64_t(size) >>
+                              uint64_t(n) >>
                           32),
                  uint32_t(uint64_t(hash_function.template operator()<6>(k)) *
-                              uint64_t(size) >>
+                              uint64_t(n) >>
                           32),
                  uint32_t(uint64_t(hash_function.template operator()<7>(k)) *
-                              uint64_t(size) >>
+                              uint64_t(n) >>
                           32)}};
     }
 
@@ -355,6 +427,97 @@ private:
         }
     }
 
+    /**
+     * insert_element inserts e in the table as described in insert(), with
+     * the epoch flag `epoch`.
+     */
+    void insert_element(Element e, bool replace, bool epoch) {
+        uint32_t last_loc = invalid();
+        bool last_epoch = epoch;
+        std::array<uint32_t, 8> locs = compute_hashes(e.getKey(), size);
+        // Make sure we have not already inserted this element.
+        // If we have, make sure that it does not get deleted.
+        for (const uint32_t loc : locs) {
+            if (table[loc].getKey() == e.getKey()) {
+                if (replace) {
+                    table[loc] = std::move(e);
+                }
+                please_keep(loc);
+                epoch_flags[loc] = last_epoch;
+                return;
+            }
+        }
+        for (uint8_t depth = 0; depth < depth_limit; ++depth) {
+            // First try to insert to an empty slot, if one exists
+            for (const uint32_t loc : locs) {
+                if (!collection_flags.bit_is_set(loc)) {
+                    continue;
+                }
+                table[loc] = std::move(e);
+                please_keep(loc);
+                epoch_flags[loc] = last_epoch;
+                return;
+            }
+            /**
+             * Swap with the element at the location that was not the last one
+             * looked at. Example:
+             *
+             * 1. On first iteration, last_loc == invalid(), find returns last,
+             * so last_loc defaults to locs[0].
+             * 2. On further iterations, where last_loc == locs[k], last_loc
+             * will go to locs[k+1 % 8], i.e., next of the 8 indices wrapping
+             * around to 0 if needed.
+             *
+             * This prevents moving the element we just put in.
+             *
+             * The swap is not a move -- we must switch onto the evicted element
+             * for the next iteration.
+             */
+            last_loc =
+                locs[(1 + (std::find(locs.begin(), locs.end(), last_loc) -
+                           locs.begin())) &
+                     7];
+            std::swap(table[last_loc], e);
+            // Can't std::swap a std::vector<bool>::reference and a bool&.
+            bool epoch_swap = last_epoch;
+            last_epoch = epoch_flags[last_loc];
+            epoch_flags[last_loc] = epoch_swap;
+
+            // Recompute the locs -- unfortunately happens one too many times!
+            locs = compute_hashes(e.getKey(), size);
+        }
+        ++evictions;
+    }
+
+    /**
+     * migrate moves the live elements among the next `n` slots of the old
+     * table to the table, and frees the old table once it is exhausted.
+     */
+    void migrate(uint32_t n) {
+        for (; n > 0 && migrate_pos < old_size; --n, ++migrate_pos) {
+            if (old_collection_flags.bit_is_set(migrate_pos)) {
+                continue;
+            }
+            // The element is copied rather than moved, as lookups may still
+            // compare against it until the old table is freed.
+            insert_element(old_table[migrate_pos], false,
+                           old_epoch_flags[migrate_pos]);
+            old_collection_flags.bit_set(migrate_pos);
+        }
+        if (migrate_pos == old_size && old_size != 0) {
+            free_old_table();
+        }
+    }
+
+    /** free_old_table ends a migration, dropping what is left to migrate. */
+    void free_old_table() {
+        old_table = std::vector<Element>();
+        old_size = 0;
+        old_collection_flags.setup(0);
+        old_epoch_flags = std::vector<bool>();
+        migrate_pos = 0;
+    }
+
 public:
     /**
      * You must always construct a cache with some elements via a subsequent
@@ -362,14 +525,17 @@ public:
      */
     cache()
         : table(), size(), collection_flags(0), epoch_flags(),
-          epoch_heuristic_counter(), epoch_size(), depth_limit(0),
+          epoch_heuristic_counter(), epoch_size(), depth_limit(0), old_table(),
+          old_size(0), old_collection_flags(0), old_epoch_flags(),
+          migrate_pos(0), lookups(), inserts(0), evictions(0),
           hash_function() {}
 
     /**
      * setup initializes the container to store no more than new_size
      * elements.
      *
-     * setup should only be called once.
+     * setup should only be called once, use resize() to change the size of
+     * a cache holding elements.
      *
      * @param new_size the desired number of elements to store
      * @returns the maximum number of elements storable
@@ -406,6 +572,52 @@ public:
         return setup(bytes / sizeof(Element));
     }
 
+    /**
+     * resize changes the number of elements the cache can store, without
+     * losing the ones it holds: they stay in the previous table and are
+     * migrated to the new one by the subsequent inserts, while lookups keep
+     * finding them in either table. Both tables are allocated until the
+     * migration completes. If a previous migration is still in progress, at
+     * most RESIZE_MIGRATE_LIMIT more slots of its old table are migrated and
+     * the rest of it is dropped.
+     *
+     * Not threadsafe with any concurrent operation.
+     *
+     * @param new_size the desired number of elements to store
+     * @returns the maximum number of elements storable
+     */
+    uint32_t resize(uint32_t new_size) {
+        migrate(RESIZE_MIGRATE_LIMIT);
+        if (old_size != 0) {
+            free_old_table();
+        }
+        std::swap(table, old_table);
+        std::swap(collection_flags, old_collection_flags);
+        std::swap(epoch_flags, old_epoch_flags);
+        old_size = size;
+        migrate_pos = 0;
+        return setup(new_size);
+    }
+
+    /** resize_bytes is to resize() what setup_bytes() is to setup(). */
+    uint32_t resize_bytes(size_t bytes) {
+        return resize(bytes / sizeof(Element));
+    }
+
+    /**
+     * get_stats returns the sizes of the tables and the operation counters.
+     * Threadsafe without any concurrent insert.
+     */
+    cache_stats get_stats() const {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        for (const lookup_counters &counters : lookups) {
+            hits += counters.hits.load(std::memory_order_relaxed);
+            misses += counters.misses.load(std::memory_order_relaxed);
+        }
+        return {size, old_size, hits, misses, inserts, evictions};
+    }
+
     /**
      * insert loops at most depth_limit times trying to insert a hash at various
      * locations in the table via a variant of the Cuckoo Algorithm with eight
@@ -433,60 +645,23 @@ public:
      */
     inline void insert(Element e, bool replace = false) {
         epoch_check();
-        uint32_t last_loc = invalid();
-        bool last_epoch = true;
-        std::array<uint32_t, 8> locs = compute_hashes(e.getKey());
-        // Make sure we have not already inserted this element.
-        // If we have, make sure that it does not get deleted.
-        for (const uint32_t loc : locs) {
-            if (table[loc].getKey() == e.getKey()) {
-                if (replace) {
-                    table[loc] = std::move(e);
-                }
-                please_keep(loc);
-                epoch_flags[loc] = last_epoch;
-                return;
-            }
-        }
-        for (uint8_t depth = 0; depth < depth_limit; ++depth) {
-            // First try to insert to an empty slot, if one exists
-            for (const uint32_t loc : locs) {
-                if (!collection_flags.bit_is_set(loc)) {
-                    continue;
+        ++inserts;
+        if (old_size != 0) {
+            // Move the element out of the old table if it is still there, so
+            // it doesn't outlive its replacement.
+            for (const uint32_t loc : compute_hashes(e.getKey(), old_size)) {
+                if (old_table[loc].getKey() == e.getKey() &&
+                    !old_collection_flags.bit_is_set(loc)) {
+                    if (!replace) {
+                        e = old_table[loc];
+                    }
+                    old_collection_flags.bit_set(loc);
+                    break;
                 }
-                table[loc] = std::move(e);
-                please_keep(loc);
-                epoch_flags[loc] = last_epoch;
-                return;
             }
-            /**
-             * Swap with the element at the location that was not the last one
-             * looked at. Example:
-             *
-             * 1. On first iteration, last_loc == invalid(), find returns last,
-             * so last_loc defaults to locs[0].
-             * 2. On further iterations, where last_loc == locs[k], last_loc
-             * will go to locs[k+1 % 8], i.e., next of the 8 indices wrapping
-             * around to 0 if needed.
-             *
-             * This prevents moving the element we just put in.
-             *
-             * The swap is not a move -- we must switch onto the evicted element
-             * for the next iteration.
-             */
-            last_loc =
-                locs[(1 + (std::find(locs.begin(), locs.end(), last_loc) -
-                           locs.begin())) &
-                     7];
-            std::swap(table[last_loc], e);
-            // Can't std::swap a std::vector<bool>::reference and a bool&.
-            bool epoch = last_epoch;
-            last_epoch = epoch_flags[last_loc];
-            epoch_flags[last_loc] = epoch;
-
-            // Recompute the locs -- unfortunately happens one too many times!
-            locs = compute_hashes(e.getKey());
+            migrate(MIGRATE_STEP);
         }
+        insert_element(std::move(e), replace, true);
     }
 
     /**
@@ -544,15 +719,28 @@ public:
 
 private:
     const Element *find(const Key &k, const bool erase) const {
-        std::array<uint32_t, 8> locs = compute_hashes(k);
-        for (const uint32_t loc : locs) {
+        for (const uint32_t loc : compute_hashes(k, size)) {
             if (table[loc].getKey() == k) {
                 if (erase) {
                     allow_erase(loc);
                 }
+                thread_counters().hits.fetch_add(1, std::memory_order_relaxed);
                 return &table[loc];
             }
         }
+        if (old_size != 0) {
+            for (const uint32_t loc : compute_hashes(k, old_size)) {
+                if (old_table[loc].getKey() == k) {
+                    if (erase) {
+                        old_collection_flags.bit_set(loc);
+                    }
+                    thread_counters().hits.fetch_add(
+                        1, std::memory_order_relaxed);
+                    return &old_table[loc];
+                }
+            }
+        }
+        thread_counters().misses.fetch_add(1, std::memory_order_relaxed);
         return nullptr;
     }
 };
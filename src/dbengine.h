@@ -0,0 +1,157 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_DBENGINE_H
+#define BITCOIN_DBENGINE_H
+
+#include <fs.h>
+#include <span.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class dbwrapper_error : public std::runtime_error {
+public:
+    explicit dbwrapper_error(const std::string &msg)
+        : std::runtime_error(msg) {}
+};
+
+/** Storage engines that can back a CDBWrapper. */
+enum class DBEngineType {
+    //! LevelDB log-structured merge tree (default)
+    LEVELDB,
+    //! Memory-mapped copy-on-write B+tree
+    BTREE,
+};
+
+static const std::string DEFAULT_DB_ENGINE{"leveldb"};
+/**
+ * Number of threads a LevelDB compaction may be split across, limited to the
+ * number of cores.
+ */
+static constexpr int DEFAULT_DB_SUBCOMPACTIONS = 4;
+
+/** Parse a storage engine name. Returns false for unknown names. */
+bool ParseDBEngineType(const std::string &name, DBEngineType &engine);
+std::string DBEngineTypeName(DBEngineType engine);
+
+/**
+ * The engine recorded in a database directory when it was opened, LevelDB for
+ * a database created before the engine was recorded, std::nullopt if there is
+ * no database.
+ */
+std::optional<DBEngineType> ReadDBEngineType(const fs::path &path);
+
+/**
+ * Background work of an engine, and the writes it held back. Engines without
+ * compactions leave the fields empty.
+ */
+struct DBEngineStats {
+    /** Files of a level, and the compactions that produced them. */
+    struct Level {
+        int level{0};
+        uint64_t files{0};
+        uint64_t bytes{0};
+        uint64_t compactions{0};
+        //! Key ranges merged concurrently, summed over the compactions
+        uint64_t subcompactions{0};
+        int64_t compaction_micros{0};
+        uint64_t bytes_read{0};
+        uint64_t bytes_written{0};
+    };
+    std::vector<Level> levels;
+
+    //! Writes delayed so compactions can keep up
+    uint64_t slowdowns{0};
+    int64_t slowdown_micros{0};
+    //! Waits for the in-memory write buffer to be written out
+    uint64_t memtable_waits{0};
+    int64_t memtable_wait_micros{0};
+    //! Waits for too many level-0 files to be compacted
+    uint64_t level0_waits{0};
+    int64_t level0_wait_micros{0};
+};
+
+/**
+ * Ordered key-value store underneath a CDBWrapper.
+ *
+ * Keys and values are opaque byte strings; keys are ordered bytewise.
+ * Serialization and obfuscation are handled by CDBWrapper, so an engine only
+ * has to provide atomic batch writes, point lookups and snapshot iteration.
+ * Engines report unrecoverable failures by throwing dbwrapper_error.
+ */
+class DBEngine {
+public:
+    /** A set of updates that is applied atomically by Write(). */
+    class Batch {
+    public:
+        virtual ~Batch() {}
+        virtual void Put(Span<const char> key, Span<const char> value) = 0;
+        virtual void Delete(Span<const char> key) = 0;
+        virtual void Clear() = 0;
+    };
+
+    /**
+     * Iterator over a consistent snapshot of the database, taken when the
+     * iterator is created. Key() and Value() are only valid until the next
+     * call to a positioning method.
+     */
+    class Iterator {
+    public:
+        virtual ~Iterator() {}
+        virtual bool Valid() const = 0;
+        virtual void SeekToFirst() = 0;
+        /** Position at the first key that is not less than key. */
+        virtual void Seek(Span<const char> key) = 0;
+        virtual void Next() = 0;
+        virtual Span<const char> Key() const = 0;
+        virtual Span<const char> Value() const = 0;
+    };
+
+    virtual ~DBEngine() {}
+
+    virtual std::unique_ptr<Batch> NewBatch() const = 0;
+    virtual void Write(Batch &batch, bool fSync) = 0;
+
+    /** Returns false if the key does not exist. */
+    virtual bool Read(Span<const char> key, std::string &value) const = 0;
+
+    virtual std::unique_ptr<Iterator> NewIterator() const = 0;
+
+    /** Memory held by the engine itself (in bytes). */
+    virtual size_t DynamicMemoryUsage() const = 0;
+
+    /** Approximate on-disk size of the keys in [begin, end). */
+    virtual size_t EstimateSize(Span<const char> begin,
+                                Span<const char> end) const = 0;
+
+    /**
+     * Compact the keys in [*begin, *end]. A null bound stands for the
+     * beginning or end of the key space.
+     */
+    virtual void CompactRange(const Span<const char> *begin,
+                              const Span<const char> *end) = 0;
+
+    virtual DBEngineStats GetStats() const = 0;
+};
+
+/**
+ * @param[in] path        Directory holding the database.
+ * @param[in] nCacheSize  Cache budget in bytes.
+ * @param[in] fMemory     If true, keep the data in memory only.
+ * @param[in] fWipe       If true, remove all existing data.
+ */
+std::unique_ptr<DBEngine> MakeLevelDBEngine(const fs::path &path,
+                                            size_t nCacheSize, bool fMemory,
+                                            bool fWipe);
+std::unique_ptr<DBEngine> MakeBTreeEngine(const fs::path &path,
+                                          size_t nCacheSize, bool fMemory,
+                                          bool fWipe);
+
+#endif // BITCOIN_DBENGINE_H
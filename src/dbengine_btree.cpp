@@ -0,0 +1,1114 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <dbengine.h>
+
+#ifndef WIN32
+
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <logging.h>
+#include <sync.h>
+#include <util/system.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+
+/**
+ * A memory-mapped copy-on-write B+tree.
+ *
+ * The database is a single file of fixed size pages. Pages 0 and 1 hold two
+ * alternating meta records; every other page is a branch, leaf, overflow or
+ * freelist page. Committed pages are never modified in place: a write batch
+ * materializes the nodes it touches, and on commit writes them to free pages
+ * and publishes the new root by writing the older meta record. The pages are
+ * synced before the meta record is written, so a torn commit falls back to the
+ * previous root.
+ *
+ * Readers take a snapshot of the committed root and read pages straight from
+ * the mapping, without copying or locking. Pages freed by a commit are only
+ * reused once no snapshot that can still reach them is alive, and once
+ * neither meta record can reach them either.
+ */
+namespace {
+
+constexpr size_t BTREE_PAGE_SIZE = 4096;
+constexpr size_t BTREE_PAGE_HEADER_SIZE = 16;
+//! Leaf cells larger than this move their value to overflow pages
+constexpr size_t BTREE_MAX_INLINE_CELL =
+    (BTREE_PAGE_SIZE - BTREE_PAGE_HEADER_SIZE) / 4;
+constexpr size_t BTREE_MAX_KEY_SIZE = 512;
+//! Nodes smaller than this are merged with a sibling on commit
+constexpr size_t BTREE_MERGE_THRESHOLD = BTREE_PAGE_SIZE / 4;
+constexpr size_t BTREE_OVERFLOW_DATA_SIZE =
+    BTREE_PAGE_SIZE - BTREE_PAGE_HEADER_SIZE;
+//! Grow the file by at least this many pages at a time
+constexpr uint64_t BTREE_MIN_GROWTH_PAGES = 256;
+
+constexpr uint8_t PAGE_BRANCH = 1;
+constexpr uint8_t PAGE_LEAF = 2;
+constexpr uint8_t PAGE_OVERFLOW = 3;
+constexpr uint8_t PAGE_FREELIST = 4;
+
+constexpr uint32_t VALUE_OVERFLOW_FLAG = 0x80000000;
+
+constexpr uint64_t META_MAGIC = 0x6565727462636261; // "abcbtree"
+constexpr uint32_t META_VERSION = 1;
+constexpr size_t META_CHECKSUM_OFFSET = 48;
+
+const char *const BTREE_FILENAME = "data.btree";
+const char *const BTREE_LOCKFILE = "LOCK";
+
+/**
+ * Page layout: a 16 byte header (type, cell count, next page for overflow
+ * and freelist chains) followed by an array of 16-bit cell offsets, sorted
+ * by key. Cells are packed at the end of the page.
+ *
+ * Leaf cell:   klen(2) vlen(4) [overflow page(8)] key [value]
+ * Branch cell: klen(2) child(8) key
+ *
+ * Branch cell i points to the subtree holding keys in [key(i), key(i+1)).
+ * Keys smaller than key(0) are routed to child 0.
+ */
+class PageView {
+private:
+    const uint8_t *m_page;
+
+public:
+    explicit PageView(const uint8_t *page) : m_page(page) {}
+
+    uint8_t Type() const { return m_page[0]; }
+    bool IsLeaf() const { return Type() == PAGE_LEAF; }
+    size_t Count() const { return ReadLE16(m_page + 2); }
+    uint64_t Next() const { return ReadLE64(m_page + 8); }
+
+    const uint8_t *Cell(size_t i) const {
+        return m_page + ReadLE16(m_page + BTREE_PAGE_HEADER_SIZE + 2 * i);
+    }
+
+    Span<const char> Key(size_t i) const {
+        const uint8_t *cell = Cell(i);
+        const size_t klen = ReadLE16(cell);
+        if (!IsLeaf()) {
+            return {reinterpret_cast<const char *>(cell + 10), klen};
+        }
+        const bool overflow = ReadLE32(cell + 2) & VALUE_OVERFLOW_FLAG;
+        return {reinterpret_cast<const char *>(cell + (overflow ? 14 : 6)),
+                klen};
+    }
+
+    uint64_t Child(size_t i) const { return ReadLE64(Cell(i) + 2); }
+
+    uint32_t ValueSize(size_t i) const {
+        return ReadLE32(Cell(i) + 2) & ~VALUE_OVERFLOW_FLAG;
+    }
+    /** First overflow page of value i, or 0 if the value is inline. */
+    uint64_t Overflow(size_t i) const {
+        const uint8_t *cell = Cell(i);
+        return (ReadLE32(cell + 2) & VALUE_OVERFLOW_FLAG) ? ReadLE64(cell + 6)
+                                                          : 0;
+    }
+    /** Inline value i. Only valid if Overflow(i) is 0. */
+    Span<const char> InlineValue(size_t i) const {
+        const uint8_t *cell = Cell(i);
+        const size_t klen = ReadLE16(cell);
+        return {reinterpret_cast<const char *>(cell + 6 + klen),
+                ReadLE32(cell + 2)};
+    }
+};
+
+int CompareKeys(Span<const char> a, Span<const char> b) {
+    const int r = memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    if (r != 0) {
+        return r;
+    }
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+/** Index of the first key in the page that is not less than key. */
+size_t LowerBound(const PageView &page, Span<const char> key) {
+    size_t lo = 0, hi = page.Count();
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (CompareKeys(page.Key(mid), key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/** Index of the child of a branch page that may contain key. */
+size_t BranchIndex(const PageView &page, Span<const char> key) {
+    size_t lo = 0, hi = page.Count();
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (CompareKeys(page.Key(mid), key) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? lo - 1 : 0;
+}
+
+/** A read/write shared mapping of the first size bytes of the data file. */
+struct Mapping {
+    uint8_t *base;
+    size_t size;
+
+    Mapping(int fd, size_t _size) : size(_size) {
+        void *addr =
+            mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            throw dbwrapper_error(
+                strprintf("Fatal B+tree error: mmap failed: %s",
+                          std::strerror(errno)));
+        }
+        base = static_cast<uint8_t *>(addr);
+        // Lookups are random accesses; readahead only pollutes the cache.
+        posix_madvise(base, size, POSIX_MADV_RANDOM);
+    }
+    ~Mapping() { munmap(base, size); }
+
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+
+    const uint8_t *Page(uint64_t pgno) const {
+        if (pgno < 2 || (pgno + 1) * BTREE_PAGE_SIZE > size) {
+            throw dbwrapper_error(strprintf(
+                "Fatal B+tree error: page %u out of bounds", pgno));
+        }
+        return base + pgno * BTREE_PAGE_SIZE;
+    }
+};
+
+/** A committed root, readable for as long as the snapshot is held. */
+struct Snapshot {
+    std::shared_ptr<const Mapping> map;
+    uint64_t root;
+    uint64_t txnid;
+};
+
+std::string ReadValue(const Mapping &map, const PageView &leaf, size_t i) {
+    const uint64_t overflow = leaf.Overflow(i);
+    if (overflow == 0) {
+        const Span<const char> value = leaf.InlineValue(i);
+        return std::string(value.begin(), value.end());
+    }
+    std::string value;
+    const size_t size = leaf.ValueSize(i);
+    value.reserve(size);
+    for (uint64_t pgno = overflow; value.size() < size;) {
+        const uint8_t *page = map.Page(pgno);
+        const size_t len =
+            std::min(size - value.size(), BTREE_OVERFLOW_DATA_SIZE);
+        value.append(
+            reinterpret_cast<const char *>(page + BTREE_PAGE_HEADER_SIZE), len);
+        pgno = PageView(page).Next();
+    }
+    return value;
+}
+
+class BTreeBatch final : public DBEngine::Batch {
+public:
+    struct Op {
+        std::string key;
+        std::string value;
+        bool erase;
+    };
+    std::vector<Op> ops;
+
+    void Put(Span<const char> key, Span<const char> value) override {
+        ops.push_back({std::string(key.begin(), key.end()),
+                       std::string(value.begin(), value.end()), false});
+    }
+    void Delete(Span<const char> key) override {
+        ops.push_back({std::string(key.begin(), key.end()), {}, true});
+    }
+    void Clear() override { ops.clear(); }
+};
+
+class BTreeIterator final : public DBEngine::Iterator {
+private:
+    struct Level {
+        PageView page;
+        size_t index;
+    };
+
+    const std::shared_ptr<const Snapshot> m_snapshot;
+    std::vector<Level> m_stack;
+    mutable std::string m_value;
+
+    /** Move forward until the top of the stack is a valid leaf entry. */
+    void Settle() {
+        while (!m_stack.empty()) {
+            Level &top = m_stack.back();
+            if (top.index >= top.page.Count()) {
+                m_stack.pop_back();
+                if (!m_stack.empty()) {
+                    m_stack.back().index++;
+                }
+                continue;
+            }
+            if (top.page.IsLeaf()) {
+                return;
+            }
+            m_stack.push_back(
+                {PageView(m_snapshot->map->Page(top.page.Child(top.index))),
+                 0});
+        }
+    }
+
+public:
+    explicit BTreeIterator(std::shared_ptr<const Snapshot> snapshot)
+        : m_snapshot(std::move(snapshot)) {}
+
+    bool Valid() const override { return !m_stack.empty(); }
+
+    void SeekToFirst() override {
+        m_stack.clear();
+        if (m_snapshot->root != 0) {
+            m_stack.push_back(
+                {PageView(m_snapshot->map->Page(m_snapshot->root)), 0});
+        }
+        Settle();
+    }
+
+    void Seek(Span<const char> key) override {
+        m_stack.clear();
+        uint64_t pgno = m_snapshot->root;
+        while (pgno != 0) {
+            const PageView page(m_snapshot->map->Page(pgno));
+            if (page.IsLeaf()) {
+                m_stack.push_back({page, LowerBound(page, key)});
+                break;
+            }
+            const size_t index = BranchIndex(page, key);
+            m_stack.push_back({page, index});
+            pgno = page.Child(index);
+        }
+        Settle();
+    }
+
+    void Next() override {
+        assert(Valid());
+        m_stack.back().index++;
+        Settle();
+    }
+
+    Span<const char> Key() const override {
+        const Level &top = m_stack.back();
+        return top.page.Key(top.index);
+    }
+
+    Span<const char> Value() const override {
+        const Level &top = m_stack.back();
+        if (top.page.Overflow(top.index) == 0) {
+            return top.page.InlineValue(top.index);
+        }
+        m_value = ReadValue(*m_snapshot->map, top.page, top.index);
+        return m_value;
+    }
+};
+
+class BTreeEngine final : public DBEngine {
+private:
+    /** In-memory copy of a node modified by the current write batch. */
+    struct INode {
+        std::string key;
+        //! leaf value, unless it is still stored in overflow pages
+        std::string value;
+        //! first overflow page of an unmodified leaf value
+        uint64_t overflow{0};
+        uint32_t overflow_size{0};
+        //! child page of a branch entry
+        uint64_t child{0};
+    };
+
+    struct Node {
+        bool leaf;
+        //! page the node was read from, or 0 for a new node
+        uint64_t pgno{0};
+        Node *parent{nullptr};
+        std::vector<INode> inodes;
+        bool unbalanced{false};
+    };
+
+    const fs::path m_path;
+    const bool m_memory;
+    FILE *m_file{nullptr};
+    int m_fd{-1};
+
+    //! Protects the committed state that new snapshots are taken from.
+    mutable Mutex m_state_mutex;
+    std::shared_ptr<const Mapping> m_map GUARDED_BY(m_state_mutex);
+    uint64_t m_root GUARDED_BY(m_state_mutex){0};
+    uint64_t m_txnid GUARDED_BY(m_state_mutex){0};
+    //! txnids of live snapshots
+    mutable std::multiset<uint64_t> m_readers GUARDED_BY(m_state_mutex);
+
+    //! Serializes writers. Everything below is only used by the writer.
+    Mutex m_write_mutex;
+    //! Pages that can be allocated
+    std::set<uint64_t> m_free GUARDED_BY(m_write_mutex);
+    //! Pages freed by each commit, not yet safe to reuse
+    std::map<uint64_t, std::vector<uint64_t>>
+        m_pending GUARDED_BY(m_write_mutex);
+    //! Pages holding the freelist of the last commit
+    std::vector<uint64_t> m_freelist_pages GUARDED_BY(m_write_mutex);
+    //! Pages in use, including the meta pages
+    uint64_t m_npages GUARDED_BY(m_write_mutex){2};
+    uint64_t m_file_pages GUARDED_BY(m_write_mutex){0};
+
+    //! State of the batch being written
+    std::map<uint64_t, std::unique_ptr<Node>> m_nodes GUARDED_BY(m_write_mutex);
+    Node *m_root_node GUARDED_BY(m_write_mutex){nullptr};
+    std::vector<uint64_t> m_freed GUARDED_BY(m_write_mutex);
+
+    std::shared_ptr<const Snapshot> GetSnapshot() const {
+        LOCK(m_state_mutex);
+        const uint64_t txnid = m_txnid;
+        m_readers.insert(txnid);
+        return std::shared_ptr<const Snapshot>(
+            new Snapshot{m_map, m_root, txnid}, [this](const Snapshot *s) {
+                {
+                    LOCK(m_state_mutex);
+                    m_readers.erase(m_readers.find(s->txnid));
+                }
+                delete s;
+            });
+    }
+
+    std::shared_ptr<const Mapping> CurrentMap() const {
+        return WITH_LOCK(m_state_mutex, return m_map);
+    }
+
+    uint8_t *WritablePage(uint64_t pgno)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        assert(pgno < m_file_pages);
+        return CurrentMap()->base + pgno * BTREE_PAGE_SIZE;
+    }
+
+    void Sync() {
+        const auto map = CurrentMap();
+        if (msync(map->base, map->size, MS_SYNC) != 0 || !FileCommit(m_file)) {
+            throw dbwrapper_error("Fatal B+tree error: failed to sync " +
+                                  fs::PathToString(m_path));
+        }
+    }
+
+    void Grow(uint64_t min_pages) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        const uint64_t pages = std::max(
+            {min_pages, m_file_pages + m_file_pages / 4,
+             m_file_pages + BTREE_MIN_GROWTH_PAGES});
+        if (ftruncate(m_fd, pages * BTREE_PAGE_SIZE) != 0) {
+            throw dbwrapper_error(
+                strprintf("Fatal B+tree error: failed to grow %s: %s",
+                          fs::PathToString(m_path), std::strerror(errno)));
+        }
+        auto map = std::make_shared<const Mapping>(m_fd,
+                                                   pages * BTREE_PAGE_SIZE);
+        m_file_pages = pages;
+        // Snapshots keep the old mapping alive for as long as they need it.
+        WITH_LOCK(m_state_mutex, m_map = std::move(map));
+    }
+
+    uint64_t Allocate() EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        if (!m_free.empty()) {
+            const uint64_t pgno = *m_free.begin();
+            m_free.erase(m_free.begin());
+            return pgno;
+        }
+        if (m_npages == m_file_pages) {
+            Grow(m_npages + 1);
+        }
+        return m_npages++;
+    }
+
+    void FreeOverflow(uint64_t pgno, uint32_t size)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        const auto map = CurrentMap();
+        for (size_t done = 0; done < size; done += BTREE_OVERFLOW_DATA_SIZE) {
+            m_freed.push_back(pgno);
+            pgno = PageView(map->Page(pgno)).Next();
+        }
+    }
+
+    uint64_t WriteOverflow(const std::string &value)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        const size_t npages =
+            (value.size() + BTREE_OVERFLOW_DATA_SIZE - 1) /
+            BTREE_OVERFLOW_DATA_SIZE;
+        std::vector<uint64_t> pages(npages);
+        for (uint64_t &pgno : pages) {
+            pgno = Allocate();
+        }
+        for (size_t i = 0; i < npages; ++i) {
+            uint8_t *page = WritablePage(pages[i]);
+            memset(page, 0, BTREE_PAGE_HEADER_SIZE);
+            page[0] = PAGE_OVERFLOW;
+            WriteLE64(page + 8, i + 1 < npages ? pages[i + 1] : 0);
+            const size_t offset = i * BTREE_OVERFLOW_DATA_SIZE;
+            memcpy(page + BTREE_PAGE_HEADER_SIZE, value.data() + offset,
+                   std::min(value.size() - offset, BTREE_OVERFLOW_DATA_SIZE));
+        }
+        return pages[0];
+    }
+
+    static size_t CellSize(bool leaf, const INode &inode) {
+        if (!leaf) {
+            return 10 + inode.key.size();
+        }
+        if (inode.overflow != 0) {
+            return 14 + inode.key.size();
+        }
+        return 6 + inode.key.size() + inode.value.size();
+    }
+
+    static size_t NodeSize(const Node &node) {
+        size_t size = BTREE_PAGE_HEADER_SIZE;
+        for (const INode &inode : node.inodes) {
+            size += 2 + CellSize(node.leaf, inode);
+        }
+        return size;
+    }
+
+    void WriteNodePage(uint64_t pgno, bool leaf, const INode *begin,
+                       const INode *end)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        uint8_t *page = WritablePage(pgno);
+        memset(page, 0, BTREE_PAGE_HEADER_SIZE);
+        page[0] = leaf ? PAGE_LEAF : PAGE_BRANCH;
+        WriteLE16(page + 2, end - begin);
+        size_t offset = BTREE_PAGE_SIZE;
+        for (const INode *inode = begin; inode != end; ++inode) {
+            offset -= CellSize(leaf, *inode);
+            WriteLE16(page + BTREE_PAGE_HEADER_SIZE + 2 * (inode - begin),
+                      offset);
+            uint8_t *cell = page + offset;
+            WriteLE16(cell, inode->key.size());
+            if (!leaf) {
+                WriteLE64(cell + 2, inode->child);
+                memcpy(cell + 10, inode->key.data(), inode->key.size());
+            } else if (inode->overflow != 0) {
+                WriteLE32(cell + 2, inode->overflow_size | VALUE_OVERFLOW_FLAG);
+                WriteLE64(cell + 6, inode->overflow);
+                memcpy(cell + 14, inode->key.data(), inode->key.size());
+            } else {
+                WriteLE32(cell + 2, inode->value.size());
+                memcpy(cell + 6, inode->key.data(), inode->key.size());
+                memcpy(cell + 6 + inode->key.size(), inode->value.data(),
+                       inode->value.size());
+            }
+        }
+    }
+
+    Node *Materialize(uint64_t pgno, Node *parent)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        auto it = m_nodes.find(pgno);
+        if (it != m_nodes.end()) {
+            return it->second.get();
+        }
+        const auto map = CurrentMap();
+        const PageView page(map->Page(pgno));
+        auto node = std::make_unique<Node>();
+        node->leaf = page.IsLeaf();
+        node->pgno = pgno;
+        node->parent = parent;
+        node->inodes.resize(page.Count());
+        for (size_t i = 0; i < node->inodes.size(); ++i) {
+            INode &inode = node->inodes[i];
+            const Span<const char> key = page.Key(i);
+            inode.key.assign(key.begin(), key.end());
+            if (!node->leaf) {
+                inode.child = page.Child(i);
+            } else if ((inode.overflow = page.Overflow(i)) != 0) {
+                inode.overflow_size = page.ValueSize(i);
+            } else {
+                const Span<const char> value = page.InlineValue(i);
+                inode.value.assign(value.begin(), value.end());
+            }
+        }
+        Node *result = node.get();
+        m_nodes.emplace(pgno, std::move(node));
+        return result;
+    }
+
+    static size_t NodeBranchIndex(const Node &node, const std::string &key) {
+        auto it = std::upper_bound(
+            node.inodes.begin(), node.inodes.end(), key,
+            [](const std::string &k, const INode &inode) {
+                return k < inode.key;
+            });
+        return it == node.inodes.begin() ? 0 : it - node.inodes.begin() - 1;
+    }
+
+    static std::vector<INode>::iterator LeafLowerBound(Node &leaf,
+                                                       const std::string &key) {
+        return std::lower_bound(leaf.inodes.begin(), leaf.inodes.end(), key,
+                                [](const INode &inode, const std::string &k) {
+                                    return inode.key < k;
+                                });
+    }
+
+    static size_t ChildIndex(const Node &parent, const Node &child) {
+        for (size_t i = 0; i < parent.inodes.size(); ++i) {
+            if (parent.inodes[i].child == child.pgno) {
+                return i;
+            }
+        }
+        assert(false);
+    }
+
+    Node *FindLeaf(const std::string &key)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        Node *node = m_root_node;
+        while (!node->leaf) {
+            const size_t i = NodeBranchIndex(*node, key);
+            node = Materialize(node->inodes[i].child, node);
+        }
+        return node;
+    }
+
+    void Put(const std::string &key, const std::string &value)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        if (key.size() > BTREE_MAX_KEY_SIZE) {
+            throw dbwrapper_error(
+                strprintf("Fatal B+tree error: key of %u bytes is too large",
+                          key.size()));
+        }
+        Node *leaf = FindLeaf(key);
+        auto it = LeafLowerBound(*leaf, key);
+        if (it == leaf->inodes.end() || it->key != key) {
+            it = leaf->inodes.insert(it, INode{});
+            it->key = key;
+        } else if (it->overflow != 0) {
+            FreeOverflow(it->overflow, it->overflow_size);
+            it->overflow = 0;
+        }
+        it->value = value;
+    }
+
+    void Delete(const std::string &key)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        Node *leaf = FindLeaf(key);
+        auto it = LeafLowerBound(*leaf, key);
+        if (it == leaf->inodes.end() || it->key != key) {
+            return;
+        }
+        if (it->overflow != 0) {
+            FreeOverflow(it->overflow, it->overflow_size);
+        }
+        leaf->inodes.erase(it);
+        leaf->unbalanced = true;
+    }
+
+    void RemoveNode(Node *node) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        if (node->pgno != 0) {
+            m_freed.push_back(node->pgno);
+        }
+        m_nodes.erase(node->pgno);
+    }
+
+    /** Merge underfull nodes into a sibling and remove empty ones. */
+    void Rebalance(Node *node) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        if (!node->unbalanced) {
+            return;
+        }
+        node->unbalanced = false;
+        if (!node->inodes.empty() && NodeSize(*node) >= BTREE_MERGE_THRESHOLD) {
+            return;
+        }
+
+        if (node == m_root_node) {
+            if (!node->leaf && node->inodes.size() == 1) {
+                // Collapse a root with a single child.
+                Node *child = Materialize(node->inodes[0].child, node);
+                child->parent = nullptr;
+                m_root_node = child;
+                RemoveNode(node);
+                child->unbalanced = true;
+                Rebalance(child);
+            } else if (!node->leaf && node->inodes.empty()) {
+                node->leaf = true;
+            }
+            return;
+        }
+
+        Node *parent = node->parent;
+        const size_t index = ChildIndex(*parent, *node);
+        if (node->inodes.empty()) {
+            parent->inodes.erase(parent->inodes.begin() + index);
+            RemoveNode(node);
+        } else if (parent->inodes.size() > 1) {
+            // Move the right node of the pair into the left one.
+            const size_t right_index = index == 0 ? 1 : index;
+            Node *left =
+                index == 0
+                    ? node
+                    : Materialize(parent->inodes[index - 1].child, parent);
+            Node *right = index == 0
+                              ? Materialize(parent->inodes[1].child, parent)
+                              : node;
+            if (!right->leaf) {
+                // The first key of a branch may be smaller than the keys it
+                // covers; the parent's separator is an exact lower bound.
+                right->inodes[0].key = parent->inodes[right_index].key;
+                for (const INode &inode : right->inodes) {
+                    auto it = m_nodes.find(inode.child);
+                    if (it != m_nodes.end()) {
+                        it->second->parent = left;
+                    }
+                }
+            }
+            std::move(right->inodes.begin(), right->inodes.end(),
+                      std::back_inserter(left->inodes));
+            parent->inodes.erase(parent->inodes.begin() + right_index);
+            RemoveNode(right);
+        }
+        parent->unbalanced = true;
+        Rebalance(parent);
+    }
+
+    /**
+     * Write a node and its materialized descendants to new pages.
+     * Returns the first key and page of each page the node was split into.
+     */
+    std::vector<std::pair<std::string, uint64_t>> Spill(Node &node)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        if (!node.leaf) {
+            std::vector<INode> inodes;
+            inodes.reserve(node.inodes.size());
+            for (INode &inode : node.inodes) {
+                auto it = m_nodes.find(inode.child);
+                if (it == m_nodes.end()) {
+                    inodes.push_back(std::move(inode));
+                    continue;
+                }
+                auto parts = Spill(*it->second);
+                for (size_t i = 0; i < parts.size(); ++i) {
+                    INode child;
+                    child.key = i == 0 ? inode.key : std::move(parts[i].first);
+                    child.child = parts[i].second;
+                    inodes.push_back(std::move(child));
+                }
+            }
+            node.inodes = std::move(inodes);
+        } else {
+            for (INode &inode : node.inodes) {
+                if (inode.overflow == 0 &&
+                    CellSize(true, inode) > BTREE_MAX_INLINE_CELL) {
+                    inode.overflow = WriteOverflow(inode.value);
+                    inode.overflow_size = inode.value.size();
+                    inode.value.clear();
+                }
+            }
+        }
+        if (node.pgno != 0) {
+            m_freed.push_back(node.pgno);
+        }
+
+        // Split into evenly filled pages.
+        std::vector<std::pair<std::string, uint64_t>> parts;
+        if (node.inodes.empty()) {
+            return parts;
+        }
+        const size_t usable = BTREE_PAGE_SIZE - BTREE_PAGE_HEADER_SIZE;
+        const size_t total = NodeSize(node) - BTREE_PAGE_HEADER_SIZE;
+        const size_t target = total / ((total + usable - 1) / usable);
+        size_t begin = 0;
+        while (begin < node.inodes.size()) {
+            size_t end = begin, size = 0;
+            while (end < node.inodes.size()) {
+                const size_t cell = 2 + CellSize(node.leaf, node.inodes[end]);
+                if (end > begin && (size + cell > usable || size >= target)) {
+                    break;
+                }
+                size += cell;
+                ++end;
+            }
+            const uint64_t pgno = Allocate();
+            WriteNodePage(pgno, node.leaf, node.inodes.data() + begin,
+                          node.inodes.data() + end);
+            parts.emplace_back(node.inodes[begin].key, pgno);
+            begin = end;
+        }
+        return parts;
+    }
+
+    /** Write the list of all unused pages. Returns its first page. */
+    uint64_t WriteFreelist() EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        // The previous freelist is superseded by this one.
+        m_freed.insert(m_freed.end(), m_freelist_pages.begin(),
+                       m_freelist_pages.end());
+        const size_t per_page = (BTREE_PAGE_SIZE - BTREE_PAGE_HEADER_SIZE) / 8;
+        auto total = [&]() {
+            size_t n = m_free.size() + m_freed.size();
+            for (const auto &pending : m_pending) {
+                n += pending.second.size();
+            }
+            return n;
+        };
+        // Allocating freelist pages can only shrink the list.
+        const size_t npages = (total() + per_page - 1) / per_page;
+        std::vector<uint64_t> pages(npages);
+        for (uint64_t &pgno : pages) {
+            pgno = Allocate();
+        }
+
+        std::vector<uint64_t> entries(m_free.begin(), m_free.end());
+        entries.insert(entries.end(), m_freed.begin(), m_freed.end());
+        for (const auto &pending : m_pending) {
+            entries.insert(entries.end(), pending.second.begin(),
+                           pending.second.end());
+        }
+        assert(entries.size() <= npages * per_page);
+        for (size_t i = 0; i < npages; ++i) {
+            uint8_t *page = WritablePage(pages[i]);
+            const size_t n = std::min(per_page, entries.size() - i * per_page);
+            memset(page, 0, BTREE_PAGE_HEADER_SIZE);
+            page[0] = PAGE_FREELIST;
+            WriteLE16(page + 2, 0);
+            WriteLE32(page + 4, n);
+            WriteLE64(page + 8, i + 1 < npages ? pages[i + 1] : 0);
+            for (size_t j = 0; j < n; ++j) {
+                WriteLE64(page + BTREE_PAGE_HEADER_SIZE + 8 * j,
+                          entries[i * per_page + j]);
+            }
+        }
+        m_freelist_pages = std::move(pages);
+        return m_freelist_pages.empty() ? 0 : m_freelist_pages[0];
+    }
+
+    void WriteMeta(uint64_t txnid, uint64_t root, uint64_t freelist)
+        EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        uint8_t *meta = CurrentMap()->base + (txnid % 2) * BTREE_PAGE_SIZE;
+        uint8_t buf[META_CHECKSUM_OFFSET + 8] = {};
+        WriteLE64(buf, META_MAGIC);
+        WriteLE32(buf + 8, META_VERSION);
+        WriteLE32(buf + 12, BTREE_PAGE_SIZE);
+        WriteLE64(buf + 16, txnid);
+        WriteLE64(buf + 24, root);
+        WriteLE64(buf + 32, freelist);
+        WriteLE64(buf + 40, m_npages);
+        uint8_t hash[CSHA256::OUTPUT_SIZE];
+        CSHA256().Write(buf, META_CHECKSUM_OFFSET).Finalize(hash);
+        memcpy(buf + META_CHECKSUM_OFFSET, hash, 8);
+        memcpy(meta, buf, sizeof(buf));
+    }
+
+    struct Meta {
+        uint64_t txnid;
+        uint64_t root;
+        uint64_t freelist;
+        uint64_t npages;
+    };
+
+    static bool ReadMeta(const uint8_t *page, Meta &meta) {
+        uint8_t hash[CSHA256::OUTPUT_SIZE];
+        CSHA256().Write(page, META_CHECKSUM_OFFSET).Finalize(hash);
+        if (ReadLE64(page) != META_MAGIC ||
+            ReadLE32(page + 8) != META_VERSION ||
+            ReadLE32(page + 12) != BTREE_PAGE_SIZE ||
+            memcmp(hash, page + META_CHECKSUM_OFFSET, 8) != 0) {
+            return false;
+        }
+        meta.txnid = ReadLE64(page + 16);
+        meta.root = ReadLE64(page + 24);
+        meta.freelist = ReadLE64(page + 32);
+        meta.npages = ReadLE64(page + 40);
+        return true;
+    }
+
+    void Open() EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) {
+        const long size = [&]() {
+            fseek(m_file, 0, SEEK_END);
+            return ftell(m_file);
+        }();
+        if (size < 0 || size % BTREE_PAGE_SIZE != 0) {
+            throw dbwrapper_error("Fatal B+tree error: " +
+                                  fs::PathToString(m_path) +
+                                  " has an invalid size");
+        }
+        m_file_pages = size / BTREE_PAGE_SIZE;
+        if (m_file_pages == 0) {
+            Grow(BTREE_MIN_GROWTH_PAGES);
+            WriteMeta(0, 0, 0);
+            WriteMeta(1, 0, 0);
+            Sync();
+            WITH_LOCK(m_state_mutex, m_txnid = 1);
+            return;
+        }
+
+        auto map = std::make_shared<const Mapping>(m_fd, size);
+        Meta metas[2];
+        const bool valid[2] = {ReadMeta(map->base, metas[0]),
+                               ReadMeta(map->base + BTREE_PAGE_SIZE, metas[1])};
+        if (!valid[0] && !valid[1]) {
+            throw dbwrapper_error("Fatal B+tree error: no valid meta page in " +
+                                  fs::PathToString(m_path));
+        }
+        const Meta &meta = (valid[0] && (!valid[1] ||
+                                         metas[0].txnid > metas[1].txnid))
+                               ? metas[0]
+                               : metas[1];
+        if (meta.npages > m_file_pages) {
+            throw dbwrapper_error("Fatal B+tree error: " +
+                                  fs::PathToString(m_path) + " is truncated");
+        }
+        m_npages = meta.npages;
+        for (uint64_t pgno = meta.freelist; pgno != 0;) {
+            const uint8_t *page = map->Page(pgno);
+            const size_t n = ReadLE32(page + 4);
+            for (size_t j = 0; j < n; ++j) {
+                m_free.insert(ReadLE64(page + BTREE_PAGE_HEADER_SIZE + 8 * j));
+            }
+            m_freelist_pages.push_back(pgno);
+            pgno = PageView(page).Next();
+        }
+        {
+            LOCK(m_state_mutex);
+            m_map = std::move(map);
+            m_root = meta.root;
+            m_txnid = meta.txnid;
+        }
+        // The freelist doesn't tell the pages freed by the last commit apart,
+        // and they are still reachable from the other meta record. Make sure
+        // the selected meta record is on disk before any of them is reused.
+        Sync();
+    }
+
+public:
+    BTreeEngine(const fs::path &path, bool fMemory, bool fWipe)
+        : m_path(path / BTREE_FILENAME), m_memory(fMemory) {
+        if (fMemory) {
+            // An anonymous temporary file keeps a single mmap code path.
+            m_file = tmpfile();
+        } else {
+            TryCreateDirectories(path);
+            if (!LockDirectory(path, BTREE_LOCKFILE)) {
+                throw dbwrapper_error("Fatal B+tree error: cannot lock " +
+                                      fs::PathToString(path));
+            }
+            if (fWipe) {
+                LogPrintf("Wiping B+tree database in %s\n",
+                          fs::PathToString(path));
+                fs::remove(m_path);
+            }
+            LogPrintf("Opening B+tree database in %s\n",
+                      fs::PathToString(path));
+            m_file = fsbridge::fopen(m_path, "r+b");
+            if (!m_file) {
+                m_file = fsbridge::fopen(m_path, "w+b");
+            }
+        }
+        if (!m_file) {
+            throw dbwrapper_error("Fatal B+tree error: cannot open " +
+                                  fs::PathToString(m_path));
+        }
+        m_fd = fileno(m_file);
+        LOCK(m_write_mutex);
+        Open();
+        LogPrintf("Opened B+tree database successfully\n");
+    }
+
+    ~BTreeEngine() {
+        WITH_LOCK(m_state_mutex, m_map.reset());
+        fclose(m_file);
+        if (!m_memory) {
+            UnlockDirectory(m_path.parent_path(), BTREE_LOCKFILE);
+        }
+    }
+
+    std::unique_ptr<Batch> NewBatch() const override {
+        return std::make_unique<BTreeBatch>();
+    }
+
+    void Write(Batch &batch, bool fSync) override {
+        std::vector<BTreeBatch::Op> &ops = static_cast<BTreeBatch &>(batch).ops;
+        // Applying the updates in key order keeps the descents local. Later
+        // updates to the same key still win as the sort is stable.
+        std::stable_sort(
+            ops.begin(), ops.end(),
+            [](const BTreeBatch::Op &a, const BTreeBatch::Op &b) {
+                return a.key < b.key;
+            });
+
+        LOCK(m_write_mutex);
+        m_nodes.clear();
+        m_freed.clear();
+        uint64_t txnid, root;
+        {
+            LOCK(m_state_mutex);
+            txnid = m_txnid + 1;
+            root = m_root;
+            // Pages freed by commit t are reachable from the state t - 1. The
+            // meta record of the last commit may not be on disk yet, so the
+            // one before it is still a valid fallback: as in LMDB, only reuse
+            // pages freed up to m_txnid - 1, and only once no older snapshot
+            // is alive.
+            const uint64_t oldest =
+                m_readers.empty()
+                    ? m_txnid - 1
+                    : std::min(*m_readers.begin(), m_txnid - 1);
+            while (!m_pending.empty() && m_pending.begin()->first <= oldest) {
+                m_free.insert(m_pending.begin()->second.begin(),
+                              m_pending.begin()->second.end());
+                m_pending.erase(m_pending.begin());
+            }
+        }
+
+        if (root == 0) {
+            auto node = std::make_unique<Node>();
+            node->leaf = true;
+            m_root_node = node.get();
+            m_nodes.emplace(0, std::move(node));
+        } else {
+            m_root_node = Materialize(root, nullptr);
+        }
+
+        for (const BTreeBatch::Op &op : ops) {
+            if (op.erase) {
+                Delete(op.key);
+            } else {
+                Put(op.key, op.value);
+            }
+        }
+
+        std::vector<uint64_t> unbalanced;
+        for (const auto &node : m_nodes) {
+            if (node.second->unbalanced) {
+                unbalanced.push_back(node.first);
+            }
+        }
+        for (const uint64_t pgno : unbalanced) {
+            auto it = m_nodes.find(pgno);
+            if (it != m_nodes.end()) {
+                Rebalance(it->second.get());
+            }
+        }
+
+        auto parts = Spill(*m_root_node);
+        while (parts.size() > 1) {
+            Node node;
+            node.leaf = false;
+            for (auto &part : parts) {
+                INode inode;
+                inode.key = std::move(part.first);
+                inode.child = part.second;
+                node.inodes.push_back(std::move(inode));
+            }
+            parts = Spill(node);
+        }
+        root = parts.empty() ? 0 : parts[0].second;
+        m_nodes.clear();
+        m_root_node = nullptr;
+
+        // The meta record must never reach the disk before the pages it
+        // points to, whether the commit is synced or not. Syncing it as well is
+        // only needed for the commit to be durable.
+        const uint64_t freelist = WriteFreelist();
+        if (!m_memory) {
+            Sync();
+        }
+        WriteMeta(txnid, root, freelist);
+        if (fSync) {
+            Sync();
+        }
+
+        m_pending[txnid] = std::move(m_freed);
+        LOCK(m_state_mutex);
+        m_root = root;
+        m_txnid = txnid;
+    }
+
+    bool Read(Span<const char> key, std::string &value) const override {
+        const auto snapshot = GetSnapshot();
+        uint64_t pgno = snapshot->root;
+        while (pgno != 0) {
+            const PageView page(snapshot->map->Page(pgno));
+            if (!page.IsLeaf()) {
+                pgno = page.Child(BranchIndex(page, key));
+                continue;
+            }
+            const size_t i = LowerBound(page, key);
+            if (i == page.Count() || CompareKeys(page.Key(i), key) != 0) {
+                return false;
+            }
+            value = ReadValue(*snapshot->map, page, i);
+            return true;
+        }
+        return false;
+    }
+
+    std::unique_ptr<Iterator> NewIterator() const override {
+        return std::make_unique<BTreeIterator>(GetSnapshot());
+    }
+
+    size_t DynamicMemoryUsage() const override {
+        // Pages live in the OS page cache; nothing is cached between batches.
+        return 0;
+    }
+
+    size_t EstimateSize(Span<const char> begin,
+                        Span<const char> end) const override {
+        const auto snapshot = GetSnapshot();
+        // Relative position of a key, assuming evenly filled pages.
+        auto position = [&](Span<const char> key) {
+            double pos = 0, width = 1;
+            for (uint64_t pgno = snapshot->root; pgno != 0;) {
+                const PageView page(snapshot->map->Page(pgno));
+                const size_t count = std::max<size_t>(page.Count(), 1);
+                const size_t i = page.IsLeaf() ? LowerBound(page, key)
+                                               : BranchIndex(page, key);
+                pos += width * i / count;
+                width /= count;
+                pgno = page.IsLeaf() ? 0 : page.Child(i);
+            }
+            return pos;
+        };
+        const double fraction = std::max(0.0, position(end) - position(begin));
+        return fraction * snapshot->map->size;
+    }
+
+    void CompactRange(const Span<const char> *begin,
+                      const Span<const char> *end) override {
+        // Nothing to do: underfull pages are merged as part of every commit.
+    }
+
+    DBEngineStats GetStats() const override {
+        // Commits are written in place, there is no background work.
+        return {};
+    }
+};
+
+} // namespace
+
+std::unique_ptr<DBEngine> MakeBTreeEngine(const fs::path &path,
+                                          size_t nCacheSize, bool fMemory,
+                                          bool fWipe) {
+    // The page cache is managed by the OS, nCacheSize does not apply.
+    return std::make_unique<BTreeEngine>(path, fMemory, fWipe);
+}
+
+#else // WIN32
+
+std::unique_ptr<DBEngine> MakeBTreeEngine(const fs::path &path,
+                                          size_t nCacheSize, bool fMemory,
+                                          bool fWipe) {
+    throw dbwrapper_error(
+        "The btree database engine is not supported on this platform");
+}
+
+#endif // WIN32
@@ -0,0 +1,330 @@
+// Copyright (c) 2012-2016 The Bitcoin Core developers
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <dbengine.h>
+
+#include <logging.h>
+#include <util/system.h>
+
+#include <leveldb/cache.h>
+#include <leveldb/db.h>
+#include <leveldb/env.h>
+#include <leveldb/filter_policy.h>
+#include <leveldb/write_batch.h>
+#include <memenv.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+
+namespace {
+
+class CBitcoinLevelDBLogger : public leveldb::Logger {
+public:
+    // This code is adapted from posix_logger.h, which is why it is using
+    // vsprintf.
+    // Please do not do this in normal code
+    void Logv(const char *format, va_list ap) override {
+        if (!LogAcceptCategory(BCLog::LEVELDB)) {
+            return;
+        }
+        char buffer[500];
+        for (int iter = 0; iter < 2; iter++) {
+            char *base;
+            int bufsize;
+            if (iter == 0) {
+                bufsize = sizeof(buffer);
+                base = buffer;
+            } else {
+                bufsize = 30000;
+                base = new char[bufsize];
+            }
+            char *p = base;
+            char *limit = base + bufsize;
+
+            // Print the message
+            if (p < limit) {
+                va_list backup_ap;
+                va_copy(backup_ap, ap);
+                // Do not use vsnprintf elsewhere in bitcoin source code, see
+                // above.
+                p += vsnprintf(p, limit - p, format, backup_ap);
+                va_end(backup_ap);
+            }
+
+            // Truncate to available space if necessary
+            if (p >= limit) {
+                if (iter == 0) {
+                    continue; // Try again with larger buffer
+                } else {
+                    p = limit - 1;
+                }
+            }
+
+            // Add newline if necessary
+            if (p == base || p[-1] != '\n') {
+                *p++ = '\n';
+            }
+
+            assert(p <= limit);
+            base[std::min(bufsize - 1, (int)(p - base))] = '\0';
+            LogPrintfToBeContinued("leveldb: %s", base);
+            if (base != buffer) {
+                delete[] base;
+            }
+            break;
+        }
+    }
+};
+
+void SetMaxOpenFiles(leveldb::Options *options) {
+    // On most platforms the default setting of max_open_files (which is 1000)
+    // is optimal. On Windows using a large file count is OK because the handles
+    // do not interfere with select() loops. On 64-bit Unix hosts this value is
+    // also OK, because up to that amount LevelDB will use an mmap
+    // implementation that does not use extra file descriptors (the fds are
+    // closed after being mmaped).
+    //
+    // Increasing the value beyond the default is dangerous because LevelDB will
+    // fall back to a non-mmap implementation when the file count is too large.
+    // On 32-bit Unix host we should decrease the value because the handles use
+    // up real fds, and we want to avoid fd exhaustion issues.
+    //
+    // See PR #12495 for further discussion.
+
+    int default_open_files = options->max_open_files;
+#ifndef WIN32
+    if (sizeof(void *) < 8) {
+        options->max_open_files = 64;
+    }
+#endif
+    LogPrint(BCLog::LEVELDB, "LevelDB using max_open_files=%d (default=%d)\n",
+             options->max_open_files, default_open_files);
+}
+
+leveldb::Options GetOptions(size_t nCacheSize) {
+    leveldb::Options options;
+    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
+    // up to two write buffers may be held in memory simultaneously
+    options.write_buffer_size = nCacheSize / 4;
+    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.compression = leveldb::kNoCompression;
+    options.max_subcompactions = std::max<int64_t>(
+        1, std::min<int64_t>(gArgs.GetArg("-dbsubcompactions",
+                                          DEFAULT_DB_SUBCOMPACTIONS),
+                             GetNumCores()));
+    options.info_log = new CBitcoinLevelDBLogger();
+    if (leveldb::kMajorVersion > 1 ||
+        (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
+        // LevelDB versions before 1.16 consider short writes to be corruption.
+        // Only trigger error on corruption in later versions.
+        options.paranoid_checks = true;
+    }
+    SetMaxOpenFiles(&options);
+    return options;
+}
+
+/**
+ * Handle database error by throwing dbwrapper_error exception.
+ */
+void HandleError(const leveldb::Status &status) {
+    if (status.ok()) {
+        return;
+    }
+    const std::string errmsg = "Fatal LevelDB error: " + status.ToString();
+    LogPrintf("%s\n", errmsg);
+    LogPrintf("You can use -debug=leveldb to get more complete diagnostic "
+              "messages\n");
+    throw dbwrapper_error(errmsg);
+}
+
+leveldb::Slice ToSlice(Span<const char> data) {
+    return leveldb::Slice(data.data(), data.size());
+}
+
+Span<const char> ToSpan(const leveldb::Slice &slice) {
+    return Span<const char>(slice.data(), slice.size());
+}
+
+class LevelDBBatch final : public DBEngine::Batch {
+public:
+    leveldb::WriteBatch batch;
+
+    void Put(Span<const char> key, Span<const char> value) override {
+        batch.Put(ToSlice(key), ToSlice(value));
+    }
+    void Delete(Span<const char> key) override { batch.Delete(ToSlice(key)); }
+    void Clear() override { batch.Clear(); }
+};
+
+class LevelDBIterator final : public DBEngine::Iterator {
+private:
+    const std::unique_ptr<leveldb::Iterator> piter;
+
+public:
+    explicit LevelDBIterator(leveldb::Iterator *_piter) : piter(_piter) {}
+
+    bool Valid() const override { return piter->Valid(); }
+    void SeekToFirst() override { piter->SeekToFirst(); }
+    void Seek(Span<const char> key) override { piter->Seek(ToSlice(key)); }
+    void Next() override { piter->Next(); }
+    Span<const char> Key() const override { return ToSpan(piter->key()); }
+    Span<const char> Value() const override { return ToSpan(piter->value()); }
+};
+
+class LevelDBEngine final : public DBEngine {
+private:
+    //! custom environment this database is using (may be nullptr in case of
+    //! default environment)
+    leveldb::Env *penv;
+
+    //! database options used
+    leveldb::Options options;
+
+    //! options used when reading from the database
+    leveldb::ReadOptions readoptions;
+
+    //! options used when iterating over values of the database
+    leveldb::ReadOptions iteroptions;
+
+    //! options used when writing to the database
+    leveldb::WriteOptions writeoptions;
+
+    //! options used when sync writing to the database
+    leveldb::WriteOptions syncoptions;
+
+    //! the database itself
+    leveldb::DB *pdb;
+
+public:
+    LevelDBEngine(const fs::path &path, size_t nCacheSize, bool fMemory,
+                  bool fWipe) {
+        penv = nullptr;
+        readoptions.verify_checksums = true;
+        iteroptions.verify_checksums = true;
+        iteroptions.fill_cache = false;
+        syncoptions.sync = true;
+        options = GetOptions(nCacheSize);
+        options.create_if_missing = true;
+        if (fMemory) {
+            penv = leveldb::NewMemEnv(leveldb::Env::Default());
+            options.env = penv;
+        } else {
+            if (fWipe) {
+                LogPrintf("Wiping LevelDB in %s\n", fs::PathToString(path));
+                leveldb::Status result =
+                    leveldb::DestroyDB(fs::PathToString(path), options);
+                HandleError(result);
+            }
+            TryCreateDirectories(path);
+            LogPrintf("Opening LevelDB in %s\n", fs::PathToString(path));
+        }
+        leveldb::Status status =
+            leveldb::DB::Open(options, fs::PathToString(path), &pdb);
+        HandleError(status);
+        LogPrintf("Opened LevelDB successfully\n");
+    }
+
+    ~LevelDBEngine() {
+        delete pdb;
+        pdb = nullptr;
+        delete options.filter_policy;
+        options.filter_policy = nullptr;
+        delete options.info_log;
+        options.info_log = nullptr;
+        delete options.block_cache;
+        options.block_cache = nullptr;
+        delete penv;
+        options.env = nullptr;
+    }
+
+    std::unique_ptr<Batch> NewBatch() const override {
+        return std::make_unique<LevelDBBatch>();
+    }
+
+    void Write(Batch &batch, bool fSync) override {
+        leveldb::Status status =
+            pdb->Write(fSync ? syncoptions : writeoptions,
+                       &static_cast<LevelDBBatch &>(batch).batch);
+        HandleError(status);
+    }
+
+    bool Read(Span<const char> key, std::string &value) const override {
+        leveldb::Status status = pdb->Get(readoptions, ToSlice(key), &value);
+        if (!status.ok()) {
+            if (status.IsNotFound()) {
+                return false;
+            }
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            HandleError(status);
+        }
+        return true;
+    }
+
+    std::unique_ptr<Iterator> NewIterator() const override {
+        return std::make_unique<LevelDBIterator>(pdb->NewIterator(iteroptions));
+    }
+
+    size_t DynamicMemoryUsage() const override {
+        std::string memory;
+        if (!pdb->GetProperty("leveldb.approximate-memory-usage", &memory)) {
+            LogPrint(BCLog::LEVELDB,
+                     "Failed to get approximate-memory-usage property\n");
+            return 0;
+        }
+        return stoul(memory);
+    }
+
+    size_t EstimateSize(Span<const char> begin,
+                        Span<const char> end) const override {
+        uint64_t size = 0;
+        leveldb::Range range(ToSlice(begin), ToSlice(end));
+        pdb->GetApproximateSizes(&range, 1, &size);
+        return size;
+    }
+
+    void CompactRange(const Span<const char> *begin,
+                      const Span<const char> *end) override {
+        leveldb::Slice slBegin, slEnd;
+        if (begin) {
+            slBegin = ToSlice(*begin);
+        }
+        if (end) {
+            slEnd = ToSlice(*end);
+        }
+        pdb->CompactRange(begin ? &slBegin : nullptr, end ? &slEnd : nullptr);
+    }
+
+    DBEngineStats GetStats() const override {
+        DBEngineStats stats;
+        std::string value;
+        if (pdb->GetProperty("leveldb.compaction-stats", &value)) {
+            std::istringstream lines(value);
+            DBEngineStats::Level level;
+            while (lines >> level.level >> level.files >> level.bytes >>
+                   level.compactions >> level.subcompactions >>
+                   level.compaction_micros >> level.bytes_read >>
+                   level.bytes_written) {
+                stats.levels.push_back(level);
+            }
+        }
+        if (pdb->GetProperty("leveldb.write-stalls", &value)) {
+            std::istringstream(value) >>
+                stats.slowdowns >> stats.slowdown_micros >>
+                stats.memtable_waits >> stats.memtable_wait_micros >>
+                stats.level0_waits >> stats.level0_wait_micros;
+        }
+        return stats;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<DBEngine> MakeLevelDBEngine(const fs::path &path,
+                                            size_t nCacheSize, bool fMemory,
+                                            bool fWipe) {
+    return std::make_unique<LevelDBEngine>(path, nCacheSize, fMemory, fWipe);
+}
@@ -5,149 +5,109 @@
 #include <dbwrapper.h>
 
 #include <random.h>
-
-#include <leveldb/cache.h>
-#include <leveldb/env.h>
-#include <leveldb/filter_policy.h>
-#include <memenv.h>
+#include <tinyformat.h>
 
 #include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <optional>
 
-class CBitcoinLevelDBLogger : public leveldb::Logger {
-public:
-    // This code is adapted from posix_logger.h, which is why it is using
-    // vsprintf.
-    // Please do not do this in normal code
-    void Logv(const char *format, va_list ap) override {
-        if (!LogAcceptCategory(BCLog::LEVELDB)) {
-            return;
-        }
-        char buffer[500];
-        for (int iter = 0; iter < 2; iter++) {
-            char *base;
-            int bufsize;
-            if (iter == 0) {
-                bufsize = sizeof(buffer);
-                base = buffer;
-            } else {
-                bufsize = 30000;
-                base = new char[bufsize];
-            }
-            char *p = base;
-            char *limit = base + bufsize;
-
-            // Print the message
-            if (p < limit) {
-                va_list backup_ap;
-                va_copy(backup_ap, ap);
-                // Do not use vsnprintf elsewhere in bitcoin source code, see
-                // above.
-                p += vsnprintf(p, limit - p, format, backup_ap);
-                va_end(backup_ap);
-            }
+bool ParseDBEngineType(const std::string &name, DBEngineType &engine) {
+    if (name == "leveldb") {
+        engine = DBEngineType::LEVELDB;
+        return true;
+    }
+    if (name == "btree") {
+        engine = DBEngineType::BTREE;
+        return true;
+    }
+    return false;
+}
 
-            // Truncate to available space if necessary
-            if (p >= limit) {
-                if (iter == 0) {
-                    continue; // Try again with larger buffer
-                } else {
-                    p = limit - 1;
-                }
-            }
+std::string DBEngineTypeName(DBEngineType engine) {
+    switch (engine) {
+        case DBEngineType::LEVELDB:
+            return "leveldb";
+        case DBEngineType::BTREE:
+            return "btree";
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
 
-            // Add newline if necessary
-            if (p == base || p[-1] != '\n') {
-                *p++ = '\n';
-            }
+/** File recording the engine of a database, in the database directory. */
+static const char *const DB_ENGINE_FILENAME = "ENGINE";
 
-            assert(p <= limit);
-            base[std::min(bufsize - 1, (int)(p - base))] = '\0';
-            LogPrintfToBeContinued("leveldb: %s", base);
-            if (base != buffer) {
-                delete[] base;
-            }
-            break;
-        }
+std::optional<DBEngineType> ReadDBEngineType(const fs::path &path) {
+    fsbridge::ifstream file(path / DB_ENGINE_FILENAME);
+    std::string name;
+    DBEngineType engine;
+    if (file >> name && ParseDBEngineType(name, engine)) {
+        return engine;
     }
-};
-
-static void SetMaxOpenFiles(leveldb::Options *options) {
-    // On most platforms the default setting of max_open_files (which is 1000)
-    // is optimal. On Windows using a large file count is OK because the handles
-    // do not interfere with select() loops. On 64-bit Unix hosts this value is
-    // also OK, because up to that amount LevelDB will use an mmap
-    // implementation that does not use extra file descriptors (the fds are
-    // closed after being mmaped).
-    //
-    // Increasing the value beyond the default is dangerous because LevelDB will
-    // fall back to a non-mmap implementation when the file count is too large.
-    // On 32-bit Unix host we should decrease the value because the handles use
-    // up real fds, and we want to avoid fd exhaustion issues.
-    //
-    // See PR #12495 for further discussion.
-
-    int default_open_files = options->max_open_files;
-#ifndef WIN32
-    if (sizeof(void *) < 8) {
-        options->max_open_files = 64;
+    if (fs::exists(path / "CURRENT")) {
+        return DBEngineType::LEVELDB;
     }
-#endif
-    LogPrint(BCLog::LEVELDB, "LevelDB using max_open_files=%d (default=%d)\n",
-             options->max_open_files, default_open_files);
+    return std::nullopt;
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize) {
-    leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    // up to two write buffers may be held in memory simultaneously
-    options.write_buffer_size = nCacheSize / 4;
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.info_log = new CBitcoinLevelDBLogger();
-    if (leveldb::kMajorVersion > 1 ||
-        (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
-        // LevelDB versions before 1.16 consider short writes to be corruption.
-        // Only trigger error on corruption in later versions.
-        options.paranoid_checks = true;
-    }
-    SetMaxOpenFiles(&options);
-    return options;
+static std::unique_ptr<DBEngine> OpenDBEngine(DBEngineType engine,
+                                              const fs::path &path,
+                                              size_t nCacheSize, bool fMemory,
+                                              bool fWipe) {
+    switch (engine) {
+        case DBEngineType::LEVELDB:
+            return MakeLevelDBEngine(path, nCacheSize, fMemory, fWipe);
+        case DBEngineType::BTREE:
+            return MakeBTreeEngine(path, nCacheSize, fMemory, fWipe);
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
 }
 
-CDBWrapper::CDBWrapper(const fs::path &path, size_t nCacheSize, bool fMemory,
-                       bool fWipe, bool obfuscate)
-    : m_name{fs::PathToString(path.stem())} {
-    penv = nullptr;
-    readoptions.verify_checksums = true;
-    iteroptions.verify_checksums = true;
-    iteroptions.fill_cache = false;
-    syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
-    options.create_if_missing = true;
+/**
+ * Open the database with the given engine, refusing to open a database written
+ * by another engine unless it is wiped.
+ */
+static std::unique_ptr<DBEngine> MakeDBEngine(DBEngineType engine,
+                                              const fs::path &path,
+                                              size_t nCacheSize, bool fMemory,
+                                              bool fWipe) {
     if (fMemory) {
-        penv = leveldb::NewMemEnv(leveldb::Env::Default());
-        options.env = penv;
-    } else {
-        if (fWipe) {
-            LogPrintf("Wiping LevelDB in %s\n", fs::PathToString(path));
-            leveldb::Status result =
-                leveldb::DestroyDB(fs::PathToString(path), options);
-            dbwrapper_private::HandleError(result);
+        return OpenDBEngine(engine, path, nCacheSize, fMemory, fWipe);
+    }
+
+    const std::optional<DBEngineType> recorded = ReadDBEngineType(path);
+    if (!fWipe && recorded && *recorded != engine) {
+        throw dbwrapper_error(strprintf(
+            "Database %s was written by the %s engine, not %s",
+            fs::PathToString(path), DBEngineTypeName(*recorded),
+            DBEngineTypeName(engine)));
+    }
+    std::unique_ptr<DBEngine> db =
+        OpenDBEngine(engine, path, nCacheSize, fMemory, fWipe);
+    if (recorded != engine) {
+        fsbridge::ofstream file(path / DB_ENGINE_FILENAME);
+        file << DBEngineTypeName(engine) << std::endl;
+        if (!file.good()) {
+            throw dbwrapper_error("Unable to record the engine of " +
+                                  fs::PathToString(path));
         }
-        TryCreateDirectories(path);
-        LogPrintf("Opening LevelDB in %s\n", fs::PathToString(path));
     }
-    leveldb::Status status =
-        leveldb::DB::Open(options, fs::PathToString(path), &pdb);
-    dbwrapper_private::HandleError(status);
-    LogPrintf("Opened LevelDB successfully\n");
+    return db;
+}
+
+CDBBatch::CDBBatch(const CDBWrapper &_parent)
+    : parent(_parent), batch(_parent.m_engine->NewBatch()),
+      ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION),
+      size_estimate(0) {}
 
+CDBWrapper::CDBWrapper(const fs::path &path, size_t nCacheSize, bool fMemory,
+                       bool fWipe, bool obfuscate, DBEngineType engine)
+    : m_engine{MakeDBEngine(engine, path, nCacheSize, fMemory, fWipe)},
+      m_name{fs::PathToString(path.stem())} {
     if (gArgs.GetBoolArg("-forcecompactdb", false)) {
         LogPrintf("Starting database compaction of %s\n",
                   fs::PathToString(path));
-        pdb->CompactRange(nullptr, nullptr);
+        m_engine->CompactRange(nullptr, nullptr);
         LogPrintf("Finished database compaction of %s\n",
                   fs::PathToString(path));
     }
@@ -174,18 +134,7 @@ CDBWrapper::CDBWrapper(const fs::path &path, size_t nCacheSize, bool fMemory,
               HexStr(obfuscate_key));
 }
 
-CDBWrapper::~CDBWrapper() {
-    delete pdb;
-    pdb = nullptr;
-    delete options.filter_policy;
-    options.filter_policy = nullptr;
-    delete options.info_log;
-    options.info_log = nullptr;
-    delete options.block_cache;
-    options.block_cache = nullptr;
-    delete penv;
-    options.env = nullptr;
-}
+CDBWrapper::~CDBWrapper() {}
 
 bool CDBWrapper::WriteBatch(CDBBatch &batch, bool fSync) {
     const bool log_memory = LogAcceptCategory(BCLog::LEVELDB);
@@ -193,9 +142,7 @@ bool CDBWrapper::WriteBatch(CDBBatch &batch, bool fSync) {
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
     }
-    leveldb::Status status =
-        pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
-    dbwrapper_private::HandleError(status);
+    m_engine->Write(*batch.batch, fSync);
     if (log_memory) {
         double mem_after = DynamicMemoryUsage() / 1024.0 / 1024;
         LogPrint(
@@ -207,13 +154,7 @@ bool CDBWrapper::WriteBatch(CDBBatch &batch, bool fSync) {
 }
 
 size_t CDBWrapper::DynamicMemoryUsage() const {
-    std::string memory;
-    if (!pdb->GetProperty("leveldb.approximate-memory-usage", &memory)) {
-        LogPrint(BCLog::LEVELDB,
-                 "Failed to get approximate-memory-usage property\n");
-        return 0;
-    }
-    return stoul(memory);
+    return m_engine->DynamicMemoryUsage();
 }
 
 // Prefixed with null character to avoid collisions with other keys
@@ -240,9 +181,7 @@ bool CDBWrapper::IsEmpty() {
     return !(it->Valid());
 }
 
-CDBIterator::~CDBIterator() {
-    delete piter;
-}
+CDBIterator::~CDBIterator() {}
 bool CDBIterator::Valid() const {
     return piter->Valid();
 }
@@ -255,17 +194,6 @@ void CDBIterator::Next() {
 
 namespace dbwrapper_private {
 
-void HandleError(const leveldb::Status &status) {
-    if (status.ok()) {
-        return;
-    }
-    const std::string errmsg = "Fatal LevelDB error: " + status.ToString();
-    LogPrintf("%s\n", errmsg);
-    LogPrintf("You can use -debug=leveldb to get more complete diagnostic "
-              "messages\n");
-    throw dbwrapper_error(errmsg);
-}
-
 const std::vector<uint8_t> &GetObfuscateKey(const CDBWrapper &w) {
     return w.obfuscate_key;
 }
@@ -6,24 +6,18 @@
 #define BITCOIN_DBWRAPPER_H
 
 #include <clientversion.h>
+#include <dbengine.h>
 #include <fs.h>
 #include <serialize.h>
 #include <streams.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 
-#include <leveldb/db.h>
-#include <leveldb/write_batch.h>
+#include <memory>
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
-class dbwrapper_error : public std::runtime_error {
-public:
-    explicit dbwrapper_error(const std::string &msg)
-        : std::runtime_error(msg) {}
-};
-
 class CDBWrapper;
 
 /**
@@ -31,11 +25,6 @@ class CDBWrapper;
  */
 namespace dbwrapper_private {
 
-/**
- * Handle database error by throwing dbwrapper_error exception.
- */
-void HandleError(const leveldb::Status &status);
-
 /**
  * Work around circular dependency, as well as for testing in dbwrapper_tests.
  * Database obfuscation should be considered an implementation detail of the
@@ -50,7 +39,7 @@ class CDBBatch {
 
 private:
     const CDBWrapper &parent;
-    leveldb::WriteBatch batch;
+    const std::unique_ptr<DBEngine::Batch> batch;
 
     CDataStream ssKey;
     CDataStream ssValue;
@@ -61,26 +50,24 @@ public:
     /**
      * @param[in] _parent   CDBWrapper that this batch is to be submitted to
      */
-    explicit CDBBatch(const CDBWrapper &_parent)
-        : parent(_parent), ssKey(SER_DISK, CLIENT_VERSION),
-          ssValue(SER_DISK, CLIENT_VERSION), size_estimate(0){};
+    explicit CDBBatch(const CDBWrapper &_parent);
 
     void Clear() {
-        batch.Clear();
+        batch->Clear();
         size_estimate = 0;
     }
 
     template <typename K, typename V> void Write(const K &key, const V &value) {
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+        Span<const char> slKey(ssKey.data(), ssKey.size());
 
         ssValue.reserve(DBWRAPPER_PREALLOC_VALUE_SIZE);
         ssValue << value;
         ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
-        leveldb::Slice slValue(ssValue.data(), ssValue.size());
+        Span<const char> slValue(ssValue.data(), ssValue.size());
 
-        batch.Put(slKey, slValue);
+        batch->Put(slKey, slValue);
         // LevelDB serializes writes as:
         // - byte: header
         // - varint: key length (1 byte up to 127B, 2 bytes up to 16383B, ...)
@@ -97,9 +84,9 @@ public:
     template <typename K> void Erase(const K &key) {
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+        Span<const char> slKey(ssKey.data(), ssKey.size());
 
-        batch.Delete(slKey);
+        batch->Delete(slKey);
         // LevelDB serializes erases as:
         // - byte: header
         // - varint: key length
@@ -115,15 +102,16 @@ public:
 class CDBIterator {
 private:
     const CDBWrapper &parent;
-    leveldb::Iterator *piter;
+    const std::unique_ptr<DBEngine::Iterator> piter;
 
 public:
     /**
      * @param[in] _parent          Parent CDBWrapper instance.
-     * @param[in] _piter           The original leveldb iterator.
+     * @param[in] _piter           The storage engine iterator.
      */
-    CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter)
-        : parent(_parent), piter(_piter){};
+    CDBIterator(const CDBWrapper &_parent,
+                std::unique_ptr<DBEngine::Iterator> _piter)
+        : parent(_parent), piter(std::move(_piter)){};
     ~CDBIterator();
 
     bool Valid() const;
@@ -134,14 +122,13 @@ public:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
-        piter->Seek(slKey);
+        piter->Seek(Span<const char>(ssKey.data(), ssKey.size()));
     }
 
     void Next();
 
     template <typename K> bool GetKey(K &key) {
-        leveldb::Slice slKey = piter->key();
+        Span<const char> slKey = piter->Key();
         try {
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(),
                               SER_DISK, CLIENT_VERSION);
@@ -153,7 +140,7 @@ public:
     }
 
     template <typename V> bool GetValue(V &value) {
-        leveldb::Slice slValue = piter->value();
+        Span<const char> slValue = piter->Value();
         try {
             CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(),
                                 SER_DISK, CLIENT_VERSION);
@@ -165,7 +152,7 @@ public:
         return true;
     }
 
-    unsigned int GetValueSize() { return piter->value().size(); }
+    unsigned int GetValueSize() { return piter->Value().size(); }
 };
 
 class CDBWrapper {
@@ -173,27 +160,10 @@ class CDBWrapper {
     dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
 
 private:
-    //! custom environment this database is using (may be nullptr in case of
-    //! default environment)
-    leveldb::Env *penv;
-
-    //! database options used
-    leveldb::Options options;
-
-    //! options used when reading from the database
-    leveldb::ReadOptions readoptions;
+    friend class CDBBatch;
 
-    //! options used when iterating over values of the database
-    leveldb::ReadOptions iteroptions;
-
-    //! options used when writing to the database
-    leveldb::WriteOptions writeoptions;
-
-    //! options used when sync writing to the database
-    leveldb::WriteOptions syncoptions;
-
-    //! the database itself
-    leveldb::DB *pdb;
+    //! the storage engine holding the data
+    std::unique_ptr<DBEngine> m_engine;
 
     //! the name of this database
     std::string m_name;
@@ -211,17 +181,19 @@ private:
 
 public:
     /**
-     * @param[in] path        Location in the filesystem where leveldb data will
-     * be stored.
-     * @param[in] nCacheSize  Configures various leveldb cache settings.
-     * @param[in] fMemory     If true, use leveldb's memory environment.
+     * @param[in] path        Location in the filesystem where the database
+     * will be stored.
+     * @param[in] nCacheSize  Configures various storage engine cache settings.
+     * @param[in] fMemory     If true, keep the database in memory only.
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If
      * false, XOR
      *                        with a zero'd byte array.
+     * @param[in] engine      The storage engine backing the database.
      */
     CDBWrapper(const fs::path &path, size_t nCacheSize, bool fMemory = false,
-               bool fWipe = false, bool obfuscate = false);
+               bool fWipe = false, bool obfuscate = false,
+               DBEngineType engine = DBEngineType::LEVELDB);
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper &) = delete;
@@ -231,14 +203,11 @@ public:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+        Span<const char> slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound()) return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
+        if (!m_engine->Read(slKey, strValue)) {
+            return false;
         }
         try {
             CDataStream ssValue(strValue.data(),
@@ -263,16 +232,10 @@ public:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+        Span<const char> slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound()) return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
-        }
-        return true;
+        return m_engine->Read(slKey, strValue);
     }
 
     template <typename K> bool Erase(const K &key, bool fSync = false) {
@@ -283,11 +246,14 @@ public:
 
     bool WriteBatch(CDBBatch &batch, bool fSync = false);
 
-    // Get an estimate of LevelDB memory usage (in bytes).
+    // Get an estimate of storage engine memory usage (in bytes).
     size_t DynamicMemoryUsage() const;
 
+    //! Compaction and write stall counters of the storage engine.
+    DBEngineStats GetStats() const { return m_engine->GetStats(); }
+
     CDBIterator *NewIterator() {
-        return new CDBIterator(*this, pdb->NewIterator(iteroptions));
+        return new CDBIterator(*this, m_engine->NewIterator());
     }
 
     /**
@@ -303,12 +269,9 @@ public:
         ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey1 << key_begin;
         ssKey2 << key_end;
-        leveldb::Slice slKey1(ssKey1.data(), ssKey1.size());
-        leveldb::Slice slKey2(ssKey2.data(), ssKey2.size());
-        uint64_t size = 0;
-        leveldb::Range range(slKey1, slKey2);
-        pdb->GetApproximateSizes(&range, 1, &size);
-        return size;
+        Span<const char> slKey1(ssKey1.data(), ssKey1.size());
+        Span<const char> slKey2(ssKey2.data(), ssKey2.size());
+        return m_engine->EstimateSize(slKey1, slKey2);
     }
 
     /**
@@ -322,9 +285,9 @@ public:
         ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey1 << key_begin;
         ssKey2 << key_end;
-        leveldb::Slice slKey1(ssKey1.data(), ssKey1.size());
-        leveldb::Slice slKey2(ssKey2.data(), ssKey2.size());
-        pdb->CompactRange(&slKey1, &slKey2);
+        Span<const char> slKey1(ssKey1.data(), ssKey1.size());
+        Span<const char> slKey2(ssKey2.data(), ssKey2.size());
+        m_engine->CompactRange(&slKey1, &slKey2);
     }
 };
 
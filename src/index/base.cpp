@@ -312,7 +312,9 @@ void BaseIndex::Interrupt() {
 void BaseIndex::Start() {
     // Need to register this ValidationInterface before running Init(), so that
     // callbacks are not missed if Init sets m_synced to true.
-    RegisterValidationInterface(this);
+    // An index missing a block would stall, its notifications are never
+    // dropped.
+    RegisterValidationInterface(this, GetName(), /* allow_drop */ false);
     if (!Init()) {
         FatalError("%s: %s failed to initialize", __func__, GetName());
         return;
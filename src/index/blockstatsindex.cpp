@@ -0,0 +1,44 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blockstatsindex.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <config.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+constexpr char DB_BLOCK_STATS = 's';
+
+std::unique_ptr<BlockStatsIndex> g_blockstatsindex;
+
+BlockStatsIndex::BlockStatsIndex(size_t n_cache_size, bool f_memory,
+                                 bool f_wipe)
+    : m_db(std::make_unique<BaseIndex::DB>(GetDataDir() / "indexes" /
+                                               "blockstats",
+                                           n_cache_size, f_memory, f_wipe)) {}
+
+bool BlockStatsIndex::WriteBlock(const CBlock &block,
+                                 const CBlockIndex *pindex) {
+    CBlockUndo blockUndo;
+    // The genesis block has no undo data, but it only contains a coinbase.
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(blockUndo, pindex)) {
+        return error("%s: Failed to read undo data for block %s", __func__,
+                     pindex->GetBlockHash().ToString());
+    }
+
+    const CBlockStats stats =
+        ComputeBlockStats(block, blockUndo, *pindex, Params().GetConsensus(),
+                          GetConfig().GetMaxBlockSize());
+    return m_db->Write(std::make_pair(DB_BLOCK_STATS, stats.blockhash), stats);
+}
+
+bool BlockStatsIndex::LookupStats(const CBlockIndex *block_index,
+                                  CBlockStats &stats_out) const {
+    return m_db->Read(
+        std::make_pair(DB_BLOCK_STATS, block_index->GetBlockHash()),
+        stats_out);
+}
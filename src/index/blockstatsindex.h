@@ -0,0 +1,45 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BLOCKSTATSINDEX_H
+#define BITCOIN_INDEX_BLOCKSTATSINDEX_H
+
+#include <index/base.h>
+#include <node/blockstats.h>
+
+#include <memory>
+
+/**
+ * BlockStatsIndex stores the statistics returned by getblockstats for every
+ * block, so they don't have to be computed again from the block and undo data
+ * on each request. The index is written to a LevelDB database and the
+ * statistics are keyed by block hash, so entries for blocks that got
+ * reorganized out of the active chain remain valid.
+ */
+class BlockStatsIndex final : public BaseIndex {
+private:
+    const std::unique_ptr<BaseIndex::DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock &block, const CBlockIndex *pindex) override;
+
+    BaseIndex::DB &GetDB() const override { return *m_db; }
+
+    const char *GetName() const override { return "blockstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit BlockStatsIndex(size_t n_cache_size, bool f_memory = false,
+                             bool f_wipe = false);
+
+    /// Look up the statistics of a block. Returns false if the block is not
+    /// indexed (yet).
+    bool LookupStats(const CBlockIndex *block_index,
+                     CBlockStats &stats_out) const;
+};
+
+/// The global block statistics index. May be null.
+extern std::unique_ptr<BlockStatsIndex> g_blockstatsindex;
+
+#endif // BITCOIN_INDEX_BLOCKSTATSINDEX_H
@@ -6,13 +6,23 @@
 
 #include <blockdb.h>
 #include <chain.h>
+#include <core_memusage.h>
 #include <index/disktxpos.h>
+#include <memusage.h>
 #include <node/ui_interface.h>
 #include <shutdown.h>
+#include <sync.h>
+#include <txmempool.h>
 #include <util/system.h>
 #include <util/translation.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <tuple>
+#include <unordered_map>
+
 constexpr char DB_BEST_BLOCK = 'B';
 constexpr char DB_TXINDEX = 't';
 constexpr char DB_TXINDEX_BLOCK = 'T';
@@ -55,6 +65,90 @@ bool TxIndex::DB::WriteTxs(
     return WriteBatch(batch);
 }
 
+/**
+ * Least recently used transactions looked up in the index, with the hash of
+ * their block, bounded by their memory usage.
+ */
+class TxIndex::TxCache {
+private:
+    struct Entry {
+        TxId txid;
+        BlockHash block_hash;
+        CTransactionRef tx;
+        size_t usage;
+    };
+    using EntryList = std::list<Entry>;
+
+    const size_t m_max_usage;
+
+    Mutex m_mutex;
+    //! Most recently used first
+    EntryList m_entries GUARDED_BY(m_mutex);
+    std::unordered_map<TxId, EntryList::iterator, SaltedTxIdHasher>
+        m_map GUARDED_BY(m_mutex);
+    size_t m_usage GUARDED_BY(m_mutex){0};
+
+    void Erase(std::unordered_map<TxId, EntryList::iterator,
+                                  SaltedTxIdHasher>::iterator it)
+        EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        m_usage -= it->second->usage;
+        m_entries.erase(it->second);
+        m_map.erase(it);
+    }
+
+public:
+    explicit TxCache(size_t max_usage) : m_max_usage(max_usage) {}
+
+    bool Get(const TxId &txid, BlockHash &block_hash, CTransactionRef &tx) {
+        LOCK(m_mutex);
+        auto it = m_map.find(txid);
+        if (it == m_map.end()) {
+            return false;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        block_hash = it->second->block_hash;
+        tx = it->second->tx;
+        return true;
+    }
+
+    void Add(const BlockHash &block_hash, const CTransactionRef &tx) {
+        // The entry, its list node and its map node.
+        const size_t usage =
+            RecursiveDynamicUsage(tx) +
+            memusage::MallocUsage(sizeof(Entry) + 2 * sizeof(void *)) +
+            memusage::MallocUsage(
+                sizeof(memusage::unordered_node<
+                       std::pair<const TxId, EntryList::iterator>>)) +
+            sizeof(void *);
+        if (usage > m_max_usage) {
+            return;
+        }
+
+        LOCK(m_mutex);
+        auto it = m_map.find(tx->GetId());
+        if (it != m_map.end()) {
+            Erase(it);
+        }
+        while (m_usage + usage > m_max_usage) {
+            Erase(m_map.find(m_entries.back().txid));
+        }
+        m_entries.push_front({tx->GetId(), block_hash, tx, usage});
+        m_map.emplace(tx->GetId(), m_entries.begin());
+        m_usage += usage;
+    }
+
+    /** Forget the transactions of a block, as their position changes. */
+    void EraseBlock(const CBlock &block) {
+        LOCK(m_mutex);
+        for (const auto &tx : block.vtx) {
+            auto it = m_map.find(tx->GetId());
+            if (it != m_map.end()) {
+                Erase(it);
+            }
+        }
+    }
+};
+
 /*
  * Safely persist a transfer of data from the old txindex database to the new
  * one, and compact the range of keys updated. This is used internally by
@@ -198,8 +292,10 @@ bool TxIndex::DB::MigrateData(CBlockTreeDB &block_tree_db,
     return true;
 }
 
-TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
-    : m_db(std::make_unique<TxIndex::DB>(n_cache_size, f_memory, f_wipe)) {}
+TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe,
+                 size_t n_tx_cache_size)
+    : m_db(std::make_unique<TxIndex::DB>(n_cache_size, f_memory, f_wipe)),
+      m_tx_cache(std::make_unique<TxIndex::TxCache>(n_tx_cache_size)) {}
 
 TxIndex::~TxIndex() {}
 
@@ -230,6 +326,7 @@ bool TxIndex::WriteBlock(const CBlock &block, const CBlockIndex *pindex) {
         vPos.emplace_back(tx->GetId(), pos);
         pos.nTxOffset += ::GetSerializeSize(*tx, CLIENT_VERSION);
     }
+    m_tx_cache->EraseBlock(block);
     return m_db->WriteTxs(vPos);
 }
 
@@ -239,28 +336,100 @@ BaseIndex::DB &TxIndex::GetDB() const {
 
 bool TxIndex::FindTx(const TxId &txid, BlockHash &block_hash,
                      CTransactionRef &tx) const {
-    CDiskTxPos postx;
-    if (!m_db->ReadTxPos(txid, postx)) {
+    auto result = FindTxs({txid}).front();
+    if (!result.second) {
         return false;
     }
+    block_hash = result.first;
+    tx = std::move(result.second);
+    return true;
+}
 
-    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-    if (file.IsNull()) {
-        return error("%s: OpenBlockFile failed", __func__);
+std::vector<std::pair<BlockHash, CTransactionRef>>
+TxIndex::FindTxs(const std::vector<TxId> &txids) const {
+    std::vector<std::pair<BlockHash, CTransactionRef>> results(txids.size());
+
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < txids.size(); ++i) {
+        if (!m_tx_cache->Get(txids[i], results[i].first, results[i].second)) {
+            misses.push_back(i);
+        }
     }
-    CBlockHeader header;
-    try {
-        file >> header;
-        if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
-            return error("%s: fseek(...) failed", __func__);
+    if (misses.empty()) {
+        return results;
+    }
+
+    // Look up the positions in key order, then read the transactions in the
+    // order of their position so that each block file is opened once and
+    // read sequentially.
+    std::sort(misses.begin(), misses.end(),
+              [&](size_t a, size_t b) { return txids[a] < txids[b]; });
+    std::vector<std::pair<CDiskTxPos, size_t>> to_read;
+    to_read.reserve(misses.size());
+    for (size_t i : misses) {
+        CDiskTxPos postx;
+        if (m_db->ReadTxPos(txids[i], postx)) {
+            to_read.emplace_back(postx, i);
         }
-        file >> tx;
-    } catch (const std::exception &e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
-    if (tx->GetId() != txid) {
-        return error("%s: txid mismatch", __func__);
+    std::sort(to_read.begin(), to_read.end(),
+              [](const std::pair<CDiskTxPos, size_t> &a,
+                 const std::pair<CDiskTxPos, size_t> &b) {
+                  return std::make_tuple(a.first.nFile, a.first.nPos,
+                                         a.first.nTxOffset) <
+                         std::make_tuple(b.first.nFile, b.first.nPos,
+                                         b.first.nTxOffset);
+              });
+
+    std::unique_ptr<CAutoFile> file;
+    // The block whose header was read last, and where its transactions start
+    FlatFilePos block_pos;
+    BlockHash block_hash;
+    long txs_start = 0;
+    for (const auto &[postx, i] : to_read) {
+        if (!file || postx.nFile != block_pos.nFile) {
+            file = std::make_unique<CAutoFile>(
+                OpenBlockFile(FlatFilePos(postx.nFile, 0), true), SER_DISK,
+                CLIENT_VERSION);
+            block_pos = FlatFilePos(postx.nFile, 0);
+            block_pos.nPos = std::numeric_limits<unsigned int>::max();
+            if (file->IsNull()) {
+                error("%s: OpenBlockFile failed", __func__);
+            }
+        }
+        if (file->IsNull()) {
+            continue;
+        }
+
+        try {
+            if (postx.nPos != block_pos.nPos) {
+                if (fseek(file->Get(), postx.nPos, SEEK_SET)) {
+                    error("%s: fseek(...) failed", __func__);
+                    continue;
+                }
+                CBlockHeader header;
+                *file >> header;
+                block_pos.nPos = postx.nPos;
+                block_hash = header.GetHash();
+                txs_start = postx.nPos +
+                            ::GetSerializeSize(header, CLIENT_VERSION);
+            }
+            if (fseek(file->Get(), txs_start + postx.nTxOffset, SEEK_SET)) {
+                error("%s: fseek(...) failed", __func__);
+                continue;
+            }
+            CTransactionRef tx;
+            *file >> tx;
+            if (tx->GetId() != txids[i]) {
+                error("%s: txid mismatch", __func__);
+                continue;
+            }
+            m_tx_cache->Add(block_hash, tx);
+            results[i] = {block_hash, std::move(tx)};
+        } catch (const std::exception &e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            block_pos.nPos = std::numeric_limits<unsigned int>::max();
+        }
     }
-    block_hash = header.GetHash();
-    return true;
+    return results;
 }
@@ -9,6 +9,11 @@
 #include <txdb.h>
 
 #include <memory>
+#include <utility>
+#include <vector>
+
+//! Default memory used by the decoded transactions cached by TxIndex
+static constexpr size_t DEFAULT_TXINDEX_TX_CACHE_SIZE = 32 << 20;
 
 /**
  * TxIndex is used to look up transactions included in the blockchain by ID.
@@ -18,9 +23,12 @@
 class TxIndex final : public BaseIndex {
 protected:
     class DB;
+    class TxCache;
 
 private:
     const std::unique_ptr<DB> m_db;
+    //! Recently looked up transactions, by transaction ID
+    const std::unique_ptr<TxCache> m_tx_cache;
 
 protected:
     /// Override base class init to migrate from old database.
@@ -35,7 +43,8 @@ protected:
 public:
     /// Constructs the index, which becomes available to be queried.
     explicit TxIndex(size_t n_cache_size, bool f_memory = false,
-                     bool f_wipe = false);
+                     bool f_wipe = false,
+                     size_t n_tx_cache_size = DEFAULT_TXINDEX_TX_CACHE_SIZE);
 
     // Destructor is declared because this class contains a unique_ptr to an
     // incomplete type.
@@ -50,6 +59,15 @@ public:
     /// @return  true if transaction is found, false otherwise
     bool FindTx(const TxId &txid, BlockHash &block_hash,
                 CTransactionRef &tx) const;
+
+    /// Look up several transactions. The transactions which are not cached
+    /// are read in the order of their position on disk.
+    ///
+    /// @param[in]   txids  The IDs of the transactions to be returned.
+    /// @return  For each ID, the hash of the block the transaction is found in
+    /// and the transaction itself, which is null if it is not found.
+    std::vector<std::pair<BlockHash, CTransactionRef>>
+    FindTxs(const std::vector<TxId> &txids) const;
 };
 
 /// The global transaction index, used in GetTransaction. May be null.
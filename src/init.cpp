@@ -23,13 +23,17 @@
 #include <compat/sanity.h>
 #include <config.h>
 #include <consensus/validation.h>
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
 #include <currencyunit.h>
+#include <dbengine.h>
 #include <flatfile.h>
 #include <fs.h>
 #include <hash.h>
 #include <httprpc.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/blockstatsindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <interfaces/node.h>
@@ -41,6 +45,7 @@
 #include <netbase.h>
 #include <network.h>
 #include <node/context.h>
+#include <node/segmentvalidation.h>
 #include <node/ui_interface.h>
 #include <policy/mempool.h>
 #include <policy/policy.h>
@@ -87,6 +92,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <functional>
+#include <optional>
 #include <set>
 #include <thread>
 #include <vector>
@@ -159,6 +165,9 @@ static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
 static std::thread g_load_block;
 
+//! The storage engine of the chainstate database, parsed from -dbengine
+static DBEngineType g_chainstate_db_engine{DBEngineType::LEVELDB};
+
 void Interrupt(NodeContext &node) {
     InterruptHTTPServer();
     InterruptHTTPRPC();
@@ -177,6 +186,9 @@ void Interrupt(NodeContext &node) {
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_blockstatsindex) {
+        g_blockstatsindex->Interrupt();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex &index) { index.Interrupt(); });
 }
 
@@ -201,6 +213,7 @@ void Shutdown(NodeContext &node) {
     StopHTTPRPC();
     StopREST();
     StopRPC();
+    StopBlockStatsWorkers();
     StopHTTPServer();
     for (const auto &client : node.chain_clients) {
         client->flush();
@@ -245,10 +258,12 @@ void Shutdown(NodeContext &node) {
     if (node.scheduler) {
         node.scheduler->stop();
     }
+    GetMainSignals().StopWorkerThreads();
     if (g_load_block.joinable()) {
         g_load_block.join();
     }
     StopScriptCheckWorkerThreads();
+    StopSegmentSnapshotWriter();
 
     // After the threads that potentially access these pointers have been
     // stopped, destruct and reset all to nullptr.
@@ -284,6 +299,10 @@ void Shutdown(NodeContext &node) {
         g_txindex->Stop();
         g_txindex.reset();
     }
+    if (g_blockstatsindex) {
+        g_blockstatsindex->Stop();
+        g_blockstatsindex.reset();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex &index) { index.Stop(); });
     DestroyAllBlockFilterIndexes();
 
@@ -489,6 +508,21 @@ void SetupServerArgs(NodeContext &node) {
                   DEFAULT_DB_BATCH_SIZE),
         ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
         OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-dbengine=<engine>",
+        strprintf("Storage engine for the chainstate database, one of "
+                  "leveldb or btree. Changing it requires "
+                  "-reindex-chainstate (default: %s)",
+                  DEFAULT_DB_ENGINE),
+        ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
+        OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-dbsubcompactions=<n>",
+        strprintf("Maximum number of threads a LevelDB compaction is split "
+                  "across, limited to the number of cores (default: %d)",
+                  DEFAULT_DB_SUBCOMPACTIONS),
+        ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
+        OptionsCategory::OPTIONS);
     argsman.AddArg(
         "-dbcache=<n>",
         strprintf("Set database cache size in MiB (%d to %d, default: %d)",
@@ -537,6 +571,13 @@ void SetupServerArgs(NodeContext &node) {
                              "memory (default: %u)",
                              DEFAULT_MAX_ORPHAN_TRANSACTIONS),
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-mempooljournalsize=<n>",
+        strprintf("Keep the last <n> additions and removals of transactions "
+                  "to the mempool for getmempoolchanges, their memory counts "
+                  "towards -maxmempool (default: %u, 0 to disable)",
+                  DEFAULT_MEMPOOL_JOURNAL_SIZE),
+        ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-mempoolexpiry=<n>",
                    strprintf("Do not keep transactions in the mempool longer "
                              "than <n> hours (default: %u)",
@@ -592,6 +633,19 @@ void SetupServerArgs(NodeContext &node) {
         "-reindex",
         "Rebuild chain state and block index from the blk*.dat files on disk",
         ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-segmentsnapshotinterval=<n>",
+        strprintf("Write a UTXO snapshot to the segments directory every <n> "
+                  "blocks connected, from which verifychainsegments validates "
+                  "the chain in parallel segments (default: %d, 0 = "
+                  "disabled)",
+                  DEFAULT_SEGMENT_SNAPSHOT_INTERVAL),
+        ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-segmentsnapshotkeep=<n>",
+                   strprintf("Keep the last <n> segment snapshots, the older "
+                             "ones are removed (default: %d)",
+                             DEFAULT_SEGMENT_SNAPSHOTS_KEPT),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg(
         "-settings=<file>",
         strprintf(
@@ -627,11 +681,25 @@ void SetupServerArgs(NodeContext &node) {
             " If <type> is not supplied or if <type> = 1, indexes for "
             "all known types are enabled.",
         ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockstatsindex",
+                   strprintf("Maintain an index of per block statistics, used "
+                             "by the getblockstats and getblockstatsrange rpc "
+                             "calls (default: %d)",
+                             DEFAULT_BLOCKSTATSINDEX),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg(
         "-usecashaddr",
         "Use Cash Address for destination encoding instead of base58 "
         "(activate by default on Jan, 14)",
         ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-validationthreads=<n>",
+        strprintf("Set the number of threads delivering the validation "
+                  "notifications to the wallets, indexes and other subscribers, "
+                  "each subscriber being notified in order (0 to %d, 0 = on "
+                  "the scheduler thread, default: %d)",
+                  MAX_VALIDATION_THREADS, DEFAULT_VALIDATION_THREADS),
+        ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 
     argsman.AddArg(
         "-addnode=<ip>",
@@ -846,6 +914,12 @@ void SetupServerArgs(NodeContext &node) {
 #else
     hidden_args.emplace_back("-upnp");
 #endif
+    argsman.AddArg("-v2transport",
+                   strprintf("Support the encrypted V2 transport, and upgrade "
+                             "connections to it with peers which support it "
+                             "too (default: %d)",
+                             DEFAULT_V2_TRANSPORT),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg(
         "-whitebind=<[permissions@]addr>",
         "Bind to the given address and add permission flags to the peers "
@@ -982,6 +1056,22 @@ void SetupServerArgs(NodeContext &node) {
                              DEFAULT_STOPATHEIGHT),
                    ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
                    OptionsCategory::DEBUG_TEST);
+    argsman.AddArg(
+        "-validationqueuesize=<n>",
+        strprintf("Number of validation notifications queued for a subscriber "
+                  "above which block and transaction processing wait for it "
+                  "(default: %u)",
+                  DEFAULT_VALIDATION_QUEUE_SIZE),
+        ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
+        OptionsCategory::DEBUG_TEST);
+    argsman.AddArg(
+        "-validationqueuedrop=<name>",
+        "Drop the validation notifications of the subscriber <name>, as "
+        "listed by getvalidationqueueinfo, when its queue is full instead of "
+        "waiting for it. The indexes and the wallets can't miss notifications "
+        "and ignore it. This option can be specified multiple times.",
+        ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
+        OptionsCategory::DEBUG_TEST);
     argsman.AddArg(
         "-limitancestorcount=<n>",
         strprintf("Do not accept transactions if number of in-mempool "
@@ -1921,6 +2011,10 @@ bool AppInitParameterInteraction(Config &config, const ArgsManager &args) {
             return InitError(
                 _("Prune mode is incompatible with -blockfilterindex."));
         }
+        if (args.GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX)) {
+            return InitError(
+                _("Prune mode is incompatible with -blockstatsindex."));
+        }
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1997,6 +2091,12 @@ bool AppInitParameterInteraction(Config &config, const ArgsManager &args) {
 
     fCheckBlockIndex = args.GetBoolArg("-checkblockindex",
                                        chainparams.DefaultConsistencyChecks());
+    g_segment_snapshot_interval = std::max<int64_t>(
+        0, args.GetArg("-segmentsnapshotinterval",
+                       DEFAULT_SEGMENT_SNAPSHOT_INTERVAL));
+    g_segment_snapshots_kept = std::clamp<int64_t>(
+        args.GetArg("-segmentsnapshotkeep", DEFAULT_SEGMENT_SNAPSHOTS_KEPT), 1,
+        std::numeric_limits<int>::max());
     fCheckpointsEnabled =
         args.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
     if (fCheckpointsEnabled) {
@@ -2036,6 +2136,12 @@ bool AppInitParameterInteraction(Config &config, const ArgsManager &args) {
                   chainparams.GetConsensus().nMinimumChainWork.GetHex());
     }
 
+    if (!ParseDBEngineType(args.GetArg("-dbengine", DEFAULT_DB_ENGINE),
+                           g_chainstate_db_engine)) {
+        return InitError(strprintf(_("Unknown database engine: %s"),
+                                   args.GetArg("-dbengine", "")));
+    }
+
     // mempool limits
     int64_t nMempoolSizeMax =
         args.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
@@ -2181,6 +2287,10 @@ bool AppInitParameterInteraction(Config &config, const ArgsManager &args) {
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
     }
 
+    if (args.GetBoolArg("-v2transport", DEFAULT_V2_TRANSPORT)) {
+        nLocalServices = ServiceFlags(nLocalServices | NODE_P2P_V2);
+    }
+
     nMaxTipAge = args.GetArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
 
     if (args.IsArgSet("-proxy") && args.GetArg("-proxy", "").empty()) {
@@ -2213,6 +2323,8 @@ bool AppInitSanityChecks() {
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    LogPrintf("Using the '%s' ChaCha20 and '%s' Poly1305 implementations\n",
+              ChaCha20AutoDetect(), Poly1305AutoDetect());
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -2366,6 +2478,19 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         std::chrono::minutes{1});
 
     GetMainSignals().RegisterBackgroundSignalScheduler(*node.scheduler);
+    GetMainSignals().SetQueueOptions(
+        std::max<int64_t>(1, args.GetArg("-validationqueuesize",
+                                         DEFAULT_VALIDATION_QUEUE_SIZE)),
+        args.GetArgs("-validationqueuedrop"));
+    const int validation_threads =
+        std::clamp<int64_t>(args.GetArg("-validationthreads",
+                                        DEFAULT_VALIDATION_THREADS),
+                            0, MAX_VALIDATION_THREADS);
+    if (validation_threads > 0) {
+        LogPrintf("Validation notifications use %d threads\n",
+                  validation_threads);
+        GetMainSignals().StartWorkerThreads(validation_threads);
+    }
 
     /**
      * Register RPC commands regardless of -server setting so they will be
@@ -2427,7 +2552,9 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
                         chainparams.DefaultConsistencyChecks() ? 1 : 0),
             0),
         1000000);
-    node.mempool = std::make_unique<CTxMemPool>(check_ratio);
+    const size_t journal_size = std::max<int64_t>(
+        args.GetArg("-mempooljournalsize", DEFAULT_MEMPOOL_JOURNAL_SIZE), 0);
+    node.mempool = std::make_unique<CTxMemPool>(check_ratio, journal_size);
 
     assert(!node.chainman);
     node.chainman = &g_chainman;
@@ -2438,7 +2565,7 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         PeerManager::make(chainparams, *node.connman, node.banman.get(),
                           *node.scheduler, chainman, *node.mempool,
                           args.GetBoolArg("-blocksonly", DEFAULT_BLOCKSONLY));
-    RegisterValidationInterface(node.peerman.get());
+    RegisterValidationInterface(node.peerman.get(), "peerman");
 
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
@@ -2589,7 +2716,7 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
     g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
     if (g_zmq_notification_interface) {
-        RegisterValidationInterface(g_zmq_notification_interface);
+        RegisterValidationInterface(g_zmq_notification_interface, "zmq");
     }
 #endif
 
@@ -2634,6 +2761,12 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         filter_index_cache = max_cache / n_indexes;
         nTotalCache -= filter_index_cache * n_indexes;
     }
+    int64_t block_stats_index_cache = std::min(
+        nTotalCache / 8,
+        args.GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX)
+            ? MAX_BLOCK_STATS_INDEX_CACHE_MB << 20
+            : 0);
+    nTotalCache -= block_stats_index_cache;
     // use 25%-50% of the remainder for disk cache
     int64_t nCoinDBCache =
         std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23));
@@ -2656,6 +2789,10 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
                   filter_index_cache * (1.0 / 1024 / 1024),
                   BlockFilterTypeName(filter_type));
     }
+    if (args.GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX)) {
+        LogPrintf("* Using %.1f MiB for block statistics index database\n",
+                  block_stats_index_cache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1f MiB for chain state database\n",
               nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of "
@@ -2766,11 +2903,27 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
 
                 bool failed_chainstate_init = false;
 
+                // The chainstate is only converted to another engine by
+                // rebuilding it.
+                const std::optional<DBEngineType> chainstate_engine =
+                    ReadDBEngineType(GetDataDir() / "chainstate");
+                if (!fReset && !fReindexChainState && chainstate_engine &&
+                    *chainstate_engine != g_chainstate_db_engine) {
+                    strLoadError = strprintf(
+                        _("The chainstate database uses the %s engine. You "
+                          "need to rebuild it using -reindex-chainstate to "
+                          "switch to %s."),
+                        DBEngineTypeName(*chainstate_engine),
+                        DBEngineTypeName(g_chainstate_db_engine));
+                    break;
+                }
+
                 for (CChainState *chainstate : chainman.GetAll()) {
                     chainstate->InitCoinsDB(
                         /* cache_size_bytes */ nCoinDBCache,
                         /* in_memory */ false,
-                        /* should_wipe */ fReset || fReindexChainState);
+                        /* should_wipe */ fReset || fReindexChainState,
+                        /* engine */ g_chainstate_db_engine);
 
                     chainstate->CoinsErrorCatcher().AddReadErrCallback([]() {
                         uiInterface.ThreadSafeMessageBox(
@@ -2929,6 +3082,12 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         GetBlockFilterIndex(filter_type)->Start();
     }
 
+    if (args.GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX)) {
+        g_blockstatsindex = std::make_unique<BlockStatsIndex>(
+            block_stats_index_cache, false, fReindex);
+        g_blockstatsindex->Start();
+    }
+
     // Step 9: load wallet
     for (const auto &client : node.chain_clients) {
         if (!client->load()) {
@@ -103,11 +103,15 @@ namespace {
 
     class NotificationsHandlerImpl : public Handler {
     public:
-        explicit NotificationsHandlerImpl(
-            std::shared_ptr<Chain::Notifications> notifications)
+        NotificationsHandlerImpl(
+            std::shared_ptr<Chain::Notifications> notifications,
+            const std::string &name)
             : m_proxy(std::make_shared<NotificationsProxy>(
                   std::move(notifications))) {
-            RegisterSharedValidationInterface(m_proxy);
+            // The clients track the chain from the notifications, they can't
+            // miss any.
+            RegisterSharedValidationInterface(m_proxy, name,
+                                              /* allow_drop */ false);
         }
         ~NotificationsHandlerImpl() override { disconnect(); }
         void disconnect() override {
@@ -431,10 +435,11 @@ namespace {
                           bool resume_possible) override {
             ::uiInterface.ShowProgress(title, progress, resume_possible);
         }
-        std::unique_ptr<Handler> handleNotifications(
-            std::shared_ptr<Notifications> notifications) override {
+        std::unique_ptr<Handler>
+        handleNotifications(std::shared_ptr<Notifications> notifications,
+                            const std::string &name) override {
             return std::make_unique<NotificationsHandlerImpl>(
-                std::move(notifications));
+                std::move(notifications), name);
         }
         void
         waitForNotificationsIfTipChanged(const BlockHash &old_tip) override {
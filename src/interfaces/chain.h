@@ -284,9 +284,11 @@ public:
         virtual void chainStateFlushed(const CBlockLocator &locator) {}
     };
 
-    //! Register handler for notifications.
+    //! Register handler for notifications. The name identifies its queue of
+    //! notifications, see RegisterValidationInterface.
     virtual std::unique_ptr<Handler>
-    handleNotifications(std::shared_ptr<Notifications> notifications) = 0;
+    handleNotifications(std::shared_ptr<Notifications> notifications,
+                        const std::string &name = "unnamed") = 0;
 
     //! Wait for pending notifications to be processed unless block hash points
     //! to the current chain tip.
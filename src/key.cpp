@@ -10,6 +10,7 @@
 #include <random.h>
 
 #include <secp256k1.h>
+#include <secp256k1_ecdh.h>
 #include <secp256k1_recovery.h>
 #include <secp256k1_schnorr.h>
 
@@ -299,6 +300,19 @@ bool CKey::SignSchnorr(const uint256 &hash, std::vector<uint8_t> &vchSig,
     return DoSignSchnorr(*this, hash, vchSig.data(), test_case);
 }
 
+bool CKey::ComputeECDHSecret(const CPubKey &pubkey, uint256 &secret) const {
+    if (!fValid) {
+        return false;
+    }
+    secp256k1_pubkey point;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_sign, &point,
+                                   pubkey.data(), pubkey.size())) {
+        return false;
+    }
+    return secp256k1_ecdh(secp256k1_context_sign, secret.begin(), &point,
+                          begin(), nullptr, nullptr);
+}
+
 bool CKey::VerifyPubKey(const CPubKey &pubkey) const {
     if (pubkey.IsCompressed() != fCompressed) {
         return false;
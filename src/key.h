@@ -145,6 +145,13 @@ public:
      */
     bool SignCompact(const uint256 &hash, std::vector<uint8_t> &vchSig) const;
 
+    /**
+     * Compute the secret shared with the owner of pubkey: the SHA256 of the
+     * compressed point pubkey * this key (libsecp256k1's ECDH). Returns false
+     * if pubkey can't be parsed.
+     */
+    bool ComputeECDHSecret(const CPubKey &pubkey, uint256 &secret) const;
+
     //! Derive BIP32 child key.
     bool Derive(CKey &keyChild, ChainCode &ccChild, unsigned int nChild,
                 const ChainCode &cc) const;
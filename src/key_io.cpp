@@ -8,14 +8,19 @@
 #include <cashaddrenc.h>
 #include <chainparams.h>
 #include <config.h>
+#include <crypto/siphash.h>
+#include <random.h>
+#include <sync.h>
 #include <util/strencodings.h>
 
 #include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/get.hpp>
 #include <boost/variant/static_visitor.hpp>
 
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <limits>
 
 namespace {
 class DestinationEncoder : public boost::static_visitor<std::string> {
@@ -167,11 +172,82 @@ std::string EncodeExtKey(const CExtKey &key) {
     return ret;
 }
 
+namespace {
+/**
+ * Remember the most recently encoded addresses, as verbose RPC outputs encode
+ * the same hot addresses over and over. The cache is direct mapped: a
+ * destination only ever lives in the slot selected by a salted hash of its
+ * type and hash, so a lookup costs one hash and one comparison, and an address
+ * evicts whichever one used its slot last.
+ */
+class AddressEncodingCache {
+private:
+    struct Slot {
+        CTxDestination dest;
+        bool cashaddr{false};
+        std::string network;
+        std::string address;
+    };
+
+    const uint64_t m_k0{GetRand(std::numeric_limits<uint64_t>::max())};
+    const uint64_t m_k1{GetRand(std::numeric_limits<uint64_t>::max())};
+
+    Mutex m_mutex;
+    std::vector<Slot> m_slots GUARDED_BY(m_mutex);
+
+    /** Select the slot of dest, which must not be a CNoDestination. */
+    size_t GetSlot(const CTxDestination &dest) const {
+        CSipHasher hasher(m_k0, m_k1);
+        if (const PKHash *pkhash = boost::get<PKHash>(&dest)) {
+            hasher.Write(CashAddrType::PUBKEY_TYPE)
+                .Write(pkhash->begin(), sizeof(uint160));
+        } else {
+            const ScriptHash &script_hash = boost::get<ScriptHash>(dest);
+            hasher.Write(CashAddrType::SCRIPT_TYPE)
+                .Write(script_hash.begin(), sizeof(uint160));
+        }
+        return hasher.Finalize() % m_slots.size();
+    }
+
+public:
+    explicit AddressEncodingCache(size_t slots) : m_slots(slots) {}
+
+    std::string Encode(const CTxDestination &dest, const Config &config) {
+        const CChainParams &params = config.GetChainParams();
+        const bool cashaddr = config.UseCashAddrEncoding();
+        if (!IsValidDestination(dest)) {
+            return cashaddr ? EncodeCashAddr(dest, params)
+                            : EncodeLegacyAddr(dest, params);
+        }
+
+        const size_t index = GetSlot(dest);
+        {
+            LOCK(m_mutex);
+            const Slot &slot = m_slots[index];
+            if (slot.dest == dest && slot.cashaddr == cashaddr &&
+                slot.network == params.NetworkIDString()) {
+                return slot.address;
+            }
+        }
+
+        std::string address = cashaddr ? EncodeCashAddr(dest, params)
+                                        : EncodeLegacyAddr(dest, params);
+        LOCK(m_mutex);
+        // Assign the members one by one so the strings reuse their buffers.
+        Slot &slot = m_slots[index];
+        slot.dest = dest;
+        slot.cashaddr = cashaddr;
+        slot.network = params.NetworkIDString();
+        slot.address = address;
+        return address;
+    }
+};
+} // namespace
+
 std::string EncodeDestination(const CTxDestination &dest,
                               const Config &config) {
-    const CChainParams &params = config.GetChainParams();
-    return config.UseCashAddrEncoding() ? EncodeCashAddr(dest, params)
-                                        : EncodeLegacyAddr(dest, params);
+    static AddressEncodingCache cache(ADDRESS_ENCODING_CACHE_SLOTS);
+    return cache.Encode(dest, config);
 }
 
 CTxDestination DecodeDestination(const std::string &addr,
@@ -15,6 +15,12 @@
 class Config;
 class CChainParams;
 
+/**
+ * Number of addresses remembered by EncodeDestination, so the addresses
+ * appearing in many outputs are only encoded once.
+ */
+static constexpr size_t ADDRESS_ENCODING_CACHE_SLOTS = 1 << 12;
+
 CKey DecodeSecret(const std::string &str);
 CKey DecodeSecret(const std::string &str, const CChainParams &params);
 std::string EncodeSecret(const CKey &key);
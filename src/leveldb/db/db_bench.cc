@@ -13,6 +13,7 @@
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
+#include "util/hash.h"
 #include "util/histogram.h"
 #include "util/mutexlock.h"
 #include "util/random.h"
@@ -25,6 +26,9 @@
 //      overwrite     -- overwrite N values in random key order in async mode
 //      fillsync      -- write N/100 values in random key order in sync mode
 //      fill100K      -- write N/1000 100K values in random order in async mode
+//      fillchainstate -- write N small values under random 33 byte keys in
+//                        batches of 10000, each also deleting 5000 keys
+//                        written before, like a UTXO set being flushed
 //      deleteseq     -- delete N keys in sequential order
 //      deleterandom  -- delete N keys in random order
 //      readseq       -- read N times sequentially
@@ -39,6 +43,7 @@
 //   Meta operations:
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
+//      writestalls -- Print the counters of writes delayed by compactions
 //      sstables    -- Print sstable info
 //      heapprofile -- Dump a heap profile (if supported by this port)
 static const char* FLAGS_benchmarks =
@@ -99,6 +104,10 @@ static int FLAGS_cache_size = -1;
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
+// Maximum number of threads a compaction is split across.
+// (initialized to default value by "main")
+static int FLAGS_max_subcompactions = 0;
+
 // Bloom filter bits per key.
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
@@ -479,6 +488,11 @@ class Benchmark {
         num_ /= 1000;
         write_options_.sync = true;
         method = &Benchmark::WriteRandom;
+      } else if (name == Slice("fillchainstate")) {
+        fresh_db = true;
+        entries_per_batch_ = 10000;
+        value_size_ = 40;
+        method = &Benchmark::WriteChainstate;
       } else if (name == Slice("fill100K")) {
         fresh_db = true;
         num_ /= 1000;
@@ -522,6 +536,8 @@ class Benchmark {
         PrintStats("leveldb.stats");
       } else if (name == Slice("sstables")) {
         PrintStats("leveldb.sstables");
+      } else if (name == Slice("writestalls")) {
+        PrintStats("leveldb.write-stalls");
       } else {
         if (name != Slice()) {  // No error message for empty name
           fprintf(stderr, "unknown benchmark '%s'\n", name.ToString().c_str());
@@ -716,6 +732,7 @@ class Benchmark {
     options.max_file_size = FLAGS_max_file_size;
     options.block_size = FLAGS_block_size;
     options.max_open_files = FLAGS_open_files;
+    options.max_subcompactions = FLAGS_max_subcompactions;
     options.filter_policy = filter_policy_;
     options.reuse_logs = FLAGS_reuse_logs;
     Status s = DB::Open(options, FLAGS_db, &db_);
@@ -771,6 +788,44 @@ class Benchmark {
     thread->stats.AddBytes(bytes);
   }
 
+  // A key looking like those of the UTXO set: a prefix byte followed by a
+  // 32 bytes transaction id, derived from k.
+  static std::string ChainstateKey(int k) {
+    std::string key(1, 'C');
+    uint32_t h = k;
+    for (int i = 0; i < 8; i++) {
+      h = Hash(reinterpret_cast<const char*>(&h), sizeof(h), i);
+      key.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+    return key;
+  }
+
+  void WriteChainstate(ThreadState* thread) {
+    RandomGenerator gen;
+    WriteBatch batch;
+    Status s;
+    int64_t bytes = 0;
+    for (int i = 0; i < num_; i += entries_per_batch_) {
+      batch.Clear();
+      for (int j = 0; j < entries_per_batch_; j++) {
+        const std::string key = ChainstateKey(i + j);
+        batch.Put(key, gen.Generate(value_size_));
+        bytes += value_size_ + key.size();
+        thread->stats.FinishedSingleOp();
+      }
+      // Spend half as many coins as were created, among the older ones
+      for (int j = 0; i > 0 && j < entries_per_batch_ / 2; j++) {
+        batch.Delete(ChainstateKey(thread->rand.Next() % i));
+      }
+      s = db_->Write(write_options_, &batch);
+      if (!s.ok()) {
+        fprintf(stderr, "put error: %s\n", s.ToString().c_str());
+        exit(1);
+      }
+    }
+    thread->stats.AddBytes(bytes);
+  }
+
   void ReadSequential(ThreadState* thread) {
     Iterator* iter = db_->NewIterator(ReadOptions());
     int i = 0;
@@ -958,6 +1013,7 @@ int main(int argc, char** argv) {
   FLAGS_max_file_size = leveldb::Options().max_file_size;
   FLAGS_block_size = leveldb::Options().block_size;
   FLAGS_open_files = leveldb::Options().max_open_files;
+  FLAGS_max_subcompactions = leveldb::Options().max_subcompactions;
   std::string default_db_path;
 
   for (int i = 1; i < argc; i++) {
@@ -991,6 +1047,8 @@ int main(int argc, char** argv) {
       FLAGS_max_file_size = n;
     } else if (sscanf(argv[i], "--block_size=%d%c", &n, &junk) == 1) {
       FLAGS_block_size = n;
+    } else if (sscanf(argv[i], "--max_subcompactions=%d%c", &n, &junk) == 1) {
+      FLAGS_max_subcompactions = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
@@ -51,6 +51,12 @@ struct DBImpl::Writer {
 struct DBImpl::CompactionState {
   Compaction* const compaction;
 
+  // Range of user keys [start, end) merged by this state, which covers all
+  // the keys of the compaction unless it is split into subcompactions.
+  bool has_start, has_end;
+  std::string start, end;
+  Compaction::Cursor cursor;
+
   // Sequence numbers < smallest_snapshot are not significant since we
   // will never have to service a snapshot below smallest_snapshot.
   // Therefore if we have seen a sequence number S <= smallest_snapshot,
@@ -71,16 +77,34 @@ struct DBImpl::CompactionState {
 
   uint64_t total_bytes;
 
+  // Micros spent doing imm_ compactions while merging
+  int64_t imm_micros;
+
+  // Result of a subcompaction run on its own thread
+  Status status;
+
   Output* current_output() { return &outputs[outputs.size()-1]; }
 
   explicit CompactionState(Compaction* c)
       : compaction(c),
+        has_start(false),
+        has_end(false),
         outfile(NULL),
         builder(NULL),
-        total_bytes(0) {
+        total_bytes(0),
+        imm_micros(0) {
   }
 };
 
+// A subcompaction running on its own thread, which signals "done" once
+// "running" is decremented.
+struct DBImpl::SubcompactionThread {
+  DBImpl* db;
+  CompactionState* compact;
+  port::CondVar* done;
+  int* running;
+};
+
 // Fix user-supplied options to be reasonable
 template <class T,class V>
 static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
@@ -98,6 +122,7 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.write_buffer_size, 64<<10,                      1<<30);
   ClipToRange(&result.max_file_size,     1<<20,                       1<<30);
   ClipToRange(&result.block_size,        1<<10,                       4<<20);
+  ClipToRange(&result.max_subcompactions, 1,                          32);
   if (result.info_log == NULL) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -136,6 +161,7 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       bg_compaction_scheduled_(false),
       manual_compaction_(NULL) {
   has_imm_.Release_Store(NULL);
+  compacting_imm_.Release_Store(NULL);
 
   // Reserve ten files or so for other uses and give the rest to TableCache.
   const int table_cache_size = options_.max_open_files - kNumNonTableCacheFiles;
@@ -525,6 +551,8 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   }
 
   CompactionStats stats;
+  stats.count = 1;
+  stats.subcompactions = 1;
   stats.micros = env_->NowMicros() - start_micros;
   stats.bytes_written = meta.file_size;
   stats_[level].Add(stats);
@@ -886,7 +914,6 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
   const uint64_t start_micros = env_->NowMicros();
-  int64_t imm_micros = 0;  // Micros spent doing imm_ compactions
 
   Log(options_.info_log,  "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0),
@@ -903,31 +930,141 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = snapshots_.oldest()->number_;
   }
 
+  // Split large compactions into key ranges merged concurrently: this
+  // thread merges the first one and a thread is started for each other.
+  std::vector<std::string> boundaries;
+  compact->compaction->GetSubcompactionBoundaries(options_.max_subcompactions,
+                                                  &boundaries);
+  std::vector<CompactionState*> subcompactions;
+  for (size_t i = 0; i < boundaries.size(); i++) {
+    CompactionState* sub = new CompactionState(compact->compaction);
+    sub->smallest_snapshot = compact->smallest_snapshot;
+    sub->has_start = true;
+    sub->start = boundaries[i];
+    if (i + 1 < boundaries.size()) {
+      sub->has_end = true;
+      sub->end = boundaries[i + 1];
+    }
+    subcompactions.push_back(sub);
+  }
+  if (!boundaries.empty()) {
+    compact->has_end = true;
+    compact->end = boundaries[0];
+    Log(options_.info_log, "Compaction split into %d subcompactions",
+        static_cast<int>(boundaries.size() + 1));
+  }
+
+  port::CondVar subcompactions_done(&mutex_);
+  int subcompactions_running = subcompactions.size();
+  std::vector<SubcompactionThread> threads(subcompactions.size());
+  for (size_t i = 0; i < subcompactions.size(); i++) {
+    threads[i].db = this;
+    threads[i].compact = subcompactions[i];
+    threads[i].done = &subcompactions_done;
+    threads[i].running = &subcompactions_running;
+    env_->StartThread(&DBImpl::BGSubcompactionWork, &threads[i]);
+  }
+
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
+  Status status = DoSubcompactionWork(compact);
+  mutex_.Lock();
+
+  while (subcompactions_running > 0) {
+    subcompactions_done.Wait();
+  }
+
+  // Gather the outputs in key order, and report the first error.
+  int64_t imm_micros = compact->imm_micros;
+  for (size_t i = 0; i < subcompactions.size(); i++) {
+    CompactionState* sub = subcompactions[i];
+    if (status.ok()) {
+      status = sub->status;
+    }
+    imm_micros += sub->imm_micros;
+    compact->outputs.insert(compact->outputs.end(), sub->outputs.begin(),
+                            sub->outputs.end());
+    compact->total_bytes += sub->total_bytes;
+    // The outputs stay pending until the parent state is cleaned up
+    sub->outputs.clear();
+    CleanupCompaction(sub);
+  }
+
+  CompactionStats stats;
+  stats.count = 1;
+  stats.subcompactions = subcompactions.size() + 1;
+  stats.micros = env_->NowMicros() - start_micros - imm_micros;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+  for (size_t i = 0; i < compact->outputs.size(); i++) {
+    stats.bytes_written += compact->outputs[i].file_size;
+  }
+
+  stats_[compact->compaction->level() + 1].Add(stats);
 
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log,
+      "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+void DBImpl::BGSubcompactionWork(void* arg) {
+  SubcompactionThread* thread = reinterpret_cast<SubcompactionThread*>(arg);
+  DBImpl* db = thread->db;
+  thread->compact->status = db->DoSubcompactionWork(thread->compact);
+
+  MutexLock l(&db->mutex_);
+  --*thread->running;
+  thread->done->SignalAll();
+}
+
+Status DBImpl::DoSubcompactionWork(CompactionState* compact) {
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
-  input->SeekToFirst();
+  if (compact->has_start) {
+    InternalKey start(compact->start, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  } else {
+    input->SeekToFirst();
+  }
   Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
   for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
-    // Prioritize immutable compaction work
-    if (has_imm_.NoBarrier_Load() != NULL) {
+    // Prioritize immutable compaction work, unless another subcompaction
+    // is already at it
+    if (has_imm_.NoBarrier_Load() != NULL &&
+        compacting_imm_.NoBarrier_Load() == NULL) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != NULL) {
+      if (imm_ != NULL && compacting_imm_.NoBarrier_Load() == NULL) {
+        compacting_imm_.Release_Store(this);
         CompactMemTable();
+        compacting_imm_.Release_Store(NULL);
         bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
       }
       mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start);
+      compact->imm_micros += (env_->NowMicros() - imm_start);
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
+    if (compact->has_end && key.size() >= 8 &&
+        user_comparator()->Compare(ExtractUserKey(key), compact->end) >= 0) {
+      // The rest belongs to the next subcompaction
+      break;
+    }
+
+    if (compact->compaction->ShouldStopBefore(key, &compact->cursor) &&
         compact->builder != NULL) {
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
@@ -957,7 +1094,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         drop = true;    // (A)
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
-                 compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+                 compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                                        &compact->cursor)) {
         // For this user key:
         // (1) there is no data in higher levels
         // (2) data in lower levels will have larger sequence numbers
@@ -976,7 +1114,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         "%d smallest_snapshot: %d",
         ikey.user_key.ToString().c_str(),
         (int)ikey.sequence, ikey.type, kTypeValue, drop,
-        compact->compaction->IsBaseLevelForKey(ikey.user_key),
+        compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                               &compact->cursor),
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
@@ -1017,31 +1156,6 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     status = input->status();
   }
   delete input;
-  input = NULL;
-
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
-  }
-
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
-
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
-  }
-  if (!status.ok()) {
-    RecordBackgroundError(status);
-  }
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log,
-      "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
@@ -1334,10 +1448,13 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // individual write by 1ms to reduce latency variance.  Also,
       // this delay hands over some CPU to the compaction thread in
       // case it is sharing the same core as the writer.
+      const uint64_t stall_start = env_->NowMicros();
       mutex_.Unlock();
       env_->SleepForMicroseconds(1000);
       allow_delay = false;  // Do not delay a single write more than once
       mutex_.Lock();
+      stall_stats_.slowdowns++;
+      stall_stats_.slowdown_micros += env_->NowMicros() - stall_start;
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
@@ -1346,11 +1463,17 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // We have filled up the current memtable, but the previous
       // one is still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
+      const uint64_t stall_start = env_->NowMicros();
       bg_cv_.Wait();
+      stall_stats_.memtable_waits++;
+      stall_stats_.memtable_wait_micros += env_->NowMicros() - stall_start;
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
+      const uint64_t stall_start = env_->NowMicros();
       bg_cv_.Wait();
+      stall_stats_.level0_waits++;
+      stall_stats_.level0_wait_micros += env_->NowMicros() - stall_start;
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1424,6 +1547,32 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
       }
     }
     return true;
+  } else if (in == "compaction-stats") {
+    char buf[200];
+    for (int level = 0; level < config::kNumLevels; level++) {
+      snprintf(buf, sizeof(buf), "%d %d %lld %lld %lld %lld %lld %lld\n",
+               level,
+               versions_->NumLevelFiles(level),
+               static_cast<long long>(versions_->NumLevelBytes(level)),
+               static_cast<long long>(stats_[level].count),
+               static_cast<long long>(stats_[level].subcompactions),
+               static_cast<long long>(stats_[level].micros),
+               static_cast<long long>(stats_[level].bytes_read),
+               static_cast<long long>(stats_[level].bytes_written));
+      value->append(buf);
+    }
+    return true;
+  } else if (in == "write-stalls") {
+    char buf[200];
+    snprintf(buf, sizeof(buf), "%lld %lld %lld %lld %lld %lld",
+             static_cast<long long>(stall_stats_.slowdowns),
+             static_cast<long long>(stall_stats_.slowdown_micros),
+             static_cast<long long>(stall_stats_.memtable_waits),
+             static_cast<long long>(stall_stats_.memtable_wait_micros),
+             static_cast<long long>(stall_stats_.level0_waits),
+             static_cast<long long>(stall_stats_.level0_wait_micros));
+    value->append(buf);
+    return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
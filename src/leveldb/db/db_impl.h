@@ -67,6 +67,7 @@ class DBImpl : public DB {
  private:
   friend class DB;
   struct CompactionState;
+  struct SubcompactionThread;
   struct Writer;
 
   Iterator* NewInternalIterator(const ReadOptions&,
@@ -112,6 +113,10 @@ class DBImpl : public DB {
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Merge the inputs of the compaction in the key range of *compact.
+  // REQUIRES: mutex_ is not held
+  Status DoSubcompactionWork(CompactionState* compact);
+  static void BGSubcompactionWork(void* thread);
 
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
@@ -140,6 +145,9 @@ class DBImpl : public DB {
   MemTable* mem_;
   MemTable* imm_;                // Memtable being compacted
   port::AtomicPointer has_imm_;  // So bg thread can detect non-NULL imm_
+  // Non-NULL while a subcompaction thread compacts imm_, so the others
+  // leave it alone
+  port::AtomicPointer compacting_imm_;
   WritableFile* logfile_;
   uint64_t logfile_number_;
   log::Writer* log_;
@@ -176,13 +184,19 @@ class DBImpl : public DB {
   // Per level compaction stats.  stats_[level] stores the stats for
   // compactions that produced data for the specified "level".
   struct CompactionStats {
+    int64_t count;
+    int64_t subcompactions;
     int64_t micros;
     int64_t bytes_read;
     int64_t bytes_written;
 
-    CompactionStats() : micros(0), bytes_read(0), bytes_written(0) { }
+    CompactionStats()
+        : count(0), subcompactions(0), micros(0), bytes_read(0),
+          bytes_written(0) { }
 
     void Add(const CompactionStats& c) {
+      this->count += c.count;
+      this->subcompactions += c.subcompactions;
       this->micros += c.micros;
       this->bytes_read += c.bytes_read;
       this->bytes_written += c.bytes_written;
@@ -190,6 +204,22 @@ class DBImpl : public DB {
   };
   CompactionStats stats_[config::kNumLevels];
 
+  // Writes delayed or blocked by MakeRoomForWrite() until compactions
+  // catch up.
+  struct WriteStallStats {
+    int64_t slowdowns;
+    int64_t slowdown_micros;
+    int64_t memtable_waits;
+    int64_t memtable_wait_micros;
+    int64_t level0_waits;
+    int64_t level0_wait_micros;
+
+    WriteStallStats()
+        : slowdowns(0), slowdown_micros(0), memtable_waits(0),
+          memtable_wait_micros(0), level0_waits(0), level0_wait_micros(0) { }
+  };
+  WriteStallStats stall_stats_;
+
   // No copying allowed
   DBImpl(const DBImpl&);
   void operator=(const DBImpl&);
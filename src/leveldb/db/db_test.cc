@@ -1006,6 +1006,68 @@ TEST(DBTest, CompactionsGenerateMultipleFiles) {
   }
 }
 
+TEST(DBTest, Subcompactions) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000000;        // Large write buffer
+  options.max_subcompactions = 4;
+  Reopen(&options);
+
+  Random rnd(301);
+
+  // Write 8MB (80 values, each 100K) and compact them into several level-1
+  // files, whose boundaries are used to split the next compaction.
+  std::vector<std::string> values;
+  for (int i = 0; i < 80; i++) {
+    values.push_back(RandomString(&rnd, 100000));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  Reopen(&options);
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_GT(NumTableFilesAtLevel(1), 1);
+
+  // Overwrite or delete some keys across the range and merge them in.
+  for (int i = 0; i < 80; i += 3) {
+    values[i] = RandomString(&rnd, 100000);
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  for (int i = 1; i < 80; i += 7) {
+    values[i] = "NOT_FOUND";
+    ASSERT_OK(Delete(Key(i)));
+  }
+  Reopen(&options);
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+
+  ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+  for (int i = 0; i < 80; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  delete iter;
+  ASSERT_EQ(count, 80 - 12);
+
+  // Since the last reopening, level-1 was produced by one split compaction.
+  std::string stats;
+  ASSERT_TRUE(db_->GetProperty("leveldb.compaction-stats", &stats));
+  int level, files;
+  long long bytes, compactions, subcompactions;
+  const char* line = strchr(stats.c_str(), '\n') + 1;
+  ASSERT_EQ(5, sscanf(line, "%d %d %lld %lld %lld", &level, &files, &bytes,
+                      &compactions, &subcompactions));
+  ASSERT_EQ(1, level);
+  ASSERT_EQ(1, compactions);
+  ASSERT_GT(subcompactions, 2);
+
+  ASSERT_TRUE(db_->GetProperty("leveldb.write-stalls", &stats));
+  long long stalls[6];
+  ASSERT_EQ(6, sscanf(stats.c_str(), "%lld %lld %lld %lld %lld %lld",
+                      &stalls[0], &stalls[1], &stalls[2], &stalls[3],
+                      &stalls[4], &stalls[5]));
+}
+
 TEST(DBTest, RepeatedWritesToSameKey) {
   Options options = CurrentOptions();
   options.env = env_;
@@ -1448,12 +1448,15 @@ Compaction* VersionSet::CompactRange(
 Compaction::Compaction(const Options* options, int level)
     : level_(level),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
-      input_version_(NULL),
-      grandparent_index_(0),
-      seen_key_(false),
-      overlapped_bytes_(0) {
+      input_version_(NULL) {
+}
+
+Compaction::Cursor::Cursor()
+    : grandparent_index(0),
+      seen_key(false),
+      overlapped_bytes(0) {
   for (int i = 0; i < config::kNumLevels; i++) {
-    level_ptrs_[i] = 0;
+    level_ptrs[i] = 0;
   }
 }
 
@@ -1481,13 +1484,15 @@ void Compaction::AddInputDeletions(VersionEdit* edit) {
   }
 }
 
-bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
+bool Compaction::IsBaseLevelForKey(const Slice& user_key,
+                                   Cursor* cursor) const {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
   for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-    for (; level_ptrs_[lvl] < files.size(); ) {
-      FileMetaData* f = files[level_ptrs_[lvl]];
+    size_t& level_ptr = cursor->level_ptrs[lvl];
+    for (; level_ptr < files.size(); ) {
+      FileMetaData* f = files[level_ptr];
       if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
         // We've advanced far enough
         if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
@@ -1496,35 +1501,87 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
         }
         break;
       }
-      level_ptrs_[lvl]++;
+      level_ptr++;
     }
   }
   return true;
 }
 
-bool Compaction::ShouldStopBefore(const Slice& internal_key) {
+bool Compaction::ShouldStopBefore(const Slice& internal_key,
+                                  Cursor* cursor) const {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
   const InternalKeyComparator* icmp = &vset->icmp_;
-  while (grandparent_index_ < grandparents_.size() &&
+  while (cursor->grandparent_index < grandparents_.size() &&
       icmp->Compare(internal_key,
-                    grandparents_[grandparent_index_]->largest.Encode()) > 0) {
-    if (seen_key_) {
-      overlapped_bytes_ += grandparents_[grandparent_index_]->file_size;
+                    grandparents_[cursor->grandparent_index]->largest.Encode())
+          > 0) {
+    if (cursor->seen_key) {
+      cursor->overlapped_bytes +=
+          grandparents_[cursor->grandparent_index]->file_size;
     }
-    grandparent_index_++;
+    cursor->grandparent_index++;
   }
-  seen_key_ = true;
+  cursor->seen_key = true;
 
-  if (overlapped_bytes_ > MaxGrandParentOverlapBytes(vset->options_)) {
+  if (cursor->overlapped_bytes > MaxGrandParentOverlapBytes(vset->options_)) {
     // Too much overlap for current output; start new output
-    overlapped_bytes_ = 0;
+    cursor->overlapped_bytes = 0;
     return true;
   } else {
     return false;
   }
 }
 
+void Compaction::GetSubcompactionBoundaries(
+    int max_parts, std::vector<std::string>* boundaries) const {
+  boundaries->clear();
+
+  // Account for the data of each input file at its largest key.  Files of
+  // level-0 may overlap, which only makes the split less even.
+  struct FileEnd {
+    Slice user_key;
+    uint64_t file_size;
+  };
+  std::vector<FileEnd> ends;
+  uint64_t total_bytes = 0;
+  for (int which = 0; which < 2; which++) {
+    for (size_t i = 0; i < inputs_[which].size(); i++) {
+      FileEnd end;
+      end.user_key = inputs_[which][i]->largest.user_key();
+      end.file_size = inputs_[which][i]->file_size;
+      ends.push_back(end);
+      total_bytes += end.file_size;
+    }
+  }
+
+  const uint64_t parts = std::min<uint64_t>(
+      max_parts > 0 ? max_parts : 1, total_bytes / max_output_file_size_);
+  if (parts <= 1) {
+    return;
+  }
+
+  const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+  std::sort(ends.begin(), ends.end(),
+            [user_cmp](const FileEnd& a, const FileEnd& b) {
+              return user_cmp->Compare(a.user_key, b.user_key) < 0;
+            });
+
+  // Start a new range after each multiple of total_bytes / parts, unless
+  // that would leave the last range empty.
+  uint64_t bytes = 0;
+  for (size_t i = 0; i + 1 < ends.size() && boundaries->size() + 1 < parts;
+       i++) {
+    bytes += ends[i].file_size;
+    if (bytes * parts >= total_bytes * (boundaries->size() + 1) &&
+        user_cmp->Compare(ends[i].user_key, ends.back().user_key) < 0 &&
+        (boundaries->empty() ||
+         user_cmp->Compare(ends[i].user_key, boundaries->back()) > 0)) {
+      boundaries->push_back(ends[i].user_key.ToString());
+    }
+  }
+}
+
 void Compaction::ReleaseInputs() {
   if (input_version_ != NULL) {
     input_version_->Unref();
@@ -117,6 +117,16 @@ class DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.compaction-stats" - returns one line per level holding, as
+  //     space separated decimal numbers: the level, its number of files and
+  //     bytes, then for the compactions that produced data in that level
+  //     their number, their number of subcompactions, the time they took in
+  //     microseconds and the bytes they read and wrote.
+  //  "leveldb.write-stalls" - returns, as space separated decimal numbers,
+  //     the number of writes delayed by 1ms because of level-0 files and the
+  //     time spent doing so in microseconds, then the number and duration of
+  //     the waits for the memtable to be compacted, then the number and
+  //     duration of the waits for level-0 files to be compacted.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -140,6 +140,14 @@ struct Options {
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression;
 
+  // Maximum number of threads a single compaction is split across.  The
+  // key range of a large compaction is divided into up to this many
+  // disjoint parts, merged concurrently into their own output files.
+  // Shorter compactions drain level-0 sooner and so stall writes less.
+  //
+  // Default: 1
+  int max_subcompactions;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
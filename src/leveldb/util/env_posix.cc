@@ -678,6 +678,9 @@ void PosixEnv::StartThread(void (*function)(void* arg), void* arg) {
   state->arg = arg;
   PthreadCall("start thread",
               pthread_create(&t, NULL,  &StartThreadWrapper, state));
+  // Nothing joins these threads, so have their resources released when
+  // they exit (compactions may start many of them).
+  PthreadCall("detach thread", pthread_detach(t));
 }
 
 }  // namespace
@@ -10,6 +10,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <deque>
 #include <map>
 #include <memory>
 #include <set>
@@ -108,6 +109,16 @@ static inline size_t DynamicUsage(const std::vector<X> &v) {
     return MallocUsage(v.capacity() * sizeof(X));
 }
 
+template <typename X>
+static inline size_t DynamicUsage(const std::deque<X> &d) {
+    // The elements are stored in blocks of 512 bytes, or of one element if
+    // it is larger, which are indexed by an array of pointers.
+    const size_t block_elements = sizeof(X) < 512 ? 512 / sizeof(X) : 1;
+    const size_t blocks = d.size() / block_elements + 1;
+    return MallocUsage(block_elements * sizeof(X)) * blocks +
+           MallocUsage(sizeof(void *) * (blocks + 2));
+}
+
 template <unsigned int N, typename X, typename S, typename D>
 static inline size_t DynamicUsage(const prevector<N, X, S, D> &v) {
     return MallocUsage(v.allocated_memory());
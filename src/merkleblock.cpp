@@ -24,7 +24,17 @@ std::vector<bool> BytesToBits(const std::vector<uint8_t> &bytes) {
     return ret;
 }
 
+std::vector<CBloomTxElements> GetBlockBloomElements(const CBlock &block) {
+    std::vector<CBloomTxElements> elements;
+    elements.reserve(block.vtx.size());
+    for (const auto &tx : block.vtx) {
+        elements.emplace_back(*tx);
+    }
+    return elements;
+}
+
 CMerkleBlock::CMerkleBlock(const CBlock &block, CBloomFilter *filter,
+                           const std::vector<CBloomTxElements> &elements,
                            const std::set<TxId> *txids) {
     header = block.GetBlockHeader();
 
@@ -35,8 +45,10 @@ CMerkleBlock::CMerkleBlock(const CBlock &block, CBloomFilter *filter,
     vHashes.reserve(block.vtx.size());
 
     if (filter) {
-        for (const auto &tx : block.vtx) {
-            vMatch.push_back(filter->MatchAndInsertOutputs(*tx));
+        assert(elements.size() == block.vtx.size());
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            vMatch.push_back(
+                filter->MatchAndInsertOutputs(*block.vtx[i], elements[i]));
         }
     }
 
@@ -45,7 +57,7 @@ CMerkleBlock::CMerkleBlock(const CBlock &block, CBloomFilter *filter,
         const TxId &txid = tx->GetId();
         if (filter) {
             if (!vMatch[i]) {
-                vMatch[i] = filter->MatchInputs(*tx);
+                vMatch[i] = filter->MatchInputs(elements[i]);
             }
             if (vMatch[i]) {
                 vMatchedTxn.push_back(std::make_pair(i, txid));
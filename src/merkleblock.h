@@ -132,6 +132,9 @@ public:
     uint32_t GetNumTransactions() const { return nTransactions; };
 };
 
+/** The bloom filter elements of each transaction of a block. */
+std::vector<CBloomTxElements> GetBlockBloomElements(const CBlock &block);
+
 /**
  * Used to create a Merkle proof (usually from a subset of transactions),
  * which consists of a block header and partial Merkle Tree.
@@ -164,13 +167,24 @@ public:
      * transaction, thus the filter will likely be modified.
      */
     CMerkleBlock(const CBlock &block, CBloomFilter &filter)
-        : CMerkleBlock(block, &filter, nullptr) {}
+        : CMerkleBlock(block, &filter, GetBlockBloomElements(block), nullptr) {
+    }
+
+    /**
+     * Create a Merkle proof according to a bloom filter, reusing the elements
+     * of the transactions of the block as returned by GetBlockBloomElements.
+     * This saves extracting them again when serving the block to many
+     * filtered peers.
+     */
+    CMerkleBlock(const CBlock &block, CBloomFilter &filter,
+                 const std::vector<CBloomTxElements> &elements)
+        : CMerkleBlock(block, &filter, elements, nullptr) {}
 
     /**
      * Create a Merkle proof for a set of transactions.
      */
     CMerkleBlock(const CBlock &block, const std::set<TxId> &txids)
-        : CMerkleBlock(block, nullptr, &txids) {}
+        : CMerkleBlock(block, nullptr, {}, &txids) {}
 
     CMerkleBlock() {}
 
@@ -182,6 +196,7 @@ private:
      * or txids may be provided.
      */
     CMerkleBlock(const CBlock &block, CBloomFilter *filter,
+                 const std::vector<CBloomTxElements> &elements,
                  const std::set<TxId> *txids);
 };
 
@@ -15,6 +15,8 @@
 #include <compat.h>
 #include <config.h>
 #include <consensus/consensus.h>
+#include <crypto/hkdf_sha256_32.h>
+#include <crypto/poly1305.h>
 #include <crypto/sha256.h>
 #include <dnsseeds.h>
 #include <i2p.h>
@@ -24,6 +26,7 @@
 #include <protocol.h>
 #include <random.h>
 #include <scheduler.h>
+#include <support/cleanse.h>
 #include <util/sock.h>
 #include <util/strencodings.h>
 #include <util/translation.h>
@@ -631,6 +634,7 @@ void CNode::copyStats(CNodeStats &stats) {
         LOCK(cs_vSend);
         stats.mapSendBytesPerMsgCmd = mapSendBytesPerMsgCmd;
         stats.nSendBytes = nSendBytes;
+        stats.m_v2_transport = m_v2_state == V2State::ESTABLISHED;
     }
     {
         LOCK(cs_vRecv);
@@ -691,6 +695,19 @@ bool CNode::ReceiveMsgBytes(const Config &config, Span<const uint8_t> msg_bytes,
             assert(i != mapRecvBytesPerMsgCmd.end());
             i->second += msg.m_raw_message_size;
 
+            // The transports change right after the messages of the
+            // encrypted transport handshake, so they are handled here rather
+            // than queued.
+            if ((nLocalServices & NODE_P2P_V2) && msg.m_valid_netmagic &&
+                msg.m_valid_header && msg.m_valid_checksum &&
+                (msg.m_command == NetMsgType::ENCINIT ||
+                 msg.m_command == NetMsgType::ENCACK)) {
+                if (!ProcessV2Handshake(config, msg)) {
+                    return false;
+                }
+                continue;
+            }
+
             // push the message to the process queue,
             vRecvMsg.push_back(std::move(msg));
 
@@ -701,6 +718,66 @@ bool CNode::ReceiveMsgBytes(const Config &config, Span<const uint8_t> msg_bytes,
     return true;
 }
 
+static CSerializedNetMsg MakeV2HandshakeMessage(std::string type,
+                                                Span<const uint8_t> payload) {
+    CSerializedNetMsg msg;
+    msg.m_type = std::move(type);
+    msg.data.assign(payload.begin(), payload.end());
+    return msg;
+}
+
+bool CNode::ProcessV2Handshake(const Config &config, const CNetMessage &msg) {
+    const CMessageHeader::MessageMagic &magic =
+        config.GetChainParams().NetMagic();
+    const Span<const uint8_t> payload = MakeUCharSpan(msg.m_recv);
+
+    LOCK(cs_vSend);
+    if (msg.m_command == NetMsgType::ENCINIT && IsInboundConn() &&
+        m_v2_state == V2State::NONE) {
+        auto handshake = std::make_unique<V2Handshake>(/* initiator */ false);
+        if (!handshake->Derive(payload, magic)) {
+            LogPrint(BCLog::NET, "invalid encinit key, disconnecting peer=%d\n",
+                     id);
+            return false;
+        }
+        // We encrypt everything we send after our encack
+        const CPubKey pubkey = handshake->GetPubKey();
+        QueueMessage(config,
+                     MakeV2HandshakeMessage(NetMsgType::ENCACK,
+                                            {pubkey.data(), pubkey.size()}));
+        m_serializer = handshake->MakeSerializer();
+        m_v2_handshake = std::move(handshake);
+        m_v2_state = V2State::ACK_SENT;
+        return true;
+    }
+
+    if (msg.m_command == NetMsgType::ENCACK &&
+        m_v2_state == V2State::INIT_SENT) {
+        if (!m_v2_handshake->Derive(payload, magic)) {
+            LogPrint(BCLog::NET, "invalid encack key, disconnecting peer=%d\n",
+                     id);
+            return false;
+        }
+        // The peer encrypts everything it sends after its encack, and so do we
+        // after ours
+        m_deserializer = m_v2_handshake->MakeDeserializer();
+        QueueMessage(config, MakeV2HandshakeMessage(NetMsgType::ENCACK, {}));
+        m_serializer = m_v2_handshake->MakeSerializer();
+    } else if (msg.m_command == NetMsgType::ENCACK &&
+               m_v2_state == V2State::ACK_SENT && payload.empty()) {
+        m_deserializer = m_v2_handshake->MakeDeserializer();
+    } else {
+        LogPrint(BCLog::NET, "unexpected %s message, disconnecting peer=%d\n",
+                 SanitizeString(msg.m_command), id);
+        return false;
+    }
+
+    m_v2_handshake.reset();
+    m_v2_state = V2State::ESTABLISHED;
+    LogPrint(BCLog::NET, "encrypted transport established with peer=%d\n", id);
+    return true;
+}
+
 int V1TransportDeserializer::readHeader(const Config &config,
                                         Span<const uint8_t> msg_bytes) {
     // copy data to temporary parsing buffer
@@ -731,6 +808,11 @@ int V1TransportDeserializer::readHeader(const Config &config,
     // switch state to reading message data
     in_data = true;
 
+    // an empty message is complete as soon as its header is
+    if (Complete()) {
+        VerifyChecksum();
+    }
+
     return nCopy;
 }
 
@@ -738,30 +820,41 @@ int V1TransportDeserializer::readData(Span<const uint8_t> msg_bytes) {
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
     unsigned int nCopy = std::min<unsigned int>(nRemaining, msg_bytes.size());
 
-    if (vRecv.size() < nDataPos + nCopy) {
-        // Allocate up to 256 KiB ahead, but never more than the total message
-        // size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+    if (vRecv.capacity() < nDataPos + nCopy) {
+        // Grow geometrically, so a large message is not copied (and the
+        // previous buffer cleansed) once per 256 KiB, but allocate no more
+        // than twice what was received plus 256 KiB, and never more than the
+        // total message size.
+        vRecv.reserve(std::min<size_t>(
+            hdr.nMessageSize,
+            std::max<size_t>(2 * nDataPos, nDataPos + nCopy + 256 * 1024)));
     }
 
+    // Append without zero filling the buffer first.
     hasher.Write(msg_bytes.first(nCopy));
-    memcpy(&vRecv[nDataPos], msg_bytes.data(), nCopy);
+    vRecv.write(reinterpret_cast<const char *>(msg_bytes.data()), nCopy);
     nDataPos += nCopy;
 
+    if (Complete()) {
+        VerifyChecksum();
+    }
+
     return nCopy;
 }
 
-const uint256 &V1TransportDeserializer::GetMessageHash() const {
-    assert(Complete());
-    if (data_hash.IsNull()) {
-        hasher.Finalize(data_hash);
-    }
-    return data_hash;
+void V1TransportDeserializer::VerifyChecksum() {
+    // The last byte arrived: finish the hash now so the message is ready to be
+    // processed with its checksum already verified.
+    hasher.Finalize(data_hash);
+    valid_checksum = (memcmp(data_hash.begin(), hdr.pchChecksum,
+                             CMessageHeader::CHECKSUM_SIZE) == 0);
 }
 
 CNetMessage
 V1TransportDeserializer::GetMessage(const Config &config,
                                     const std::chrono::microseconds time) {
+    assert(Complete());
+
     // decompose a single CNetMessage from the TransportDeserializer
     CNetMessage msg(std::move(vRecv));
 
@@ -773,7 +866,6 @@ V1TransportDeserializer::GetMessage(const Config &config,
         (memcmp(std::begin(hdr.pchMessageStart),
                 std::begin(config.GetChainParams().NetMagic()),
                 CMessageHeader::MESSAGE_START_SIZE) == 0);
-    uint256 hash = GetMessageHash();
 
     // store command string, payload size
     msg.m_command = hdr.GetCommand();
@@ -782,18 +874,18 @@ V1TransportDeserializer::GetMessage(const Config &config,
 
     // We just received a message off the wire, harvest entropy from the time
     // (and the message checksum)
-    RandAddEvent(ReadLE32(hash.begin()));
+    RandAddEvent(ReadLE32(data_hash.begin()));
 
-    msg.m_valid_checksum = (memcmp(hash.begin(), hdr.pchChecksum,
-                                   CMessageHeader::CHECKSUM_SIZE) == 0);
+    msg.m_valid_checksum = valid_checksum;
 
     if (!msg.m_valid_checksum) {
-        LogPrint(
-            BCLog::NET, "CHECKSUM ERROR (%s, %u bytes), expected %s was %s\n",
-            SanitizeString(msg.m_command), msg.m_message_size,
-            HexStr(Span<uint8_t>(hash.begin(),
-                                 hash.begin() + CMessageHeader::CHECKSUM_SIZE)),
-            HexStr(hdr.pchChecksum));
+        LogPrint(BCLog::NET,
+                 "CHECKSUM ERROR (%s, %u bytes), expected %s was %s\n",
+                 SanitizeString(msg.m_command), msg.m_message_size,
+                 HexStr(Span<uint8_t>(data_hash.begin(),
+                                      data_hash.begin() +
+                                          CMessageHeader::CHECKSUM_SIZE)),
+                 HexStr(hdr.pchChecksum));
     }
 
     // store receive time
@@ -820,6 +912,264 @@ void V1TransportSerializer::prepareForTransport(const Config &config,
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, header, 0, hdr};
 }
 
+/** Move to the AEAD sequence numbers of the next V2 packet. */
+static void NextV2Packet(uint64_t &payload_seqnr, uint64_t &aad_seqnr,
+                         int &aad_pos) {
+    payload_seqnr++;
+    aad_pos += CHACHA20_POLY1305_AEAD_AAD_LEN;
+    if (aad_pos + CHACHA20_POLY1305_AEAD_AAD_LEN > CHACHA20_ROUND_OUTPUT) {
+        aad_pos = 0;
+        aad_seqnr++;
+    }
+}
+
+int V2TransportDeserializer::readHeader(const Config &config,
+                                        Span<const uint8_t> msg_bytes) {
+    // copy the encrypted payload length
+    uint32_t nRemaining = CHACHA20_POLY1305_AEAD_AAD_LEN - m_packet_pos;
+    uint32_t nCopy = std::min<unsigned int>(nRemaining, msg_bytes.size());
+
+    vRecv.resize(m_packet_start + CHACHA20_POLY1305_AEAD_AAD_LEN);
+    memcpy(&vRecv[m_packet_start + m_packet_pos], msg_bytes.data(), nCopy);
+    m_packet_pos += nCopy;
+
+    // if length incomplete, exit
+    if (m_packet_pos < CHACHA20_POLY1305_AEAD_AAD_LEN) {
+        return nCopy;
+    }
+
+    m_aead.GetLength(&m_packet_length, m_aad_seqnr, m_aad_pos,
+                     reinterpret_cast<const uint8_t *>(&vRecv[m_packet_start]));
+
+    // The payload holds at least the command length
+    if (m_packet_length == 0) {
+        LogPrint(BCLog::NET, "Empty V2 packet detected\n");
+        return -1;
+    }
+
+    // Reject messages larger than any command allows, the command specific
+    // limit is checked once the message is complete.
+    if (uint64_t(m_packet_start) + m_packet_length >
+        2 * config.GetMaxBlockSize()) {
+        LogPrint(BCLog::NET, "Oversized V2 message detected\n");
+        return -1;
+    }
+
+    // switch state to reading the payload and MAC
+    in_data = true;
+
+    return nCopy;
+}
+
+int V2TransportDeserializer::readData(Span<const uint8_t> msg_bytes) {
+    const uint32_t packet_size = CHACHA20_POLY1305_AEAD_AAD_LEN +
+                                 m_packet_length + POLY1305_TAGLEN;
+    unsigned int nRemaining = packet_size - m_packet_pos;
+    unsigned int nCopy = std::min<unsigned int>(nRemaining, msg_bytes.size());
+
+    const uint32_t packet_end = m_packet_start + m_packet_pos + nCopy;
+    if (vRecv.size() < packet_end) {
+        // Allocate up to 256 KiB ahead, but never more than the total packet
+        // size.
+        vRecv.resize(
+            std::min(m_packet_start + packet_size, packet_end + 256 * 1024));
+    }
+
+    memcpy(&vRecv[m_packet_start + m_packet_pos], msg_bytes.data(), nCopy);
+    m_packet_pos += nCopy;
+
+    if (m_packet_pos == packet_size && !processPacket()) {
+        return -1;
+    }
+    return nCopy;
+}
+
+bool V2TransportDeserializer::processPacket() {
+    uint8_t *packet = reinterpret_cast<uint8_t *>(&vRecv[m_packet_start]);
+    const uint32_t payload_end =
+        CHACHA20_POLY1305_AEAD_AAD_LEN + m_packet_length;
+
+    // check the MAC, then decrypt the packet in place
+    if (!m_aead.Crypt(m_payload_seqnr, m_aad_seqnr, m_aad_pos, packet,
+                      payload_end, packet, payload_end + POLY1305_TAGLEN,
+                      false)) {
+        LogPrint(BCLog::NET, "V2 packet MAC mismatch\n");
+        return false;
+    }
+    NextV2Packet(m_payload_seqnr, m_aad_seqnr, m_aad_pos);
+
+    // We just received a packet off the wire, harvest entropy from the time
+    // (and the MAC)
+    RandAddEvent(ReadLE32(packet + payload_end));
+
+    const uint8_t flags = packet[CHACHA20_POLY1305_AEAD_AAD_LEN];
+    const uint32_t command_length = flags & ~V2_PACKET_CONTINUED;
+    // The command comes with the first packet of the message, and only with it
+    const bool valid_command_length =
+        m_command.empty()
+            ? command_length > 0 &&
+                  command_length <= CMessageHeader::COMMAND_SIZE &&
+                  command_length < m_packet_length
+            : command_length == 0;
+    if (!valid_command_length) {
+        LogPrint(BCLog::NET, "Invalid V2 packet command length %u\n",
+                 command_length);
+        return false;
+    }
+    const uint32_t data_start = CHACHA20_POLY1305_AEAD_AAD_LEN + 1;
+    m_command.append(reinterpret_cast<const char *>(packet + data_start),
+                     command_length);
+
+    // keep the message data only
+    vRecv.resize(m_packet_start + payload_end);
+    vRecv.erase(vRecv.begin() + m_packet_start,
+                vRecv.begin() + m_packet_start + data_start + command_length);
+
+    m_raw_size += payload_end + POLY1305_TAGLEN;
+    m_packet_start = vRecv.size();
+    m_packet_pos = 0;
+    in_data = false;
+    m_complete = !(flags & V2_PACKET_CONTINUED);
+    return true;
+}
+
+CNetMessage
+V2TransportDeserializer::GetMessage(const Config &config,
+                                    const std::chrono::microseconds time) {
+    assert(Complete());
+
+    // decompose a single CNetMessage from the TransportDeserializer
+    CNetMessage msg(std::move(vRecv));
+
+    // The MAC authenticated the message, which has no netmagic. Check the
+    // command and the size as for a V1 header.
+    CMessageHeader hdr(config.GetChainParams().NetMagic(), m_command.c_str(),
+                       msg.m_recv.size());
+    msg.m_valid_netmagic = true;
+    msg.m_valid_header = hdr.IsValid(config);
+    msg.m_valid_checksum = true;
+
+    // store command string, payload size
+    msg.m_command = hdr.GetCommand();
+    msg.m_message_size = msg.m_recv.size();
+    msg.m_raw_message_size = m_raw_size;
+
+    // store receive time
+    msg.m_time = time;
+
+    // reset the network deserializer (prepare for the next message)
+    Reset();
+    return msg;
+}
+
+void V2TransportSerializer::prepareForTransport(const Config &config,
+                                                CSerializedNetMsg &msg,
+                                                std::vector<uint8_t> &header) {
+    const uint32_t command_length = msg.m_type.size();
+    assert(command_length > 0 &&
+           command_length <= CMessageHeader::COMMAND_SIZE);
+
+    const size_t n_packets = 1 + msg.data.size() / (V2_MAX_PACKET_PAYLOAD - 1);
+    std::vector<uint8_t> packets;
+    packets.reserve(msg.data.size() + command_length +
+                    n_packets * (CHACHA20_POLY1305_AEAD_AAD_LEN + 1 +
+                                 POLY1305_TAGLEN));
+
+    size_t data_pos = 0;
+    do {
+        const bool first = data_pos == 0;
+        const uint32_t prefix_length = 1 + (first ? command_length : 0);
+        const uint32_t data_length =
+            std::min<size_t>(msg.data.size() - data_pos,
+                             V2_MAX_PACKET_PAYLOAD - prefix_length);
+        const uint32_t payload_length = prefix_length + data_length;
+        const bool continued = data_pos + data_length < msg.data.size();
+
+        const size_t packet_start = packets.size();
+        // LE serialize the 24 bits payload length
+        packets.push_back(payload_length & 0xff);
+        packets.push_back((payload_length >> 8) & 0xff);
+        packets.push_back((payload_length >> 16) & 0xff);
+        packets.push_back((first ? command_length : 0) |
+                          (continued ? V2_PACKET_CONTINUED : 0));
+        if (first) {
+            packets.insert(packets.end(), msg.m_type.begin(),
+                           msg.m_type.end());
+        }
+        packets.insert(packets.end(), msg.data.begin() + data_pos,
+                       msg.data.begin() + data_pos + data_length);
+        // room for the MAC
+        packets.resize(packets.size() + POLY1305_TAGLEN);
+        uint8_t *packet = packets.data() + packet_start;
+
+        const bool encrypted = m_aead.Crypt(
+            m_payload_seqnr, m_aad_seqnr, m_aad_pos, packet,
+            CHACHA20_POLY1305_AEAD_AAD_LEN + payload_length + POLY1305_TAGLEN,
+            packet, CHACHA20_POLY1305_AEAD_AAD_LEN + payload_length, true);
+        assert(encrypted);
+        NextV2Packet(m_payload_seqnr, m_aad_seqnr, m_aad_pos);
+
+        data_pos += data_length;
+    } while (data_pos < msg.data.size());
+
+    // the packets replace the message data, there is no separate header
+    msg.data = std::move(packets);
+    header.clear();
+}
+
+V2Handshake::V2Handshake(bool initiator) : m_initiator(initiator) {
+    m_key.MakeNewKey(/* fCompressed */ true);
+}
+
+V2Handshake::~V2Handshake() {
+    memory_cleanse(m_send_k1, sizeof(m_send_k1));
+    memory_cleanse(m_send_k2, sizeof(m_send_k2));
+    memory_cleanse(m_recv_k1, sizeof(m_recv_k1));
+    memory_cleanse(m_recv_k2, sizeof(m_recv_k2));
+}
+
+bool V2Handshake::Derive(Span<const uint8_t> peer_pubkey,
+                         const CMessageHeader::MessageMagic &magic) {
+    // Only compressed keys, so that the handshake messages have a fixed size
+    const CPubKey peer(peer_pubkey.begin(), peer_pubkey.end());
+    uint256 secret;
+    if (peer_pubkey.size() != CPubKey::COMPRESSED_SIZE ||
+        !peer.IsCompressed() || !m_key.ComputeECDHSecret(peer, secret)) {
+        return false;
+    }
+
+    // Both sides list the public keys in the same order, the initiator's
+    // first.
+    const CPubKey ours = m_key.GetPubKey();
+    const CPubKey &initiator_pubkey = m_initiator ? ours : peer;
+    const CPubKey &responder_pubkey = m_initiator ? peer : ours;
+    std::string salt = "bitcoin_v2_transport";
+    salt.append(magic.begin(), magic.end());
+    salt.append(initiator_pubkey.begin(), initiator_pubkey.end());
+    salt.append(responder_pubkey.begin(), responder_pubkey.end());
+    CHKDF_HMAC_SHA256_L32 hkdf(secret.begin(), secret.size(), salt);
+    memory_cleanse(secret.begin(), secret.size());
+
+    const std::string send_side = m_initiator ? "initiator" : "responder";
+    const std::string recv_side = m_initiator ? "responder" : "initiator";
+    hkdf.Expand32(send_side + "_K1", m_send_k1);
+    hkdf.Expand32(send_side + "_K2", m_send_k2);
+    hkdf.Expand32(recv_side + "_K1", m_recv_k1);
+    hkdf.Expand32(recv_side + "_K2", m_recv_k2);
+    return true;
+}
+
+std::unique_ptr<TransportSerializer> V2Handshake::MakeSerializer() const {
+    return std::make_unique<V2TransportSerializer>(
+        m_send_k1, sizeof(m_send_k1), m_send_k2, sizeof(m_send_k2));
+}
+
+std::unique_ptr<TransportDeserializer> V2Handshake::MakeDeserializer() const {
+    return std::make_unique<V2TransportDeserializer>(
+        m_recv_k1, sizeof(m_recv_k1), m_recv_k2, sizeof(m_recv_k2),
+        SER_NETWORK, INIT_PROTO_VERSION);
+}
+
 size_t CConnman::SocketSendData(CNode &node) const {
     size_t nSentSize = 0;
     size_t nMsgCount = 0;
@@ -3633,32 +3983,39 @@ bool CConnman::NodeFullyConnected(const CNode *pnode) {
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
+void CNode::QueueMessage(const Config &config, CSerializedNetMsg &&msg) {
+    // make sure we use the appropriate network transport format
+    std::vector<uint8_t> serializedHeader;
+    m_serializer->prepareForTransport(config, msg, serializedHeader);
+    // The transport may have framed the message data itself
+    size_t nTotalSize = msg.data.size() + serializedHeader.size();
+
+    // log total amount of bytes per message type
+    mapSendBytesPerMsgCmd[msg.m_type] += nTotalSize;
+    nSendSize += nTotalSize;
+
+    if (!serializedHeader.empty()) {
+        vSendMsg.push_back(std::move(serializedHeader));
+    }
+    if (!msg.data.empty()) {
+        vSendMsg.push_back(std::move(msg.data));
+    }
+}
+
 void CConnman::PushMessage(CNode *pnode, CSerializedNetMsg &&msg) {
     size_t nMessageSize = msg.data.size();
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",
              SanitizeString(msg.m_type), nMessageSize, pnode->GetId());
 
-    // make sure we use the appropriate network transport format
-    std::vector<uint8_t> serializedHeader;
-    pnode->m_serializer->prepareForTransport(*config, msg, serializedHeader);
-    size_t nTotalSize = nMessageSize + serializedHeader.size();
-
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
         bool optimisticSend(pnode->vSendMsg.empty());
 
-        // log total amount of bytes per message type
-        pnode->mapSendBytesPerMsgCmd[msg.m_type] += nTotalSize;
-        pnode->nSendSize += nTotalSize;
-
+        pnode->QueueMessage(*config, std::move(msg));
         if (pnode->nSendSize > nSendBufferMaxSize) {
             pnode->fPauseSend = true;
         }
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize) {
-            pnode->vSendMsg.push_back(std::move(msg.data));
-        }
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true) {
@@ -3670,6 +4027,23 @@ void CConnman::PushMessage(CNode *pnode, CSerializedNetMsg &&msg) {
     }
 }
 
+void CConnman::StartV2Handshake(CNode &node) {
+    CPubKey pubkey;
+    {
+        LOCK(node.cs_vSend);
+        if (node.m_v2_state != CNode::V2State::NONE) {
+            return;
+        }
+        node.m_v2_handshake =
+            std::make_unique<V2Handshake>(/* initiator */ true);
+        node.m_v2_state = CNode::V2State::INIT_SENT;
+        pubkey = node.m_v2_handshake->GetPubKey();
+    }
+    PushMessage(&node,
+                MakeV2HandshakeMessage(NetMsgType::ENCINIT,
+                                       {pubkey.data(), pubkey.size()}));
+}
+
 bool CConnman::ForNode(NodeId id, std::function<bool(CNode *pnode)> func) {
     CNode *found = nullptr;
     LOCK(cs_vNodes);
@@ -14,9 +14,11 @@
 #include <bloom.h>
 #include <chainparams.h>
 #include <compat.h>
+#include <crypto/chacha_poly_aead.h>
 #include <crypto/siphash.h>
 #include <hash.h>
 #include <i2p.h>
+#include <key.h>
 #include <net_permissions.h>
 #include <netaddress.h>
 #include <nodeid.h>
@@ -93,6 +95,8 @@ static constexpr uint64_t DEFAULT_MAX_UPLOAD_TARGET = 0;
 static const bool DEFAULT_BLOCKSONLY = false;
 /** -peertimeout default */
 static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
+/** Default for -v2transport */
+static const bool DEFAULT_V2_TRANSPORT = false;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const bool DEFAULT_DNSSEED = true;
@@ -303,6 +307,8 @@ struct CNodeStats {
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    // Whether both directions use the encrypted V2 transport
+    bool m_v2_transport;
     NetPermissionFlags m_permissionFlags;
     bool m_legacyWhitelisted;
     std::chrono::microseconds m_last_ping_time;
@@ -367,8 +373,11 @@ public:
 
 class V1TransportDeserializer final : public TransportDeserializer {
 private:
-    mutable CHash256 hasher;
-    mutable uint256 data_hash;
+    // Hash of the data received so far, finalized along with the checksum
+    // verification when the last byte of the message arrives.
+    CHash256 hasher;
+    uint256 data_hash;
+    bool valid_checksum;
 
     // Parsing header (false) or data (true)
     bool in_data;
@@ -381,9 +390,9 @@ private:
     uint32_t nHdrPos;
     uint32_t nDataPos;
 
-    const uint256 &GetMessageHash() const;
     int readHeader(const Config &config, Span<const uint8_t> msg_bytes);
     int readData(Span<const uint8_t> msg_bytes);
+    void VerifyChecksum();
 
     void Reset() {
         vRecv.clear();
@@ -393,6 +402,7 @@ private:
         nHdrPos = 0;
         nDataPos = 0;
         data_hash.SetNull();
+        valid_checksum = false;
         hasher.Reset();
     }
 
@@ -431,6 +441,88 @@ public:
                            std::chrono::microseconds time) override;
 };
 
+/**
+ * Largest payload of a V2 packet, as its length is encoded on 3 bytes. Longer
+ * messages are split across several packets.
+ */
+static constexpr uint32_t V2_MAX_PACKET_PAYLOAD = 0xffffff;
+/** Set in the first payload byte of a V2 packet if the message continues. */
+static constexpr uint8_t V2_PACKET_CONTINUED = 0x80;
+
+/**
+ * The encrypted V2 transport, framing messages in chacha20-poly1305@bitcoin
+ * packets (see ChaCha20Poly1305AEAD). A packet is made of:
+ *  - the encrypted 3 bytes payload length,
+ *  - the encrypted payload: 1 byte holding the length of the command and the
+ *    V2_PACKET_CONTINUED flag, the command (only in the first packet of a
+ *    message) and the message data,
+ *  - the 16 bytes MAC of the above.
+ *
+ * The MAC replaces the V1 checksum and there is no network magic. Both sides
+ * get their keys from a V2Handshake, each direction using its own pair.
+ */
+class V2TransportDeserializer final : public TransportDeserializer {
+private:
+    ChaCha20Poly1305AEAD m_aead;
+    uint64_t m_payload_seqnr{0};
+    uint64_t m_aad_seqnr{0};
+    int m_aad_pos{0};
+
+    // Reading the payload of a packet (true) or its length (false)
+    bool in_data;
+    // The data of the message, followed by the packet being received
+    CDataStream vRecv;
+    // Offset of the packet being received in vRecv
+    uint32_t m_packet_start;
+    // Number of bytes of the packet received so far
+    uint32_t m_packet_pos;
+    // Decrypted payload length of the packet being received
+    uint32_t m_packet_length;
+    // Command of the message, empty until its first packet is decrypted
+    std::string m_command;
+    // Number of bytes received for the message
+    uint32_t m_raw_size;
+    bool m_complete;
+
+    int readHeader(const Config &config, Span<const uint8_t> msg_bytes);
+    int readData(Span<const uint8_t> msg_bytes);
+    bool processPacket();
+
+    void Reset() {
+        vRecv.clear();
+        in_data = false;
+        m_packet_start = 0;
+        m_packet_pos = 0;
+        m_packet_length = 0;
+        m_command.clear();
+        m_raw_size = 0;
+        m_complete = false;
+    }
+
+public:
+    V2TransportDeserializer(const uint8_t *k1, size_t k1_len,
+                            const uint8_t *k2, size_t k2_len, int nTypeIn,
+                            int nVersionIn)
+        : m_aead(k1, k1_len, k2, k2_len), vRecv(nTypeIn, nVersionIn) {
+        Reset();
+    }
+
+    bool Complete() const override { return m_complete; }
+    void SetVersion(int nVersionIn) override { vRecv.SetVersion(nVersionIn); }
+    int Read(const Config &config, Span<const uint8_t> &msg_bytes) override {
+        int ret = in_data ? readData(msg_bytes) : readHeader(config, msg_bytes);
+        if (ret < 0) {
+            Reset();
+        } else {
+            msg_bytes = msg_bytes.subspan(ret);
+        }
+        return ret;
+    }
+
+    CNetMessage GetMessage(const Config &config,
+                           std::chrono::microseconds time) override;
+};
+
 /**
  * The TransportSerializer prepares messages for the network transport
  */
@@ -450,14 +542,77 @@ public:
                              std::vector<uint8_t> &header) override;
 };
 
+/**
+ * Encrypts messages in V2 packets, see V2TransportDeserializer. The packets
+ * replace the data of the message and the header is left empty.
+ */
+class V2TransportSerializer : public TransportSerializer {
+private:
+    ChaCha20Poly1305AEAD m_aead;
+    uint64_t m_payload_seqnr{0};
+    uint64_t m_aad_seqnr{0};
+    int m_aad_pos{0};
+
+public:
+    V2TransportSerializer(const uint8_t *k1, size_t k1_len, const uint8_t *k2,
+                          size_t k2_len)
+        : m_aead(k1, k1_len, k2, k2_len) {}
+
+    void prepareForTransport(const Config &config, CSerializedNetMsg &msg,
+                             std::vector<uint8_t> &header) override;
+};
+
+/**
+ * The key exchange upgrading a V1 connection to the encrypted V2 transport.
+ *
+ * Once the version handshake shows that both peers advertise NODE_P2P_V2, the
+ * outbound peer sends an ephemeral public key in an encinit message and the
+ * inbound peer answers with its own in an encack message. Both derive the keys
+ * of each direction with HKDF from their ECDH secret, bound to the network
+ * magic and to both public keys. The inbound peer encrypts everything it sends
+ * after its encack. The outbound peer answers with an empty encack and
+ * encrypts everything after it.
+ *
+ * The public keys are not authenticated: this protects against passive
+ * observers, not against a man in the middle, and a peer which doesn't
+ * advertise NODE_P2P_V2 keeps using V1.
+ */
+class V2Handshake {
+private:
+    const bool m_initiator;
+    CKey m_key;
+    uint8_t m_send_k1[CHACHA20_POLY1305_AEAD_KEY_LEN];
+    uint8_t m_send_k2[CHACHA20_POLY1305_AEAD_KEY_LEN];
+    uint8_t m_recv_k1[CHACHA20_POLY1305_AEAD_KEY_LEN];
+    uint8_t m_recv_k2[CHACHA20_POLY1305_AEAD_KEY_LEN];
+
+public:
+    /** Generate an ephemeral key, initiator is true on the outbound side. */
+    explicit V2Handshake(bool initiator);
+    ~V2Handshake();
+
+    CPubKey GetPubKey() const { return m_key.GetPubKey(); }
+
+    /**
+     * Derive the keys of both directions from the public key the peer sent.
+     * Returns false if it is not a valid compressed public key.
+     */
+    bool Derive(Span<const uint8_t> peer_pubkey,
+                const CMessageHeader::MessageMagic &magic);
+
+    /** The transport of each direction, once the keys are derived. */
+    std::unique_ptr<TransportSerializer> MakeSerializer() const;
+    std::unique_ptr<TransportDeserializer> MakeDeserializer() const;
+};
+
 /** Information about a peer */
 class CNode {
     friend class CConnman;
     friend struct ConnmanTestMsg;
 
 public:
-    std::unique_ptr<TransportDeserializer> m_deserializer;
-    std::unique_ptr<TransportSerializer> m_serializer;
+    std::unique_ptr<TransportDeserializer> m_deserializer GUARDED_BY(cs_vRecv);
+    std::unique_ptr<TransportSerializer> m_serializer GUARDED_BY(cs_vSend);
 
     // socket
     std::atomic<ServiceFlags> nServices{NODE_NONE};
@@ -618,8 +773,8 @@ public:
             GUARDED_BY(cs_filter){nullptr};
 
         mutable RecursiveMutex cs_tx_inventory;
-        CRollingBloomFilter filterInventoryKnown GUARDED_BY(cs_tx_inventory){
-            50000, 0.000001};
+        CBlockedRollingBloomFilter filterInventoryKnown
+            GUARDED_BY(cs_tx_inventory){50000, 0.000001};
         // Set of transaction ids we still have to announce.
         // They are sorted by the mempool before relay, so the order is not
         // important.
@@ -645,8 +800,8 @@ public:
         std::set<avalanche::ProofId>
             setInventoryProofToSend GUARDED_BY(cs_proof_inventory);
         // Prevent sending proof invs if the peer already knows about them
-        CRollingBloomFilter filterProofKnown GUARDED_BY(cs_proof_inventory){
-            10000, 0.000001};
+        CBlockedRollingBloomFilter filterProofKnown
+            GUARDED_BY(cs_proof_inventory){10000, 0.000001};
         std::chrono::microseconds nextInvSend{0};
     };
 
@@ -789,6 +944,35 @@ private:
     // Used only by SocketHandler thread
     std::list<CNetMessage> vRecvMsg;
 
+    //! Progress of the upgrade to the encrypted transport, see V2Handshake.
+    enum class V2State {
+        //! Both directions use the V1 transport.
+        NONE,
+        //! Outbound: encinit sent, waiting for the encack.
+        INIT_SENT,
+        //! Inbound: encack sent, waiting for the empty encack.
+        ACK_SENT,
+        //! Both directions are encrypted.
+        ESTABLISHED,
+    };
+    V2State m_v2_state GUARDED_BY(cs_vSend){V2State::NONE};
+    std::unique_ptr<V2Handshake> m_v2_handshake GUARDED_BY(cs_vSend);
+
+    /**
+     * Prepare a message with the current transport and queue it. This is
+     * done under cs_vSend, as the transport may change or keep a state which
+     * must follow the order of the queue.
+     */
+    void QueueMessage(const Config &config, CSerializedNetMsg &&msg)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_vSend);
+    /**
+     * Handle an encinit or encack message, switching the transports at the
+     * exact points the protocol defines. Returns false if the peer should be
+     * disconnected from.
+     */
+    bool ProcessV2Handshake(const Config &config, const CNetMessage &msg)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_vRecv);
+
     mutable RecursiveMutex cs_addrName;
     std::string addrName GUARDED_BY(cs_addrName);
 
@@ -1031,6 +1215,13 @@ public:
 
     void PushMessage(CNode *pnode, CSerializedNetMsg &&msg);
 
+    /**
+     * Start upgrading an outbound connection to the encrypted transport, once
+     * the version handshake shows that both sides support it (see
+     * V2Handshake).
+     */
+    void StartV2Handshake(CNode &node);
+
     using NodeFn = std::function<void(CNode *)>;
     void ForEachNode(const NodeFn &func) {
         LOCK(cs_vNodes);
@@ -1167,7 +1358,7 @@ public:
                            std::chrono::seconds average_interval);
 
     void SetAsmap(std::vector<bool> asmap) {
-        addrman.m_asmap = std::move(asmap);
+        addrman.m_asmap = CompiledAsmap(std::move(asmap));
     }
 
     /**
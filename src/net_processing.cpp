@@ -23,6 +23,7 @@
 #include <hash.h>
 #include <index/blockfilterindex.h>
 #include <invrequest.h>
+#include <memusage.h>
 #include <merkleblock.h>
 #include <netbase.h>
 #include <netmessagemaker.h>
@@ -57,6 +58,11 @@ static constexpr auto RELAY_TX_CACHE_TIME = 15min;
  * unconditionally be relayed (even when not in mapRelay).
  */
 static constexpr auto UNCONDITIONAL_RELAY_DELAY = 2min;
+/**
+ * Memory usage of the bloom filter elements of the announced transactions kept
+ * for the peers with a BIP37 filter.
+ */
+static constexpr size_t MAX_BLOOM_ELEMENTS_CACHE_USAGE = 8 << 20;
 /**
  * Headers download timeout.
  * Timeout = base + per_header * (expected number of headers)
@@ -393,7 +399,7 @@ struct Peer {
      *
      *  Presence of this filter must correlate with m_addr_relay_enabled.
      **/
-    std::unique_ptr<CRollingBloomFilter> m_addr_known;
+    std::unique_ptr<CBlockedRollingBloomFilter> m_addr_known;
     /**
      * Whether we are participating in address relay with this connection.
      *
@@ -797,6 +803,18 @@ MapRelay mapRelay GUARDED_BY(cs_main);
 std::deque<std::pair<std::chrono::microseconds, MapRelay::iterator>>
     g_relay_expiration GUARDED_BY(cs_main);
 
+/**
+ * Bloom filter elements of the transactions recently announced to peers with
+ * a BIP37 filter, so that each transaction is only parsed once for all of
+ * them. Entries are evicted in insertion order once their memory usage,
+ * accounted in g_bloom_elements_usage, exceeds MAX_BLOOM_ELEMENTS_CACHE_USAGE.
+ */
+typedef std::map<TxId, CBloomTxElements> MapBloomElements;
+MapBloomElements g_bloom_elements GUARDED_BY(cs_main);
+std::deque<MapBloomElements::iterator>
+    g_bloom_elements_order GUARDED_BY(cs_main);
+size_t g_bloom_elements_usage GUARDED_BY(cs_main) = 0;
+
 struct IteratorComparator {
     template <typename I> bool operator()(const I &a, const I &b) const {
         return &(*a) < &(*b);
@@ -2163,6 +2181,64 @@ static std::shared_ptr<const CBlock>
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs>
     most_recent_compact_block GUARDED_BY(cs_most_recent_block);
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
+// Computed on the first request of the block by a filtered peer
+static std::shared_ptr<const std::vector<CBloomTxElements>>
+    most_recent_block_bloom_elements GUARDED_BY(cs_most_recent_block);
+
+/**
+ * The bloom filter elements of pblock, shared with the other peers requesting
+ * it when it is the most recent block.
+ */
+static std::shared_ptr<const std::vector<CBloomTxElements>>
+GetSharedBlockBloomElements(const std::shared_ptr<const CBlock> &pblock) {
+    {
+        LOCK(cs_most_recent_block);
+        if (most_recent_block == pblock && most_recent_block_bloom_elements) {
+            return most_recent_block_bloom_elements;
+        }
+    }
+
+    // Don't hold cs_most_recent_block while parsing a large block.
+    auto elements = std::make_shared<const std::vector<CBloomTxElements>>(
+        GetBlockBloomElements(*pblock));
+
+    LOCK(cs_most_recent_block);
+    if (most_recent_block == pblock && !most_recent_block_bloom_elements) {
+        most_recent_block_bloom_elements = elements;
+    }
+    return elements;
+}
+
+/** The memory usage of an entry of g_bloom_elements and its order entry. */
+static size_t BloomElementsUsage(const MapBloomElements::iterator &it)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    return memusage::IncrementalDynamicUsage(g_bloom_elements) +
+           sizeof(MapBloomElements::iterator) + it->second.DynamicMemoryUsage();
+}
+
+/**
+ * The bloom filter elements of a transaction being announced, shared with the
+ * other peers it is announced to.
+ */
+static const CBloomTxElements &GetTxBloomElements(const CTransaction &tx)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    auto [it, inserted] = g_bloom_elements.try_emplace(tx.GetId(), tx);
+    if (inserted) {
+        g_bloom_elements_order.push_back(it);
+        g_bloom_elements_usage += BloomElementsUsage(it);
+        // The elements just inserted are kept, even if they are larger than
+        // the whole cache.
+        while (g_bloom_elements_usage > MAX_BLOOM_ELEMENTS_CACHE_USAGE &&
+               g_bloom_elements_order.size() > 1) {
+            const MapBloomElements::iterator oldest =
+                g_bloom_elements_order.front();
+            g_bloom_elements_usage -= BloomElementsUsage(oldest);
+            g_bloom_elements.erase(oldest);
+            g_bloom_elements_order.pop_front();
+        }
+    }
+    return it->second;
+}
 
 /**
  * Maintain state about the best-seen block and fast-announce a compact block
@@ -2189,6 +2265,7 @@ void PeerManagerImpl::NewPoWValidBlock(
         most_recent_block_hash = hashBlock;
         most_recent_block = pblock;
         most_recent_compact_block = pcmpctblock;
+        most_recent_block_bloom_elements.reset();
     }
 
     m_connman.ForEachNode(
@@ -2533,7 +2610,8 @@ static void ProcessGetBlockData(const Config &config, CNode &pfrom, Peer &peer,
                 if (pfrom.m_tx_relay->pfilter) {
                     sendMerkleBlock = true;
                     merkleBlock =
-                        CMerkleBlock(*pblock, *pfrom.m_tx_relay->pfilter);
+                        CMerkleBlock(*pblock, *pfrom.m_tx_relay->pfilter,
+                                     *GetSharedBlockBloomElements(pblock));
                 }
             }
             if (sendMerkleBlock) {
@@ -3603,6 +3681,12 @@ void PeerManagerImpl::ProcessMessage(
         // Signal ADDRv2 support (BIP155).
         m_connman.PushMessage(&pfrom, msg_maker.Make(NetMsgType::SENDADDRV2));
 
+        // Upgrade to the encrypted transport if both sides support it.
+        if (!pfrom.IsInboundConn() && (nServices & NODE_P2P_V2) &&
+            (pfrom.GetLocalServices() & NODE_P2P_V2)) {
+            m_connman.StartV2Handshake(pfrom);
+        }
+
         pfrom.nServices = nServices;
         pfrom.SetAddrLocal(addrMe);
         {
@@ -4365,6 +4449,10 @@ void PeerManagerImpl::ProcessMessage(
         const TxId &txid = tx.GetId();
         pfrom.AddKnownTx(txid);
 
+        // Wait for the subscribers to catch up with the notifications of the
+        // previous transactions before adding more.
+        LimitValidationInterfaceQueue();
+
         LOCK2(cs_main, g_cs_orphans);
 
         m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
@@ -6212,7 +6300,8 @@ bool PeerManagerImpl::SetupAddressRelay(CNode &node, Peer &peer) {
     if (!peer.m_addr_relay_enabled.exchange(true)) {
         // First addr message we have received from the peer, initialize
         // m_addr_known
-        peer.m_addr_known = std::make_unique<CRollingBloomFilter>(5000, 0.001);
+        peer.m_addr_known =
+            std::make_unique<CBlockedRollingBloomFilter>(5000, 0.001);
     }
 
     return true;
@@ -6661,7 +6750,7 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
                     }
                     if (pto->m_tx_relay->pfilter &&
                         !pto->m_tx_relay->pfilter->IsRelevantAndUpdate(
-                            *txinfo.tx)) {
+                            *txinfo.tx, GetTxBloomElements(*txinfo.tx))) {
                         continue;
                     }
                     // Send
@@ -726,37 +726,24 @@ Network CNetAddr::GetNetClass() const {
     return m_net;
 }
 
-uint32_t CNetAddr::GetMappedAS(const std::vector<bool> &asmap) const {
+uint32_t CNetAddr::GetMappedAS(const CompiledAsmap &asmap) const {
     uint32_t net_class = GetNetClass();
-    if (asmap.size() == 0 || (net_class != NET_IPV4 && net_class != NET_IPV6)) {
+    if (asmap.empty() || (net_class != NET_IPV4 && net_class != NET_IPV6)) {
         return 0; // Indicates not found, safe because AS0 is reserved per
                   // RFC7607.
     }
-    std::vector<bool> ip_bits(128);
+    uint8_t ip[ADDR_IPV6_SIZE];
     if (HasLinkedIPv4()) {
         // For lookup, treat as if it was just an IPv4 address
         // (IPV4_IN_IPV6_PREFIX + IPv4 bits)
-        for (int8_t byte_i = 0; byte_i < 12; ++byte_i) {
-            for (uint8_t bit_i = 0; bit_i < 8; ++bit_i) {
-                ip_bits[byte_i * 8 + bit_i] =
-                    (IPV4_IN_IPV6_PREFIX[byte_i] >> (7 - bit_i)) & 1;
-            }
-        }
-        uint32_t ipv4 = GetLinkedIPv4();
-        for (int i = 0; i < 32; ++i) {
-            ip_bits[96 + i] = (ipv4 >> (31 - i)) & 1;
-        }
+        memcpy(ip, IPV4_IN_IPV6_PREFIX.data(), IPV4_IN_IPV6_PREFIX.size());
+        WriteBE32(ip + IPV4_IN_IPV6_PREFIX.size(), GetLinkedIPv4());
     } else {
         // Use all 128 bits of the IPv6 address otherwise
         assert(IsIPv6());
-        for (int8_t byte_i = 0; byte_i < 16; ++byte_i) {
-            uint8_t cur_byte = m_addr[byte_i];
-            for (uint8_t bit_i = 0; bit_i < 8; ++bit_i) {
-                ip_bits[byte_i * 8 + bit_i] = (cur_byte >> (7 - bit_i)) & 1;
-            }
-        }
+        memcpy(ip, m_addr.data(), ADDR_IPV6_SIZE);
     }
-    uint32_t mapped_as = Interpret(asmap, ip_bits);
+    uint32_t mapped_as = asmap.Lookup(ip);
     return mapped_as;
 }
 
@@ -770,7 +757,7 @@ uint32_t CNetAddr::GetMappedAS(const std::vector<bool> &asmap) const {
  * @note No two connections will be attempted to addresses with the same network
  *       group.
  */
-std::vector<uint8_t> CNetAddr::GetGroup(const std::vector<bool> &asmap) const {
+std::vector<uint8_t> CNetAddr::GetGroup(const CompiledAsmap &asmap) const {
     std::vector<uint8_t> vchRet;
     uint32_t net_class = GetNetClass();
     // If non-empty asmap is supplied and the address is IPv4/IPv6,
@@ -24,6 +24,8 @@
 #include <string>
 #include <vector>
 
+class CompiledAsmap;
+
 /**
  * A flag that is ORed into the protocol version to designate that addresses
  * should be serialized in (unserialized from) v2 format (BIP155).
@@ -229,9 +231,9 @@ public:
     // The AS on the BGP path to the node we use to diversify
     // peers in AddrMan bucketing based on the AS infrastructure.
     // The ip->AS mapping depends on how asmap is constructed.
-    uint32_t GetMappedAS(const std::vector<bool> &asmap) const;
+    uint32_t GetMappedAS(const CompiledAsmap &asmap) const;
 
-    std::vector<uint8_t> GetGroup(const std::vector<bool> &asmap) const;
+    std::vector<uint8_t> GetGroup(const CompiledAsmap &asmap) const;
     std::vector<uint8_t> GetAddrBytes() const;
     int GetReachabilityFrom(const CNetAddr *paddrPartner = nullptr) const;
 
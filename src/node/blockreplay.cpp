@@ -0,0 +1,300 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockreplay.h>
+
+#include <blockdb.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <coins.h>
+#include <config.h>
+#include <consensus/validation.h>
+#include <hash.h>
+#include <streams.h>
+#include <tinyformat.h>
+#include <txdb.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+//! Number of headers needed to compute the median time past of a block
+static constexpr size_t MTP_CONTEXT_SIZE = 11;
+
+bool ExportBlockReplay(const CChain &chain, const CChainParams &params,
+                       int start_height, int end_height,
+                       BlockReplayData &data, std::string &error) {
+    data = BlockReplayData();
+    data.chain = params.NetworkIDString();
+    data.start_height = start_height;
+
+    // Only the index is read under cs_main, the blocks and undo data are read
+    // from disk once the lock is released.
+    std::vector<const CBlockIndex *> indexes;
+    {
+        LOCK(cs_main);
+        if (start_height < 1 || start_height > end_height ||
+            end_height > chain.Height()) {
+            error = strprintf("Invalid block range [%d, %d]", start_height,
+                              end_height);
+            return false;
+        }
+
+        const int first_context =
+            std::max<int>(0, start_height - MTP_CONTEXT_SIZE);
+        for (int height = first_context; height < start_height; ++height) {
+            data.context.push_back(chain[height]->GetBlockHeader());
+        }
+
+        const int bip34_height = params.GetConsensus().BIP34Height;
+        if (bip34_height >= 0 && bip34_height < first_context) {
+            data.bip34_hash = chain[bip34_height]->GetBlockHash();
+        }
+
+        indexes.reserve(end_height - start_height + 1);
+        for (int height = start_height; height <= end_height; ++height) {
+            indexes.push_back(chain[height]);
+        }
+    }
+
+    data.blocks.resize(indexes.size());
+    data.undo.resize(indexes.size());
+    for (size_t pos = 0; pos < indexes.size(); ++pos) {
+        const CBlockIndex *pindex = indexes[pos];
+        if (!ReadBlockFromDisk(data.blocks[pos], pindex,
+                               params.GetConsensus())) {
+            error = strprintf("Can't read block %s from disk",
+                              pindex->GetBlockHash().ToString());
+            return false;
+        }
+        if (!UndoReadFromDisk(data.undo[pos], pindex)) {
+            error = strprintf("Can't read undo data for block %s from disk",
+                              pindex->GetBlockHash().ToString());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+BlockReplay::BlockReplay(BlockReplayData data, const CChainParams &params,
+                         const fs::path &path)
+    : m_data(std::move(data)), m_params(params), m_path(path) {
+    if (m_data.chain != params.NetworkIDString()) {
+        throw std::runtime_error(
+            strprintf("Replay data is for %s but running on %s", m_data.chain,
+                      params.NetworkIDString()));
+    }
+
+    const int start_height = m_data.start_height;
+    const int first_context = start_height - m_data.context.size();
+    if (m_data.blocks.empty() || m_data.context.empty() ||
+        first_context < 0 || m_data.undo.size() != m_data.blocks.size()) {
+        throw std::runtime_error("Malformed replay data");
+    }
+
+    const int end_height = start_height + m_data.blocks.size() - 1;
+    const int bip34_height = params.GetConsensus().BIP34Height;
+    if (!m_data.bip34_hash.IsNull() &&
+        (bip34_height < 0 || bip34_height >= first_context)) {
+        throw std::runtime_error("Unexpected BIP34 block hash");
+    }
+
+    // Build the skeleton index. The hashes are reserved up front so the
+    // phashBlock pointers remain valid.
+    m_index.resize(end_height + 1);
+    m_hashes.reserve(m_data.context.size() + m_data.blocks.size() + 1);
+    for (int height = 0; height <= end_height; ++height) {
+        CBlockIndex &index = m_index[height];
+        if (height >= first_context) {
+            const CBlockHeader &header =
+                height < start_height
+                    ? m_data.context[height - first_context]
+                    : m_data.blocks[height - start_height];
+            if (height > first_context &&
+                header.hashPrevBlock != m_hashes.back()) {
+                throw std::runtime_error(
+                    strprintf("Block at height %d does not connect", height));
+            }
+            index = CBlockIndex(header);
+            m_hashes.push_back(header.GetHash());
+            index.phashBlock = &m_hashes.back();
+        } else if (height == bip34_height && !m_data.bip34_hash.IsNull()) {
+            m_hashes.push_back(m_data.bip34_hash);
+            index.phashBlock = &m_hashes.back();
+        }
+        index.nHeight = height;
+        index.pprev = height > 0 ? &m_index[height - 1] : nullptr;
+        index.BuildSkip();
+
+        if (height >= start_height) {
+            index.nStatus = BlockStatus()
+                                .withValidity(BlockValidity::SCRIPTS)
+                                .withUndo();
+            index.nFile = 0;
+            index.nUndoPos = 0;
+        }
+    }
+
+    // Collect the coins spent by the range that the range does not create:
+    // these form the UTXO subset the replay starts from.
+    m_db = std::make_unique<CCoinsViewDB>(m_path / "chainstate", 8 << 20,
+                                          /* fMemory */ false,
+                                          /* fWipe */ true);
+    CCoinsViewCache base(m_db.get());
+    for (size_t i = 0; i < m_data.blocks.size(); ++i) {
+        const CBlock &block = m_data.blocks[i];
+        const CBlockUndo &blockundo = m_data.undo[i];
+        if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+            throw std::runtime_error(
+                strprintf("Block and undo data at height %d are inconsistent",
+                          start_height + i));
+        }
+        for (size_t t = 1; t < block.vtx.size(); ++t) {
+            const CTransaction &tx = *block.vtx[t];
+            const CTxUndo &txundo = blockundo.vtxundo[t - 1];
+            if (txundo.vprevout.size() != tx.vin.size()) {
+                throw std::runtime_error(strprintf(
+                    "Transaction and undo data for %s are inconsistent",
+                    tx.GetId().ToString()));
+            }
+            for (size_t j = 0; j < tx.vin.size(); ++j) {
+                const Coin &coin = txundo.vprevout[j];
+                if (coin.GetHeight() >= uint32_t(start_height)) {
+                    // Created by the range itself.
+                    continue;
+                }
+                if (base.HaveCoin(tx.vin[j].prevout)) {
+                    throw std::runtime_error(
+                        strprintf("Coin %s is spent twice",
+                                  tx.vin[j].prevout.ToString()));
+                }
+                base.AddCoin(tx.vin[j].prevout, Coin(coin), false);
+                ++m_base_coins;
+            }
+        }
+    }
+    base.SetBestBlock(m_data.blocks.front().hashPrevBlock);
+    if (!base.Flush()) {
+        throw std::runtime_error("Failed to write the replay coins database");
+    }
+}
+
+BlockReplay::~BlockReplay() {}
+
+bool BlockReplay::Run(const Config &config, CChainState &chainstate,
+                      const BlockReplayOptions &options,
+                      BlockReplayTimings &timings, std::string &error) {
+    AssertLockHeld(cs_main);
+
+    if (options.warm_cache && !m_warm_cache) {
+        m_warm_cache = std::make_unique<CCoinsViewCache>(m_db.get());
+        for (const CBlock &block : m_data.blocks) {
+            for (const auto &ptx : block.vtx) {
+                for (const CTxIn &in : ptx->vin) {
+                    m_warm_cache->HaveCoin(in.prevout);
+                }
+            }
+        }
+    }
+
+    CCoinsView *base = options.warm_cache
+                           ? static_cast<CCoinsView *>(m_warm_cache.get())
+                           : m_db.get();
+    CCoinsViewCache view(base);
+
+    CAutoFile undo_file(fsbridge::fopen(m_path / "undo.dat", "wb"), SER_DISK,
+                        CLIENT_VERSION);
+    if (undo_file.IsNull()) {
+        error = "Failed to open the undo file";
+        return false;
+    }
+
+    auto flush = [&](size_t done) {
+        if (done == m_data.blocks.size() ||
+            (options.flush_interval > 0 &&
+             done % options.flush_interval == 0)) {
+            int64_t nTimeStart = GetTimeMicros();
+            bool ok = view.Flush();
+            timings.flush += GetTimeMicros() - nTimeStart;
+            return ok;
+        }
+        return true;
+    };
+
+    const BlockValidationOptions validation_options(config);
+    const int start_height = m_data.start_height;
+    for (size_t i = 0; i < m_data.blocks.size(); ++i) {
+        CBlock &block = m_data.blocks[i];
+        const CBlockUndo &blockundo = m_data.undo[i];
+        CBlockIndex *pindex = &m_index[start_height + i];
+
+        int64_t nTime1 = GetTimeMicros();
+        for (size_t t = 1; t < block.vtx.size(); ++t) {
+            const CTransaction &tx = *block.vtx[t];
+            for (size_t j = 0; j < tx.vin.size(); ++j) {
+                // Coins created by this very block are not in the base view.
+                if (blockundo.vtxundo[t - 1].vprevout[j].GetHeight() !=
+                    uint32_t(pindex->nHeight)) {
+                    view.HaveCoin(tx.vin[j].prevout);
+                }
+            }
+        }
+
+        int64_t nTime2 = GetTimeMicros();
+        timings.fetch_inputs += nTime2 - nTime1;
+
+        // Make sure CheckBlock runs every time.
+        block.fChecked = false;
+        BlockValidationState state;
+        if (!chainstate.ConnectBlock(block, state, pindex, view, m_params,
+                                     validation_options)) {
+            error = strprintf("ConnectBlock failed at height %d: %s",
+                              pindex->nHeight, state.ToString());
+            return false;
+        }
+
+        int64_t nTime3 = GetTimeMicros();
+        timings.connect += nTime3 - nTime2;
+
+        // Same layout as the rev files.
+        undo_file << m_params.DiskMagic()
+                  << uint32_t(GetSerializeSize(blockundo, CLIENT_VERSION))
+                  << blockundo;
+        CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+        hasher << pindex->pprev->GetBlockHash();
+        hasher << blockundo;
+        undo_file << hasher.GetHash();
+
+        timings.undo_write += GetTimeMicros() - nTime3;
+
+        if (!flush(i + 1)) {
+            error = "Failed to flush the coins cache";
+            return false;
+        }
+    }
+
+    for (size_t i = m_data.blocks.size(); i-- > 0;) {
+        int64_t nTimeStart = GetTimeMicros();
+        const CBlockIndex *pindex = &m_index[start_height + i];
+        if (ApplyBlockUndo(m_data.undo[i], m_data.blocks[i], pindex, view) !=
+            DisconnectResult::OK) {
+            error = strprintf("Failed to disconnect block at height %d",
+                              pindex->nHeight);
+            return false;
+        }
+        timings.disconnect += GetTimeMicros() - nTimeStart;
+
+        if (!flush(m_data.blocks.size() - i)) {
+            error = "Failed to flush the coins cache";
+            return false;
+        }
+    }
+
+    timings.blocks += m_data.blocks.size();
+    return true;
+}
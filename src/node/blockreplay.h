@@ -0,0 +1,133 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKREPLAY_H
+#define BITCOIN_NODE_BLOCKREPLAY_H
+
+#include <blockindex.h>
+#include <fs.h>
+#include <primitives/block.h>
+#include <primitives/blockhash.h>
+#include <serialize.h>
+#include <sync.h>
+#include <undo.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CChain;
+class CChainParams;
+class CChainState;
+class CCoinsViewCache;
+class CCoinsViewDB;
+class Config;
+
+extern RecursiveMutex cs_main;
+
+/**
+ * A range of blocks together with their undo data and the chain context
+ * needed to connect them again outside of the node they were exported from.
+ */
+struct BlockReplayData {
+    //! Network the blocks belong to, as in CBaseChainParams
+    std::string chain;
+    //! Height of the first block of the range
+    int32_t start_height{0};
+    //! Headers of the (up to 11) blocks preceding the range, oldest first.
+    //! They provide the median time past of the first blocks.
+    std::vector<CBlockHeader> context;
+    //! Hash of the block at the BIP34 height when it is below the context
+    //! headers, or null.
+    BlockHash bip34_hash;
+    std::vector<CBlock> blocks;
+    //! Undo data of each block, which holds every coin spent by the range
+    std::vector<CBlockUndo> undo;
+
+    SERIALIZE_METHODS(BlockReplayData, obj) {
+        READWRITE(obj.chain, obj.start_height, obj.context, obj.bip34_hash,
+                  obj.blocks, obj.undo);
+    }
+};
+
+/**
+ * Read the blocks of the active chain in [start_height, end_height] and their
+ * undo data from disk. cs_main is only held while the block index is read.
+ */
+bool ExportBlockReplay(const CChain &chain, const CChainParams &params,
+                       int start_height, int end_height,
+                       BlockReplayData &data, std::string &error)
+    LOCKS_EXCLUDED(cs_main);
+
+/** Time spent in each phase of a replay, in microseconds. */
+struct BlockReplayTimings {
+    int64_t blocks{0};
+    //! Loading the coins spent by a block from the base view into the cache
+    int64_t fetch_inputs{0};
+    //! ConnectBlock: input checks, script verification and coin updates
+    int64_t connect{0};
+    //! Serializing and checksumming the undo data as it goes to rev files
+    int64_t undo_write{0};
+    //! Writing the cache to the base view
+    int64_t flush{0};
+    //! Applying the undo data in reverse order
+    int64_t disconnect{0};
+};
+
+struct BlockReplayOptions {
+    //! Keep the base coins in a cache shared by all runs instead of reading
+    //! them from the database every time.
+    bool warm_cache{false};
+    //! Flush the cache every this many blocks. 0 only flushes at the end of
+    //! the range.
+    int flush_interval{0};
+};
+
+/**
+ * Deterministic replay of an exported block range.
+ *
+ * The coins spent by the range but not created in it are written to a fresh
+ * coins database. A skeleton block index is built so that ConnectBlock sees
+ * the same heights, median time past and BIP34 block as on the original
+ * chain. Each Run() connects all the blocks and then disconnects them, which
+ * leaves the database in its initial state, so runs can be repeated.
+ *
+ * The block index entries are marked as already having undo data and valid
+ * scripts so that ConnectBlock does not touch the block files or the block
+ * index of the node hosting the replay; the undo write is timed separately.
+ */
+class BlockReplay {
+private:
+    BlockReplayData m_data;
+    const CChainParams &m_params;
+    const fs::path m_path;
+
+    //! One entry per height up to the end of the range. Only the context and
+    //! replayed blocks carry real headers.
+    std::vector<CBlockIndex> m_index;
+    std::vector<BlockHash> m_hashes;
+
+    std::unique_ptr<CCoinsViewDB> m_db;
+    std::unique_ptr<CCoinsViewCache> m_warm_cache;
+    size_t m_base_coins{0};
+
+public:
+    /**
+     * @throws std::runtime_error if the data is inconsistent.
+     */
+    BlockReplay(BlockReplayData data, const CChainParams &params,
+                const fs::path &path);
+    ~BlockReplay();
+
+    const BlockReplayData &GetData() const { return m_data; }
+    //! Number of coins the range spends that it does not create
+    size_t GetBaseCoinsCount() const { return m_base_coins; }
+
+    bool Run(const Config &config, CChainState &chainstate,
+             const BlockReplayOptions &options, BlockReplayTimings &timings,
+             std::string &error) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+};
+
+#endif // BITCOIN_NODE_BLOCKREPLAY_H
@@ -0,0 +1,179 @@
+// Copyright (c) 2017-2019 The Bitcoin Core developers
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockstats.h>
+
+#include <blockindex.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <undo.h>
+#include <util/check.h>
+#include <validation.h>
+#include <version.h>
+
+#include <algorithm>
+#include <vector>
+
+template <typename T>
+static T CalculateTruncatedMedian(std::vector<T> &scores) {
+    size_t size = scores.size();
+    if (size == 0) {
+        return T();
+    }
+
+    std::sort(scores.begin(), scores.end());
+    if (size % 2 == 0) {
+        return (scores[size / 2 - 1] + scores[size / 2]) / 2;
+    } else {
+        return scores[size / 2];
+    }
+}
+
+// outpoint (needed for the utxo index) + nHeight + fCoinBase
+static constexpr size_t PER_UTXO_OVERHEAD =
+    sizeof(COutPoint) + sizeof(uint32_t) + sizeof(bool);
+
+template <typename T> static inline bool SetHasKeys(const std::set<T> &set) {
+    return false;
+}
+template <typename T, typename Tk, typename... Args>
+static inline bool SetHasKeys(const std::set<T> &set, const Tk &key,
+                              const Args &...args) {
+    return (set.count(key) != 0) || SetHasKeys(set, args...);
+}
+
+CBlockStats ComputeBlockStats(const CBlock &block, const CBlockUndo &blockUndo,
+                              const CBlockIndex &index,
+                              const Consensus::Params &params,
+                              int64_t max_block_size,
+                              const std::set<std::string> &selected) {
+    // Calculate everything if nothing selected (default)
+    const bool do_all = selected.size() == 0;
+    const bool do_mediantxsize = do_all || selected.count("mediantxsize") != 0;
+    const bool do_medianfee = do_all || selected.count("medianfee") != 0;
+    const bool do_medianfeerate =
+        do_all || selected.count("medianfeerate") != 0;
+    const bool loop_inputs =
+        do_all || do_medianfee || do_medianfeerate ||
+        SetHasKeys(selected, "utxo_size_inc", "totalfee", "avgfee",
+                   "avgfeerate", "minfee", "maxfee", "minfeerate",
+                   "maxfeerate");
+    const bool loop_outputs =
+        do_all || loop_inputs || selected.count("total_out");
+    const bool do_calculate_size =
+        do_mediantxsize || loop_inputs ||
+        SetHasKeys(selected, "total_size", "avgtxsize", "mintxsize",
+                   "maxtxsize");
+
+    Amount maxfee = Amount::zero();
+    Amount maxfeerate = Amount::zero();
+    Amount minfee = MAX_MONEY;
+    Amount minfeerate = MAX_MONEY;
+    Amount total_out = Amount::zero();
+    Amount totalfee = Amount::zero();
+    int64_t inputs = 0;
+    int64_t maxtxsize = 0;
+    int64_t mintxsize = max_block_size;
+    int64_t outputs = 0;
+    int64_t total_size = 0;
+    int64_t utxo_size_inc = 0;
+    std::vector<Amount> fee_array;
+    std::vector<Amount> feerate_array;
+    std::vector<int64_t> txsize_array;
+
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const auto &tx = block.vtx.at(i);
+        outputs += tx->vout.size();
+        Amount tx_total_out = Amount::zero();
+        if (loop_outputs) {
+            for (const CTxOut &out : tx->vout) {
+                tx_total_out += out.nValue;
+                utxo_size_inc +=
+                    GetSerializeSize(out, PROTOCOL_VERSION) + PER_UTXO_OVERHEAD;
+            }
+        }
+
+        if (tx->IsCoinBase()) {
+            continue;
+        }
+
+        // Don't count coinbase's fake input
+        inputs += tx->vin.size();
+        // Don't count coinbase reward
+        total_out += tx_total_out;
+
+        int64_t tx_size = 0;
+        if (do_calculate_size) {
+            tx_size = tx->GetTotalSize();
+            if (do_mediantxsize) {
+                txsize_array.push_back(tx_size);
+            }
+            maxtxsize = std::max(maxtxsize, tx_size);
+            mintxsize = std::min(mintxsize, tx_size);
+            total_size += tx_size;
+        }
+
+        if (loop_inputs) {
+            Amount tx_total_in = Amount::zero();
+            const auto &txundo = blockUndo.vtxundo.at(i - 1);
+            for (const Coin &coin : txundo.vprevout) {
+                const CTxOut &prevoutput = coin.GetTxOut();
+
+                tx_total_in += prevoutput.nValue;
+                utxo_size_inc -=
+                    GetSerializeSize(prevoutput, PROTOCOL_VERSION) +
+                    PER_UTXO_OVERHEAD;
+            }
+
+            Amount txfee = tx_total_in - tx_total_out;
+            CHECK_NONFATAL(MoneyRange(txfee));
+            if (do_medianfee) {
+                fee_array.push_back(txfee);
+            }
+            maxfee = std::max(maxfee, txfee);
+            minfee = std::min(minfee, txfee);
+            totalfee += txfee;
+
+            Amount feerate = txfee / tx_size;
+            if (do_medianfeerate) {
+                feerate_array.push_back(feerate);
+            }
+            maxfeerate = std::max(maxfeerate, feerate);
+            minfeerate = std::min(minfeerate, feerate);
+        }
+    }
+
+    CBlockStats stats;
+    stats.blockhash = index.GetBlockHash();
+    stats.height = index.nHeight;
+    stats.time = index.GetBlockTime();
+    stats.mediantime = index.GetMedianTimePast();
+    stats.txs = block.vtx.size();
+    stats.ins = inputs;
+    stats.outs = outputs;
+    stats.utxo_increase = outputs - inputs;
+    stats.utxo_size_inc = utxo_size_inc;
+    stats.subsidy = GetBlockSubsidy(index.nHeight, params);
+    stats.total_out = total_out;
+    stats.totalfee = totalfee;
+    stats.avgfee = block.vtx.size() > 1
+                       ? (totalfee / int((block.vtx.size() - 1)))
+                       : Amount::zero();
+    stats.minfee = minfee == MAX_MONEY ? Amount::zero() : minfee;
+    stats.maxfee = maxfee;
+    stats.medianfee = CalculateTruncatedMedian(fee_array);
+    stats.avgfeerate =
+        total_size > 0 ? (totalfee / total_size) : Amount::zero();
+    stats.minfeerate = minfeerate == MAX_MONEY ? Amount::zero() : minfeerate;
+    stats.maxfeerate = maxfeerate;
+    stats.medianfeerate = CalculateTruncatedMedian(feerate_array);
+    stats.total_size = total_size;
+    stats.avgtxsize =
+        block.vtx.size() > 1 ? total_size / (block.vtx.size() - 1) : 0;
+    stats.mintxsize = mintxsize == max_block_size ? 0 : mintxsize;
+    stats.maxtxsize = maxtxsize;
+    stats.mediantxsize = CalculateTruncatedMedian(txsize_array);
+    return stats;
+}
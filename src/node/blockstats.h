@@ -0,0 +1,86 @@
+// Copyright (c) 2017-2019 The Bitcoin Core developers
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKSTATS_H
+#define BITCOIN_NODE_BLOCKSTATS_H
+
+#include <amount.h>
+#include <primitives/blockhash.h>
+#include <serialize.h>
+
+#include <cstdint>
+#include <set>
+#include <string>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+
+namespace Consensus {
+struct Params;
+}
+
+/**
+ * Per block statistics, as returned by the getblockstats RPC. All sizes are
+ * in bytes and all feerates in satoshis per byte.
+ */
+struct CBlockStats {
+    BlockHash blockhash{};
+    int height{0};
+    int64_t time{0};
+    int64_t mediantime{0};
+
+    int64_t txs{0};
+    int64_t ins{0};
+    int64_t outs{0};
+    int64_t utxo_increase{0};
+    int64_t utxo_size_inc{0};
+
+    Amount subsidy{Amount::zero()};
+    Amount total_out{Amount::zero()};
+    Amount totalfee{Amount::zero()};
+    Amount avgfee{Amount::zero()};
+    Amount minfee{Amount::zero()};
+    Amount maxfee{Amount::zero()};
+    Amount medianfee{Amount::zero()};
+    Amount avgfeerate{Amount::zero()};
+    Amount minfeerate{Amount::zero()};
+    Amount maxfeerate{Amount::zero()};
+    Amount medianfeerate{Amount::zero()};
+
+    int64_t total_size{0};
+    int64_t avgtxsize{0};
+    int64_t mintxsize{0};
+    int64_t maxtxsize{0};
+    int64_t mediantxsize{0};
+
+    SERIALIZE_METHODS(CBlockStats, obj) {
+        READWRITE(obj.blockhash, obj.height, obj.time, obj.mediantime,
+                  obj.txs, obj.ins, obj.outs, obj.utxo_increase,
+                  obj.utxo_size_inc, obj.subsidy, obj.total_out, obj.totalfee,
+                  obj.avgfee, obj.minfee, obj.maxfee, obj.medianfee,
+                  obj.avgfeerate, obj.minfeerate, obj.maxfeerate,
+                  obj.medianfeerate, obj.total_size, obj.avgtxsize,
+                  obj.mintxsize, obj.maxtxsize, obj.mediantxsize);
+    }
+};
+
+/**
+ * Compute the statistics of a block from its content and undo data. The undo
+ * data is only used to compute the fees and can be left empty for a block
+ * that only contains a coinbase, such as the genesis block.
+ *
+ * Only the statistics named in selected are computed, all of them if it is
+ * empty; the others are left at zero. mintxsize is reported as 0 when there
+ * are no transactions besides the coinbase, or none smaller than
+ * max_block_size.
+ */
+CBlockStats ComputeBlockStats(const CBlock &block, const CBlockUndo &blockUndo,
+                              const CBlockIndex &index,
+                              const Consensus::Params &params,
+                              int64_t max_block_size,
+                              const std::set<std::string> &selected = {});
+
+#endif // BITCOIN_NODE_BLOCKSTATS_H
@@ -43,17 +43,28 @@ static void ApplyHash(CCoinsStats &stats, std::nullptr_t, const TxId &txid,
                       const std::map<uint32_t, Coin> &outputs,
                       std::map<uint32_t, Coin>::const_iterator it) {}
 
-static void ApplyHash(CCoinsStats &stats, MuHash3072 &muhash, const TxId &txid,
-                      const std::map<uint32_t, Coin> &outputs,
-                      std::map<uint32_t, Coin>::const_iterator it) {
-    COutPoint outpoint = COutPoint(txid, it->first);
-    Coin coin = it->second;
-
+static CDataStream TxOutSer(const COutPoint &outpoint, const Coin &coin) {
     CDataStream ss(SER_DISK, PROTOCOL_VERSION);
     ss << outpoint;
     ss << static_cast<uint32_t>(coin.GetHeight() * 2 + coin.IsCoinBase());
     ss << coin.GetTxOut();
-    muhash.Insert(MakeUCharSpan(ss));
+    return ss;
+}
+
+void ApplyCoinHash(MuHash3072 &muhash, const COutPoint &outpoint,
+                   const Coin &coin) {
+    muhash.Insert(MakeUCharSpan(TxOutSer(outpoint, coin)));
+}
+
+void RemoveCoinHash(MuHash3072 &muhash, const COutPoint &outpoint,
+                    const Coin &coin) {
+    muhash.Remove(MakeUCharSpan(TxOutSer(outpoint, coin)));
+}
+
+static void ApplyHash(CCoinsStats &stats, MuHash3072 &muhash, const TxId &txid,
+                      const std::map<uint32_t, Coin> &outputs,
+                      std::map<uint32_t, Coin>::const_iterator it) {
+    ApplyCoinHash(muhash, COutPoint(txid, it->first), it->second);
 }
 
 template <typename T>
@@ -14,6 +14,9 @@
 #include <functional>
 
 class CCoinsView;
+class COutPoint;
+class Coin;
+class MuHash3072;
 
 enum class CoinStatsHashType {
     HASH_SERIALIZED,
@@ -40,4 +43,11 @@ bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats,
                   const CoinStatsHashType hash_type,
                   const std::function<void()> &interruption_point = {});
 
+//! Add or remove a coin from a MuHash of the UTXO set, as computed by
+//! GetUTXOStats with CoinStatsHashType::MUHASH.
+void ApplyCoinHash(MuHash3072 &muhash, const COutPoint &outpoint,
+                   const Coin &coin);
+void RemoveCoinHash(MuHash3072 &muhash, const COutPoint &outpoint,
+                    const Coin &coin);
+
 #endif // BITCOIN_NODE_COINSTATS_H
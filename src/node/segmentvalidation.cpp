@@ -0,0 +1,542 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/segmentvalidation.h>
+
+#include <blockdb.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <coins.h>
+#include <config.h>
+#include <consensus/validation.h>
+#include <crypto/muhash.h>
+#include <logging.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
+#include <shutdown.h>
+#include <streams.h>
+#include <tinyformat.h>
+#include <txdb.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+//! Cache of the coins database of each segment
+static constexpr size_t SEGMENT_DB_CACHE_SIZE = 8 << 20;
+//! The coins cache of a segment is flushed when it grows above this size
+static constexpr size_t SEGMENT_COINS_CACHE_SIZE = 64 << 20;
+
+int64_t g_segment_snapshot_interval{DEFAULT_SEGMENT_SNAPSHOT_INTERVAL};
+int g_segment_snapshots_kept{DEFAULT_SEGMENT_SNAPSHOTS_KEPT};
+
+/**
+ * Held while the chain segments are validated, so that the snapshots they
+ * start from are not pruned meanwhile.
+ */
+static Mutex g_segment_validation_mutex;
+
+fs::path GetSegmentSnapshotsDir() {
+    return GetDataDir() / "segments";
+}
+
+bool IsSegmentSnapshotHeight(int height) {
+    return g_segment_snapshot_interval > 0 && height > 0 &&
+           height % g_segment_snapshot_interval == 0;
+}
+
+/** Remove the snapshots of the lowest heights, keeping the last `keep`. */
+static void PruneSegmentSnapshots(const fs::path &dir, int keep) {
+    TRY_LOCK(g_segment_validation_mutex, lock);
+    if (!lock) {
+        // The next snapshot prunes them instead.
+        return;
+    }
+
+    std::map<int32_t, fs::path> snapshots;
+    for (const auto &entry : fs::directory_iterator(dir)) {
+        const std::string name = fs::PathToString(entry.path().filename());
+        int32_t height;
+        if (name.size() > 9 && name.compare(0, 5, "utxo-") == 0 &&
+            name.compare(name.size() - 4, 4, ".dat") == 0 &&
+            ParseInt32(name.substr(5, name.size() - 9), &height)) {
+            snapshots.emplace(height, entry.path());
+        }
+    }
+
+    for (auto it = snapshots.begin();
+         snapshots.size() > size_t(std::max(keep, 1));
+         it = snapshots.erase(it)) {
+        LogPrint(BCLog::VALIDATION, "Removing segment snapshot %s\n",
+                 it->second.u8string());
+        fs::remove(it->second);
+    }
+}
+
+namespace {
+/** Writes the segment snapshots on a background thread, one at a time. */
+class SegmentSnapshotWriter {
+private:
+    struct Job {
+        std::unique_ptr<CCoinsViewCursor> cursor;
+        SnapshotMetadata metadata;
+        int height;
+        fs::path dir;
+    };
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Job> m_jobs GUARDED_BY(m_mutex);
+    bool m_writing GUARDED_BY(m_mutex){false};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
+
+    bool Interrupted() {
+        LOCK(m_mutex);
+        return m_stop;
+    }
+
+    bool Write(Job &job, std::string &error) {
+        const fs::path path = job.dir / strprintf("utxo-%d.dat", job.height);
+        const fs::path temppath =
+            job.dir / strprintf("utxo-%d.dat.incomplete", job.height);
+        try {
+            fs::create_directories(job.dir);
+            CAutoFile afile{fsbridge::fopen(temppath, "wb"), SER_DISK,
+                            CLIENT_VERSION};
+            if (afile.IsNull()) {
+                error = "Unable to open " + temppath.u8string();
+                return false;
+            }
+
+            // The coins are counted as they are written, the metadata is
+            // written again with the count at the end.
+            afile << job.metadata;
+            COutPoint key;
+            Coin coin;
+            for (CCoinsViewCursor &cursor = *job.cursor; cursor.Valid();
+                 cursor.Next()) {
+                if (job.metadata.m_coins_count % 10000 == 0 && Interrupted()) {
+                    afile.fclose();
+                    fs::remove(temppath);
+                    error = "Interrupted";
+                    return false;
+                }
+                if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+                    error = "Unable to read the UTXO set";
+                    return false;
+                }
+                afile << key;
+                afile << coin;
+                ++job.metadata.m_coins_count;
+            }
+            if (fseek(afile.Get(), 0, SEEK_SET) != 0) {
+                error = "Unable to write " + temppath.u8string();
+                return false;
+            }
+            afile << job.metadata;
+            if (!FileCommit(afile.Get())) {
+                error = "Unable to write " + temppath.u8string();
+                return false;
+            }
+            afile.fclose();
+            fs::rename(temppath, path);
+        } catch (const std::exception &e) {
+            error = e.what();
+            return false;
+        }
+
+        PruneSegmentSnapshots(job.dir, g_segment_snapshots_kept);
+        return true;
+    }
+
+    void ThreadWrite() {
+        util::ThreadRename("segsnap");
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                return m_stop || !m_jobs.empty();
+            });
+            if (m_stop) {
+                return;
+            }
+            Job job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_writing = true;
+
+            std::string error;
+            bool written;
+            {
+                REVERSE_LOCK(lock);
+                written = Write(job, error);
+                // The cursor pins the coins database, release it right away.
+                job.cursor.reset();
+            }
+            if (!written) {
+                LogPrintf("Failed to write the segment snapshot at height %d: "
+                          "%s\n",
+                          job.height, error);
+            }
+
+            m_writing = false;
+            m_cond.notify_all();
+        }
+    }
+
+public:
+    ~SegmentSnapshotWriter() { Stop(); }
+
+    void Queue(std::unique_ptr<CCoinsViewCursor> cursor,
+               const SnapshotMetadata &metadata, int height,
+               const fs::path &dir) {
+        LOCK(m_mutex);
+        if (!m_thread.joinable()) {
+            m_stop = false;
+            m_thread = std::thread(&SegmentSnapshotWriter::ThreadWrite, this);
+        }
+        m_jobs.push_back({std::move(cursor), metadata, height, dir});
+        m_cond.notify_all();
+    }
+
+    void Wait() {
+        WAIT_LOCK(m_mutex, lock);
+        m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+            return m_stop || (m_jobs.empty() && !m_writing);
+        });
+    }
+
+    void Stop() {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+            m_cond.notify_all();
+        }
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        LOCK(m_mutex);
+        m_jobs.clear();
+    }
+};
+} // namespace
+
+static SegmentSnapshotWriter g_segment_snapshot_writer;
+
+bool QueueSegmentSnapshot(const CCoinsViewDB &db, const CBlockIndex &tip,
+                          std::string &error) {
+    // The cursor iterates over a snapshot of the coins database, which stays
+    // at the tip while the chainstate moves on.
+    std::unique_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+    if (pcursor->GetBestBlock() != tip.GetBlockHash()) {
+        error = "The coins database is not flushed up to the tip";
+        return false;
+    }
+
+    g_segment_snapshot_writer.Queue(
+        std::move(pcursor),
+        SnapshotMetadata{tip.GetBlockHash(), 0,
+                         uint64_t(tip.GetChainTxCount())},
+        tip.nHeight, GetSegmentSnapshotsDir());
+    return true;
+}
+
+void WaitForSegmentSnapshots() {
+    g_segment_snapshot_writer.Wait();
+}
+
+void StopSegmentSnapshotWriter() {
+    g_segment_snapshot_writer.Stop();
+}
+
+static uint256 FinalizeMuHash(MuHash3072 muhash) {
+    uint256 out;
+    muhash.Finalize(out);
+    return out;
+}
+
+/**
+ * Connect the blocks of a segment on a fresh coins database, starting from the
+ * snapshot, and compute the MuHash of the UTXO set at both ends.
+ *
+ * @throws std::runtime_error if the blocks can't be connected.
+ */
+static void ValidateSegment(const Config &config, CChainState &chainstate,
+                            const std::vector<CBlockIndex *> &blocks,
+                            const fs::path &snapshot, const fs::path &db_path,
+                            ChainSegment &segment) {
+    const CChainParams &params = config.GetChainParams();
+    CCoinsViewDB db(db_path, SEGMENT_DB_CACHE_SIZE, /* fMemory */ false,
+                    /* fWipe */ true);
+    CCoinsViewCache view(&db);
+    MuHash3072 muhash;
+
+    auto flush_if_needed = [&]() {
+        if (view.DynamicMemoryUsage() > SEGMENT_COINS_CACHE_SIZE &&
+            !view.Flush()) {
+            throw std::runtime_error("Failed to flush the coins cache");
+        }
+    };
+
+    if (segment.start_height > 0) {
+        CAutoFile afile{fsbridge::fopen(snapshot, "rb"), SER_DISK,
+                        CLIENT_VERSION};
+        if (afile.IsNull()) {
+            throw std::runtime_error("Unable to open " + snapshot.u8string());
+        }
+        SnapshotMetadata metadata;
+        afile >> metadata;
+        for (uint64_t i = 0; i < metadata.m_coins_count; ++i) {
+            if (i % 10000 == 0 && ShutdownRequested()) {
+                throw std::runtime_error("Interrupted");
+            }
+            COutPoint outpoint;
+            Coin coin;
+            afile >> outpoint;
+            afile >> coin;
+            if (coin.IsSpent()) {
+                throw std::runtime_error(strprintf(
+                    "Spent coin %s in the snapshot", outpoint.ToString()));
+            }
+            ApplyCoinHash(muhash, outpoint, coin);
+            view.AddCoin(outpoint, std::move(coin),
+                         /* possible_overwrite */ false);
+            flush_if_needed();
+        }
+    }
+    view.SetBestBlock(blocks[segment.start_height]->GetBlockHash());
+    segment.start_muhash = FinalizeMuHash(muhash);
+
+    for (int height = segment.start_height + 1; height <= segment.end_height;
+         ++height) {
+        if (ShutdownRequested()) {
+            throw std::runtime_error("Interrupted");
+        }
+
+        CBlockIndex *pindex = blocks[height];
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, params.GetConsensus())) {
+            throw std::runtime_error(
+                strprintf("Can't read block %s from disk",
+                          pindex->GetBlockHash().ToString()));
+        }
+
+        // Remove the coins the block spends from the MuHash, which also
+        // loads them into the cache before taking cs_main. The coins both
+        // created and spent by the block are not in the view yet and never
+        // make it to the UTXO set. The coinbase can overwrite an unspent
+        // coinbase at the two heights exempted from BIP30.
+        for (const auto &ptx : block.vtx) {
+            if (ptx->IsCoinBase()) {
+                for (uint32_t i = 0; i < ptx->vout.size(); ++i) {
+                    const COutPoint outpoint(ptx->GetId(), i);
+                    const Coin &coin = view.AccessCoin(outpoint);
+                    if (!coin.IsSpent()) {
+                        RemoveCoinHash(muhash, outpoint, coin);
+                    }
+                }
+                continue;
+            }
+            for (const CTxIn &in : ptx->vin) {
+                const Coin &coin = view.AccessCoin(in.prevout);
+                if (!coin.IsSpent()) {
+                    RemoveCoinHash(muhash, in.prevout, coin);
+                }
+            }
+        }
+
+        {
+            LOCK(cs_main);
+            BlockValidationState state;
+            if (!chainstate.ConnectBlock(
+                    block, state, pindex, view, params,
+                    BlockValidationOptions(config).withForceScriptChecks())) {
+                throw std::runtime_error(
+                    strprintf("ConnectBlock failed at height %d: %s", height,
+                              state.ToString()));
+            }
+        }
+
+        for (const auto &ptx : block.vtx) {
+            for (uint32_t i = 0; i < ptx->vout.size(); ++i) {
+                if (ptx->vout[i].scriptPubKey.IsUnspendable()) {
+                    continue;
+                }
+                const COutPoint outpoint(ptx->GetId(), i);
+                const Coin &coin = view.AccessCoin(outpoint);
+                if (!coin.IsSpent()) {
+                    ApplyCoinHash(muhash, outpoint, coin);
+                }
+            }
+        }
+
+        flush_if_needed();
+    }
+
+    segment.end_muhash = FinalizeMuHash(muhash);
+}
+
+SegmentValidationResult ValidateChainSegments(const Config &config,
+                                              CChainState &chainstate,
+                                              const fs::path &snapshot_dir,
+                                              const fs::path &work_dir,
+                                              int n_threads) {
+    TRY_LOCK(g_segment_validation_mutex, lock);
+    if (!lock) {
+        throw std::runtime_error(
+            "The chain segments are already being validated");
+    }
+
+    // Start from the snapshots queued so far, and from a clean work
+    // directory in case a previous validation was interrupted.
+    WaitForSegmentSnapshots();
+    fs::remove_all(work_dir);
+
+    SegmentValidationResult result;
+    std::vector<CBlockIndex *> blocks;
+    std::map<int, fs::path> snapshots;
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+
+    {
+        // The cursor iterates over a snapshot of the coins database, which
+        // stays at the tip taken here while the chainstate moves on.
+        LOCK(cs_main);
+        chainstate.ForceFlushStateToDisk();
+        pcursor.reset(chainstate.CoinsDB().Cursor());
+
+        const CChain &chain = chainstate.m_chain;
+        blocks.reserve(chain.Height() + 1);
+        for (int height = 0; height <= chain.Height(); ++height) {
+            blocks.push_back(chain[height]);
+        }
+
+        // Only keep the snapshots of blocks in the chain, the others may
+        // have been taken before a reorg.
+        if (fs::is_directory(snapshot_dir)) {
+            for (const auto &entry : fs::directory_iterator(snapshot_dir)) {
+                if (!fs::is_regular_file(entry.path()) ||
+                    entry.path().extension() != ".dat") {
+                    continue;
+                }
+                CAutoFile afile{fsbridge::fopen(entry.path(), "rb"), SER_DISK,
+                                CLIENT_VERSION};
+                SnapshotMetadata metadata;
+                try {
+                    afile >> metadata;
+                } catch (const std::exception &) {
+                    continue;
+                }
+                const CBlockIndex *pindex =
+                    chainstate.m_blockman.LookupBlockIndex(
+                        metadata.m_base_blockhash);
+                if (pindex && pindex->nHeight > 0 && chain.Contains(pindex)) {
+                    snapshots[pindex->nHeight] = entry.path();
+                }
+            }
+        }
+    }
+
+    // The snapshot each segment starts from, none for the first one.
+    std::vector<fs::path> segment_snapshots;
+    const int tip_height = int(blocks.size()) - 1;
+    int start_height = 0;
+    fs::path start_snapshot;
+    for (const auto &snapshot : snapshots) {
+        result.segments.emplace_back(start_height, snapshot.first);
+        segment_snapshots.push_back(start_snapshot);
+        start_height = snapshot.first;
+        start_snapshot = snapshot.second;
+    }
+    if (start_height < tip_height) {
+        result.segments.emplace_back(start_height, tip_height);
+        segment_snapshots.push_back(start_snapshot);
+    }
+
+    // Each task validates a segment, the last one hashes the UTXO set of the
+    // chainstate. Failed segments don't stop the others, so the result
+    // reports all of them.
+    const size_t n_tasks = result.segments.size() + 1;
+    std::atomic<size_t> next_task{0};
+    std::string target_error;
+
+    auto worker = [&]() {
+        for (size_t i = next_task++; i < n_tasks; i = next_task++) {
+            if (i == result.segments.size()) {
+                MuHash3072 muhash;
+                COutPoint key;
+                Coin coin;
+                for (; pcursor->Valid(); pcursor->Next()) {
+                    if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                        target_error = "Unable to read the UTXO set";
+                        break;
+                    }
+                    ApplyCoinHash(muhash, key, coin);
+                }
+                result.target_muhash = FinalizeMuHash(muhash);
+                continue;
+            }
+
+            ChainSegment &segment = result.segments[i];
+            const fs::path db_path =
+                work_dir / strprintf("segment-%d", segment.start_height);
+            try {
+                ValidateSegment(config, chainstate, blocks,
+                                segment_snapshots[i], db_path, segment);
+            } catch (const std::exception &e) {
+                segment.error = e.what();
+            }
+            fs::remove_all(db_path);
+        }
+    };
+
+    const size_t threads_count = std::min<size_t>(
+        std::clamp(n_threads, 1, MAX_SEGMENT_VALIDATION_THREADS), n_tasks);
+    std::vector<std::thread> threads;
+    threads.reserve(threads_count - 1);
+    for (size_t i = 1; i < threads_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    if (!target_error.empty()) {
+        result.error = target_error;
+        return result;
+    }
+
+    for (const ChainSegment &segment : result.segments) {
+        if (!segment.error.empty()) {
+            result.error =
+                strprintf("Segment [%d, %d]: %s", segment.start_height,
+                          segment.end_height, segment.error);
+            return result;
+        }
+    }
+
+    for (size_t i = 0; i < result.segments.size(); ++i) {
+        const ChainSegment &segment = result.segments[i];
+        const bool last = i + 1 == result.segments.size();
+        const uint256 &expected = last ? result.target_muhash
+                                       : result.segments[i + 1].start_muhash;
+        if (segment.end_muhash != expected) {
+            result.error = strprintf(
+                "The UTXO set at height %d does not match the %s",
+                segment.end_height, last ? "chainstate" : "snapshot");
+            return result;
+        }
+    }
+
+    return result;
+}
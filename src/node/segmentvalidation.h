@@ -0,0 +1,123 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_SEGMENTVALIDATION_H
+#define BITCOIN_NODE_SEGMENTVALIDATION_H
+
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CBlockIndex;
+class CChainState;
+class CCoinsViewDB;
+class Config;
+
+extern RecursiveMutex cs_main;
+
+/** Default for -segmentsnapshotinterval, 0 disables the segment snapshots. */
+static constexpr int64_t DEFAULT_SEGMENT_SNAPSHOT_INTERVAL = 0;
+/** Default for -segmentsnapshotkeep. */
+static constexpr int DEFAULT_SEGMENT_SNAPSHOTS_KEPT = 10;
+/** Maximum number of segments validated at the same time. */
+static constexpr int MAX_SEGMENT_VALIDATION_THREADS = 16;
+
+/**
+ * The chainstate writes a UTXO snapshot to GetSegmentSnapshotsDir() when it
+ * connects a block at a multiple of this height. 0 if disabled.
+ */
+extern int64_t g_segment_snapshot_interval;
+/**
+ * Number of segment snapshots kept, the ones of the lowest heights are removed
+ * when a new snapshot is written.
+ */
+extern int g_segment_snapshots_kept;
+
+fs::path GetSegmentSnapshotsDir();
+
+bool IsSegmentSnapshotHeight(int height);
+
+/**
+ * Write the coins database, which must have been flushed up to tip, as a UTXO
+ * snapshot in the dumptxoutset format. The file is named after the height of
+ * the tip and replaces any previous snapshot at that height.
+ *
+ * Only a cursor over the database is taken here, the snapshot is written by a
+ * background thread from this cursor while the chainstate moves on. The oldest
+ * snapshots are then removed to keep g_segment_snapshots_kept of them.
+ */
+bool QueueSegmentSnapshot(const CCoinsViewDB &db, const CBlockIndex &tip,
+                          std::string &error);
+
+/** Wait for the snapshots queued so far to be written. */
+void WaitForSegmentSnapshots();
+
+/**
+ * Stop the thread writing the snapshots, abandoning the ones not written yet.
+ * Must be called before the coins database is closed.
+ */
+void StopSegmentSnapshotWriter();
+
+/** A range of blocks validated from the UTXO set at its start height. */
+struct ChainSegment {
+    int start_height;
+    int end_height;
+    //! MuHash of the UTXO set at start_height, as loaded from the snapshot
+    uint256 start_muhash;
+    //! MuHash of the UTXO set after connecting the blocks of the segment
+    uint256 end_muhash;
+    //! Why the blocks could not be connected, empty on success
+    std::string error;
+
+    ChainSegment(int start_height_in, int end_height_in)
+        : start_height(start_height_in), end_height(end_height_in) {}
+};
+
+struct SegmentValidationResult {
+    //! Segments ordered by height, covering the chain from genesis
+    std::vector<ChainSegment> segments;
+    //! MuHash of the UTXO set of the chainstate, at the end of the last
+    //! segment
+    uint256 target_muhash;
+    //! The first failure, empty if the chain is valid
+    std::string error;
+
+    bool IsValid() const { return error.empty(); }
+};
+
+/**
+ * Validate the history of a chainstate in parallel segments.
+ *
+ * Only one validation runs at a time.
+ * @throws std::runtime_error if another one is in progress.
+ *
+ * The chain is split at the heights of the segment snapshots found in
+ * snapshot_dir that belong to it. Each segment is validated on its own
+ * coins database, in work_dir, starting from the UTXO set of the snapshot at
+ * its start (or the empty set at genesis) and connecting the blocks up to the
+ * start of the next segment.
+ *
+ * The snapshots are not trusted: the segments are chained by requiring the
+ * MuHash of the UTXO set each segment ends with to be the MuHash of the
+ * snapshot the next one starts from, and the last segment to end with the
+ * UTXO set of the chainstate. The chainstate is therefore valid if and only
+ * if every segment is, which lets the segments run concurrently. The scripts
+ * are checked even below the -assumevalid block.
+ *
+ * Reading the blocks, loading the snapshots and hashing the coins happens on
+ * up to n_threads threads, ConnectBlock runs under cs_main and uses the
+ * script check threads.
+ */
+SegmentValidationResult ValidateChainSegments(const Config &config,
+                                              CChainState &chainstate,
+                                              const fs::path &snapshot_dir,
+                                              const fs::path &work_dir,
+                                              int n_threads)
+    LOCKS_EXCLUDED(cs_main);
+
+#endif // BITCOIN_NODE_SEGMENTVALIDATION_H
@@ -52,6 +52,8 @@ const char *AVAPOLL = "avapoll";
 const char *AVARESPONSE = "avaresponse";
 const char *AVAPROOF = "avaproof";
 const char *GETAVAADDR = "getavaaddr";
+const char *ENCINIT = "encinit";
+const char *ENCACK = "encack";
 
 bool IsBlockLike(const std::string &strCommand) {
     return strCommand == NetMsgType::BLOCK ||
@@ -76,6 +78,7 @@ static const std::string allNetMessageTypes[] = {
     NetMsgType::CMPCTBLOCK,  NetMsgType::GETBLOCKTXN,  NetMsgType::BLOCKTXN,
     NetMsgType::GETCFILTERS, NetMsgType::CFILTER,      NetMsgType::GETCFHEADERS,
     NetMsgType::CFHEADERS,   NetMsgType::GETCFCHECKPT, NetMsgType::CFCHECKPT,
+    NetMsgType::ENCINIT,     NetMsgType::ENCACK,
 };
 static const std::vector<std::string>
     allNetMessageTypesVec(std::begin(allNetMessageTypes),
@@ -267,6 +270,8 @@ static std::string serviceFlagToStr(const size_t bit) {
             return "COMPACT_FILTERS";
         case NODE_AVALANCHE:
             return "AVALANCHE";
+        case NODE_P2P_V2:
+            return "P2P_V2";
         default:
             std::ostringstream stream;
             stream.imbue(std::locale::classic());
@@ -303,6 +303,21 @@ extern const char *AVAPROOF;
  */
 extern const char *GETAVAADDR;
 
+/**
+ * The encinit message starts the upgrade of the connection to the encrypted
+ * V2 transport. It is sent by the outbound peer once both peers advertised
+ * NODE_P2P_V2, and holds its compressed ephemeral public key.
+ */
+extern const char *ENCINIT;
+
+/**
+ * The encack message answers an encinit message with the compressed ephemeral
+ * public key of the inbound peer. Everything its sender sends after it is
+ * encrypted. The outbound peer answers with an empty encack and encrypts
+ * everything after it.
+ */
+extern const char *ENCACK;
+
 /**
  * Indicate if the message is used to transmit the content of a block.
  * These messages can be significantly larger than usual messages and therefore
@@ -363,6 +378,10 @@ enum ServiceFlags : uint64_t {
     // NODE_AVALANCHE means the node supports Bitcoin Cash's avalanche
     // preconsensus mechanism.
     NODE_AVALANCHE = (1 << 24),
+
+    // NODE_P2P_V2 means the node supports upgrading the connection to the
+    // encrypted V2 transport, with the encinit and encack messages.
+    NODE_P2P_V2 = (1 << 25),
 };
 
 /**
@@ -16,9 +16,13 @@
 #include <core_io.h>
 #include <hash.h>
 #include <index/blockfilterindex.h>
+#include <index/blockstatsindex.h>
 #include <network.h>
+#include <node/blockreplay.h>
+#include <node/blockstats.h>
 #include <node/coinstats.h>
 #include <node/context.h>
+#include <node/segmentvalidation.h>
 #include <node/utxo_snapshot.h>
 #include <policy/policy.h>
 #include <primitives/transaction.h>
@@ -31,17 +35,22 @@
 #include <undo.h>
 #include <util/ref.h>
 #include <util/strencodings.h>
+#include <util/string.h>
 #include <util/system.h>
 #include <util/translation.h>
+#include <util/workerpool.h>
 #include <validation.h>
 #include <validationinterface.h>
 #include <versionbitsinfo.h> // For VersionBitsDeploymentInfo
 #include <warnings.h>
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 
 struct CUpdatedBlock {
     BlockHash hash;
@@ -160,16 +169,18 @@ UniValue blockToJSON(const CBlock &block, const CBlockIndex *tip,
     result.pushKV("versionHex", strprintf("%08x", block.nVersion));
     result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
     UniValue txs(UniValue::VARR);
+    txs.reserve(block.vtx.size());
+    const int serialize_flags = RPCSerializationFlags();
     for (const auto &tx : block.vtx) {
         if (txDetails) {
             UniValue objTx(UniValue::VOBJ);
-            TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
-            txs.push_back(objTx);
+            TxToUniv(*tx, uint256(), objTx, true, serialize_flags);
+            txs.push_back(std::move(objTx));
         } else {
             txs.push_back(tx->GetId().GetHex());
         }
     }
-    result.pushKV("tx", txs);
+    result.pushKV("tx", std::move(txs));
     result.pushKV("time", block.GetBlockTime());
     result.pushKV("mediantime", int64_t(blockindex->GetMedianTimePast()));
     result.pushKV("nonce", uint64_t(block.nNonce));
@@ -695,6 +706,104 @@ static RPCHelpMan getrawmempool() {
     };
 }
 
+static RPCHelpMan getmempoolchanges() {
+    return RPCHelpMan{
+        "getmempoolchanges",
+        "Returns the transactions added to and removed from the memory pool "
+        "since the given mempool sequence number, to keep a copy of the "
+        "transaction ids returned by getrawmempool up to date.\n"
+        "Transactions both added and removed in the meantime are omitted. "
+        "The call fails when the changes are too old to be known, the memory "
+        "pool must be listed again with getrawmempool in that case.\n",
+        {
+            {"mempool_sequence", RPCArg::Type::NUM, RPCArg::Optional::NO,
+             "The mempool sequence number returned by getrawmempool or by a "
+             "previous call"},
+        },
+        RPCResult{RPCResult::Type::OBJ,
+                  "",
+                  "",
+                  {
+                      {RPCResult::Type::ARR,
+                       "added",
+                       "The transactions added to the memory pool",
+                       {
+                           {RPCResult::Type::STR_HEX, "",
+                            "The transaction id"},
+                       }},
+                      {RPCResult::Type::ARR,
+                       "removed",
+                       "The transactions removed from the memory pool",
+                       {
+                           {RPCResult::Type::STR_HEX, "",
+                            "The transaction id"},
+                       }},
+                      {RPCResult::Type::NUM, "mempool_sequence",
+                       "The mempool sequence number to pass to the next "
+                       "call"},
+                  }},
+        RPCExamples{HelpExampleCli("getmempoolchanges", "42") +
+                    HelpExampleRpc("getmempoolchanges", "42")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            const int64_t since = request.params[0].get_int64();
+            if (since < 0) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER,
+                                   "Negative mempool sequence");
+            }
+
+            const CTxMemPool &mempool = EnsureMemPool(request.context);
+            std::vector<MempoolChange> changes;
+            uint64_t mempool_sequence;
+            {
+                LOCK(mempool.cs);
+                if (!mempool.GetChangesSince(since, changes)) {
+                    throw JSONRPCError(
+                        RPC_MISC_ERROR,
+                        strprintf("Mempool changes since sequence %d are not "
+                                  "available, use getrawmempool",
+                                  since));
+                }
+                mempool_sequence = mempool.GetSequence();
+            }
+
+            // Only the first and last change of each transaction matter: a
+            // transaction added then removed was neither in the mempool
+            // before nor is now.
+            std::vector<std::pair<TxId, std::pair<bool, bool>>> net_changes;
+            std::unordered_map<TxId, size_t, SaltedTxIdHasher> positions;
+            for (const MempoolChange &change : changes) {
+                auto it = positions.emplace(change.txid, net_changes.size());
+                if (it.second) {
+                    net_changes.emplace_back(
+                        change.txid,
+                        std::make_pair(change.added, change.added));
+                } else {
+                    net_changes[it.first->second].second.second = change.added;
+                }
+            }
+
+            UniValue added(UniValue::VARR);
+            UniValue removed(UniValue::VARR);
+            for (const auto &net_change : net_changes) {
+                const bool first_added = net_change.second.first;
+                const bool last_added = net_change.second.second;
+                if (first_added && last_added) {
+                    added.push_back(net_change.first.GetHex());
+                } else if (!first_added && !last_added) {
+                    removed.push_back(net_change.first.GetHex());
+                }
+            }
+
+            UniValue ret(UniValue::VOBJ);
+            ret.pushKV("added", added);
+            ret.pushKV("removed", removed);
+            ret.pushKV("mempool_sequence", mempool_sequence);
+            return ret;
+        },
+    };
+}
+
 static RPCHelpMan getmempoolancestors() {
     return RPCHelpMan{
         "getmempoolancestors",
@@ -1418,6 +1527,102 @@ RPCHelpMan gettxout() {
     };
 }
 
+static UniValue DBEngineStatsToJSON(const DBEngineStats &stats) {
+    UniValue levels(UniValue::VARR);
+    for (const DBEngineStats::Level &level : stats.levels) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("level", level.level);
+        entry.pushKV("files", level.files);
+        entry.pushKV("bytes", level.bytes);
+        entry.pushKV("compactions", level.compactions);
+        entry.pushKV("subcompactions", level.subcompactions);
+        entry.pushKV("compaction_time", level.compaction_micros / 1e6);
+        entry.pushKV("bytes_read", level.bytes_read);
+        entry.pushKV("bytes_written", level.bytes_written);
+        levels.push_back(entry);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("levels", levels);
+    ret.pushKV("slowdowns", stats.slowdowns);
+    ret.pushKV("slowdown_time", stats.slowdown_micros / 1e6);
+    ret.pushKV("memtable_waits", stats.memtable_waits);
+    ret.pushKV("memtable_wait_time", stats.memtable_wait_micros / 1e6);
+    ret.pushKV("level0_waits", stats.level0_waits);
+    ret.pushKV("level0_wait_time", stats.level0_wait_micros / 1e6);
+    return ret;
+}
+
+static RPCHelpMan getdbstats() {
+    const std::vector<RPCResult> db_stats{
+        {RPCResult::Type::ARR,
+         "levels",
+         "The levels of the database, empty if the storage engine has none",
+         {
+             {RPCResult::Type::OBJ,
+              "",
+              "",
+              {
+                  {RPCResult::Type::NUM, "level", "The level"},
+                  {RPCResult::Type::NUM, "files", "Number of files"},
+                  {RPCResult::Type::NUM, "bytes", "Size of the files"},
+                  {RPCResult::Type::NUM, "compactions",
+                   "Number of compactions that produced data in this level"},
+                  {RPCResult::Type::NUM, "subcompactions",
+                   "Number of key ranges these compactions were split into "
+                   "and merged concurrently"},
+                  {RPCResult::Type::NUM, "compaction_time",
+                   "Time spent in these compactions, in seconds"},
+                  {RPCResult::Type::NUM, "bytes_read",
+                   "Bytes read by these compactions"},
+                  {RPCResult::Type::NUM, "bytes_written",
+                   "Bytes written by these compactions"},
+              }},
+         }},
+        {RPCResult::Type::NUM, "slowdowns",
+         "Number of writes delayed to let compactions catch up"},
+        {RPCResult::Type::NUM, "slowdown_time",
+         "Time writes were delayed, in seconds"},
+        {RPCResult::Type::NUM, "memtable_waits",
+         "Number of times writes waited for the write buffer to be written "
+         "out"},
+        {RPCResult::Type::NUM, "memtable_wait_time",
+         "Time writes waited for the write buffer, in seconds"},
+        {RPCResult::Type::NUM, "level0_waits",
+         "Number of times writes waited for too many level 0 files to be "
+         "compacted"},
+        {RPCResult::Type::NUM, "level0_wait_time",
+         "Time writes waited for level 0 compactions, in seconds"},
+    };
+    return RPCHelpMan{
+        "getdbstats",
+        "Returns compaction and write stall statistics of the chainstate and "
+        "block index databases since the node started.\n",
+        {},
+        RPCResult{RPCResult::Type::OBJ,
+                  "",
+                  "",
+                  {
+                      {RPCResult::Type::OBJ, "chainstate",
+                       "The chainstate database", db_stats},
+                      {RPCResult::Type::OBJ, "blockindex",
+                       "The block index database", db_stats},
+                  }},
+        RPCExamples{HelpExampleCli("getdbstats", "") +
+                    HelpExampleRpc("getdbstats", "")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            LOCK(cs_main);
+            const CCoinsViewDB &coins_db = ::ChainstateActive().CoinsDB();
+            UniValue ret(UniValue::VOBJ);
+            ret.pushKV("chainstate", DBEngineStatsToJSON(coins_db.GetDBStats()));
+            ret.pushKV("blockindex",
+                       DBEngineStatsToJSON(pblocktree->GetStats()));
+            return ret;
+        },
+    };
+}
+
 static RPCHelpMan verifychain() {
     return RPCHelpMan{
         "verifychain",
@@ -1452,6 +1657,103 @@ static RPCHelpMan verifychain() {
     };
 }
 
+static RPCHelpMan verifychainsegments() {
+    return RPCHelpMan{
+        "verifychainsegments",
+        "Validates the active chain from genesis in parallel segments.\n"
+        "The chain is split at the heights of the UTXO snapshots written with "
+        "-segmentsnapshotinterval, and each segment connects its blocks from "
+        "the snapshot at its start. The snapshots are not trusted: the MuHash "
+        "of the UTXO set each segment ends with must match the snapshot the "
+        "next segment starts from, and the last one must match the UTXO set "
+        "of the chainstate.\n",
+        {
+            {"threads", RPCArg::Type::NUM,
+             /* default */ "the number of cores",
+             strprintf("The number of segments validated at the same time "
+                       "(up to %d)",
+                       MAX_SEGMENT_VALIDATION_THREADS)},
+        },
+        RPCResult{
+            RPCResult::Type::OBJ,
+            "",
+            "",
+            {
+                {RPCResult::Type::BOOL, "valid", "Verified or not"},
+                {RPCResult::Type::NUM, "height",
+                 "The height of the chain that was verified"},
+                {RPCResult::Type::STR_HEX, "muhash",
+                 "The MuHash of the UTXO set of the chainstate at that "
+                 "height"},
+                {RPCResult::Type::ARR,
+                 "segments",
+                 "",
+                 {
+                     {RPCResult::Type::OBJ,
+                      "",
+                      "",
+                      {
+                          {RPCResult::Type::NUM, "start_height",
+                           "The height of the UTXO set the segment starts "
+                           "from"},
+                          {RPCResult::Type::NUM, "end_height",
+                           "The height of the last block of the segment"},
+                          {RPCResult::Type::STR_HEX, "start_muhash",
+                           "The MuHash of the UTXO set at start_height"},
+                          {RPCResult::Type::STR_HEX, "end_muhash",
+                           "The MuHash of the UTXO set at end_height"},
+                          {RPCResult::Type::STR, "error", /* optional */ true,
+                           "Why the blocks could not be connected"},
+                      }},
+                 }},
+                {RPCResult::Type::STR, "error", /* optional */ true,
+                 "The first failure"},
+            }},
+        RPCExamples{HelpExampleCli("verifychainsegments", "") +
+                    HelpExampleRpc("verifychainsegments", "")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            const int threads{request.params[0].isNull()
+                                  ? GetNumCores()
+                                  : request.params[0].get_int()};
+            if (threads < 1) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER,
+                                   "The number of threads must be positive");
+            }
+
+            const fs::path snapshot_dir = GetSegmentSnapshotsDir();
+            const SegmentValidationResult result = ValidateChainSegments(
+                config, ::ChainstateActive(), snapshot_dir,
+                snapshot_dir / "validation", threads);
+
+            UniValue segments(UniValue::VARR);
+            for (const ChainSegment &segment : result.segments) {
+                UniValue obj(UniValue::VOBJ);
+                obj.pushKV("start_height", segment.start_height);
+                obj.pushKV("end_height", segment.end_height);
+                obj.pushKV("start_muhash", segment.start_muhash.GetHex());
+                obj.pushKV("end_muhash", segment.end_muhash.GetHex());
+                if (!segment.error.empty()) {
+                    obj.pushKV("error", segment.error);
+                }
+                segments.push_back(obj);
+            }
+
+            UniValue ret(UniValue::VOBJ);
+            ret.pushKV("valid", result.IsValid());
+            ret.pushKV("height", result.segments.empty()
+                                     ? 0
+                                     : result.segments.back().end_height);
+            ret.pushKV("muhash", result.target_muhash.GetHex());
+            ret.pushKV("segments", segments);
+            if (!result.IsValid()) {
+                ret.pushKV("error", result.error);
+            }
+            return ret;
+        },
+    };
+}
+
 static void BIP9SoftForkDescPushBack(UniValue &softforks,
                                      const Consensus::Params &consensusParams,
                                      Consensus::DeploymentPos id)
@@ -2239,33 +2541,136 @@ static RPCHelpMan getchaintxstats() {
     };
 }
 
-template <typename T>
-static T CalculateTruncatedMedian(std::vector<T> &scores) {
-    size_t size = scores.size();
-    if (size == 0) {
-        return T();
-    }
+/**
+ * The fields returned by getblockstats, also used for each element of the
+ * getblockstatsrange result.
+ */
+static std::vector<RPCResult> GetBlockStatsResultFields() {
+    const auto &ticker = Currency::get().ticker;
+    return {
+        {RPCResult::Type::NUM, "avgfee", "Average fee in the block"},
+        {RPCResult::Type::NUM, "avgfeerate",
+         "Average feerate (in satoshis per virtual byte)"},
+        {RPCResult::Type::NUM, "avgtxsize", "Average transaction size"},
+        {RPCResult::Type::STR_HEX, "blockhash",
+         "The block hash (to check for potential reorgs)"},
+        {RPCResult::Type::NUM, "height", "The height of the block"},
+        {RPCResult::Type::NUM, "ins",
+         "The number of inputs (excluding coinbase)"},
+        {RPCResult::Type::NUM, "maxfee", "Maximum fee in the block"},
+        {RPCResult::Type::NUM, "maxfeerate",
+         "Maximum feerate (in satoshis per virtual byte)"},
+        {RPCResult::Type::NUM, "maxtxsize", "Maximum transaction size"},
+        {RPCResult::Type::NUM, "medianfee",
+         "Truncated median fee in the block"},
+        {RPCResult::Type::NUM, "medianfeerate",
+         "Truncated median feerate (in " + ticker + " per byte)"},
+        {RPCResult::Type::NUM, "mediantime",
+         "The block median time past"},
+        {RPCResult::Type::NUM, "mediantxsize",
+         "Truncated median transaction size"},
+        {RPCResult::Type::NUM, "minfee", "Minimum fee in the block"},
+        {RPCResult::Type::NUM, "minfeerate",
+         "Minimum feerate (in satoshis per virtual byte)"},
+        {RPCResult::Type::NUM, "mintxsize", "Minimum transaction size"},
+        {RPCResult::Type::NUM, "outs", "The number of outputs"},
+        {RPCResult::Type::NUM, "subsidy", "The block subsidy"},
+        {RPCResult::Type::NUM, "time", "The block time"},
+        {RPCResult::Type::NUM, "total_out",
+         "Total amount in all outputs (excluding coinbase and thus "
+         "reward [ie subsidy + totalfee])"},
+        {RPCResult::Type::NUM, "total_size",
+         "Total size of all non-coinbase transactions"},
+        {RPCResult::Type::NUM, "totalfee", "The fee total"},
+        {RPCResult::Type::NUM, "txs",
+         "The number of transactions (including coinbase)"},
+        {RPCResult::Type::NUM, "utxo_increase",
+         "The increase/decrease in the number of unspent outputs"},
+        {RPCResult::Type::NUM, "utxo_size_inc",
+         "The increase/decrease in size for the utxo index (not "
+         "discounting op_return and similar)"},
+    };
+}
 
-    std::sort(scores.begin(), scores.end());
-    if (size % 2 == 0) {
-        return (scores[size / 2 - 1] + scores[size / 2]) / 2;
-    } else {
-        return scores[size / 2];
+static std::set<std::string> ParseSelectedStats(const UniValue &param) {
+    std::set<std::string> stats;
+    if (!param.isNull()) {
+        const UniValue stats_univalue = param.get_array();
+        for (unsigned int i = 0; i < stats_univalue.size(); i++) {
+            const std::string stat = stats_univalue[i].get_str();
+            stats.insert(stat);
+        }
     }
+    return stats;
 }
 
-template <typename T> static inline bool SetHasKeys(const std::set<T> &set) {
-    return false;
-}
-template <typename T, typename Tk, typename... Args>
-static inline bool SetHasKeys(const std::set<T> &set, const Tk &key,
-                              const Args &...args) {
-    return (set.count(key) != 0) || SetHasKeys(set, args...);
+/**
+ * Get the statistics of a block from the block statistics index if it is
+ * enabled and has them, or compute the selected ones from the block and undo
+ * data. The genesis block has no undo data, so it fails either way.
+ */
+static CBlockStats GetBlockStats(const Config &config,
+                                 const CBlockIndex *pindex,
+                                 const std::set<std::string> &selected) {
+    CBlockStats stats;
+    if (pindex->nHeight > 0 && g_blockstatsindex &&
+        g_blockstatsindex->LookupStats(pindex, stats)) {
+        return stats;
+    }
+
+    const CBlock block = GetBlockChecked(config, pindex);
+    const CBlockUndo blockUndo = GetUndoChecked(pindex);
+    return ComputeBlockStats(block, blockUndo, *pindex,
+                             config.GetChainParams().GetConsensus(),
+                             config.GetMaxBlockSize(), selected);
 }
 
-// outpoint (needed for the utxo index) + nHeight + fCoinBase
-static constexpr size_t PER_UTXO_OVERHEAD =
-    sizeof(COutPoint) + sizeof(uint32_t) + sizeof(bool);
+static UniValue BlockStatsToJSON(const CBlockStats &stats,
+                                 const std::set<std::string> &selected) {
+    UniValue ret_all(UniValue::VOBJ);
+    ret_all.pushKV("avgfee", stats.avgfee);
+    ret_all.pushKV("avgfeerate", stats.avgfeerate);
+    ret_all.pushKV("avgtxsize", stats.avgtxsize);
+    ret_all.pushKV("blockhash", stats.blockhash.GetHex());
+    ret_all.pushKV("height", int64_t(stats.height));
+    ret_all.pushKV("ins", stats.ins);
+    ret_all.pushKV("maxfee", stats.maxfee);
+    ret_all.pushKV("maxfeerate", stats.maxfeerate);
+    ret_all.pushKV("maxtxsize", stats.maxtxsize);
+    ret_all.pushKV("medianfee", stats.medianfee);
+    ret_all.pushKV("medianfeerate", stats.medianfeerate);
+    ret_all.pushKV("mediantime", stats.mediantime);
+    ret_all.pushKV("mediantxsize", stats.mediantxsize);
+    ret_all.pushKV("minfee", stats.minfee);
+    ret_all.pushKV("minfeerate", stats.minfeerate);
+    ret_all.pushKV("mintxsize", stats.mintxsize);
+    ret_all.pushKV("outs", stats.outs);
+    ret_all.pushKV("subsidy", stats.subsidy);
+    ret_all.pushKV("time", stats.time);
+    ret_all.pushKV("total_out", stats.total_out);
+    ret_all.pushKV("total_size", stats.total_size);
+    ret_all.pushKV("totalfee", stats.totalfee);
+    ret_all.pushKV("txs", stats.txs);
+    ret_all.pushKV("utxo_increase", stats.utxo_increase);
+    ret_all.pushKV("utxo_size_inc", stats.utxo_size_inc);
+
+    // Return everything if nothing selected (default)
+    if (selected.empty()) {
+        return ret_all;
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    for (const std::string &stat : selected) {
+        const UniValue &value = ret_all[stat];
+        if (value.isNull()) {
+            throw JSONRPCError(
+                RPC_INVALID_PARAMETER,
+                strprintf("Invalid selected statistic %s", stat));
+        }
+        ret.pushKV(stat, value);
+    }
+    return ret;
+}
 
 static RPCHelpMan getblockstats() {
     const auto &ticker = Currency::get().ticker;
@@ -2295,53 +2700,7 @@ static RPCHelpMan getblockstats() {
              },
              "stats"},
         },
-        RPCResult{
-            RPCResult::Type::OBJ,
-            "",
-            "",
-            {
-                {RPCResult::Type::NUM, "avgfee", "Average fee in the block"},
-                {RPCResult::Type::NUM, "avgfeerate",
-                 "Average feerate (in satoshis per virtual byte)"},
-                {RPCResult::Type::NUM, "avgtxsize", "Average transaction size"},
-                {RPCResult::Type::STR_HEX, "blockhash",
-                 "The block hash (to check for potential reorgs)"},
-                {RPCResult::Type::NUM, "height", "The height of the block"},
-                {RPCResult::Type::NUM, "ins",
-                 "The number of inputs (excluding coinbase)"},
-                {RPCResult::Type::NUM, "maxfee", "Maximum fee in the block"},
-                {RPCResult::Type::NUM, "maxfeerate",
-                 "Maximum feerate (in satoshis per virtual byte)"},
-                {RPCResult::Type::NUM, "maxtxsize", "Maximum transaction size"},
-                {RPCResult::Type::NUM, "medianfee",
-                 "Truncated median fee in the block"},
-                {RPCResult::Type::NUM, "medianfeerate",
-                 "Truncated median feerate (in " + ticker + " per byte)"},
-                {RPCResult::Type::NUM, "mediantime",
-                 "The block median time past"},
-                {RPCResult::Type::NUM, "mediantxsize",
-                 "Truncated median transaction size"},
-                {RPCResult::Type::NUM, "minfee", "Minimum fee in the block"},
-                {RPCResult::Type::NUM, "minfeerate",
-                 "Minimum feerate (in satoshis per virtual byte)"},
-                {RPCResult::Type::NUM, "mintxsize", "Minimum transaction size"},
-                {RPCResult::Type::NUM, "outs", "The number of outputs"},
-                {RPCResult::Type::NUM, "subsidy", "The block subsidy"},
-                {RPCResult::Type::NUM, "time", "The block time"},
-                {RPCResult::Type::NUM, "total_out",
-                 "Total amount in all outputs (excluding coinbase and thus "
-                 "reward [ie subsidy + totalfee])"},
-                {RPCResult::Type::NUM, "total_size",
-                 "Total size of all non-coinbase transactions"},
-                {RPCResult::Type::NUM, "totalfee", "The fee total"},
-                {RPCResult::Type::NUM, "txs",
-                 "The number of transactions (including coinbase)"},
-                {RPCResult::Type::NUM, "utxo_increase",
-                 "The increase/decrease in the number of unspent outputs"},
-                {RPCResult::Type::NUM, "utxo_size_inc",
-                 "The increase/decrease in size for the utxo index (not "
-                 "discounting op_return and similar)"},
-            }},
+        RPCResult{RPCResult::Type::OBJ, "", "", GetBlockStatsResultFields()},
         RPCExamples{
             HelpExampleCli(
                 "getblockstats",
@@ -2392,172 +2751,163 @@ static RPCHelpMan getblockstats() {
 
             CHECK_NONFATAL(pindex != nullptr);
 
-            std::set<std::string> stats;
-            if (!request.params[1].isNull()) {
-                const UniValue stats_univalue = request.params[1].get_array();
-                for (unsigned int i = 0; i < stats_univalue.size(); i++) {
-                    const std::string stat = stats_univalue[i].get_str();
-                    stats.insert(stat);
-                }
-            }
+            const std::set<std::string> stats =
+                ParseSelectedStats(request.params[1]);
+            return BlockStatsToJSON(GetBlockStats(config, pindex, stats),
+                                    stats);
+        },
+    };
+}
 
-            const CBlock block = GetBlockChecked(config, pindex);
-            const CBlockUndo blockUndo = GetUndoChecked(pindex);
-
-            // Calculate everything if nothing selected (default)
-            const bool do_all = stats.size() == 0;
-            const bool do_mediantxsize =
-                do_all || stats.count("mediantxsize") != 0;
-            const bool do_medianfee = do_all || stats.count("medianfee") != 0;
-            const bool do_medianfeerate =
-                do_all || stats.count("medianfeerate") != 0;
-            const bool loop_inputs =
-                do_all || do_medianfee || do_medianfeerate ||
-                SetHasKeys(stats, "utxo_size_inc", "totalfee", "avgfee",
-                           "avgfeerate", "minfee", "maxfee", "minfeerate",
-                           "maxfeerate");
-            const bool loop_outputs =
-                do_all || loop_inputs || stats.count("total_out");
-            const bool do_calculate_size =
-                do_mediantxsize || loop_inputs ||
-                SetHasKeys(stats, "total_size", "avgtxsize", "mintxsize",
-                           "maxtxsize");
-
-            const int64_t blockMaxSize = config.GetMaxBlockSize();
-            Amount maxfee = Amount::zero();
-            Amount maxfeerate = Amount::zero();
-            Amount minfee = MAX_MONEY;
-            Amount minfeerate = MAX_MONEY;
-            Amount total_out = Amount::zero();
-            Amount totalfee = Amount::zero();
-            int64_t inputs = 0;
-            int64_t maxtxsize = 0;
-            int64_t mintxsize = blockMaxSize;
-            int64_t outputs = 0;
-            int64_t total_size = 0;
-            int64_t utxo_size_inc = 0;
-            std::vector<Amount> fee_array;
-            std::vector<Amount> feerate_array;
-            std::vector<int64_t> txsize_array;
-
-            for (size_t i = 0; i < block.vtx.size(); ++i) {
-                const auto &tx = block.vtx.at(i);
-                outputs += tx->vout.size();
-                Amount tx_total_out = Amount::zero();
-                if (loop_outputs) {
-                    for (const CTxOut &out : tx->vout) {
-                        tx_total_out += out.nValue;
-                        utxo_size_inc +=
-                            GetSerializeSize(out, PROTOCOL_VERSION) +
-                            PER_UTXO_OVERHEAD;
-                    }
-                }
+/** Maximum number of threads used by getblockstatsrange. */
+static constexpr int MAX_BLOCKSTATS_THREADS = 16;
+/** Maximum number of blocks processed by a getblockstatsrange call. */
+static constexpr int MAX_BLOCKSTATS_RANGE = 10000;
 
-                if (tx->IsCoinBase()) {
-                    continue;
-                }
+static Mutex g_blockstats_workers_mutex;
+/**
+ * The worker threads of getblockstatsrange, started by the first call and
+ * reused by the next ones.
+ */
+static std::unique_ptr<WorkerPool>
+    g_blockstats_workers GUARDED_BY(g_blockstats_workers_mutex);
 
-                // Don't count coinbase's fake input
-                inputs += tx->vin.size();
-                // Don't count coinbase reward
-                total_out += tx_total_out;
+void StopBlockStatsWorkers() {
+    LOCK(g_blockstats_workers_mutex);
+    g_blockstats_workers.reset();
+}
 
-                int64_t tx_size = 0;
-                if (do_calculate_size) {
-                    tx_size = tx->GetTotalSize();
-                    if (do_mediantxsize) {
-                        txsize_array.push_back(tx_size);
-                    }
-                    maxtxsize = std::max(maxtxsize, tx_size);
-                    mintxsize = std::min(mintxsize, tx_size);
-                    total_size += tx_size;
-                }
+static RPCHelpMan getblockstatsrange() {
+    const auto &ticker = Currency::get().ticker;
+    return RPCHelpMan{
+        "getblockstatsrange",
+        "Compute per block statistics for a range of heights in the active "
+        "chain. The blocks are processed in parallel, at most " +
+            ToString(MAX_BLOCKSTATS_RANGE) +
+            " of them per call. All amounts are in " +
+            ticker +
+            ".\n"
+            "It won't work for some heights with pruning.\n",
+        {
+            {"start_height", RPCArg::Type::NUM, RPCArg::Optional::NO,
+             "The height of the first block in the range"},
+            {"end_height", RPCArg::Type::NUM, RPCArg::Optional::NO,
+             "The height of the last block in the range (inclusive)"},
+            {"stats",
+             RPCArg::Type::ARR,
+             /* default */ "all values",
+             "Values to plot (see getblockstats)",
+             {
+                 {"height", RPCArg::Type::STR, RPCArg::Optional::OMITTED,
+                  "Selected statistic"},
+                 {"time", RPCArg::Type::STR, RPCArg::Optional::OMITTED,
+                  "Selected statistic"},
+             },
+             "stats"},
+        },
+        RPCResult{RPCResult::Type::ARR,
+                  "",
+                  "",
+                  {
+                      {RPCResult::Type::OBJ, "", "",
+                       GetBlockStatsResultFields()},
+                  }},
+        RPCExamples{
+            HelpExampleCli("getblockstatsrange",
+                           R"(1000 2000 '["minfeerate","avgfeerate"]')") +
+            HelpExampleRpc("getblockstatsrange",
+                           R"(1000, 2000, ["minfeerate","avgfeerate"])")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            const int start_height = request.params[0].get_int();
+            const int end_height = request.params[1].get_int();
+            const std::set<std::string> stats =
+                ParseSelectedStats(request.params[2]);
 
-                if (loop_inputs) {
-                    Amount tx_total_in = Amount::zero();
-                    const auto &txundo = blockUndo.vtxundo.at(i - 1);
-                    for (const Coin &coin : txundo.vprevout) {
-                        const CTxOut &prevoutput = coin.GetTxOut();
+            std::vector<const CBlockIndex *> blocks;
+            {
+                LOCK(cs_main);
+                const int current_tip = ::ChainActive().Height();
+                if (start_height < 0) {
+                    throw JSONRPCError(
+                        RPC_INVALID_PARAMETER,
+                        strprintf("Start height %d is negative", start_height));
+                }
+                if (end_height < start_height) {
+                    throw JSONRPCError(
+                        RPC_INVALID_PARAMETER,
+                        strprintf("End height %d is before start height %d",
+                                  end_height, start_height));
+                }
+                if (end_height - start_height >= MAX_BLOCKSTATS_RANGE) {
+                    throw JSONRPCError(
+                        RPC_INVALID_PARAMETER,
+                        strprintf("Range of %d blocks exceeds the maximum of "
+                                  "%d",
+                                  end_height - start_height + 1,
+                                  MAX_BLOCKSTATS_RANGE));
+                }
+                if (end_height > current_tip) {
+                    throw JSONRPCError(
+                        RPC_INVALID_PARAMETER,
+                        strprintf("End height %d after current tip %d",
+                                  end_height, current_tip));
+                }
 
-                        tx_total_in += prevoutput.nValue;
-                        utxo_size_inc -=
-                            GetSerializeSize(prevoutput, PROTOCOL_VERSION) +
-                            PER_UTXO_OVERHEAD;
-                    }
+                blocks.reserve(end_height - start_height + 1);
+                for (int height = start_height; height <= end_height;
+                     ++height) {
+                    blocks.push_back(::ChainActive()[height]);
+                }
+            }
 
-                    Amount txfee = tx_total_in - tx_total_out;
-                    CHECK_NONFATAL(MoneyRange(txfee));
-                    if (do_medianfee) {
-                        fee_array.push_back(txfee);
-                    }
-                    maxfee = std::max(maxfee, txfee);
-                    minfee = std::min(minfee, txfee);
-                    totalfee += txfee;
+            // Blocks are read and processed by several workers, each picking
+            // the next height that has not been processed yet. The first
+            // error encountered stops all the workers and is reported.
+            std::vector<CBlockStats> results(blocks.size());
+            std::atomic<size_t> next_block{0};
+            std::atomic<bool> failed{false};
+            Mutex error_mutex;
+            UniValue error;
 
-                    Amount feerate = txfee / tx_size;
-                    if (do_medianfeerate) {
-                        feerate_array.push_back(feerate);
-                    }
-                    maxfeerate = std::max(maxfeerate, feerate);
-                    minfeerate = std::min(minfeerate, feerate);
+            // The calls are processed one at a time, each using all the
+            // workers.
+            {
+                LOCK(g_blockstats_workers_mutex);
+                if (!g_blockstats_workers) {
+                    g_blockstats_workers = std::make_unique<WorkerPool>(
+                        "blockstats",
+                        std::clamp(GetNumCores(), 1, MAX_BLOCKSTATS_THREADS));
                 }
+                g_blockstats_workers->Run([&](int) {
+                    for (size_t i = next_block++; i < blocks.size() && !failed;
+                         i = next_block++) {
+                        try {
+                            results[i] =
+                                GetBlockStats(config, blocks[i], stats);
+                        } catch (const UniValue &e) {
+                            LOCK(error_mutex);
+                            if (!failed.exchange(true)) {
+                                error = e;
+                            }
+                        } catch (const std::exception &e) {
+                            LOCK(error_mutex);
+                            if (!failed.exchange(true)) {
+                                error = JSONRPCError(RPC_MISC_ERROR, e.what());
+                            }
+                        }
+                    }
+                });
             }
 
-            UniValue ret_all(UniValue::VOBJ);
-            ret_all.pushKV("avgfee",
-                           block.vtx.size() > 1
-                               ? (totalfee / int((block.vtx.size() - 1)))
-                               : Amount::zero());
-            ret_all.pushKV("avgfeerate", total_size > 0
-                                             ? (totalfee / total_size)
-                                             : Amount::zero());
-            ret_all.pushKV("avgtxsize",
-                           (block.vtx.size() > 1)
-                               ? total_size / (block.vtx.size() - 1)
-                               : 0);
-            ret_all.pushKV("blockhash", pindex->GetBlockHash().GetHex());
-            ret_all.pushKV("height", (int64_t)pindex->nHeight);
-            ret_all.pushKV("ins", inputs);
-            ret_all.pushKV("maxfee", maxfee);
-            ret_all.pushKV("maxfeerate", maxfeerate);
-            ret_all.pushKV("maxtxsize", maxtxsize);
-            ret_all.pushKV("medianfee", CalculateTruncatedMedian(fee_array));
-            ret_all.pushKV("medianfeerate",
-                           CalculateTruncatedMedian(feerate_array));
-            ret_all.pushKV("mediantime", pindex->GetMedianTimePast());
-            ret_all.pushKV("mediantxsize",
-                           CalculateTruncatedMedian(txsize_array));
-            ret_all.pushKV("minfee",
-                           minfee == MAX_MONEY ? Amount::zero() : minfee);
-            ret_all.pushKV("minfeerate", minfeerate == MAX_MONEY
-                                             ? Amount::zero()
-                                             : minfeerate);
-            ret_all.pushKV("mintxsize",
-                           mintxsize == blockMaxSize ? 0 : mintxsize);
-            ret_all.pushKV("outs", outputs);
-            ret_all.pushKV("subsidy", GetBlockSubsidy(pindex->nHeight,
-                                                      Params().GetConsensus()));
-            ret_all.pushKV("time", pindex->GetBlockTime());
-            ret_all.pushKV("total_out", total_out);
-            ret_all.pushKV("total_size", total_size);
-            ret_all.pushKV("totalfee", totalfee);
-            ret_all.pushKV("txs", (int64_t)block.vtx.size());
-            ret_all.pushKV("utxo_increase", outputs - inputs);
-            ret_all.pushKV("utxo_size_inc", utxo_size_inc);
-
-            if (do_all) {
-                return ret_all;
+            if (failed) {
+                throw error;
             }
 
-            UniValue ret(UniValue::VOBJ);
-            for (const std::string &stat : stats) {
-                const UniValue &value = ret_all[stat];
-                if (value.isNull()) {
-                    throw JSONRPCError(
-                        RPC_INVALID_PARAMETER,
-                        strprintf("Invalid selected statistic %s", stat));
-                }
-                ret.pushKV(stat, value);
+            UniValue ret(UniValue::VARR);
+            ret.reserve(results.size());
+            for (const CBlockStats &blockstats : results) {
+                ret.push_back(BlockStatsToJSON(blockstats, stats));
             }
             return ret;
         },
@@ -3089,6 +3439,70 @@ UniValue CreateUTXOSnapshot(NodeContext &node, CChainState &chainstate,
     return result;
 }
 
+static RPCHelpMan dumpblockreplay() {
+    return RPCHelpMan{
+        "dumpblockreplay",
+        "Write a range of blocks of the active chain, their undo data and the "
+        "chain context needed to replay them to disk. The file can be "
+        "replayed with bench_bitcoin -blockreplay=<file>.\n",
+        {
+            {"path", RPCArg::Type::STR, RPCArg::Optional::NO,
+             "path to the output file. If relative, will be prefixed by "
+             "datadir."},
+            {"start_height", RPCArg::Type::NUM, RPCArg::Optional::NO,
+             "The height of the first block"},
+            {"end_height", RPCArg::Type::NUM, RPCArg::Optional::NO,
+             "The height of the last block"},
+        },
+        RPCResult{RPCResult::Type::OBJ,
+                  "",
+                  "",
+                  {
+                      {RPCResult::Type::NUM, "blocks",
+                       "the number of blocks written"},
+                      {RPCResult::Type::NUM, "bytes", "the size of the file"},
+                      {RPCResult::Type::STR, "path",
+                       "the absolute path that the blocks were written to"},
+                  }},
+        RPCExamples{HelpExampleCli("dumpblockreplay", "replay.dat 1000 1100")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            fs::path path = fs::absolute(
+                fs::u8path(request.params[0].get_str()), GetDataDir());
+            if (fs::exists(path)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER,
+                                   path.u8string() +
+                                       " already exists. If you are sure this "
+                                       "is what you want, "
+                                       "move it out of the way first");
+            }
+
+            BlockReplayData data;
+            std::string error;
+            if (!ExportBlockReplay(::ChainActive(), config.GetChainParams(),
+                                   request.params[1].get_int(),
+                                   request.params[2].get_int(), data, error)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, error);
+            }
+
+            CAutoFile afile{fsbridge::fopen(path, "wb"), SER_DISK,
+                            CLIENT_VERSION};
+            if (afile.IsNull()) {
+                throw JSONRPCError(RPC_MISC_ERROR,
+                                   "Unable to open " + path.u8string());
+            }
+            afile << data;
+            afile.fclose();
+
+            UniValue result(UniValue::VOBJ);
+            result.pushKV("blocks", uint64_t(data.blocks.size()));
+            result.pushKV("bytes", uint64_t(fs::file_size(path)));
+            result.pushKV("path", path.u8string());
+            return result;
+        },
+    };
+}
+
 void RegisterBlockchainRPCCommands(CRPCTable &t) {
     // clang-format off
     static const CRPCCommand commands[] = {
@@ -3101,10 +3515,13 @@ void RegisterBlockchainRPCCommands(CRPCTable &t) {
         { "blockchain",         getblockhash,                      },
         { "blockchain",         getblockheader,                    },
         { "blockchain",         getblockstats,                     },
+        { "blockchain",         getblockstatsrange,                },
         { "blockchain",         getchaintips,                      },
         { "blockchain",         getchaintxstats,                   },
+        { "blockchain",         getdbstats,                        },
         { "blockchain",         getdifficulty,                     },
         { "blockchain",         getmempoolancestors,               },
+        { "blockchain",         getmempoolchanges,                 },
         { "blockchain",         getmempooldescendants,             },
         { "blockchain",         getmempoolentry,                   },
         { "blockchain",         getmempoolinfo,                    },
@@ -3114,6 +3531,7 @@ void RegisterBlockchainRPCCommands(CRPCTable &t) {
         { "blockchain",         pruneblockchain,                   },
         { "blockchain",         savemempool,                       },
         { "blockchain",         verifychain,                       },
+        { "blockchain",         verifychainsegments,               },
         { "blockchain",         preciousblock,                     },
         { "blockchain",         scantxoutset,                      },
         { "blockchain",         getblockfilter,                    },
@@ -3126,6 +3544,7 @@ void RegisterBlockchainRPCCommands(CRPCTable &t) {
         { "hidden",             reconsiderblock,                   },
         { "hidden",             syncwithvalidationinterfacequeue,  },
         { "hidden",             dumptxoutset,                      },
+        { "hidden",             dumpblockreplay,                   },
         { "hidden",             unparkblock,                       },
         { "hidden",             waitfornewblock,                   },
         { "hidden",             waitforblock,                      },
@@ -36,6 +36,9 @@ double GetDifficulty(const CBlockIndex *blockindex);
 /** Callback for when block tip changed. */
 void RPCNotifyBlockChange(const CBlockIndex *pindex);
 
+/** Stop the worker threads of getblockstatsrange. */
+void StopBlockStatsWorkers();
+
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock &block, const CBlockIndex *tip,
                      const CBlockIndex *blockindex, bool txDetails = false)
@@ -24,6 +24,8 @@ public:
  */
 static const CRPCConvertParam vRPCConvertParams[] = {
     {"setmocktime", 0, "timestamp"},
+    {"setsigcachesize", 0, "sigcachesize"},
+    {"setsigcachesize", 1, "scriptcachesize"},
     {"mockscheduler", 0, "delta_time"},
     {"utxoupdatepsbt", 1, "descriptors"},
     {"generatetoaddress", 0, "nblocks"},
@@ -124,12 +126,19 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     {"importdescriptors", 0, "requests"},
     {"verifychain", 0, "checklevel"},
     {"verifychain", 1, "nblocks"},
+    {"verifychainsegments", 0, "threads"},
     {"getblockstats", 0, "hash_or_height"},
     {"getblockstats", 1, "stats"},
+    {"getblockstatsrange", 0, "start_height"},
+    {"getblockstatsrange", 1, "end_height"},
+    {"getblockstatsrange", 2, "stats"},
+    {"dumpblockreplay", 1, "start_height"},
+    {"dumpblockreplay", 2, "end_height"},
     {"pruneblockchain", 0, "height"},
     {"keypoolrefill", 0, "newsize"},
     {"getrawmempool", 0, "verbose"},
     {"getrawmempool", 1, "mempool_sequence"},
+    {"getmempoolchanges", 0, "mempool_sequence"},
     {"prioritisetransaction", 1, "dummy"},
     {"prioritisetransaction", 2, "fee_delta"},
     {"setban", 2, "bantime"},
@@ -11,9 +11,11 @@
 #include <config.h>
 #include <consensus/activation.h>
 #include <consensus/consensus.h>
+#include <consensus/merkle.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <hash.h>
 #include <key_io.h>
 #include <miner.h>
 #include <minerfund.h>
@@ -28,6 +30,8 @@
 #include <script/descriptor.h>
 #include <script/script.h>
 #include <shutdown.h>
+#include <streams.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <univalue.h>
 #include <util/strencodings.h>
@@ -39,6 +43,7 @@
 #include <warnings.h>
 
 #include <cstdint>
+#include <deque>
 
 /**
  * Return average network hashes per second based on the last 'lookup' blocks,
@@ -613,6 +618,53 @@ static UniValue BIP22ValidationResult(const Config &config,
     return "valid?";
 }
 
+/**
+ * Block templates recently handed out by getblocktemplate in "light" mode,
+ * keyed by their template id. Pool servers only receive the merkle branch of
+ * the coinbase, so the node keeps the full transaction list around until the
+ * solved header and coinbase come back through submitblocklight.
+ */
+static Mutex g_light_templates_mutex;
+static std::deque<std::pair<uint256, std::shared_ptr<const CBlock>>>
+    g_light_templates GUARDED_BY(g_light_templates_mutex);
+
+/**
+ * The template id commits to the previous block and to the merkle branch of
+ * the coinbase, which in turn commits to every other transaction in the block.
+ */
+static uint256 GetLightTemplateId(const CBlock &block,
+                                  const std::vector<uint256> &merkleBranch) {
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << block.hashPrevBlock << merkleBranch;
+    return ss.GetHash();
+}
+
+static void AddLightTemplate(const uint256 &templateId, const CBlock &block) {
+    LOCK(g_light_templates_mutex);
+    for (const auto &entry : g_light_templates) {
+        if (entry.first == templateId) {
+            return;
+        }
+    }
+
+    g_light_templates.emplace_back(templateId,
+                                   std::make_shared<const CBlock>(block));
+    while (g_light_templates.size() > MAX_LIGHT_BLOCK_TEMPLATES) {
+        g_light_templates.pop_front();
+    }
+}
+
+static std::shared_ptr<const CBlock>
+GetLightTemplate(const uint256 &templateId) {
+    LOCK(g_light_templates_mutex);
+    for (const auto &entry : g_light_templates) {
+        if (entry.first == templateId) {
+            return entry.second;
+        }
+    }
+    return nullptr;
+}
+
 static RPCHelpMan getblocktemplate() {
     return RPCHelpMan{
         "getblocktemplate",
@@ -640,7 +692,10 @@ static RPCHelpMan getblocktemplate() {
                  {"mode", RPCArg::Type::STR, /* treat as named arg */
                   RPCArg::Optional::OMITTED_NAMED_ARG,
                   "This must be set to \"template\", \"proposal\" (see BIP "
-                  "23), or omitted"},
+                  "23), \"light\", or omitted. In \"light\" mode, the "
+                  "transactions are replaced by the merkle branch of the "
+                  "coinbase and a template id to be used with "
+                  "submitblocklight"},
                  {
                      "capabilities",
                      RPCArg::Type::ARR,
@@ -706,6 +761,18 @@ static RPCHelpMan getblocktemplate() {
                            "unknown and clients MUST NOT assume it is zero"},
                       }},
                  }},
+                {RPCResult::Type::ARR,
+                 "merkle",
+                 "only in \"light\" mode: merkle branch of the coinbase "
+                 "transaction, replacing the \"transactions\" list",
+                 {
+                     {RPCResult::Type::STR_HEX, "",
+                      "hash of the sibling node at each level of the tree, "
+                      "bottom to top"},
+                 }},
+                {RPCResult::Type::STR_HEX, "templateid",
+                 "only in \"light\" mode: identifier of the template to be "
+                 "passed to submitblocklight"},
                 {RPCResult::Type::OBJ,
                  "coinbaseaux",
                  "data that should be included in the coinbase's scriptSig "
@@ -828,9 +895,10 @@ static RPCHelpMan getblocktemplate() {
                 }
             }
 
-            if (strMode != "template") {
+            if (strMode != "template" && strMode != "light") {
                 throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid mode");
             }
+            const bool fLight = strMode == "light";
 
             NodeContext &node = EnsureNodeContext(request.context);
             if (!node.connman) {
@@ -948,20 +1016,19 @@ static RPCHelpMan getblocktemplate() {
 
             Amount coinbasevalue = Amount::zero();
 
+            for (const auto &o : pblock->vtx[0]->vout) {
+                coinbasevalue += o.nValue;
+            }
+
             UniValue transactions(UniValue::VARR);
-            transactions.reserve(pblock->vtx.size());
+            transactions.reserve(fLight ? 0 : pblock->vtx.size());
             int index_in_template = 0;
             for (const auto &it : pblock->vtx) {
                 const CTransaction &tx = *it;
                 const TxId txId = tx.GetId();
 
-                if (tx.IsCoinBase()) {
+                if (tx.IsCoinBase() || fLight) {
                     index_in_template++;
-
-                    for (const auto &o : pblock->vtx[0]->vout) {
-                        coinbasevalue += o.nValue;
-                    }
-
                     continue;
                 }
 
@@ -1019,7 +1086,24 @@ static RPCHelpMan getblocktemplate() {
             result.pushKV("version", pblock->nVersion);
 
             result.pushKV("previousblockhash", pblock->hashPrevBlock.GetHex());
-            result.pushKV("transactions", transactions);
+            if (fLight) {
+                const std::vector<uint256> merkleBranch =
+                    BlockMerkleBranch(*pblock, 0);
+                UniValue merkle(UniValue::VARR);
+                merkle.reserve(merkleBranch.size());
+                for (const uint256 &hash : merkleBranch) {
+                    merkle.push_back(hash.GetHex());
+                }
+
+                const uint256 templateId =
+                    GetLightTemplateId(*pblock, merkleBranch);
+                AddLightTemplate(templateId, *pblock);
+
+                result.pushKV("merkle", merkle);
+                result.pushKV("templateid", templateId.GetHex());
+            } else {
+                result.pushKV("transactions", transactions);
+            }
             result.pushKV("coinbaseaux", aux);
             result.pushKV("coinbasetxn", coinbasetxn);
             result.pushKV("coinbasevalue", int64_t(coinbasevalue / SATOSHI));
@@ -1064,6 +1148,44 @@ protected:
     }
 };
 
+static UniValue ProcessSubmittedBlock(const Config &config,
+                                      const JSONRPCRequest &request,
+                                      const std::shared_ptr<CBlock> &blockptr) {
+    const CBlock &block = *blockptr;
+    const BlockHash hash = block.GetHash();
+    {
+        LOCK(cs_main);
+        const CBlockIndex *pindex =
+            g_chainman.m_blockman.LookupBlockIndex(hash);
+        if (pindex) {
+            if (pindex->IsValid(BlockValidity::SCRIPTS)) {
+                return "duplicate";
+            }
+            if (pindex->nStatus.isInvalid()) {
+                return "duplicate-invalid";
+            }
+        }
+    }
+
+    bool new_block;
+    auto sc = std::make_shared<submitblock_StateCatcher>(block.GetHash());
+    RegisterSharedValidationInterface(sc, "submitblock");
+    bool accepted = EnsureChainman(request.context)
+                        .ProcessNewBlock(config, blockptr,
+                                         /* fForceProcessing */ true,
+                                         /* fNewBlock */ &new_block);
+    UnregisterSharedValidationInterface(sc);
+    if (!new_block && accepted) {
+        return "duplicate";
+    }
+
+    if (!sc->found) {
+        return "inconclusive";
+    }
+
+    return BIP22ValidationResult(config, sc->state);
+}
+
 static RPCHelpMan submitblock() {
     // We allow 2 arguments for compliance with BIP22. Argument 2 is ignored.
     return RPCHelpMan{
@@ -1096,39 +1218,66 @@ static RPCHelpMan submitblock() {
                                    "Block does not start with a coinbase");
             }
 
-            const BlockHash hash = block.GetHash();
-            {
-                LOCK(cs_main);
-                const CBlockIndex *pindex =
-                    g_chainman.m_blockman.LookupBlockIndex(hash);
-                if (pindex) {
-                    if (pindex->IsValid(BlockValidity::SCRIPTS)) {
-                        return "duplicate";
-                    }
-                    if (pindex->nStatus.isInvalid()) {
-                        return "duplicate-invalid";
-                    }
-                }
+            return ProcessSubmittedBlock(config, request, blockptr);
+        },
+    };
+}
+
+static RPCHelpMan submitblocklight() {
+    return RPCHelpMan{
+        "submitblocklight",
+        "Attempts to submit a new block to the network, built from a block "
+        "template previously returned by getblocktemplate in \"light\" "
+        "mode.\n",
+        {
+            {"hexdata", RPCArg::Type::STR_HEX, RPCArg::Optional::NO,
+             "the hex-encoded block header, immediately followed by the "
+             "hex-encoded coinbase transaction"},
+            {"templateid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO,
+             "the template id returned by getblocktemplate"},
+        },
+        RPCResult{RPCResult::Type::NONE, "",
+                  "Returns JSON Null when valid, a string according to BIP22 "
+                  "otherwise"},
+        RPCExamples{
+            HelpExampleCli("submitblocklight", "\"mydata\" \"templateid\"") +
+            HelpExampleRpc("submitblocklight", "\"mydata\", \"templateid\"")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            const uint256 templateId =
+                ParseHashV(request.params[1], "templateid");
+            std::shared_ptr<const CBlock> blockTemplate =
+                GetLightTemplate(templateId);
+            if (!blockTemplate) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER,
+                                   "Block template not found");
             }
 
-            bool new_block;
-            auto sc =
-                std::make_shared<submitblock_StateCatcher>(block.GetHash());
-            RegisterSharedValidationInterface(sc);
-            bool accepted = EnsureChainman(request.context)
-                                .ProcessNewBlock(config, blockptr,
-                                                 /* fForceProcessing */ true,
-                                                 /* fNewBlock */ &new_block);
-            UnregisterSharedValidationInterface(sc);
-            if (!new_block && accepted) {
-                return "duplicate";
+            std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>();
+            CBlock &block = *blockptr;
+            CMutableTransaction coinbase;
+            try {
+                CDataStream ssBlock(ParseHexV(request.params[0], "hexdata"),
+                                    SER_NETWORK, PROTOCOL_VERSION);
+                ssBlock >> static_cast<CBlockHeader &>(block);
+                ssBlock >> coinbase;
+            } catch (const std::exception &) {
+                throw JSONRPCError(RPC_DESERIALIZATION_ERROR,
+                                   "Block decode failed");
             }
 
-            if (!sc->found) {
-                return "inconclusive";
+            if (!CTransaction(coinbase).IsCoinBase()) {
+                throw JSONRPCError(RPC_DESERIALIZATION_ERROR,
+                                   "Block does not start with a coinbase");
             }
 
-            return BIP22ValidationResult(config, sc->state);
+            block.vtx.reserve(blockTemplate->vtx.size());
+            block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+            block.vtx.insert(block.vtx.end(),
+                             std::next(blockTemplate->vtx.begin()),
+                             blockTemplate->vtx.end());
+
+            return ProcessSubmittedBlock(config, request, blockptr);
         },
     };
 }
@@ -1203,6 +1352,7 @@ void RegisterMiningRPCCommands(CRPCTable &t) {
         {"mining",      prioritisetransaction, },
         {"mining",      getblocktemplate,      },
         {"mining",      submitblock,           },
+        {"mining",      submitblocklight,      },
         {"mining",      submitheader,          },
 
         {"generating",  generatetoaddress,     },
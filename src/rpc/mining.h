@@ -11,4 +11,10 @@
  */
 static const uint64_t DEFAULT_MAX_TRIES{1000000};
 
+/**
+ * Maximum number of block templates kept around for submitblocklight after
+ * being returned by getblocktemplate in "light" mode.
+ */
+static const size_t MAX_LIGHT_BLOCK_TEMPLATES{32};
+
 #endif // BITCOIN_RPC_MINING_H
@@ -8,6 +8,7 @@
 #include <config.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/blockstatsindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key_io.h>
@@ -19,11 +20,15 @@
 #include <rpc/util.h>
 #include <scheduler.h>
 #include <script/descriptor.h>
+#include <script/scriptcache.h>
+#include <script/sigcache.h>
 #include <util/check.h>
 #include <util/message.h> // For MessageSign(), MessageVerify()
 #include <util/ref.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <validation.h>
+#include <validationinterface.h>
 
 #include <univalue.h>
 
@@ -532,6 +537,32 @@ static UniValue RPCLockedMemoryInfo() {
     return obj;
 }
 
+static UniValue CacheStatsToJSON(const CuckooCache::cache_stats &stats) {
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("size", uint64_t(stats.size));
+    obj.pushKV("migrating", uint64_t(stats.migrating_size));
+    obj.pushKV("hits", stats.hits);
+    obj.pushKV("misses", stats.misses);
+    obj.pushKV("inserts", stats.inserts);
+    obj.pushKV("evictions", stats.evictions);
+    return obj;
+}
+
+static std::vector<RPCResult> CacheStatsDescription() {
+    return {
+        {RPCResult::Type::NUM, "size", "Number of entries the cache can store"},
+        {RPCResult::Type::NUM, "migrating",
+         "Number of slots of the previous table whose entries are still being "
+         "moved after a resize, 0 if none"},
+        {RPCResult::Type::NUM, "hits", "Number of lookups which found an entry"},
+        {RPCResult::Type::NUM, "misses",
+         "Number of lookups which found no entry"},
+        {RPCResult::Type::NUM, "inserts", "Number of entries inserted"},
+        {RPCResult::Type::NUM, "evictions",
+         "Number of entries dropped to make room for others"},
+    };
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo() {
     char *ptr = nullptr;
@@ -591,6 +622,12 @@ static RPCHelpMan getmemoryinfo() {
                          {RPCResult::Type::NUM, "chunks_free",
                           "Number unused chunks"},
                      }},
+                    {RPCResult::Type::OBJ, "sigcache",
+                     "Information about the signature cache",
+                     CacheStatsDescription()},
+                    {RPCResult::Type::OBJ, "scriptcache",
+                     "Information about the script execution cache",
+                     CacheStatsDescription()},
                 }},
             RPCResult{"mode \"mallocinfo\"", RPCResult::Type::STR, "",
                       "\"<malloc version=\"1\">...\""},
@@ -605,6 +642,11 @@ static RPCHelpMan getmemoryinfo() {
             if (mode == "stats") {
                 UniValue obj(UniValue::VOBJ);
                 obj.pushKV("locked", RPCLockedMemoryInfo());
+                obj.pushKV("sigcache",
+                           CacheStatsToJSON(GetSignatureCacheStats()));
+                obj.pushKV("scriptcache",
+                           CacheStatsToJSON(WITH_LOCK(
+                               cs_main, return GetScriptExecutionCacheStats())));
                 return obj;
             } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -622,6 +664,122 @@ static RPCHelpMan getmemoryinfo() {
     };
 }
 
+/**
+ * Convert a cache size in MiB to bytes, clamped as the -maxsigcachesize and
+ * -maxscriptcachesize options are.
+ */
+static size_t CacheSizeToBytes(int64_t mebibytes, int64_t max_mebibytes) {
+    return std::min(std::max(int64_t(0), mebibytes), max_mebibytes) *
+           (size_t(1) << 20);
+}
+
+static RPCHelpMan setsigcachesize() {
+    return RPCHelpMan{
+        "setsigcachesize",
+        "Resize the signature and script execution caches, as "
+        "-maxsigcachesize and -maxscriptcachesize do at startup, without "
+        "losing the entries they hold.\n",
+        {
+            {"sigcachesize", RPCArg::Type::NUM,
+             RPCArg::Optional::OMITTED_NAMED_ARG,
+             "The size of the signature cache in MiB, unchanged if omitted"},
+            {"scriptcachesize", RPCArg::Type::NUM,
+             RPCArg::Optional::OMITTED_NAMED_ARG,
+             "The size of the script execution cache in MiB, unchanged if "
+             "omitted"},
+        },
+        RPCResult{RPCResult::Type::OBJ,
+                  "",
+                  "",
+                  {
+                      {RPCResult::Type::NUM, "sigcache", /* optional */ true,
+                       "Number of entries the signature cache can store"},
+                      {RPCResult::Type::NUM, "scriptcache",
+                       /* optional */ true,
+                       "Number of entries the script execution cache can "
+                       "store"},
+                  }},
+        RPCExamples{HelpExampleCli("setsigcachesize", "64 64") +
+                    HelpExampleRpc("setsigcachesize", "64, 64")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            UniValue result(UniValue::VOBJ);
+            if (!request.params[0].isNull()) {
+                const size_t bytes = CacheSizeToBytes(
+                    request.params[0].get_int64(), MAX_MAX_SIG_CACHE_SIZE);
+                result.pushKV("sigcache",
+                              uint64_t(ResizeSignatureCache(bytes)));
+            }
+            if (!request.params[1].isNull()) {
+                const size_t bytes = CacheSizeToBytes(
+                    request.params[1].get_int64(), MAX_MAX_SCRIPT_CACHE_SIZE);
+                LOCK(cs_main);
+                result.pushKV("scriptcache",
+                              uint64_t(ResizeScriptExecutionCache(bytes)));
+            }
+            return result;
+        },
+    };
+}
+
+static RPCHelpMan getvalidationqueueinfo() {
+    return RPCHelpMan{
+        "getvalidationqueueinfo",
+        "Returns the state of the validation notification queue of each "
+        "subscriber.\n",
+        {},
+        RPCResult{
+            RPCResult::Type::ARR,
+            "",
+            "",
+            {
+                {RPCResult::Type::OBJ,
+                 "",
+                 "",
+                 {
+                     {RPCResult::Type::STR, "name", "The subscriber name"},
+                     {RPCResult::Type::NUM, "pending",
+                      "Number of notifications waiting to be delivered"},
+                     {RPCResult::Type::NUM, "max_pending",
+                      "Number of pending notifications above which the queue "
+                      "is full"},
+                     {RPCResult::Type::STR, "policy",
+                      "What happens when the queue is full: \"wait\" for "
+                      "the subscriber or \"drop\" the new notifications"},
+                     {RPCResult::Type::NUM, "processed",
+                      "Number of notifications delivered"},
+                     {RPCResult::Type::NUM, "dropped",
+                      "Number of notifications dropped"},
+                     {RPCResult::Type::NUM, "waits",
+                      "Number of times block or transaction processing "
+                      "waited for the queue"},
+                 }},
+            }},
+        RPCExamples{HelpExampleCli("getvalidationqueueinfo", "") +
+                    HelpExampleRpc("getvalidationqueueinfo", "")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            UniValue result(UniValue::VARR);
+            for (const ValidationQueueInfo &info :
+                 GetMainSignals().GetQueueInfo()) {
+                UniValue obj(UniValue::VOBJ);
+                obj.pushKV("name", info.name);
+                obj.pushKV("pending", uint64_t(info.pending));
+                obj.pushKV("max_pending", uint64_t(info.max_pending));
+                obj.pushKV("policy",
+                           info.policy == ValidationQueuePolicy::DROP
+                               ? "drop"
+                               : "wait");
+                obj.pushKV("processed", info.processed);
+                obj.pushKV("dropped", info.dropped);
+                obj.pushKV("waits", info.waits);
+                result.push_back(obj);
+            }
+            return result;
+        },
+    };
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (size_t i = 0; i < cats.size(); ++i) {
@@ -875,6 +1033,11 @@ static RPCHelpMan getindexinfo() {
                     SummaryToJSON(g_txindex->GetSummary(), index_name));
             }
 
+            if (g_blockstatsindex) {
+                result.pushKVs(SummaryToJSON(g_blockstatsindex->GetSummary(),
+                                             index_name));
+            }
+
             ForEachBlockFilterIndex([&result, &index_name](
                                         const BlockFilterIndex &index) {
                 result.pushKVs(SummaryToJSON(index.GetSummary(), index_name));
@@ -892,6 +1055,7 @@ void RegisterMiscRPCCommands(CRPCTable &t) {
         //  ------------------  ----------------------
         { "control",            getmemoryinfo,           },
         { "control",            logging,                 },
+        { "control",            getvalidationqueueinfo,  },
         { "util",               validateaddress,         },
         { "util",               createmultisig,          },
         { "util",               deriveaddresses,         },
@@ -906,6 +1070,7 @@ void RegisterMiscRPCCommands(CRPCTable &t) {
         { "hidden",             mockscheduler,           },
         { "hidden",             echo,                    },
         { "hidden",             echojson,                },
+        { "hidden",             setsigcachesize,         },
     };
     // clang-format on
     for (const auto &c : commands) {
@@ -178,6 +178,9 @@ static RPCHelpMan getpeerinfo() {
                     {RPCResult::Type::STR, "connection_type",
                      "Type of connection: \n" +
                          Join(CONNECTION_TYPE_DOC, ",\n") + "."},
+                    {RPCResult::Type::STR, "transport_protocol_type",
+                     "Type of transport protocol: \"v1\" (plaintext) or "
+                     "\"v2\" (encrypted, see -v2transport)"},
                     {RPCResult::Type::NUM, "startingheight",
                      "The starting height (block) of the peer"},
                     {RPCResult::Type::NUM, "synced_headers",
@@ -340,6 +343,8 @@ static RPCHelpMan getpeerinfo() {
                 }
                 obj.pushKV("bytesrecv_per_msg", recvPerMsgCmd);
                 obj.pushKV("connection_type", stats.m_conn_type_string);
+                obj.pushKV("transport_protocol_type",
+                           stats.m_v2_transport ? "v2" : "v1");
 
                 if (stats.m_availabilityScore) {
                     obj.pushKV("availability_score",
@@ -72,6 +72,9 @@ static void TxToJSON(const CTransaction &tx, const BlockHash &hashBlock,
     }
 }
 
+/** Maximum number of transaction ids getrawtransaction accepts at once. */
+static constexpr size_t MAX_GETRAWTRANSACTION_TXIDS = 1000;
+
 static RPCHelpMan getrawtransaction() {
     return RPCHelpMan{
         "getrawtransaction",
@@ -89,10 +92,20 @@ static RPCHelpMan getrawtransaction() {
         "\nIf verbose is 'true', returns an Object with information about "
         "'txid'.\n"
         "If verbose is 'false' or omitted, returns a string that is "
-        "serialized, hex-encoded data for 'txid'.\n",
+        "serialized, hex-encoded data for 'txid'.\n"
+        "If 'txid' is an array of transaction ids, returns an array with the "
+        "result for each of them, or null if the transaction is not found. "
+        "The transactions are then looked up together, which is faster. At "
+        "most " +
+            ToString(MAX_GETRAWTRANSACTION_TXIDS) +
+            " transaction ids can be passed at once.\n",
         {
-            {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO,
-             "The transaction id"},
+            {"txid",
+             RPCArg::Type::STR_HEX,
+             RPCArg::Optional::NO,
+             "The transaction id, or an array of transaction ids",
+             "",
+             {"", "string or array"}},
             {"verbose", RPCArg::Type::BOOL, /* default */ "false",
              "If false, return a string, otherwise return a json object"},
             {"blockhash", RPCArg::Type::STR_HEX,
@@ -181,6 +194,15 @@ static RPCHelpMan getrawtransaction() {
                      "The block time expressed in " + UNIX_EPOCH_TIME},
                     {RPCResult::Type::NUM, "time", "Same as \"blocktime\""},
                 }},
+            RPCResult{"if txid is an array",
+                      RPCResult::Type::ARR,
+                      "",
+                      "",
+                      {
+                          {RPCResult::Type::ELISION, "",
+                           "The result for each transaction id as above, or "
+                           "null if the transaction is not found"},
+                      }},
         },
         RPCExamples{HelpExampleCli("getrawtransaction", "\"mytxid\"") +
                     HelpExampleCli("getrawtransaction", "\"mytxid\" true") +
@@ -188,22 +210,43 @@ static RPCHelpMan getrawtransaction() {
                     HelpExampleCli("getrawtransaction",
                                    "\"mytxid\" false \"myblockhash\"") +
                     HelpExampleCli("getrawtransaction",
-                                   "\"mytxid\" true \"myblockhash\"")},
+                                   "\"mytxid\" true \"myblockhash\"") +
+                    HelpExampleRpc("getrawtransaction",
+                                   "[\"mytxid1\", \"mytxid2\"], true")},
         [&](const RPCHelpMan &self, const Config &config,
             const JSONRPCRequest &request) -> UniValue {
             const NodeContext &node = EnsureNodeContext(request.context);
 
             bool in_active_chain = true;
-            TxId txid = TxId(ParseHashV(request.params[0], "parameter 1"));
+            std::vector<TxId> txids;
+            if (request.params[0].isArray()) {
+                const UniValue &txids_param = request.params[0].get_array();
+                if (txids_param.size() > MAX_GETRAWTRANSACTION_TXIDS) {
+                    throw JSONRPCError(
+                        RPC_INVALID_PARAMETER,
+                        strprintf("At most %u transaction ids can be passed",
+                                  MAX_GETRAWTRANSACTION_TXIDS));
+                }
+                for (size_t i = 0; i < txids_param.size(); ++i) {
+                    txids.emplace_back(
+                        ParseHashV(txids_param[i], "parameter 1"));
+                }
+            } else {
+                txids.emplace_back(
+                    ParseHashV(request.params[0], "parameter 1"));
+            }
             CBlockIndex *blockindex = nullptr;
 
             const CChainParams &params = config.GetChainParams();
-            if (txid == params.GenesisBlock().hashMerkleRoot) {
-                // Special exception for the genesis block coinbase transaction
-                throw JSONRPCError(
-                    RPC_INVALID_ADDRESS_OR_KEY,
-                    "The genesis block coinbase is not considered an "
-                    "ordinary transaction and cannot be retrieved");
+            for (const TxId &txid : txids) {
+                if (txid == params.GenesisBlock().hashMerkleRoot) {
+                    // Special exception for the genesis block coinbase
+                    // transaction
+                    throw JSONRPCError(
+                        RPC_INVALID_ADDRESS_OR_KEY,
+                        "The genesis block coinbase is not considered an "
+                        "ordinary transaction and cannot be retrieved");
+                }
             }
 
             // Accept either a bool (true) or a num (>=1) to indicate verbose
@@ -233,9 +276,40 @@ static RPCHelpMan getrawtransaction() {
                 f_txindex_ready = g_txindex->BlockUntilSyncedToCurrentChain();
             }
 
+            auto tx_to_univ = [&](const CTransaction &tx,
+                                  const BlockHash &hash_block) {
+                if (!fVerbose) {
+                    return UniValue(EncodeHexTx(tx, RPCSerializationFlags()));
+                }
+
+                UniValue result(UniValue::VOBJ);
+                if (blockindex) {
+                    result.pushKV("in_active_chain", in_active_chain);
+                }
+                TxToJSON(tx, hash_block, result);
+                return result;
+            };
+
+            if (request.params[0].isArray()) {
+                if (blockindex && !blockindex->nStatus.hasData()) {
+                    throw JSONRPCError(RPC_MISC_ERROR, "Block not available");
+                }
+                std::vector<BlockHash> hash_blocks;
+                const std::vector<CTransactionRef> txs =
+                    GetTransactions(blockindex, node.mempool.get(), txids,
+                                    params.GetConsensus(), hash_blocks);
+                UniValue ret(UniValue::VARR);
+                ret.reserve(txs.size());
+                for (size_t i = 0; i < txs.size(); ++i) {
+                    ret.push_back(txs[i] ? tx_to_univ(*txs[i], hash_blocks[i])
+                                         : NullUniValue);
+                }
+                return ret;
+            }
+
             BlockHash hash_block;
             const CTransactionRef tx =
-                GetTransaction(blockindex, node.mempool.get(), txid,
+                GetTransaction(blockindex, node.mempool.get(), txids[0],
                                params.GetConsensus(), hash_block);
             if (!tx) {
                 std::string errmsg;
@@ -261,16 +335,7 @@ static RPCHelpMan getrawtransaction() {
                     errmsg + ". Use gettransaction for wallet transactions.");
             }
 
-            if (!fVerbose) {
-                return EncodeHexTx(*tx, RPCSerializationFlags());
-            }
-
-            UniValue result(UniValue::VOBJ);
-            if (blockindex) {
-                result.pushKV("in_active_chain", in_active_chain);
-            }
-            TxToJSON(*tx, hash_block, result);
-            return result;
+            return tx_to_univ(*tx, hash_block);
         },
     };
 }
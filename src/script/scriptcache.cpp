@@ -4,7 +4,8 @@
 
 #include <script/scriptcache.h>
 
-#include <crypto/sha256.h>
+#include <crypto/common.h>
+#include <crypto/siphash.h>
 #include <cuckoocache.h>
 #include <primitives/transaction.h>
 #include <random.h>
@@ -13,14 +14,14 @@
 #include <util/system.h>
 #include <validation.h>
 
+#include <limits>
+
 /**
- * In future if many more values are added, it should be considered to
- * expand the element size to 64 bytes (with padding the spare space as
- * needed) so the key can be long. Shortening the key too much risks
- * opening ourselves up to consensus-failing collisions, however it should
- * be noted that our cache nonce is private and unique, so collisions would
- * affect only one node and attackers have no way of offline-preparing a
- * collision attack even on short keys.
+ * Shortening the key further risks opening ourselves up to consensus-failing
+ * collisions, see ScriptCacheKey for the bound it provides. It should be noted
+ * that our cache salts are private and unique, so collisions would affect only
+ * one node and attackers have no way of offline-preparing a collision attack
+ * even on short keys.
  */
 struct ScriptCacheElement {
     using KeyType = ScriptCacheKey;
@@ -36,51 +37,38 @@ struct ScriptCacheElement {
     const KeyType &getKey() const { return key; }
 };
 
-static_assert(sizeof(ScriptCacheElement) == 32,
-              "ScriptCacheElement should be 32 bytes");
+static_assert(sizeof(ScriptCacheElement) == 20,
+              "ScriptCacheElement should be 20 bytes");
 
 class ScriptCacheHasher {
 public:
+    /**
+     * The key is already a random value, so the 8 hashes are derived from its
+     * two halves a and b as a + i * b, as in double hashing.
+     */
     template <uint8_t hash_select>
     uint32_t operator()(const ScriptCacheKey &k) const {
         static_assert(hash_select < 8, "only has 8 hashes available.");
-
-        const auto &d = k.data;
-
-        static_assert(sizeof(d) == 28,
+        static_assert(sizeof(k.data) == 16,
                       "modify the following if key size changes");
 
-        uint32_t u;
-        static_assert(sizeof(u) == 4 && sizeof(d[0]) == 1, "basic assumptions");
-        if (hash_select < 7) {
-            std::memcpy(&u, d.data() + 4 * hash_select, 4);
-        } else {
-            // We are required to produce 8 subhashes, and all bytes have
-            // been used once. We re-use the bytes but mix together different
-            // entries (and flip the order) to get a new, distinct value.
-            uint8_t arr[4];
-            arr[0] = d[3] ^ d[7] ^ d[11] ^ d[15];
-            arr[1] = d[6] ^ d[10] ^ d[14] ^ d[18];
-            arr[2] = d[9] ^ d[13] ^ d[17] ^ d[21];
-            arr[3] = d[12] ^ d[16] ^ d[20] ^ d[24];
-            std::memcpy(&u, arr, 4);
-        }
-        return u;
+        const uint64_t a = ReadLE64(k.data.data());
+        const uint64_t b = ReadLE64(k.data.data() + 8);
+        return (a + hash_select * b) >> 32;
     }
 };
 
 static CuckooCache::cache<ScriptCacheElement, ScriptCacheHasher>
     g_scriptExecutionCache;
-static CSHA256 g_scriptExecutionCacheHasher;
+
+/** The salts of the two SipHash values making up the keys. */
+static std::array<uint64_t, 4> g_scriptExecutionCacheSalts;
 
 void InitScriptExecutionCache() {
-    // Setup the salted hasher
-    uint256 nonce = GetRandHash();
-    // We want the nonce to be 64 bytes long to force the hasher to process
-    // this chunk, which makes later hash computations more efficient. We
-    // just write our 32-byte entropy twice to fill the 64 bytes.
-    g_scriptExecutionCacheHasher.Write(nonce.begin(), 32);
-    g_scriptExecutionCacheHasher.Write(nonce.begin(), 32);
+    // Setup the salted hashers
+    for (uint64_t &salt : g_scriptExecutionCacheSalts) {
+        salt = GetRand(std::numeric_limits<uint64_t>::max());
+    }
     // nMaxCacheSize is unsigned. If -maxscriptcachesize is set to zero,
     // setup_bytes creates the minimum possible cache (2 elements).
     size_t nMaxCacheSize =
@@ -92,18 +80,26 @@ void InitScriptExecutionCache() {
     size_t nElems = g_scriptExecutionCache.setup_bytes(nMaxCacheSize);
     LogPrintf("Using %zu MiB out of %zu requested for script execution cache, "
               "able to store %zu elements\n",
-              (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
+              (nElems * sizeof(ScriptCacheElement)) >> 20, nMaxCacheSize >> 20,
+              nElems);
+}
+
+uint32_t ResizeScriptExecutionCache(size_t bytes) {
+    AssertLockHeld(cs_main);
+    return g_scriptExecutionCache.resize_bytes(bytes);
+}
+
+CuckooCache::cache_stats GetScriptExecutionCacheStats() {
+    AssertLockHeld(cs_main);
+    return g_scriptExecutionCache.get_stats();
 }
 
 ScriptCacheKey::ScriptCacheKey(const CTransaction &tx, uint32_t flags) {
-    std::array<uint8_t, 32> hash;
-    CSHA256 hasher = g_scriptExecutionCacheHasher;
-    hasher.Write(tx.GetHash().begin(), 32)
-        .Write((uint8_t *)&flags, sizeof(flags))
-        .Finalize(hash.begin());
-
-    assert(data.size() < hash.size());
-    std::copy(hash.begin(), hash.begin() + data.size(), data.begin());
+    const std::array<uint64_t, 4> &salts = g_scriptExecutionCacheSalts;
+    WriteLE64(data.data(), SipHashUint256Extra(salts[0], salts[1],
+                                               tx.GetHash(), flags));
+    WriteLE64(data.data() + 8, SipHashUint256Extra(salts[2], salts[3],
+                                                   tx.GetHash(), flags));
 }
 
 bool IsKeyInScriptCache(ScriptCacheKey key, bool erase, int &nSigChecksOut) {
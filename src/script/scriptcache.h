@@ -6,8 +6,10 @@
 #define BITCOIN_SCRIPT_SCRIPTCACHE_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
+#include <cuckoocache.h>
 #include <sync.h>
 
 // Actually declared in validation.cpp; can't include because of circular
@@ -22,11 +24,15 @@ class CTransaction;
  * specific set of flags, along with any associated information learned
  * during execution.
  *
- * The key is slightly shorter than a power-of-two size to make room for
- * the value.
+ * The key is made of two SipHash-2-4 values of the transaction hash and the
+ * flags, computed with independent secret salts, so a pair that is not in the
+ * cache matches one of its N entries with probability at most N / 2^128. The
+ * largest cache allowed holds less than 2^30 entries, which bounds this to
+ * 2^-98 per lookup, and to 2^-58 over 2^40 lookups. The salts are private to
+ * the node, so collisions cannot be prepared offline either.
  */
 class ScriptCacheKey {
-    std::array<uint8_t, 28> data;
+    std::array<uint8_t, 16> data;
 
 public:
     ScriptCacheKey() = default;
@@ -52,6 +58,17 @@ static const int64_t MAX_MAX_SCRIPT_CACHE_SIZE = 16384;
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
+/**
+ * Resize the script-execution cache to about `bytes`, keeping the entries it
+ * holds. Returns the number of entries it can store.
+ */
+uint32_t ResizeScriptExecutionCache(size_t bytes)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/** Return the size and the lookup counters of the script-execution cache. */
+CuckooCache::cache_stats GetScriptExecutionCacheStats()
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /**
  * Check if a given key is in the cache, and if so, return its values.
  * (if not found, nSigChecks may or may not be set to an arbitrary value)
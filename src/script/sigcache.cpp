@@ -61,6 +61,16 @@ public:
         setValid.insert(entry);
     }
     uint32_t setup_bytes(size_t n) { return setValid.setup_bytes(n); }
+
+    uint32_t resize_bytes(size_t n) {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.resize_bytes(n);
+    }
+
+    CuckooCache::cache_stats get_stats() {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.get_stats();
+    }
 };
 
 /**
@@ -89,6 +99,14 @@ void InitSignatureCache() {
               (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
 }
 
+uint32_t ResizeSignatureCache(size_t bytes) {
+    return signatureCache.resize_bytes(bytes);
+}
+
+CuckooCache::cache_stats GetSignatureCacheStats() {
+    return signatureCache.get_stats();
+}
+
 template <typename F>
 bool RunMemoizedCheck(const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
                       const uint256 &sighash, bool storeOrErase, const F &fun) {
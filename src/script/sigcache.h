@@ -6,8 +6,10 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include <cuckoocache.h>
 #include <script/interpreter.h>
 
+#include <cstddef>
 #include <vector>
 
 // DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
@@ -63,4 +65,13 @@ public:
 
 void InitSignatureCache();
 
+/**
+ * Resize the signature cache to about `bytes`, keeping the entries it holds.
+ * Returns the number of entries it can store.
+ */
+uint32_t ResizeSignatureCache(size_t bytes);
+
+/** Return the size and the lookup counters of the signature cache. */
+CuckooCache::cache_stats GetSignatureCacheStats();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -12,13 +12,24 @@
 #include <script/standard.h>
 #include <uint256.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 typedef std::vector<uint8_t> valtype;
 
 MutableTransactionSignatureCreator::MutableTransactionSignatureCreator(
     const CMutableTransaction *txToIn, unsigned int nInIn,
     const Amount &amountIn, SigHashType sigHashTypeIn)
     : txTo(txToIn), nIn(nInIn), amount(amountIn), sigHashType(sigHashTypeIn),
-      checker(txTo, nIn, amountIn) {}
+      txdata(nullptr), checker(txTo, nIn, amountIn) {}
+
+MutableTransactionSignatureCreator::MutableTransactionSignatureCreator(
+    const CMutableTransaction *txToIn, unsigned int nInIn,
+    const Amount &amountIn, SigHashType sigHashTypeIn,
+    const PrecomputedTransactionData &txdataIn)
+    : txTo(txToIn), nIn(nInIn), amount(amountIn), sigHashType(sigHashTypeIn),
+      txdata(&txdataIn), checker(txTo, nIn, amountIn, txdataIn) {}
 
 bool MutableTransactionSignatureCreator::CreateSig(
     const SigningProvider &provider, std::vector<uint8_t> &vchSig,
@@ -28,7 +39,8 @@ bool MutableTransactionSignatureCreator::CreateSig(
         return false;
     }
 
-    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, sigHashType, amount);
+    uint256 hash =
+        SignatureHash(scriptCode, *txTo, nIn, sigHashType, amount, txdata);
     if (!key.SignECDSA(hash, vchSig)) {
         return false;
     }
@@ -437,6 +449,17 @@ bool IsSolvable(const SigningProvider &provider, const CScript &script) {
     return false;
 }
 
+namespace {
+/** The outcome of signing an input, applied once all inputs are signed. */
+struct InputSigningResult {
+    //! Whether the coin spent by the input was found
+    bool found{false};
+    CScript scriptSig;
+    //! Empty if the input is fully signed
+    std::string error;
+};
+} // namespace
+
 bool SignTransaction(CMutableTransaction &mtx, const SigningProvider *keystore,
                      const std::map<COutPoint, Coin> &coins,
                      SigHashType sigHashType,
@@ -444,14 +467,21 @@ bool SignTransaction(CMutableTransaction &mtx, const SigningProvider *keystore,
     // Use CTransaction for the constant parts of the
     // transaction to avoid rehashing.
     const CTransaction txConst(mtx);
-    // Sign what we can:
-    for (size_t i = 0; i < mtx.vin.size(); i++) {
-        CTxIn &txin = mtx.vin[i];
-        auto coin = coins.find(txin.prevout);
+    // The signatures don't commit to the scriptSigs, so the sighash data can
+    // be computed once and shared by all the inputs.
+    const PrecomputedTransactionData txdata(txConst);
+
+    // Sign what we can. The transaction is left untouched until all the
+    // inputs are signed, so they can be signed on several threads.
+    std::vector<InputSigningResult> results(mtx.vin.size());
+    auto sign_input = [&](size_t i) {
+        InputSigningResult &result = results[i];
+        auto coin = coins.find(mtx.vin[i].prevout);
         if (coin == coins.end() || coin->second.IsSpent()) {
-            input_errors[i] = "Input not found or already spent";
-            continue;
+            result.error = "Input not found or already spent";
+            return;
         }
+        result.found = true;
         const CScript &prevPubKey = coin->second.GetTxOut().scriptPubKey;
         const Amount amount = coin->second.GetTxOut().nValue;
 
@@ -461,31 +491,64 @@ bool SignTransaction(CMutableTransaction &mtx, const SigningProvider *keystore,
         if ((sigHashType.getBaseType() != BaseSigHashType::SINGLE) ||
             (i < mtx.vout.size())) {
             ProduceSignature(*keystore,
-                             MutableTransactionSignatureCreator(&mtx, i, amount,
-                                                                sigHashType),
+                             MutableTransactionSignatureCreator(
+                                 &mtx, i, amount, sigHashType, txdata),
                              prevPubKey, sigdata);
         }
 
-        UpdateInput(txin, sigdata);
+        result.scriptSig = std::move(sigdata.scriptSig);
 
         // amount must be specified for valid signature
         if (amount == MAX_MONEY) {
-            input_errors[i] = "Missing amount";
-            continue;
+            result.error = "Missing amount";
+            return;
         }
 
         ScriptError serror = ScriptError::OK;
-        if (!VerifyScript(
-                txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS,
-                TransactionSignatureChecker(&txConst, i, amount), &serror)) {
+        if (!VerifyScript(result.scriptSig, prevPubKey,
+                          STANDARD_SCRIPT_VERIFY_FLAGS,
+                          TransactionSignatureChecker(&txConst, i, amount,
+                                                      txdata),
+                          &serror)) {
             if (serror == ScriptError::INVALID_STACK_OPERATION) {
                 // Unable to sign input and verification failed (possible
                 // attempt to partially sign).
-                input_errors[i] = "Unable to sign input, invalid stack size "
-                                  "(possibly missing key)";
+                result.error = "Unable to sign input, invalid stack size "
+                               "(possibly missing key)";
             } else {
-                input_errors[i] = ScriptErrorString(serror);
+                result.error = ScriptErrorString(serror);
             }
+        }
+    };
+
+    const size_t num_threads = std::max<size_t>(
+        1, std::min<size_t>(
+               std::clamp<size_t>(std::thread::hardware_concurrency(), 1,
+                                  MAX_SIGNING_THREADS),
+               mtx.vin.size() / MIN_INPUTS_PER_SIGNING_THREAD));
+    std::atomic<size_t> next_input{0};
+    auto worker = [&] {
+        for (size_t i = next_input++; i < results.size(); i = next_input++) {
+            sign_input(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (size_t i = 1; i < num_threads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        InputSigningResult &result = results[i];
+        if (result.found) {
+            mtx.vin[i].scriptSig = std::move(result.scriptSig);
+        }
+        if (!result.error.empty()) {
+            input_errors[i] = std::move(result.error);
         } else {
             // If this input succeeds, make sure there is no error set for it
             input_errors.erase(i);
@@ -40,12 +40,21 @@ class MutableTransactionSignatureCreator : public BaseSignatureCreator {
     unsigned int nIn;
     Amount amount;
     SigHashType sigHashType;
+    const PrecomputedTransactionData *txdata;
     const MutableTransactionSignatureChecker checker;
 
 public:
     MutableTransactionSignatureCreator(
         const CMutableTransaction *txToIn, unsigned int nInIn,
         const Amount &amountIn, SigHashType sigHashTypeIn = SigHashType());
+    /**
+     * Use the precomputed sighash data of the transaction, which can be
+     * shared by all its inputs.
+     */
+    MutableTransactionSignatureCreator(
+        const CMutableTransaction *txToIn, unsigned int nInIn,
+        const Amount &amountIn, SigHashType sigHashTypeIn,
+        const PrecomputedTransactionData &txdataIn);
     const BaseSignatureChecker &Checker() const override { return checker; }
     bool CreateSig(const SigningProvider &provider,
                    std::vector<uint8_t> &vchSig, const CKeyID &keyid,
@@ -193,7 +202,17 @@ void UpdateInput(CTxIn &input, const SignatureData &data);
  */
 bool IsSolvable(const SigningProvider &provider, const CScript &script);
 
-/** Sign the CMutableTransaction */
+//! Maximum number of threads signing the inputs of a transaction
+static constexpr int MAX_SIGNING_THREADS = 16;
+//! Transactions with fewer inputs per thread are signed on fewer threads
+static constexpr size_t MIN_INPUTS_PER_SIGNING_THREAD = 32;
+
+/**
+ * Sign the CMutableTransaction. Large transactions have their inputs signed on
+ * several threads, so the provider must be safe to query concurrently and
+ * must not need a lock held by the caller. The result doesn't depend on the
+ * number of threads.
+ */
 bool SignTransaction(CMutableTransaction &mtx, const SigningProvider *provider,
                      const std::map<COutPoint, Coin> &coins,
                      SigHashType sigHashType,
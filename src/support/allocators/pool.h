@@ -0,0 +1,263 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * Memory pool for node based containers. Small blocks are carved from large
+ * slabs and recycled through a free list per slab, which saves the
+ * bookkeeping overhead and the fragmentation of one malloc per element.
+ * Larger blocks, such as the bucket arrays of hashed containers, are allocated
+ * with operator new.
+ *
+ * Each slab only holds blocks of a single size, and a slab is returned to the
+ * system as soon as all its blocks are freed, except for one empty slab per
+ * block size which is kept for the next allocations. The memory of a slab is
+ * only touched as blocks are carved from it, so UsedBytes() + FreeBytes() is
+ * what the pool really holds, while AllocatedBytes() also counts the part of
+ * the slabs that was never used.
+ *
+ * The pool is not thread safe: the containers using it have their own lock.
+ */
+class SlabPool {
+public:
+    //! Blocks up to this size are allocated from the slabs
+    static constexpr size_t MAX_BLOCK_SIZE = 512;
+    //! Block sizes are rounded up to a multiple of the alignment
+    static constexpr size_t BLOCK_ALIGN = alignof(void *);
+    //! Slabs are aligned on their size, so the slab of a block is found by
+    //! masking its address.
+    static constexpr size_t SLAB_SIZE = 256 * 1024;
+
+private:
+    static constexpr size_t NUM_SIZES = MAX_BLOCK_SIZE / BLOCK_ALIGN + 1;
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+    static_assert(sizeof(FreeBlock) <= BLOCK_ALIGN,
+                  "Free blocks must fit in the smallest block");
+
+    struct Slab {
+        //! Links in the list of the slabs with free blocks of the same size
+        Slab *prev;
+        Slab *next;
+        FreeBlock *free_list;
+        //! Start of the part of the slab which was never allocated
+        char *pos;
+        size_t block_size;
+        size_t used_blocks;
+
+        char *End() { return reinterpret_cast<char *>(this) + SLAB_SIZE; }
+        bool HasFreeBlock() {
+            return free_list != nullptr ||
+                   size_t(End() - pos) >= block_size;
+        }
+    };
+    static constexpr size_t SLAB_HEADER_SIZE =
+        (sizeof(Slab) + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+
+    //! For each block size, the slabs which have free blocks
+    std::array<Slab *, NUM_SIZES> m_available{};
+    //! For each block size, whether an empty slab is kept
+    std::array<bool, NUM_SIZES> m_has_empty_slab{};
+    size_t m_slab_count{0};
+    //! Size of the blocks currently allocated, rounded up
+    size_t m_used_bytes{0};
+    //! Size of the freed blocks kept in the free lists of the slabs
+    size_t m_free_bytes{0};
+    //! Size of the blocks allocated with operator new
+    size_t m_large_bytes{0};
+
+    static size_t BlockSize(size_t bytes) {
+        return (std::max<size_t>(bytes, 1) + BLOCK_ALIGN - 1) / BLOCK_ALIGN *
+               BLOCK_ALIGN;
+    }
+
+    static bool IsSmall(size_t bytes, size_t alignment) {
+        return bytes <= MAX_BLOCK_SIZE && alignment <= BLOCK_ALIGN;
+    }
+
+    static Slab *SlabOf(void *p) {
+        return reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(p) &
+                                        ~uintptr_t(SLAB_SIZE - 1));
+    }
+
+    void Link(Slab *slab) {
+        Slab *&head = m_available[slab->block_size / BLOCK_ALIGN];
+        slab->prev = nullptr;
+        slab->next = head;
+        if (head != nullptr) {
+            head->prev = slab;
+        }
+        head = slab;
+    }
+
+    void Unlink(Slab *slab) {
+        if (slab->prev != nullptr) {
+            slab->prev->next = slab->next;
+        } else {
+            m_available[slab->block_size / BLOCK_ALIGN] = slab->next;
+        }
+        if (slab->next != nullptr) {
+            slab->next->prev = slab->prev;
+        }
+    }
+
+    Slab *NewSlab(size_t block_size) {
+        void *mem = ::operator new(SLAB_SIZE, std::align_val_t(SLAB_SIZE));
+        Slab *slab = new (mem) Slab{};
+        slab->pos = static_cast<char *>(mem) + SLAB_HEADER_SIZE;
+        slab->block_size = block_size;
+        ++m_slab_count;
+        Link(slab);
+        return slab;
+    }
+
+    void FreeSlab(Slab *slab) noexcept {
+        // All the blocks carved from the slab are free by now.
+        m_free_bytes -= slab->pos - (reinterpret_cast<char *>(slab) +
+                                     SLAB_HEADER_SIZE);
+        Unlink(slab);
+        slab->~Slab();
+        ::operator delete(slab, std::align_val_t(SLAB_SIZE));
+        --m_slab_count;
+    }
+
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+
+    ~SlabPool() {
+        for (Slab *head : m_available) {
+            while (head != nullptr) {
+                Slab *next = head->next;
+                head->~Slab();
+                ::operator delete(head, std::align_val_t(SLAB_SIZE));
+                head = next;
+            }
+        }
+    }
+
+    void *Allocate(size_t bytes, size_t alignment) {
+        if (!IsSmall(bytes, alignment)) {
+            void *p = ::operator new(bytes);
+            m_large_bytes += bytes;
+            m_used_bytes += bytes;
+            return p;
+        }
+
+        const size_t block_size = BlockSize(bytes);
+        Slab *slab = m_available[block_size / BLOCK_ALIGN];
+        if (slab == nullptr) {
+            slab = NewSlab(block_size);
+        }
+        if (slab->used_blocks++ == 0) {
+            m_has_empty_slab[block_size / BLOCK_ALIGN] = false;
+        }
+
+        void *p;
+        if (slab->free_list != nullptr) {
+            p = slab->free_list;
+            slab->free_list = slab->free_list->next;
+            m_free_bytes -= block_size;
+        } else {
+            p = slab->pos;
+            slab->pos += block_size;
+        }
+        if (!slab->HasFreeBlock()) {
+            Unlink(slab);
+        }
+        m_used_bytes += block_size;
+        return p;
+    }
+
+    void Deallocate(void *p, size_t bytes, size_t alignment) noexcept {
+        if (!IsSmall(bytes, alignment)) {
+            ::operator delete(p);
+            m_large_bytes -= bytes;
+            m_used_bytes -= bytes;
+            return;
+        }
+
+        Slab *slab = SlabOf(p);
+        m_used_bytes -= slab->block_size;
+        if (!slab->HasFreeBlock()) {
+            Link(slab);
+        }
+        slab->free_list = new (p) FreeBlock{slab->free_list};
+        m_free_bytes += slab->block_size;
+        if (--slab->used_blocks == 0) {
+            bool &has_empty_slab =
+                m_has_empty_slab[slab->block_size / BLOCK_ALIGN];
+            if (has_empty_slab) {
+                FreeSlab(slab);
+            } else {
+                has_empty_slab = true;
+            }
+        }
+    }
+
+    //! Memory of the blocks in use
+    size_t UsedBytes() const { return m_used_bytes; }
+    //! Memory of the free blocks held by the slabs, which is reused by the
+    //! next allocations of the same size
+    size_t FreeBytes() const { return m_free_bytes; }
+    //! Memory of the slabs and of the large blocks
+    size_t AllocatedBytes() const {
+        return m_slab_count * SLAB_SIZE + m_large_bytes;
+    }
+};
+
+/** Allocator drawing from a SlabPool, which must outlive the container. */
+template <typename T> struct slab_pool_allocator {
+    typedef T value_type;
+    template <typename U> struct rebind {
+        typedef slab_pool_allocator<U> other;
+    };
+
+    SlabPool *pool;
+
+    explicit slab_pool_allocator(SlabPool &pool_in) noexcept
+        : pool(&pool_in) {}
+    template <typename U>
+    slab_pool_allocator(const slab_pool_allocator<U> &other) noexcept
+        : pool(other.pool) {}
+
+    T *allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(pool->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, size_t n) noexcept {
+        pool->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const slab_pool_allocator<T> &a,
+                const slab_pool_allocator<U> &b) noexcept {
+    return a.pool == b.pool;
+}
+
+template <typename T, typename U>
+bool operator!=(const slab_pool_allocator<T> &a,
+                const slab_pool_allocator<U> &b) noexcept {
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
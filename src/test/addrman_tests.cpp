@@ -14,6 +14,7 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
 #include <optional>
 #include <string>
 
@@ -29,7 +30,7 @@ public:
             MakeDeterministic();
         }
         deterministic = makeDeterministic;
-        m_asmap = asmap;
+        m_asmap = CompiledAsmap(asmap);
     }
 
     //! Ensure that bucket placement is always the same for testing purposes.
@@ -68,6 +69,32 @@ public:
         return std::pair<int, int>(-1, -1);
     }
 
+    // Used to test deserialization, lists the tables as "bucket/position
+    // address" entries.
+    std::vector<std::string> GetTables() {
+        LOCK(cs);
+        std::vector<std::string> tables;
+        for (int bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; ++bucket) {
+            for (int entry = 0; entry < ADDRMAN_BUCKET_SIZE; ++entry) {
+                if (vvTried[bucket][entry] != -1) {
+                    tables.push_back(
+                        strprintf("tried %d/%d %s", bucket, entry,
+                                  mapInfo[vvTried[bucket][entry]].ToString()));
+                }
+            }
+        }
+        for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; ++bucket) {
+            for (int entry = 0; entry < ADDRMAN_BUCKET_SIZE; ++entry) {
+                if (vvNew[bucket][entry] != -1) {
+                    tables.push_back(
+                        strprintf("new %d/%d %s", bucket, entry,
+                                  mapInfo[vvNew[bucket][entry]].ToString()));
+                }
+            }
+        }
+        return tables;
+    }
+
     // Simulates connection failure so that we can test eviction of offline
     // nodes
     void SimConnFail(const CService &addr) {
@@ -247,7 +274,7 @@ BOOST_AUTO_TEST_CASE(addrman_select) {
 
     // Test: Select pulls from new and tried regardless of port number.
     std::set<uint16_t> ports;
-    for (int i = 0; i < 20; ++i) {
+    for (int i = 0; i < 50; ++i) {
         ports.insert(addrman.Select().GetPort());
     }
     BOOST_CHECK_EQUAL(ports.size(), 3U);
@@ -468,7 +495,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_tried_bucket_legacy) {
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
     // use /16
-    std::vector<bool> asmap;
+    CompiledAsmap asmap;
 
     BOOST_CHECK_EQUAL(info1.GetTriedBucket(nKey1, asmap), 40);
 
@@ -524,7 +551,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_new_bucket_legacy) {
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
     // use /16
-    std::vector<bool> asmap;
+    CompiledAsmap asmap;
 
     // Test: Make sure the buckets are what we expect
     BOOST_CHECK_EQUAL(info1.GetNewBucket(nKey1, asmap), 786);
@@ -604,7 +631,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_tried_bucket) {
     uint256 nKey1 = (uint256)(CHashWriter(SER_GETHASH, 0) << 1).GetHash();
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
-    std::vector<bool> asmap = FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
+    CompiledAsmap asmap(FromBytes(asmap_raw, sizeof(asmap_raw) * 8));
 
     BOOST_CHECK_EQUAL(info1.GetTriedBucket(nKey1, asmap), 236);
 
@@ -659,7 +686,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_new_bucket) {
     uint256 nKey1 = (uint256)(CHashWriter(SER_GETHASH, 0) << 1).GetHash();
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
-    std::vector<bool> asmap = FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
+    CompiledAsmap asmap(FromBytes(asmap_raw, sizeof(asmap_raw) * 8));
 
     // Test: Make sure the buckets are what we expect
     BOOST_CHECK_EQUAL(info1.GetNewBucket(nKey1, asmap), 795);
@@ -727,6 +754,38 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_new_bucket) {
     BOOST_CHECK(buckets.size() == 1);
 }
 
+BOOST_AUTO_TEST_CASE(compiled_asmap_lookup) {
+    const std::vector<bool> asmap =
+        FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
+    BOOST_REQUIRE(SanityCheckASMap(asmap, 128));
+    const CompiledAsmap compiled(asmap);
+    BOOST_CHECK(compiled.GetBits() == asmap);
+    // The runs of MATCH instructions for the IPv4 prefix are merged.
+    BOOST_CHECK(compiled.GetInstructionCount() < 50);
+
+    FastRandomContext rng(true);
+    std::set<uint32_t> asns;
+    for (int i = 0; i < 10000; ++i) {
+        std::vector<uint8_t> ip = rng.randbytes(16);
+        if (i % 2) {
+            // IPv4 addresses, mostly in the mapped ranges.
+            std::copy(IPV4_IN_IPV6_PREFIX.begin(), IPV4_IN_IPV6_PREFIX.end(),
+                      ip.begin());
+            ip[12] = rng.randbool() ? 101 : 250;
+            ip[13] = rng.randrange(10);
+        }
+        std::vector<bool> bits(128);
+        for (int bit = 0; bit < 128; ++bit) {
+            bits[bit] = (ip[bit / 8] >> (7 - bit % 8)) & 1;
+        }
+        const uint32_t asn = Interpret(asmap, bits);
+        BOOST_CHECK_EQUAL(compiled.Lookup(ip), asn);
+        asns.insert(asn);
+    }
+    // AS0 and the 9 ASes of the map.
+    BOOST_CHECK_EQUAL(asns.size(), 10U);
+}
+
 BOOST_AUTO_TEST_CASE(addrman_serialization) {
     std::vector<bool> asmap1 = FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
 
@@ -807,6 +866,117 @@ BOOST_AUTO_TEST_CASE(addrman_serialization) {
                 bucketAndEntry_asmap1_deser_addr2.second);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_serialization_positions) {
+    CAddrManTest addrman;
+    CAddrManTest addrman_dup;
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+
+    // Addresses learnt from several sources, so that some of them are
+    // referenced from more than one new bucket, and some in tried.
+    for (int source_i = 1; source_i <= 8; ++source_i) {
+        const CNetAddr source =
+            ResolveIP(strprintf("252.%d.%d.1", source_i, source_i));
+        for (int addr_i = 1; addr_i <= 100; ++addr_i) {
+            CAddress addr(ResolveService(strprintf("250.%d.1.1", addr_i),
+                                         8333),
+                          NODE_NONE);
+            // Newer information from each source, to add references.
+            addr.nTime = GetAdjustedTime() - (8 - source_i) * 60;
+            addrman.Add(addr, source);
+        }
+    }
+    for (int addr_i = 1; addr_i <= 100; addr_i += 3) {
+        addrman.Good(ResolveService(strprintf("250.%d.1.1", addr_i), 8333));
+    }
+
+    const std::vector<std::string> tables = addrman.GetTables();
+    BOOST_CHECK_GT(tables.size(), addrman.size());
+
+    // The entries are restored at the same positions, including all the
+    // references to the new entries.
+    stream << addrman;
+    stream >> addrman_dup;
+    BOOST_CHECK_EQUAL(addrman_dup.size(), addrman.size());
+    BOOST_CHECK(addrman_dup.GetTables() == tables);
+
+    // Selecting from the restored tables works.
+    for (int i = 0; i < 10; ++i) {
+        BOOST_CHECK(addrman_dup.Select().GetPort() == 8333);
+        BOOST_CHECK(addrman_dup.Select(/* newOnly */ true).GetPort() == 8333);
+    }
+
+    // The positions are recalculated when the asmap changes.
+    std::vector<bool> asmap1 = FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
+    CAddrManTest addrman_asmap1(true, asmap1);
+    stream << addrman;
+    stream >> addrman_asmap1;
+    BOOST_CHECK(addrman_asmap1.size() > 0);
+    BOOST_CHECK(addrman_asmap1.GetTables() != tables);
+
+    // The file is still compatible with the previous format.
+    CDataStream tampered(SER_DISK, CLIENT_VERSION);
+    tampered << addrman;
+    BOOST_CHECK_EQUAL(uint8_t(tampered[0]), 4);
+    BOOST_CHECK_EQUAL(uint8_t(tampered[1]), 32 + 3);
+
+    // A stored tried position that is not the one of the address in its
+    // bucket is ignored, the address is hashed into its position again. The
+    // tried positions are right before the 32 bytes of the asmap version.
+    const size_t tried_count = std::count_if(
+        tables.begin(), tables.end(),
+        [](const std::string &entry) { return entry.rfind("tried", 0) == 0; });
+    BOOST_CHECK(tried_count > 0);
+    const size_t first_position = tampered.size() - 32 - 4 * tried_count;
+    tampered[first_position] ^= 1;
+    CAddrManTest addrman_tampered;
+    tampered >> addrman_tampered;
+    BOOST_CHECK(addrman_tampered.GetTables() == tables);
+
+    // A reader of the previous format sees the tried positions as an extra
+    // new bucket and places all the entries again.
+    CDataStream v3(SER_DISK, CLIENT_VERSION);
+    v3 << addrman;
+    v3[0] = 3;
+    CAddrManTest addrman_v3;
+    v3 >> addrman_v3;
+    BOOST_CHECK(addrman_v3.size() > 0);
+    std::vector<std::string> tried_tables;
+    for (const std::string &entry : addrman_v3.GetTables()) {
+        if (entry.rfind("tried", 0) == 0) {
+            tried_tables.push_back(entry);
+        }
+    }
+    BOOST_CHECK(tried_tables == std::vector<std::string>(
+                                    tables.begin(),
+                                    tables.begin() + tried_count));
+}
+
+BOOST_AUTO_TEST_CASE(addrman_occupancy) {
+    AddrManOccupancy occupancy(ADDRMAN_NEW_BUCKET_COUNT);
+    BOOST_CHECK_EQUAL(occupancy.Count(), 0);
+
+    const std::vector<std::pair<int, int>> positions{
+        {0, 0}, {0, 63}, {1, 5}, {500, 17}, {1023, 0}, {1023, 63}};
+    for (const auto &[bucket, pos] : positions) {
+        occupancy.Set(bucket, pos);
+    }
+    BOOST_CHECK_EQUAL(occupancy.Count(), positions.size());
+    for (size_t n = 0; n < positions.size(); ++n) {
+        BOOST_CHECK(occupancy.Get(n) == positions[n]);
+    }
+
+    occupancy.Unset(0, 63);
+    occupancy.Unset(1023, 0);
+    BOOST_CHECK_EQUAL(occupancy.Count(), 4);
+    BOOST_CHECK(occupancy.Get(0) == std::make_pair(0, 0));
+    BOOST_CHECK(occupancy.Get(1) == std::make_pair(1, 5));
+    BOOST_CHECK(occupancy.Get(2) == std::make_pair(500, 17));
+    BOOST_CHECK(occupancy.Get(3) == std::make_pair(1023, 63));
+
+    occupancy.Clear();
+    BOOST_CHECK_EQUAL(occupancy.Count(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(addrman_selecttriedcollision) {
     CAddrManTest addrman;
 
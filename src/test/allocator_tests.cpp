@@ -2,12 +2,14 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <support/allocators/pool.h>
 #include <util/system.h>
 
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
 
+#include <list>
 #include <memory>
 
 BOOST_FIXTURE_TEST_SUITE(allocator_tests, BasicTestingSetup)
@@ -240,4 +242,63 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live) {
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(slabpool_tests) {
+    SlabPool pool;
+
+    // Small blocks are rounded up and carved from a slab.
+    void *a0 = pool.Allocate(20, 4);
+    void *a1 = pool.Allocate(24, 8);
+    BOOST_CHECK_EQUAL(pool.UsedBytes(), 48U);
+    BOOST_CHECK_EQUAL(pool.AllocatedBytes(), SlabPool::SLAB_SIZE);
+    BOOST_CHECK_EQUAL(static_cast<char *>(a1) - static_cast<char *>(a0), 24);
+
+    // Freed blocks are reused for blocks of the same size, other sizes come
+    // from another slab.
+    pool.Deallocate(a0, 20, 4);
+    BOOST_CHECK_EQUAL(pool.UsedBytes(), 24U);
+    BOOST_CHECK_EQUAL(pool.FreeBytes(), 24U);
+    BOOST_CHECK_EQUAL(pool.Allocate(17, 8), a0);
+    BOOST_CHECK_EQUAL(pool.FreeBytes(), 0U);
+    pool.Deallocate(a0, 17, 8);
+    void *a2 = pool.Allocate(8, 8);
+    BOOST_CHECK(a2 != a0);
+    BOOST_CHECK_EQUAL(pool.AllocatedBytes(), 2 * SlabPool::SLAB_SIZE);
+
+    // Large blocks are allocated separately.
+    void *large = pool.Allocate(SlabPool::MAX_BLOCK_SIZE + 1, 8);
+    BOOST_CHECK_EQUAL(pool.UsedBytes(), 32U + SlabPool::MAX_BLOCK_SIZE + 1);
+    BOOST_CHECK_EQUAL(pool.AllocatedBytes(),
+                      2 * SlabPool::SLAB_SIZE + SlabPool::MAX_BLOCK_SIZE + 1);
+    pool.Deallocate(large, SlabPool::MAX_BLOCK_SIZE + 1, 8);
+    pool.Deallocate(a1, 24, 8);
+    pool.Deallocate(a2, 8, 8);
+    BOOST_CHECK_EQUAL(pool.UsedBytes(), 0U);
+    BOOST_CHECK_EQUAL(pool.FreeBytes(), 56U);
+    // One empty slab is kept for each block size.
+    BOOST_CHECK_EQUAL(pool.AllocatedBytes(), 2 * SlabPool::SLAB_SIZE);
+
+    // Containers using the pool allocate new slabs as they grow, and reuse
+    // the freed nodes.
+    {
+        std::list<uint64_t, slab_pool_allocator<uint64_t>> list{
+            slab_pool_allocator<uint64_t>(pool)};
+        for (uint64_t i = 0; i < SlabPool::SLAB_SIZE; ++i) {
+            list.push_back(i);
+        }
+        BOOST_CHECK(pool.AllocatedBytes() > 2 * SlabPool::SLAB_SIZE);
+        const size_t used = pool.UsedBytes();
+        BOOST_CHECK(used >= SlabPool::SLAB_SIZE * 3 * sizeof(void *));
+
+        const size_t allocated = pool.AllocatedBytes();
+        list.pop_front();
+        list.push_back(0);
+        BOOST_CHECK_EQUAL(pool.UsedBytes(), used);
+        BOOST_CHECK_EQUAL(pool.AllocatedBytes(), allocated);
+    }
+    BOOST_CHECK_EQUAL(pool.UsedBytes(), 0U);
+    // The slabs are returned as they become empty.
+    BOOST_CHECK_EQUAL(pool.AllocatedBytes(), 2 * SlabPool::SLAB_SIZE);
+    BOOST_CHECK(pool.FreeBytes() <= pool.AllocatedBytes());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
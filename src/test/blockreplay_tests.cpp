@@ -0,0 +1,182 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockreplay.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <config.h>
+#include <consensus/params.h>
+#include <script/interpreter.h>
+#include <script/sighashtype.h>
+#include <streams.h>
+#include <validation.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+BOOST_AUTO_TEST_SUITE(blockreplay_tests)
+
+/**
+ * Mine two blocks: the first one spends a coinbase to anyone-can-spend
+ * outputs, the second one spends them together with another coinbase.
+ */
+static void MineReplayBlocks(TestChain100Setup &setup) {
+    const CKey &key = setup.coinbaseKey;
+    const CScript coinbase_script = CScript() << ToByteVector(key.GetPubKey())
+                                              << OP_CHECKSIG;
+    const CScript anyone_can_spend = CScript() << OP_TRUE;
+
+    auto sign_coinbase_spend = [&](CMutableTransaction &mtx, unsigned int nIn,
+                                   const CTransactionRef &coinbase) {
+        // Sign the way the next block will verify.
+        uint32_t flags = SCRIPT_ENABLE_SIGHASH_FORKID;
+        if (WITH_LOCK(cs_main,
+                      return ::ChainActive().Tip()->GetMedianTimePast()) >=
+            Params().GetConsensus().jeffersonActivationTime) {
+            flags |= SCRIPT_ENABLE_REPLAY_PROTECTION;
+        }
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(coinbase_script, CTransaction(mtx), nIn,
+                                     SigHashType().withForkId(),
+                                     coinbase->vout[0].nValue, nullptr, flags);
+        BOOST_REQUIRE(key.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        mtx.vin[nIn].scriptSig = CScript() << vchSig;
+    };
+
+    CMutableTransaction fanout;
+    fanout.vin.emplace_back(COutPoint(setup.m_coinbase_txns[0]->GetId(), 0));
+    const Amount value = setup.m_coinbase_txns[0]->vout[0].nValue / 2;
+    fanout.vout.emplace_back(value - 1000 * SATOSHI, anyone_can_spend);
+    fanout.vout.emplace_back(value - 1000 * SATOSHI, anyone_can_spend);
+    sign_coinbase_spend(fanout, 0, setup.m_coinbase_txns[0]);
+    setup.CreateAndProcessBlock({fanout}, coinbase_script);
+
+    CMutableTransaction fanin;
+    fanin.vin.emplace_back(COutPoint(fanout.GetId(), 0));
+    fanin.vin.emplace_back(COutPoint(fanout.GetId(), 1));
+    fanin.vout.emplace_back(2 * value - 3000 * SATOSHI, coinbase_script);
+    CMutableTransaction spend;
+    spend.vin.emplace_back(COutPoint(setup.m_coinbase_txns[1]->GetId(), 0));
+    spend.vout.emplace_back(value, coinbase_script);
+    sign_coinbase_spend(spend, 0, setup.m_coinbase_txns[1]);
+    setup.CreateAndProcessBlock({fanin, spend}, coinbase_script);
+
+    BOOST_REQUIRE_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Height()),
+                        102);
+}
+
+static BlockReplayData ExportBlocks(int start_height, int end_height) {
+    BlockReplayData data;
+    std::string error;
+    BOOST_REQUIRE(ExportBlockReplay(::ChainActive(), Params(), start_height,
+                                    end_height, data, error));
+    return data;
+}
+
+BOOST_FIXTURE_TEST_CASE(blockreplay_export, TestChain100Setup) {
+    MineReplayBlocks(*this);
+
+    BlockReplayData data;
+    std::string error;
+    BOOST_CHECK(!ExportBlockReplay(::ChainActive(), Params(), 0, 1, data,
+                                   error));
+    BOOST_CHECK(!ExportBlockReplay(::ChainActive(), Params(), 102, 101, data,
+                                   error));
+    BOOST_CHECK(!ExportBlockReplay(::ChainActive(), Params(), 101, 103, data,
+                                   error));
+
+    BOOST_REQUIRE(ExportBlockReplay(::ChainActive(), Params(), 101, 102, data,
+                                    error));
+    BOOST_CHECK_EQUAL(data.chain, CBaseChainParams::REGTEST);
+    BOOST_CHECK_EQUAL(data.start_height, 101);
+    BOOST_CHECK_EQUAL(data.context.size(), 11U);
+    BOOST_CHECK(data.context.back().GetHash() ==
+                WITH_LOCK(cs_main,
+                          return ::ChainActive()[100]->GetBlockHash()));
+    BOOST_REQUIRE_EQUAL(data.blocks.size(), 2U);
+    BOOST_CHECK(data.blocks[1].GetHash() ==
+                WITH_LOCK(cs_main,
+                          return ::ChainActive().Tip()->GetBlockHash()));
+    BOOST_CHECK_EQUAL(data.undo[1].vtxundo.size(), 2U);
+
+    // The context starts at the genesis block for early ranges.
+    BOOST_REQUIRE(ExportBlockReplay(::ChainActive(), Params(), 5, 6, data,
+                                    error));
+    BOOST_CHECK_EQUAL(data.context.size(), 5U);
+}
+
+BOOST_FIXTURE_TEST_CASE(blockreplay_run, TestChain100Setup) {
+    MineReplayBlocks(*this);
+
+    // Round trip through serialization, as when replaying from a file.
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << ExportBlocks(101, 102);
+    BlockReplayData data;
+    stream >> data;
+
+    BlockReplay replay(std::move(data), Params(), m_path_root / "replay");
+    // The two coinbases; the anyone-can-spend outputs are created in range.
+    BOOST_CHECK_EQUAL(replay.GetBaseCoinsCount(), 2U);
+
+    LOCK(cs_main);
+    BlockReplayOptions options;
+    BlockReplayTimings timings;
+    std::string error;
+    // Every run leaves the coins database as it found it, so it can be
+    // repeated, with or without a warm cache or intermediate flushes.
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK_MESSAGE(replay.Run(GetConfig(), ::ChainstateActive(),
+                                       options, timings, error),
+                            error);
+    }
+    options.flush_interval = 1;
+    BOOST_CHECK(replay.Run(GetConfig(), ::ChainstateActive(), options,
+                           timings, error));
+    options.warm_cache = true;
+    BOOST_CHECK(replay.Run(GetConfig(), ::ChainstateActive(), options,
+                           timings, error));
+    BOOST_CHECK_EQUAL(timings.blocks, 8);
+
+    // The replay did not touch the node's own chain.
+    BOOST_CHECK_EQUAL(::ChainActive().Height(), 102);
+
+    // A shorter range takes the outputs of the blocks before it from the
+    // base coins.
+    BlockReplay short_replay(ExportBlocks(102, 102), Params(),
+                             m_path_root / "short_replay");
+    BOOST_CHECK_EQUAL(short_replay.GetBaseCoinsCount(), 3U);
+    BOOST_CHECK(short_replay.Run(GetConfig(), ::ChainstateActive(), {},
+                                 timings, error));
+}
+
+BOOST_FIXTURE_TEST_CASE(blockreplay_invalid_data, TestChain100Setup) {
+    MineReplayBlocks(*this);
+
+    // Context that does not lead to the range.
+    BlockReplayData data = ExportBlocks(101, 102);
+    data.context.back().nTime++;
+    BOOST_CHECK_THROW(BlockReplay(data, Params(), m_path_root / "replay"),
+                      std::runtime_error);
+
+    // Missing undo data.
+    data = ExportBlocks(101, 102);
+    data.undo.pop_back();
+    BOOST_CHECK_THROW(BlockReplay(data, Params(), m_path_root / "replay"),
+                      std::runtime_error);
+
+    // Wrong network.
+    data = ExportBlocks(101, 102);
+    data.chain = CBaseChainParams::MAIN;
+    BOOST_CHECK_THROW(BlockReplay(data, Params(), m_path_root / "replay"),
+                      std::runtime_error);
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
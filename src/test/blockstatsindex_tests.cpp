@@ -0,0 +1,107 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blockstatsindex.h>
+
+#include <blockdb.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <config.h>
+#include <hash.h>
+#include <undo.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockstatsindex_tests)
+
+static void CheckIndexedStats(const BlockStatsIndex &index,
+                              const CBlockIndex *pindex) {
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+    CBlockUndo blockUndo;
+    if (pindex->nHeight > 0) {
+        BOOST_REQUIRE(UndoReadFromDisk(blockUndo, pindex));
+    }
+    const CBlockStats expected =
+        ComputeBlockStats(block, blockUndo, *pindex, Params().GetConsensus(),
+                          GetConfig().GetMaxBlockSize());
+
+    CBlockStats stats;
+    BOOST_REQUIRE(index.LookupStats(pindex, stats));
+    BOOST_CHECK_EQUAL(stats.blockhash, pindex->GetBlockHash());
+    BOOST_CHECK_EQUAL(stats.height, pindex->nHeight);
+    BOOST_CHECK_EQUAL(stats.txs, block.vtx.size());
+    BOOST_CHECK(SerializeHash(stats) == SerializeHash(expected));
+}
+
+BOOST_FIXTURE_TEST_CASE(blockstatsindex_initial_sync, TestChain100Setup) {
+    BlockStatsIndex index(1 << 20, true);
+
+    CBlockStats stats;
+    const CBlockIndex *tip = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+
+    // Nothing is indexed before the index is started.
+    BOOST_CHECK(!index.LookupStats(tip, stats));
+
+    // BlockUntilSyncedToCurrentChain should return false before the index is
+    // started.
+    BOOST_CHECK(!index.BlockUntilSyncedToCurrentChain());
+
+    index.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // Check that all the blocks that were in the chain before the index
+    // started are indexed, including the genesis block.
+    for (const CBlockIndex *pindex = tip; pindex; pindex = pindex->pprev) {
+        CheckIndexedStats(index, pindex);
+    }
+
+    // Check that new blocks make it into the index, including one with a
+    // transaction paying a fee.
+    CScript coinbase_script_pub_key = CScript() << ToByteVector(
+                                          coinbaseKey.GetPubKey())
+                                      << OP_CHECKSIG;
+    for (int i = 0; i < 10; i++) {
+        std::vector<CMutableTransaction> txns;
+        if (i == 0) {
+            txns.push_back(CreateValidMempoolTransaction(
+                m_coinbase_txns[0], 0, 1, coinbaseKey, coinbase_script_pub_key,
+                m_coinbase_txns[0]->vout[0].nValue - 1000 * SATOSHI,
+                /* submit */ false));
+        }
+        const CBlock &block =
+            CreateAndProcessBlock(txns, coinbase_script_pub_key);
+
+        BOOST_CHECK(index.BlockUntilSyncedToCurrentChain());
+        const CBlockIndex *pindex = WITH_LOCK(
+            cs_main,
+            return g_chainman.m_blockman.LookupBlockIndex(block.GetHash()));
+        CheckIndexedStats(index, pindex);
+        if (i == 0) {
+            BOOST_REQUIRE(index.LookupStats(pindex, stats));
+            BOOST_CHECK_EQUAL(stats.txs, 2);
+            BOOST_CHECK_EQUAL(stats.totalfee, 1000 * SATOSHI);
+        }
+    }
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    index.Stop();
+
+    // Let scheduler events finish running to avoid accessing any memory related
+    // to the index after it is destructed
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -325,6 +325,55 @@ BOOST_AUTO_TEST_CASE(merkle_block_1) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(merkle_block_shared_elements) {
+    CBlock block = getBlock13b8a();
+    const std::vector<CBloomTxElements> elements =
+        GetBlockBloomElements(block);
+    BOOST_CHECK_EQUAL(elements.size(), block.vtx.size());
+    // Every transaction has at least the outpoint of an input.
+    for (const CBloomTxElements &tx_elements : elements) {
+        BOOST_CHECK(tx_elements.DynamicMemoryUsage() > 0);
+    }
+
+    // The elements extracted once give the same result for any number of
+    // filters, and the same updates of the filters, as extracting them again
+    // for each of them.
+    for (const uint8_t flags : {BLOOM_UPDATE_NONE, BLOOM_UPDATE_ALL,
+                                BLOOM_UPDATE_P2PUBKEY_ONLY}) {
+        for (uint32_t tweak = 0; tweak < 10; tweak++) {
+            CBloomFilter filter(10, 0.000001, tweak, flags);
+            // A transaction and the data pushed by an output of another one.
+            filter.insert(uint256S("0x74d681e0e03bafa802c8aa084379aa98d9fcd632"
+                                   "ddc2ed9782b586ec87451f20"));
+            const CScript &script =
+                block.vtx[tweak % block.vtx.size()]->vout[0].scriptPubKey;
+            CScript::const_iterator pc = script.begin();
+            opcodetype opcode;
+            std::vector<uint8_t> data;
+            while (script.GetOp(pc, opcode, data)) {
+                if (!data.empty()) {
+                    filter.insert(data);
+                    break;
+                }
+            }
+            CBloomFilter filter_shared = filter;
+
+            const CMerkleBlock merkleBlock(block, filter);
+            const CMerkleBlock merkleBlockShared(block, filter_shared,
+                                                 elements);
+            BOOST_CHECK(merkleBlock.vMatchedTxn ==
+                        merkleBlockShared.vMatchedTxn);
+            BOOST_CHECK(!merkleBlock.vMatchedTxn.empty());
+
+            CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+            CDataStream stream_shared(SER_NETWORK, PROTOCOL_VERSION);
+            stream << merkleBlock << filter;
+            stream_shared << merkleBlockShared << filter_shared;
+            BOOST_CHECK(stream.str() == stream_shared.str());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(merkle_block_2) {
     // Random real block
     // (000000005a4ded781e667e06ceefafb71410b511fe0d5adc3e5a27ecbec34ae6)
@@ -1168,4 +1217,75 @@ BOOST_AUTO_TEST_CASE(rolling_bloom) {
     g_mock_deterministic_tests = false;
 }
 
+BOOST_AUTO_TEST_CASE(blocked_rolling_bloom) {
+    SeedInsecureRand(SeedRand::ZEROS);
+    g_mock_deterministic_tests = true;
+
+    // last-100-entry, 1% false positive:
+    CBlockedRollingBloomFilter rb1(100, 0.01);
+
+    // Overfill:
+    static const int DATASIZE = 399;
+    std::vector<uint8_t> data[DATASIZE];
+    for (int i = 0; i < DATASIZE; i++) {
+        data[i] = RandomData();
+        rb1.insert(data[i]);
+    }
+    // Last 100 guaranteed to be remembered:
+    for (int i = 299; i < DATASIZE; i++) {
+        BOOST_CHECK(rb1.contains(data[i]));
+    }
+
+    // The filter is as full as possible, expect about 100 hits out of 10,000
+    // random keys and no more than the false positive rate allows.
+    unsigned int nHits = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (rb1.contains(RandomData())) {
+            ++nHits;
+        }
+    }
+    BOOST_CHECK_LT(nHits, 150U);
+
+    BOOST_CHECK(rb1.contains(data[DATASIZE - 1]));
+    rb1.reset();
+    BOOST_CHECK(!rb1.contains(data[DATASIZE - 1]));
+
+    // Now roll through data, make sure last 100 entries
+    // are always remembered:
+    for (int i = 0; i < DATASIZE; i++) {
+        if (i >= 100) {
+            BOOST_CHECK(rb1.contains(data[i - 100]));
+        }
+        rb1.insert(data[i]);
+        BOOST_CHECK(rb1.contains(data[i]));
+    }
+
+    // The uint256 overloads hash the same bytes as the Span ones.
+    const uint256 hash = InsecureRand256();
+    rb1.insert(hash);
+    BOOST_CHECK(rb1.contains(hash));
+    BOOST_CHECK(rb1.contains(std::vector<uint8_t>(hash.begin(), hash.end())));
+
+    // last-1000-entry, 0.0001% false positive, as used for the peers
+    // inventories:
+    CBlockedRollingBloomFilter rb2(1000, 0.000001);
+    for (int i = 0; i < 1500; i++) {
+        rb2.insert(InsecureRand256());
+    }
+    for (int i = 0; i < DATASIZE; i++) {
+        rb2.insert(data[i]);
+    }
+    for (int i = 0; i < DATASIZE; i++) {
+        BOOST_CHECK(rb2.contains(data[i]));
+    }
+    nHits = 0;
+    for (int i = 0; i < 100000; i++) {
+        if (rb2.contains(InsecureRand256())) {
+            ++nHits;
+        }
+    }
+    BOOST_CHECK_LE(nHits, 1U);
+    g_mock_deterministic_tests = false;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -849,6 +849,74 @@ BOOST_AUTO_TEST_CASE(poly1305_testvector) {
         "13000000000000000000000000000000");
 }
 
+static std::vector<uint8_t> PatternBytes(size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = i * 31 + 7;
+    }
+    return bytes;
+}
+
+BOOST_AUTO_TEST_CASE(poly1305_long_messages) {
+    // Long enough for the vectorized implementation, with and without a
+    // remainder of whole and partial blocks. The tags were computed with a
+    // big integer implementation.
+    const std::string key =
+        "85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b";
+    TestPoly1305(HexStr(PatternBytes(256)), key,
+                 "98f068a587351a375834d40d58c20b62");
+    TestPoly1305(HexStr(PatternBytes(1000)), key,
+                 "eb0cd879ab1263944d644b6ff5cc857e");
+    TestPoly1305(HexStr(PatternBytes(4096)), key,
+                 "38dc309bfc173e02f842ead88a3b1085");
+    TestPoly1305(HexStr(PatternBytes(4111)), key,
+                 "1f2d27d5fe6c82b990664fa24753211b");
+    // Largest limbs
+    TestPoly1305(HexStr(std::vector<uint8_t>(1024, 0xff)),
+                 std::string(64, 'f'), "25d4926a53bb480da228ec61e0a31a38");
+}
+
+BOOST_AUTO_TEST_CASE(chacha20_long_streams) {
+    // The vectorized implementations process the bulk of long streams, which
+    // must match the output of the scalar implementation that processes them
+    // one block at a time.
+    const std::vector<uint8_t> key = PatternBytes(32);
+    for (const uint64_t seek : {uint64_t(0), uint64_t(0xfffffff0)}) {
+        for (const size_t size : {256, 512, 1000, 4096 + 17}) {
+            const std::vector<uint8_t> m = PatternBytes(size);
+            ChaCha20 chacha(key.data(), key.size());
+            chacha.SetIV(42);
+
+            chacha.Seek(seek);
+            std::vector<uint8_t> c(size);
+            chacha.Crypt(m.data(), c.data(), size);
+            std::vector<uint8_t> keystream(size);
+            chacha.Seek(seek);
+            chacha.Keystream(keystream.data(), size);
+
+            chacha.Seek(seek);
+            std::vector<uint8_t> expected_c(size);
+            std::vector<uint8_t> expected_keystream(size);
+            for (size_t pos = 0; pos < size; pos += 64) {
+                const size_t len = std::min<size_t>(64, size - pos);
+                chacha.Crypt(m.data() + pos, expected_c.data() + pos, len);
+            }
+            chacha.Seek(seek);
+            for (size_t pos = 0; pos < size; pos += 64) {
+                const size_t len = std::min<size_t>(64, size - pos);
+                chacha.Keystream(expected_keystream.data() + pos, len);
+            }
+
+            BOOST_CHECK(c == expected_c);
+            BOOST_CHECK(keystream == expected_keystream);
+            for (size_t i = 0; i < size; ++i) {
+                keystream[i] ^= m[i];
+            }
+            BOOST_CHECK(c == keystream);
+        }
+    }
+}
+
 static void
 TestChaCha20Poly1305AEAD(bool must_succeed, unsigned int expected_aad_length,
                          const std::string &hex_m, const std::string &hex_k1,
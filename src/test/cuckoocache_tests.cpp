@@ -477,6 +477,94 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations) {
     test_cache_generations<CuckooCacheMap>();
 }
 
+/**
+ * This helper checks that the elements of a cache are kept when it grows, both
+ * while they are migrated to the new table and after, and that it keeps as
+ * many as it can store when it shrinks.
+ */
+template <typename Cache> static void test_cache_resize() {
+    SeedInsecureRand(SeedRand::ZEROS);
+    Cache set{};
+    const size_t bytes = 1 << 20;
+    const uint32_t size = set.setup_bytes(bytes);
+    std::vector<uint256> hashes;
+    for (uint32_t i = 0; i < size / 2; ++i) {
+        hashes.emplace_back(InsecureRand256());
+        set.insert(hashes.back());
+    }
+    auto count_hits = [&set](const std::vector<uint256> &v) {
+        uint32_t count = 0;
+        for (const uint256 &h : v) {
+            count += set.contains(h, false);
+        }
+        return count;
+    };
+    const uint32_t hits = count_hits(hashes);
+
+    const uint32_t new_size = set.resize_bytes(4 * bytes);
+    BOOST_CHECK_EQUAL(set.get_stats().size, new_size);
+    BOOST_CHECK_EQUAL(set.get_stats().migrating_size, size);
+    BOOST_CHECK_EQUAL(count_hits(hashes), hits);
+
+    std::vector<uint256> more;
+    while (set.get_stats().migrating_size != 0) {
+        more.emplace_back(InsecureRand256());
+        set.insert(more.back());
+        if (more.size() % 256 == 0) {
+            BOOST_CHECK_EQUAL(count_hits(hashes), hits);
+        }
+    }
+    BOOST_CHECK_EQUAL(more.size(), size / 16);
+    BOOST_CHECK_EQUAL(count_hits(hashes), hits);
+    BOOST_CHECK_EQUAL(count_hits(more), more.size());
+
+    // Shrinking drops the elements which no longer fit.
+    const uint32_t small_size = set.resize_bytes(bytes / 4);
+    while (set.get_stats().migrating_size != 0) {
+        more.emplace_back(InsecureRand256());
+        set.insert(more.back());
+    }
+    const uint32_t kept = count_hits(hashes) + count_hits(more);
+    BOOST_CHECK(kept <= small_size);
+    BOOST_CHECK(kept > small_size / 2);
+    BOOST_CHECK(set.get_stats().evictions > 0);
+
+    // Resizing again during a migration only migrates a bounded part of the
+    // previous table, the rest is dropped.
+    const uint32_t large_size = set.resize_bytes(4 * bytes);
+    BOOST_CHECK_EQUAL(set.get_stats().migrating_size, small_size);
+    set.resize_bytes(bytes);
+    BOOST_CHECK_EQUAL(set.get_stats().migrating_size, large_size);
+    BOOST_CHECK(count_hits(hashes) + count_hits(more) <= kept);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_resize) {
+    test_cache_resize<CuckooCacheSet>();
+    test_cache_resize<CuckooCacheMap>();
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_stats) {
+    SeedInsecureRand(SeedRand::ZEROS);
+    CuckooCacheSet set{};
+    set.setup_bytes(4 * 1024);
+
+    const uint256 present = InsecureRand256();
+    set.insert(present);
+    set.insert(present);
+    for (int i = 0; i < 10; ++i) {
+        BOOST_CHECK(set.contains(present, false));
+        BOOST_CHECK(!set.contains(InsecureRand256(), false));
+    }
+
+    const CuckooCache::cache_stats stats = set.get_stats();
+    BOOST_CHECK_EQUAL(stats.size, 4 * 1024 / sizeof(uint256));
+    BOOST_CHECK_EQUAL(stats.migrating_size, 0);
+    BOOST_CHECK_EQUAL(stats.hits, 10);
+    BOOST_CHECK_EQUAL(stats.misses, 10);
+    BOOST_CHECK_EQUAL(stats.inserts, 2);
+    BOOST_CHECK_EQUAL(stats.evictions, 0);
+}
+
 BOOST_AUTO_TEST_CASE(cuckoocache_map_element) {
     // Check the hash is parsed properly.
     uint256 hash = uint256S(
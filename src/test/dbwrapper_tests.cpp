@@ -10,8 +10,16 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <map>
 #include <memory>
 
+static const std::vector<DBEngineType> DB_ENGINES{
+    DBEngineType::LEVELDB,
+#ifndef WIN32
+    DBEngineType::BTREE,
+#endif
+};
+
 // Test if a string consists entirely of null characters
 static bool is_null_key(const std::vector<uint8_t> &key) {
     bool isnull = true;
@@ -26,314 +34,396 @@ static bool is_null_key(const std::vector<uint8_t> &key) {
 BOOST_FIXTURE_TEST_SUITE(dbwrapper_tests, BasicTestingSetup)
 
 BOOST_AUTO_TEST_CASE(dbwrapper) {
-    // Perform tests both obfuscated and non-obfuscated.
-    for (const bool obfuscate : {false, true}) {
-        fs::path ph =
-            m_args.GetDataDirPath() / (obfuscate ? "dbwrapper_obfuscate_true"
-                                                 : "dbwrapper_obfuscate_false");
-        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
-        char key = 'k';
-        uint256 in = InsecureRand256();
-        uint256 res;
-
-        // Ensure that we're doing real obfuscation when obfuscate=true
-        BOOST_CHECK(obfuscate !=
-                    is_null_key(dbwrapper_private::GetObfuscateKey(dbw)));
-
-        BOOST_CHECK(dbw.Write(key, in));
-        BOOST_CHECK(dbw.Read(key, res));
-        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+    for (const DBEngineType engine : DB_ENGINES) {
+        // Perform tests both obfuscated and non-obfuscated.
+        for (const bool obfuscate : {false, true}) {
+            fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                          (obfuscate ? "dbwrapper_obfuscate_true"
+                                     : "dbwrapper_obfuscate_false");
+            CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate, engine);
+            char key = 'k';
+            uint256 in = InsecureRand256();
+            uint256 res;
+
+            // Ensure that we're doing real obfuscation when obfuscate=true
+            BOOST_CHECK(obfuscate !=
+                        is_null_key(dbwrapper_private::GetObfuscateKey(dbw)));
+
+            BOOST_CHECK(dbw.Write(key, in));
+            BOOST_CHECK(dbw.Read(key, res));
+            BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+        }
     }
 }
 
 BOOST_AUTO_TEST_CASE(dbwrapper_basic_data) {
-    // Perform tests both obfuscated and non-obfuscated.
-    for (bool obfuscate : {false, true}) {
-        fs::path ph = m_args.GetDataDirPath() /
-                      (obfuscate ? "dbwrapper_1_obfuscate_true"
-                                 : "dbwrapper_1_obfuscate_false");
-        CDBWrapper dbw(ph, (1 << 20), false, true, obfuscate);
-
-        uint256 res;
-        uint32_t res_uint_32;
-        bool res_bool;
-
-        // Ensure that we're doing real obfuscation when obfuscate=true
-        BOOST_CHECK(obfuscate !=
-                    is_null_key(dbwrapper_private::GetObfuscateKey(dbw)));
-
-        // Simulate block raw data - "b + block hash"
-        std::string key_block = "b" + InsecureRand256().ToString();
-
-        uint256 in_block = InsecureRand256();
-        BOOST_CHECK(dbw.Write(key_block, in_block));
-        BOOST_CHECK(dbw.Read(key_block, res));
-        BOOST_CHECK_EQUAL(res.ToString(), in_block.ToString());
-
-        // Simulate file raw data - "f + file_number"
-        std::string key_file = strprintf("f%04x", InsecureRand32());
-
-        uint256 in_file_info = InsecureRand256();
-        BOOST_CHECK(dbw.Write(key_file, in_file_info));
-        BOOST_CHECK(dbw.Read(key_file, res));
-        BOOST_CHECK_EQUAL(res.ToString(), in_file_info.ToString());
-
-        // Simulate transaction raw data - "t + transaction hash"
-        std::string key_transaction = "t" + InsecureRand256().ToString();
-
-        uint256 in_transaction = InsecureRand256();
-        BOOST_CHECK(dbw.Write(key_transaction, in_transaction));
-        BOOST_CHECK(dbw.Read(key_transaction, res));
-        BOOST_CHECK_EQUAL(res.ToString(), in_transaction.ToString());
-
-        // Simulate UTXO raw data - "c + transaction hash"
-        std::string key_utxo = "c" + InsecureRand256().ToString();
-
-        uint256 in_utxo = InsecureRand256();
-        BOOST_CHECK(dbw.Write(key_utxo, in_utxo));
-        BOOST_CHECK(dbw.Read(key_utxo, res));
-        BOOST_CHECK_EQUAL(res.ToString(), in_utxo.ToString());
-
-        // Simulate last block file number - "l"
-        char key_last_blockfile_number = 'l';
-        uint32_t lastblockfilenumber = InsecureRand32();
-        BOOST_CHECK(dbw.Write(key_last_blockfile_number, lastblockfilenumber));
-        BOOST_CHECK(dbw.Read(key_last_blockfile_number, res_uint_32));
-        BOOST_CHECK_EQUAL(lastblockfilenumber, res_uint_32);
-
-        // Simulate Is Reindexing - "R"
-        char key_IsReindexing = 'R';
-        bool isInReindexing = InsecureRandBool();
-        BOOST_CHECK(dbw.Write(key_IsReindexing, isInReindexing));
-        BOOST_CHECK(dbw.Read(key_IsReindexing, res_bool));
-        BOOST_CHECK_EQUAL(isInReindexing, res_bool);
-
-        // Simulate last block hash up to which UXTO covers - 'B'
-        char key_lastblockhash_uxto = 'B';
-        uint256 lastblock_hash = InsecureRand256();
-        BOOST_CHECK(dbw.Write(key_lastblockhash_uxto, lastblock_hash));
-        BOOST_CHECK(dbw.Read(key_lastblockhash_uxto, res));
-        BOOST_CHECK_EQUAL(lastblock_hash, res);
-
-        // Simulate file raw data - "F + filename_number + filename"
-        std::string file_option_tag = "F";
-        uint8_t filename_length = InsecureRandBits(8);
-        std::string filename = "randomfilename";
-        std::string key_file_option =
-            strprintf("%s%01x%s", file_option_tag, filename_length, filename);
-
-        bool in_file_bool = InsecureRandBool();
-        BOOST_CHECK(dbw.Write(key_file_option, in_file_bool));
-        BOOST_CHECK(dbw.Read(key_file_option, res_bool));
-        BOOST_CHECK_EQUAL(res_bool, in_file_bool);
+    for (const DBEngineType engine : DB_ENGINES) {
+        // Perform tests both obfuscated and non-obfuscated.
+        for (bool obfuscate : {false, true}) {
+            fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                          (obfuscate ? "dbwrapper_1_obfuscate_true"
+                                     : "dbwrapper_1_obfuscate_false");
+            CDBWrapper dbw(ph, (1 << 20), false, true, obfuscate, engine);
+
+            uint256 res;
+            uint32_t res_uint_32;
+            bool res_bool;
+
+            // Ensure that we're doing real obfuscation when obfuscate=true
+            BOOST_CHECK(obfuscate !=
+                        is_null_key(dbwrapper_private::GetObfuscateKey(dbw)));
+
+            // Simulate block raw data - "b + block hash"
+            std::string key_block = "b" + InsecureRand256().ToString();
+
+            uint256 in_block = InsecureRand256();
+            BOOST_CHECK(dbw.Write(key_block, in_block));
+            BOOST_CHECK(dbw.Read(key_block, res));
+            BOOST_CHECK_EQUAL(res.ToString(), in_block.ToString());
+
+            // Simulate file raw data - "f + file_number"
+            std::string key_file = strprintf("f%04x", InsecureRand32());
+
+            uint256 in_file_info = InsecureRand256();
+            BOOST_CHECK(dbw.Write(key_file, in_file_info));
+            BOOST_CHECK(dbw.Read(key_file, res));
+            BOOST_CHECK_EQUAL(res.ToString(), in_file_info.ToString());
+
+            // Simulate transaction raw data - "t + transaction hash"
+            std::string key_transaction = "t" + InsecureRand256().ToString();
+
+            uint256 in_transaction = InsecureRand256();
+            BOOST_CHECK(dbw.Write(key_transaction, in_transaction));
+            BOOST_CHECK(dbw.Read(key_transaction, res));
+            BOOST_CHECK_EQUAL(res.ToString(), in_transaction.ToString());
+
+            // Simulate UTXO raw data - "c + transaction hash"
+            std::string key_utxo = "c" + InsecureRand256().ToString();
+
+            uint256 in_utxo = InsecureRand256();
+            BOOST_CHECK(dbw.Write(key_utxo, in_utxo));
+            BOOST_CHECK(dbw.Read(key_utxo, res));
+            BOOST_CHECK_EQUAL(res.ToString(), in_utxo.ToString());
+
+            // Simulate last block file number - "l"
+            char key_last_blockfile_number = 'l';
+            uint32_t lastblockfilenumber = InsecureRand32();
+            BOOST_CHECK(
+                dbw.Write(key_last_blockfile_number, lastblockfilenumber));
+            BOOST_CHECK(dbw.Read(key_last_blockfile_number, res_uint_32));
+            BOOST_CHECK_EQUAL(lastblockfilenumber, res_uint_32);
+
+            // Simulate Is Reindexing - "R"
+            char key_IsReindexing = 'R';
+            bool isInReindexing = InsecureRandBool();
+            BOOST_CHECK(dbw.Write(key_IsReindexing, isInReindexing));
+            BOOST_CHECK(dbw.Read(key_IsReindexing, res_bool));
+            BOOST_CHECK_EQUAL(isInReindexing, res_bool);
+
+            // Simulate last block hash up to which UXTO covers - 'B'
+            char key_lastblockhash_uxto = 'B';
+            uint256 lastblock_hash = InsecureRand256();
+            BOOST_CHECK(dbw.Write(key_lastblockhash_uxto, lastblock_hash));
+            BOOST_CHECK(dbw.Read(key_lastblockhash_uxto, res));
+            BOOST_CHECK_EQUAL(lastblock_hash, res);
+
+            // Simulate file raw data - "F + filename_number + filename"
+            std::string file_option_tag = "F";
+            uint8_t filename_length = InsecureRandBits(8);
+            std::string filename = "randomfilename";
+            std::string key_file_option = strprintf(
+                "%s%01x%s", file_option_tag, filename_length, filename);
+
+            bool in_file_bool = InsecureRandBool();
+            BOOST_CHECK(dbw.Write(key_file_option, in_file_bool));
+            BOOST_CHECK(dbw.Read(key_file_option, res_bool));
+            BOOST_CHECK_EQUAL(res_bool, in_file_bool);
+        }
     }
 }
 
 // Test batch operations
 BOOST_AUTO_TEST_CASE(dbwrapper_batch) {
-    // Perform tests both obfuscated and non-obfuscated.
-    for (const bool obfuscate : {false, true}) {
-        fs::path ph = m_args.GetDataDirPath() /
-                      (obfuscate ? "dbwrapper_batch_obfuscate_true"
-                                 : "dbwrapper_batch_obfuscate_false");
-        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
-
-        char key = 'i';
-        uint256 in = InsecureRand256();
-        char key2 = 'j';
-        uint256 in2 = InsecureRand256();
-        char key3 = 'k';
-        uint256 in3 = InsecureRand256();
-
-        uint256 res;
-        CDBBatch batch(dbw);
-
-        batch.Write(key, in);
-        batch.Write(key2, in2);
-        batch.Write(key3, in3);
+    for (const DBEngineType engine : DB_ENGINES) {
+        // Perform tests both obfuscated and non-obfuscated.
+        for (const bool obfuscate : {false, true}) {
+            fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                          (obfuscate ? "dbwrapper_batch_obfuscate_true"
+                                     : "dbwrapper_batch_obfuscate_false");
+            CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate, engine);
+
+            char key = 'i';
+            uint256 in = InsecureRand256();
+            char key2 = 'j';
+            uint256 in2 = InsecureRand256();
+            char key3 = 'k';
+            uint256 in3 = InsecureRand256();
+
+            uint256 res;
+            CDBBatch batch(dbw);
+
+            batch.Write(key, in);
+            batch.Write(key2, in2);
+            batch.Write(key3, in3);
+
+            // Remove key3 before it's even been written
+            batch.Erase(key3);
+
+            BOOST_CHECK(dbw.WriteBatch(batch));
+
+            BOOST_CHECK(dbw.Read(key, res));
+            BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+            BOOST_CHECK(dbw.Read(key2, res));
+            BOOST_CHECK_EQUAL(res.ToString(), in2.ToString());
+
+            // key3 should've never been written
+            BOOST_CHECK(dbw.Read(key3, res) == false);
+        }
+    }
+}
 
-        // Remove key3 before it's even been written
-        batch.Erase(key3);
+BOOST_AUTO_TEST_CASE(dbwrapper_iterator) {
+    for (const DBEngineType engine : DB_ENGINES) {
+        // Perform tests both obfuscated and non-obfuscated.
+        for (const bool obfuscate : {false, true}) {
+            fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                          (obfuscate ? "dbwrapper_iterator_obfuscate_true"
+                                     : "dbwrapper_iterator_obfuscate_false");
+            CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate, engine);
+
+            // The two keys are intentionally chosen for ordering
+            char key = 'j';
+            uint256 in = InsecureRand256();
+            BOOST_CHECK(dbw.Write(key, in));
+            char key2 = 'k';
+            uint256 in2 = InsecureRand256();
+            BOOST_CHECK(dbw.Write(key2, in2));
+
+            std::unique_ptr<CDBIterator> it(
+                const_cast<CDBWrapper &>(dbw).NewIterator());
+
+            // Be sure to seek past the obfuscation key (if it exists)
+            it->Seek(key);
+
+            char key_res;
+            uint256 val_res;
+
+            BOOST_REQUIRE(it->GetKey(key_res));
+            BOOST_REQUIRE(it->GetValue(val_res));
+            BOOST_CHECK_EQUAL(key_res, key);
+            BOOST_CHECK_EQUAL(val_res.ToString(), in.ToString());
 
-        BOOST_CHECK(dbw.WriteBatch(batch));
+            it->Next();
 
-        BOOST_CHECK(dbw.Read(key, res));
-        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
-        BOOST_CHECK(dbw.Read(key2, res));
-        BOOST_CHECK_EQUAL(res.ToString(), in2.ToString());
+            BOOST_REQUIRE(it->GetKey(key_res));
+            BOOST_REQUIRE(it->GetValue(val_res));
+            BOOST_CHECK_EQUAL(key_res, key2);
+            BOOST_CHECK_EQUAL(val_res.ToString(), in2.ToString());
 
-        // key3 should've never been written
-        BOOST_CHECK(dbw.Read(key3, res) == false);
+            it->Next();
+            BOOST_CHECK_EQUAL(it->Valid(), false);
+        }
     }
 }
 
-BOOST_AUTO_TEST_CASE(dbwrapper_iterator) {
-    // Perform tests both obfuscated and non-obfuscated.
-    for (const bool obfuscate : {false, true}) {
-        fs::path ph = m_args.GetDataDirPath() /
-                      (obfuscate ? "dbwrapper_iterator_obfuscate_true"
-                                 : "dbwrapper_iterator_obfuscate_false");
-        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
-
-        // The two keys are intentionally chosen for ordering
-        char key = 'j';
+// Test that we do not obfuscation if there is existing data.
+BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate) {
+    for (const DBEngineType engine : DB_ENGINES) {
+        // We're going to share this fs::path between two wrappers
+        fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                      "existing_data_no_obfuscate";
+        create_directories(ph);
+
+        // Set up a non-obfuscated wrapper to write some initial data.
+        std::unique_ptr<CDBWrapper> dbw = std::make_unique<CDBWrapper>(
+            ph, (1 << 10), false, false, false, engine);
+        char key = 'k';
         uint256 in = InsecureRand256();
-        BOOST_CHECK(dbw.Write(key, in));
-        char key2 = 'k';
-        uint256 in2 = InsecureRand256();
-        BOOST_CHECK(dbw.Write(key2, in2));
+        uint256 res;
 
-        std::unique_ptr<CDBIterator> it(
-            const_cast<CDBWrapper &>(dbw).NewIterator());
+        BOOST_CHECK(dbw->Write(key, in));
+        BOOST_CHECK(dbw->Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
 
-        // Be sure to seek past the obfuscation key (if it exists)
-        it->Seek(key);
+        // Call the destructor to free leveldb LOCK
+        dbw.reset();
 
-        char key_res;
-        uint256 val_res;
+        // Now, set up another wrapper that wants to obfuscate the same
+        // directory
+        CDBWrapper odbw(ph, (1 << 10), false, false, true, engine);
 
-        BOOST_REQUIRE(it->GetKey(key_res));
-        BOOST_REQUIRE(it->GetValue(val_res));
-        BOOST_CHECK_EQUAL(key_res, key);
-        BOOST_CHECK_EQUAL(val_res.ToString(), in.ToString());
+        // Check that the key/val we wrote with unobfuscated wrapper exists and
+        // is readable.
+        uint256 res2;
+        BOOST_CHECK(odbw.Read(key, res2));
+        BOOST_CHECK_EQUAL(res2.ToString(), in.ToString());
 
-        it->Next();
+        // There should be existing data
+        BOOST_CHECK(!odbw.IsEmpty());
+        // The key should be an empty string
+        BOOST_CHECK(is_null_key(dbwrapper_private::GetObfuscateKey(odbw)));
 
-        BOOST_REQUIRE(it->GetKey(key_res));
-        BOOST_REQUIRE(it->GetValue(val_res));
-        BOOST_CHECK_EQUAL(key_res, key2);
-        BOOST_CHECK_EQUAL(val_res.ToString(), in2.ToString());
+        uint256 in2 = InsecureRand256();
+        uint256 res3;
 
-        it->Next();
-        BOOST_CHECK_EQUAL(it->Valid(), false);
+        // Check that we can write successfully
+        BOOST_CHECK(odbw.Write(key, in2));
+        BOOST_CHECK(odbw.Read(key, res3));
+        BOOST_CHECK_EQUAL(res3.ToString(), in2.ToString());
     }
 }
 
-// Test that we do not obfuscation if there is existing data.
-BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate) {
-    // We're going to share this fs::path between two wrappers
-    fs::path ph = m_args.GetDataDirPath() / "existing_data_no_obfuscate";
-    create_directories(ph);
-
-    // Set up a non-obfuscated wrapper to write some initial data.
-    std::unique_ptr<CDBWrapper> dbw =
-        std::make_unique<CDBWrapper>(ph, (1 << 10), false, false, false);
-    char key = 'k';
-    uint256 in = InsecureRand256();
-    uint256 res;
-
-    BOOST_CHECK(dbw->Write(key, in));
-    BOOST_CHECK(dbw->Read(key, res));
-    BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+// Ensure that we start obfuscating during a reindex.
+BOOST_AUTO_TEST_CASE(existing_data_reindex) {
+    for (const DBEngineType engine : DB_ENGINES) {
+        // We're going to share this fs::path between two wrappers
+        fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                      "existing_data_reindex";
+        create_directories(ph);
+
+        // Set up a non-obfuscated wrapper to write some initial data.
+        std::unique_ptr<CDBWrapper> dbw = std::make_unique<CDBWrapper>(
+            ph, (1 << 10), false, false, false, engine);
+        char key = 'k';
+        uint256 in = InsecureRand256();
+        uint256 res;
 
-    // Call the destructor to free leveldb LOCK
-    dbw.reset();
+        BOOST_CHECK(dbw->Write(key, in));
+        BOOST_CHECK(dbw->Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
 
-    // Now, set up another wrapper that wants to obfuscate the same directory
-    CDBWrapper odbw(ph, (1 << 10), false, false, true);
+        // Call the destructor to free leveldb LOCK
+        dbw.reset();
 
-    // Check that the key/val we wrote with unobfuscated wrapper exists and
-    // is readable.
-    uint256 res2;
-    BOOST_CHECK(odbw.Read(key, res2));
-    BOOST_CHECK_EQUAL(res2.ToString(), in.ToString());
+        // Simulate a -reindex by wiping the existing data store
+        CDBWrapper odbw(ph, (1 << 10), false, true, true, engine);
 
-    // There should be existing data
-    BOOST_CHECK(!odbw.IsEmpty());
-    // The key should be an empty string
-    BOOST_CHECK(is_null_key(dbwrapper_private::GetObfuscateKey(odbw)));
+        // Check that the key/val we wrote with unobfuscated wrapper doesn't
+        // exist
+        uint256 res2;
+        BOOST_CHECK(!odbw.Read(key, res2));
+        BOOST_CHECK(!is_null_key(dbwrapper_private::GetObfuscateKey(odbw)));
 
-    uint256 in2 = InsecureRand256();
-    uint256 res3;
+        uint256 in2 = InsecureRand256();
+        uint256 res3;
 
-    // Check that we can write successfully
-    BOOST_CHECK(odbw.Write(key, in2));
-    BOOST_CHECK(odbw.Read(key, res3));
-    BOOST_CHECK_EQUAL(res3.ToString(), in2.ToString());
+        // Check that we can write successfully
+        BOOST_CHECK(odbw.Write(key, in2));
+        BOOST_CHECK(odbw.Read(key, res3));
+        BOOST_CHECK_EQUAL(res3.ToString(), in2.ToString());
+    }
 }
 
-// Ensure that we start obfuscating during a reindex.
-BOOST_AUTO_TEST_CASE(existing_data_reindex) {
-    // We're going to share this fs::path between two wrappers
-    fs::path ph = m_args.GetDataDirPath() / "existing_data_reindex";
-    create_directories(ph);
-
-    // Set up a non-obfuscated wrapper to write some initial data.
-    std::unique_ptr<CDBWrapper> dbw =
-        std::make_unique<CDBWrapper>(ph, (1 << 10), false, false, false);
-    char key = 'k';
-    uint256 in = InsecureRand256();
-    uint256 res;
-
-    BOOST_CHECK(dbw->Write(key, in));
-    BOOST_CHECK(dbw->Read(key, res));
-    BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(existing_data_other_engine) {
+    fs::path ph = m_args.GetDataDirPath() / "existing_data_other_engine";
+    BOOST_CHECK(!ReadDBEngineType(ph));
 
-    // Call the destructor to free leveldb LOCK
+    // The engine is recorded when the database is created.
+    std::unique_ptr<CDBWrapper> dbw = std::make_unique<CDBWrapper>(
+        ph, (1 << 10), false, false, false, DBEngineType::LEVELDB);
+    BOOST_CHECK(dbw->Write('k', InsecureRand256()));
+    dbw.reset();
+    BOOST_CHECK(ReadDBEngineType(ph) == DBEngineType::LEVELDB);
+
+    // It can't be opened with another engine, unless it is wiped.
+    BOOST_CHECK_THROW(CDBWrapper(ph, (1 << 10), false, false, false,
+                                 DBEngineType::BTREE),
+                      dbwrapper_error);
+    BOOST_CHECK(ReadDBEngineType(ph) == DBEngineType::LEVELDB);
+    dbw = std::make_unique<CDBWrapper>(ph, (1 << 10), false, true, false,
+                                       DBEngineType::BTREE);
+    uint256 res;
+    BOOST_CHECK(!dbw->Read('k', res));
     dbw.reset();
+    BOOST_CHECK(ReadDBEngineType(ph) == DBEngineType::BTREE);
+    BOOST_CHECK_THROW(CDBWrapper(ph, (1 << 10), false, false, false,
+                                 DBEngineType::LEVELDB),
+                      dbwrapper_error);
+}
+#endif
 
-    // Simulate a -reindex by wiping the existing data store
-    CDBWrapper odbw(ph, (1 << 10), false, true, true);
+BOOST_AUTO_TEST_CASE(dbwrapper_stats) {
+    for (const DBEngineType engine : DB_ENGINES) {
+        fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                      "dbwrapper_stats";
+        CDBWrapper dbw(ph, (1 << 20), false, true, false, engine);
 
-    // Check that the key/val we wrote with unobfuscated wrapper doesn't exist
-    uint256 res2;
-    BOOST_CHECK(!odbw.Read(key, res2));
-    BOOST_CHECK(!is_null_key(dbwrapper_private::GetObfuscateKey(odbw)));
+        for (uint32_t i = 0; i < 1000; ++i) {
+            BOOST_CHECK(dbw.Write(i, InsecureRand256()));
+        }
+        dbw.CompactRange(uint32_t(0), uint32_t(1000));
 
-    uint256 in2 = InsecureRand256();
-    uint256 res3;
+        const DBEngineStats stats = dbw.GetStats();
+        BOOST_CHECK_EQUAL(stats.level0_waits, 0U);
+        if (engine != DBEngineType::LEVELDB) {
+            BOOST_CHECK(stats.levels.empty());
+            continue;
+        }
 
-    // Check that we can write successfully
-    BOOST_CHECK(odbw.Write(key, in2));
-    BOOST_CHECK(odbw.Read(key, res3));
-    BOOST_CHECK_EQUAL(res3.ToString(), in2.ToString());
+        // The write buffer was written out to a file.
+        uint64_t compactions = 0, files = 0, bytes_written = 0;
+        for (const DBEngineStats::Level &level : stats.levels) {
+            compactions += level.compactions;
+            files += level.files;
+            bytes_written += level.bytes_written;
+            BOOST_CHECK_GE(level.subcompactions, level.compactions);
+        }
+        BOOST_CHECK_EQUAL(stats.levels.size(), 7U);
+        BOOST_CHECK_GE(compactions, 1U);
+        BOOST_CHECK_GE(files, 1U);
+        BOOST_CHECK_GT(bytes_written, 1000U * 32);
+    }
 }
 
 BOOST_AUTO_TEST_CASE(iterator_ordering) {
-    fs::path ph = m_args.GetDataDirPath() / "iterator_ordering";
-    CDBWrapper dbw(ph, (1 << 20), true, false, false);
-    for (int x = 0x00; x < 256; ++x) {
-        uint8_t key = x;
-        uint32_t value = x * x;
-        if (!(x & 1)) {
-            BOOST_CHECK(dbw.Write(key, value));
+    for (const DBEngineType engine : DB_ENGINES) {
+        fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                      "iterator_ordering";
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, engine);
+        for (int x = 0x00; x < 256; ++x) {
+            uint8_t key = x;
+            uint32_t value = x * x;
+            if (!(x & 1)) {
+                BOOST_CHECK(dbw.Write(key, value));
+            }
         }
-    }
 
-    // Check that creating an iterator creates a snapshot
-    std::unique_ptr<CDBIterator> it(
-        const_cast<CDBWrapper &>(dbw).NewIterator());
+        // Check that creating an iterator creates a snapshot
+        std::unique_ptr<CDBIterator> it(
+            const_cast<CDBWrapper &>(dbw).NewIterator());
 
-    for (unsigned int x = 0x00; x < 256; ++x) {
-        uint8_t key = x;
-        uint32_t value = x * x;
-        if (x & 1) {
-            BOOST_CHECK(dbw.Write(key, value));
+        for (unsigned int x = 0x00; x < 256; ++x) {
+            uint8_t key = x;
+            uint32_t value = x * x;
+            if (x & 1) {
+                BOOST_CHECK(dbw.Write(key, value));
+            }
         }
-    }
 
-    for (const int seek_start : {0x00, 0x80}) {
-        it->Seek((uint8_t)seek_start);
-        for (unsigned int x = seek_start; x < 255; ++x) {
-            uint8_t key;
-            uint32_t value;
-            BOOST_CHECK(it->Valid());
-            // Avoid spurious errors about invalid iterator's  key and value in
-            // case of failure
-            if (!it->Valid()) {
-                break;
-            }
-            BOOST_CHECK(it->GetKey(key));
-            if (x & 1) {
-                BOOST_CHECK_EQUAL(key, x + 1);
-                continue;
+        for (const int seek_start : {0x00, 0x80}) {
+            it->Seek((uint8_t)seek_start);
+            for (unsigned int x = seek_start; x < 255; ++x) {
+                uint8_t key;
+                uint32_t value;
+                BOOST_CHECK(it->Valid());
+                // Avoid spurious errors about invalid iterator's  key and value
+                // in case of failure
+                if (!it->Valid()) {
+                    break;
+                }
+                BOOST_CHECK(it->GetKey(key));
+                if (x & 1) {
+                    BOOST_CHECK_EQUAL(key, x + 1);
+                    continue;
+                }
+                BOOST_CHECK(it->GetValue(value));
+                BOOST_CHECK_EQUAL(key, x);
+                BOOST_CHECK_EQUAL(value, x * x);
+                it->Next();
             }
-            BOOST_CHECK(it->GetValue(value));
-            BOOST_CHECK_EQUAL(key, x);
-            BOOST_CHECK_EQUAL(value, x * x);
-            it->Next();
+            BOOST_CHECK(!it->Valid());
         }
-        BOOST_CHECK(!it->Valid());
     }
 }
 
@@ -373,53 +463,244 @@ struct StringContentsSerializer {
 };
 
 BOOST_AUTO_TEST_CASE(iterator_string_ordering) {
-    char buf[10];
-
-    fs::path ph = m_args.GetDataDirPath() / "iterator_string_ordering";
-    CDBWrapper dbw(ph, (1 << 20), true, false, false);
-    for (int x = 0x00; x < 10; ++x) {
-        for (int y = 0; y < 10; y++) {
-            snprintf(buf, sizeof(buf), "%d", x);
-            StringContentsSerializer key(buf);
-            for (int z = 0; z < y; z++) {
-                key += key;
-            }
-            uint32_t value = x * x;
-            BOOST_CHECK(dbw.Write(key, value));
-        }
-    }
+    for (const DBEngineType engine : DB_ENGINES) {
+        char buf[10];
 
-    std::unique_ptr<CDBIterator> it(
-        const_cast<CDBWrapper &>(dbw).NewIterator());
-    for (const int seek_start : {0, 5}) {
-        snprintf(buf, sizeof(buf), "%d", seek_start);
-        StringContentsSerializer seek_key(buf);
-        it->Seek(seek_key);
-        for (unsigned int x = seek_start; x < 10; ++x) {
+        fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                      "iterator_string_ordering";
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, engine);
+        for (int x = 0x00; x < 10; ++x) {
             for (int y = 0; y < 10; y++) {
                 snprintf(buf, sizeof(buf), "%d", x);
-                std::string exp_key(buf);
+                StringContentsSerializer key(buf);
                 for (int z = 0; z < y; z++) {
-                    exp_key += exp_key;
+                    key += key;
                 }
-                StringContentsSerializer key;
-                uint32_t value;
-                BOOST_CHECK(it->Valid());
-                // Avoid spurious errors about invalid iterator's key and value
-                // in case of failure
-                if (!it->Valid()) {
-                    break;
+                uint32_t value = x * x;
+                BOOST_CHECK(dbw.Write(key, value));
+            }
+        }
+
+        std::unique_ptr<CDBIterator> it(
+            const_cast<CDBWrapper &>(dbw).NewIterator());
+        for (const int seek_start : {0, 5}) {
+            snprintf(buf, sizeof(buf), "%d", seek_start);
+            StringContentsSerializer seek_key(buf);
+            it->Seek(seek_key);
+            for (unsigned int x = seek_start; x < 10; ++x) {
+                for (int y = 0; y < 10; y++) {
+                    snprintf(buf, sizeof(buf), "%d", x);
+                    std::string exp_key(buf);
+                    for (int z = 0; z < y; z++) {
+                        exp_key += exp_key;
+                    }
+                    StringContentsSerializer key;
+                    uint32_t value;
+                    BOOST_CHECK(it->Valid());
+                    // Avoid spurious errors about invalid iterator's key and
+                    // value in case of failure
+                    if (!it->Valid()) {
+                        break;
+                    }
+                    BOOST_CHECK(it->GetKey(key));
+                    BOOST_CHECK(it->GetValue(value));
+                    BOOST_CHECK_EQUAL(key.str, exp_key);
+                    BOOST_CHECK_EQUAL(value, x * x);
+                    it->Next();
+                }
+            }
+            BOOST_CHECK(!it->Valid());
+        }
+    }
+}
+
+// Compare random batches of updates against an in-memory model, including
+// values large enough to be stored out of line, and reopen the database.
+BOOST_AUTO_TEST_CASE(dbwrapper_random_updates) {
+    for (const DBEngineType engine : DB_ENGINES) {
+        fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                      "dbwrapper_random_updates";
+        auto dbw = std::make_unique<CDBWrapper>(ph, (1 << 20), false, true,
+                                                true, engine);
+        std::map<uint32_t, std::vector<uint8_t>> model;
+
+        auto check = [&]() {
+            std::map<uint32_t, std::vector<uint8_t>> contents;
+            std::unique_ptr<CDBIterator> it(dbw->NewIterator());
+            for (it->Seek(std::make_pair('r', uint32_t(0))); it->Valid();
+                 it->Next()) {
+                std::pair<char, uint32_t> key;
+                std::vector<uint8_t> value;
+                BOOST_REQUIRE(it->GetKey(key));
+                BOOST_REQUIRE(it->GetValue(value));
+                contents.emplace(key.second, std::move(value));
+            }
+            BOOST_CHECK(contents == model);
+            for (uint32_t key = 0; key < 100; ++key) {
+                std::vector<uint8_t> value;
+                const auto model_it = model.find(key);
+                BOOST_CHECK_EQUAL(dbw->Read(std::make_pair('r', key), value),
+                                  model_it != model.end());
+                if (model_it != model.end()) {
+                    BOOST_CHECK(value == model_it->second);
+                }
+            }
+        };
+
+        for (int round = 0; round < 20; ++round) {
+            CDBBatch batch(*dbw);
+            for (int i = 0; i < 200; ++i) {
+                const uint32_t key = InsecureRandRange(2000);
+                if (InsecureRandBool()) {
+                    batch.Erase(std::make_pair('r', key));
+                    model.erase(key);
+                    continue;
+                }
+                const size_t size =
+                    InsecureRandBits(4) == 0 ? InsecureRandRange(10000)
+                                             : InsecureRandRange(100);
+                std::vector<uint8_t> value =
+                    g_insecure_rand_ctx.randbytes(size);
+                batch.Write(std::make_pair('r', key), value);
+                model[key] = std::move(value);
+            }
+            BOOST_CHECK(dbw->WriteBatch(batch, round % 5 == 0));
+        }
+        check();
+
+        dbw.reset();
+        dbw = std::make_unique<CDBWrapper>(ph, (1 << 20), false, false, true,
+                                           engine);
+        check();
+
+        CDBBatch batch(*dbw);
+        for (const auto &entry : model) {
+            batch.Erase(std::make_pair('r', entry.first));
+        }
+        model.clear();
+        BOOST_CHECK(dbw->WriteBatch(batch));
+        check();
+    }
+}
+
+// An iterator keeps seeing the data as of its creation while the database is
+// rewritten underneath it.
+BOOST_AUTO_TEST_CASE(dbwrapper_iterator_snapshot) {
+    for (const DBEngineType engine : DB_ENGINES) {
+        fs::path ph = m_args.GetDataDirPath() / DBEngineTypeName(engine) /
+                      "dbwrapper_iterator_snapshot";
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, engine);
+        for (uint32_t x = 0; x < 1000; ++x) {
+            BOOST_CHECK(dbw.Write(std::make_pair('k', x), x));
+        }
+
+        std::unique_ptr<CDBIterator> it(dbw.NewIterator());
+        for (uint32_t round = 1; round <= 5; ++round) {
+            CDBBatch batch(dbw);
+            for (uint32_t x = 0; x < 1000; ++x) {
+                if (round % 2) {
+                    batch.Erase(std::make_pair('k', x));
+                } else {
+                    batch.Write(std::make_pair('k', x), x * round);
                 }
-                BOOST_CHECK(it->GetKey(key));
-                BOOST_CHECK(it->GetValue(value));
-                BOOST_CHECK_EQUAL(key.str, exp_key);
-                BOOST_CHECK_EQUAL(value, x * x);
-                it->Next();
             }
+            BOOST_CHECK(dbw.WriteBatch(batch));
+        }
+
+        it->Seek(std::make_pair('k', uint32_t(0)));
+        for (uint32_t x = 0; x < 1000; ++x) {
+            BOOST_REQUIRE(it->Valid());
+            std::pair<char, uint32_t> key;
+            uint32_t value;
+            BOOST_CHECK(it->GetKey(key));
+            BOOST_CHECK(it->GetValue(value));
+            BOOST_CHECK_EQUAL(value, key.second);
+            it->Next();
         }
         BOOST_CHECK(!it->Valid());
+        BOOST_CHECK(dbw.IsEmpty());
+    }
+}
+
+#ifndef WIN32
+// The B+tree publishes a commit by writing one of its two meta pages. If the
+// newest meta pages don't make it to disk, reopening must fall back to an
+// older root whose pages have not been reused since.
+BOOST_AUTO_TEST_CASE(btree_meta_fallback) {
+    // Layout of the B+tree file: the meta records are in the first two pages.
+    constexpr size_t META_SIZE = 2 * 4096;
+    fs::path ph = m_args.GetDataDirPath() / "btree_meta_fallback";
+    const fs::path file = ph / "data.btree";
+    auto read_metas = [&]() {
+        std::vector<uint8_t> metas(META_SIZE);
+        FILE *f = fsbridge::fopen(file, "rb");
+        BOOST_REQUIRE(f);
+        BOOST_REQUIRE_EQUAL(fread(metas.data(), 1, META_SIZE, f), META_SIZE);
+        fclose(f);
+        return metas;
+    };
+    auto write_metas = [&](const std::vector<uint8_t> &metas) {
+        FILE *f = fsbridge::fopen(file, "r+b");
+        BOOST_REQUIRE(f);
+        BOOST_REQUIRE_EQUAL(fwrite(metas.data(), 1, META_SIZE, f), META_SIZE);
+        fclose(f);
+    };
+    auto write_all = [](CDBWrapper &dbw, uint32_t round, bool fSync) {
+        CDBBatch batch(dbw);
+        for (uint32_t x = 0; x < 2000; ++x) {
+            batch.Write(std::make_pair('k', x), x * round);
+        }
+        BOOST_CHECK(dbw.WriteBatch(batch, fSync));
+    };
+    auto check_all = [](CDBWrapper &dbw, uint32_t round) {
+        for (uint32_t x = 0; x < 2000; ++x) {
+            uint32_t value;
+            BOOST_REQUIRE(dbw.Read(std::make_pair('k', x), value));
+            BOOST_REQUIRE_EQUAL(value, x * round);
+        }
+    };
+
+    auto dbw = std::make_unique<CDBWrapper>(ph, (1 << 20), false, true, false,
+                                            DBEngineType::BTREE);
+    write_all(*dbw, 1, true);
+    dbw.reset();
+    const std::vector<uint8_t> metas1 = read_metas();
+
+    // The next two commits are not synced. Each one rewrites every leaf, so
+    // the second one allocates as many pages as the first one freed.
+    dbw = std::make_unique<CDBWrapper>(ph, (1 << 20), false, false, false,
+                                       DBEngineType::BTREE);
+    write_all(*dbw, 2, false);
+    write_all(*dbw, 3, false);
+    check_all(*dbw, 3);
+    dbw.reset();
+
+    // Neither of their meta pages reached the disk: the first root is back
+    // and none of its pages has been overwritten.
+    write_metas(metas1);
+    dbw = std::make_unique<CDBWrapper>(ph, (1 << 20), false, false, false,
+                                       DBEngineType::BTREE);
+    check_all(*dbw, 1);
+
+    // The newest meta page is torn: the previous commit is still intact.
+    write_all(*dbw, 4, false);
+    const std::vector<uint8_t> metas4 = read_metas();
+    write_all(*dbw, 5, false);
+    check_all(*dbw, 5);
+    dbw.reset();
+    std::vector<uint8_t> metas5 = read_metas();
+    BOOST_REQUIRE(metas5 != metas4);
+    for (size_t i = 0; i < META_SIZE; ++i) {
+        if (metas5[i] != metas4[i]) {
+            metas5[i] ^= 0xff;
+        }
     }
+    write_metas(metas5);
+    dbw = std::make_unique<CDBWrapper>(ph, (1 << 20), false, false, false,
+                                       DBEngineType::BTREE);
+    check_all(*dbw, 4);
 }
+#endif
 
 BOOST_AUTO_TEST_CASE(unicodepath) {
     // Attempt to create a database with a UTF8 character in the path.
@@ -5,6 +5,7 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <config.h>
+#include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
 
@@ -29,8 +30,10 @@ BOOST_AUTO_TEST_CASE(finalizationDelay) {
     }
 
     // Create maxreorgdepth blocks. Auto-finalization will not occur because
-    // the delay is not expired
-    int64_t mockedTime = GetTime();
+    // the delay is not expired. The test chain is mocked in the past, so start
+    // the clock at the node startup time, which also delays finalization.
+    int64_t mockedTime = GetStartupTime();
+    SetMockTime(mockedTime);
     for (uint32_t i = 0; i < DEFAULT_MAX_REORG_DEPTH; i++) {
         block = CreateAndProcessBlock({}, p2pk_scriptPubKey);
         LOCK(cs_main);
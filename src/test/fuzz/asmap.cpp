@@ -7,7 +7,9 @@
 #include <test/fuzz/fuzz.h>
 #include <util/asmap.h>
 
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 
 //! asmap code that consumes nothing
@@ -76,5 +78,20 @@ void test_one_input(const std::vector<uint8_t> &buffer) {
         memcpy(&ipv4, addr_data, addr_size);
         net_addr.SetIP(CNetAddr{ipv4});
     }
-    (void)net_addr.GetMappedAS(asmap);
+    const CompiledAsmap compiled(asmap);
+    (void)net_addr.GetMappedAS(compiled);
+
+    // The compiled asmap gives the same result as the interpreter.
+    uint8_t ip[ADDR_IPV6_SIZE];
+    if (ipv6) {
+        memcpy(ip, addr_data, ADDR_IPV6_SIZE);
+    } else {
+        memcpy(ip, IPV4_IN_IPV6_PREFIX.data(), IPV4_IN_IPV6_PREFIX.size());
+        memcpy(ip + IPV4_IN_IPV6_PREFIX.size(), addr_data, ADDR_IPV4_SIZE);
+    }
+    std::vector<bool> ip_bits(128);
+    for (int bit = 0; bit < 128; ++bit) {
+        ip_bits[bit] = (ip[bit / 8] >> (7 - bit % 8)) & 1;
+    }
+    assert(compiled.Lookup(ip) == Interpret(asmap, ip_bits));
 }
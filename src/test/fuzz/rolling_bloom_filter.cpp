@@ -17,10 +17,13 @@
 void test_one_input(const std::vector<uint8_t> &buffer) {
     FuzzedDataProvider fuzzed_data_provider(buffer.data(), buffer.size());
 
-    CRollingBloomFilter rolling_bloom_filter{
-        fuzzed_data_provider.ConsumeIntegralInRange<unsigned int>(1, 1000),
+    const unsigned int elements =
+        fuzzed_data_provider.ConsumeIntegralInRange<unsigned int>(1, 1000);
+    const double fp_rate =
         0.999 / fuzzed_data_provider.ConsumeIntegralInRange<unsigned int>(
-                    1, std::numeric_limits<unsigned int>::max())};
+                    1, std::numeric_limits<unsigned int>::max());
+    CRollingBloomFilter rolling_bloom_filter{elements, fp_rate};
+    CBlockedRollingBloomFilter blocked_rolling_bloom_filter{elements, fp_rate};
     while (fuzzed_data_provider.remaining_bytes() > 0) {
         switch (fuzzed_data_provider.ConsumeIntegralInRange(0, 2)) {
             case 0: {
@@ -30,6 +33,9 @@ void test_one_input(const std::vector<uint8_t> &buffer) {
                 rolling_bloom_filter.insert(b);
                 const bool present = rolling_bloom_filter.contains(b);
                 assert(present);
+                (void)blocked_rolling_bloom_filter.contains(b);
+                blocked_rolling_bloom_filter.insert(b);
+                assert(blocked_rolling_bloom_filter.contains(b));
                 break;
             }
             case 1: {
@@ -42,10 +48,14 @@ void test_one_input(const std::vector<uint8_t> &buffer) {
                 rolling_bloom_filter.insert(*u256);
                 const bool present = rolling_bloom_filter.contains(*u256);
                 assert(present);
+                (void)blocked_rolling_bloom_filter.contains(*u256);
+                blocked_rolling_bloom_filter.insert(*u256);
+                assert(blocked_rolling_bloom_filter.contains(*u256));
                 break;
             }
             case 2:
                 rolling_bloom_filter.reset();
+                blocked_rolling_bloom_filter.reset();
                 break;
         }
     }
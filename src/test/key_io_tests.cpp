@@ -5,7 +5,10 @@
 #include <test/data/key_io_invalid.json.h>
 #include <test/data/key_io_valid.json.h>
 
+#include <cashaddrenc.h>
 #include <chainparams.h>
+#include <config.h>
+#include <crypto/common.h>
 #include <key.h>
 #include <key_io.h>
 #include <script/script.h>
@@ -134,6 +137,45 @@ BOOST_AUTO_TEST_CASE(key_io_valid_gen) {
     SelectParams(CBaseChainParams::MAIN);
 }
 
+// Goal: check that the addresses cached by EncodeDestination follow the address
+// format and the network in use
+BOOST_AUTO_TEST_CASE(key_io_encode_destination_cache) {
+    GlobalConfig config;
+    const uint160 hash = uint160S("0123456789abcdef0123456789abcdef01234567");
+    const std::vector<CTxDestination> dests = {PKHash(hash), ScriptHash(hash)};
+
+    for (const auto &chain :
+         {CBaseChainParams::MAIN, CBaseChainParams::TESTNET,
+          CBaseChainParams::REGTEST}) {
+        SelectParams(chain);
+        for (const bool cashaddr : {true, false, true}) {
+            config.SetCashAddrEncoding(cashaddr);
+            for (const CTxDestination &dest : dests) {
+                const std::string expected =
+                    cashaddr ? EncodeCashAddr(dest, Params())
+                             : EncodeLegacyAddr(dest, Params());
+                BOOST_CHECK_EQUAL(EncodeDestination(dest, config), expected);
+                BOOST_CHECK_EQUAL(EncodeDestination(dest, config), expected);
+            }
+        }
+    }
+
+    // More destinations than the cache holds evict each other.
+    SelectParams(CBaseChainParams::MAIN);
+    config.SetCashAddrEncoding(true);
+    for (int round = 0; round < 2; ++round) {
+        for (uint32_t i = 0; i < 2 * ADDRESS_ENCODING_CACHE_SLOTS; ++i) {
+            uint160 other;
+            WriteLE32(other.begin(), i);
+            const PKHash dest(other);
+            BOOST_CHECK_EQUAL(EncodeDestination(dest, config),
+                              EncodeCashAddr(dest, Params()));
+        }
+    }
+
+    BOOST_CHECK_EQUAL(EncodeDestination(CNoDestination(), config), "");
+}
+
 // Goal: check that base58 parsing code is robust against a variety of corrupted
 // data
 BOOST_AUTO_TEST_CASE(key_io_invalid) {
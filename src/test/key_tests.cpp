@@ -5,6 +5,7 @@
 #include <key.h>
 
 #include <chainparams.h> // For Params()
+#include <crypto/sha256.h>
 #include <key_io.h>
 #include <streams.h>
 #include <uint256.h>
@@ -405,6 +406,46 @@ BOOST_AUTO_TEST_CASE(key_key_negation) {
     BOOST_CHECK(key.GetPubKey().data()[0] == 0x03);
 }
 
+BOOST_AUTO_TEST_CASE(key_ecdh) {
+    const CKey key1 = DecodeSecret(strSecret1C);
+    const CKey key2 = DecodeSecret(strSecret2C);
+    const CPubKey pubkey1 = key1.GetPubKey();
+    const CPubKey pubkey2 = key2.GetPubKey();
+
+    // Both sides compute the same secret
+    uint256 secret12, secret21;
+    BOOST_CHECK(key1.ComputeECDHSecret(pubkey2, secret12));
+    BOOST_CHECK(key2.ComputeECDHSecret(pubkey1, secret21));
+    BOOST_CHECK(secret12 == secret21);
+
+    // It depends on the point only, not on how it is encoded
+    const CKey key1U = DecodeSecret(strSecret1);
+    uint256 secret;
+    BOOST_CHECK(key2.ComputeECDHSecret(key1U.GetPubKey(), secret));
+    BOOST_CHECK(secret == secret12);
+
+    // With the key 1, the point is the public key itself, and the secret is
+    // the SHA256 of its compressed encoding
+    CKey one;
+    uint8_t one_bytes[32] = {0};
+    one_bytes[31] = 1;
+    one.Set(std::begin(one_bytes), std::end(one_bytes), true);
+    BOOST_CHECK(one.ComputeECDHSecret(pubkey1, secret));
+    uint256 expected;
+    CSHA256()
+        .Write(pubkey1.data(), pubkey1.size())
+        .Finalize(expected.begin());
+    BOOST_CHECK(secret == expected);
+
+    // Another key gives another secret, an invalid public key none
+    BOOST_CHECK(one.ComputeECDHSecret(pubkey2, secret));
+    BOOST_CHECK(secret != secret12);
+    std::vector<uint8_t> invalid(pubkey1.begin(), pubkey1.end());
+    invalid[0] = 0x05;
+    BOOST_CHECK(!key1.ComputeECDHSecret(
+        CPubKey(invalid.begin(), invalid.end()), secret));
+}
+
 static CPubKey UnserializePubkey(const std::vector<uint8_t> &data) {
     CDataStream stream{SER_NETWORK, INIT_PROTO_VERSION};
     stream << data;
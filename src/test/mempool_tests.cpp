@@ -305,6 +305,86 @@ BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     BOOST_CHECK_EQUAL(testPool.vTxHashes.size(), 0UL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolJournalTest) {
+    // Additions are numbered by the caller of addUnchecked(), as done when
+    // accepting transactions, removals by the mempool.
+    TestMemPoolEntryHelper entry;
+    CTxMemPool testPool(0, 4);
+    LOCK2(cs_main, testPool.cs);
+
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < 3; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = 10000 * SATOSHI;
+        txs.push_back(MakeTransactionRef(tx));
+    }
+
+    const uint64_t start = testPool.GetSequence();
+    std::vector<MempoolChange> changes;
+    BOOST_CHECK(testPool.GetChangesSince(start, changes));
+    BOOST_CHECK(changes.empty());
+    BOOST_CHECK(!testPool.GetChangesSince(start + 1, changes));
+
+    for (size_t i = 0; i < txs.size(); i++) {
+        testPool.addUnchecked(entry.FromTx(txs[i]));
+        BOOST_CHECK_EQUAL(testPool.RecordChange(txs[i]->GetId(), true),
+                          start + i);
+    }
+    testPool.removeRecursive(*txs[1], MemPoolRemovalReason::CONFLICT);
+    BOOST_CHECK_EQUAL(testPool.GetSequence(), start + 4);
+
+    BOOST_CHECK(testPool.GetChangesSince(start, changes));
+    BOOST_CHECK_EQUAL(changes.size(), 4U);
+    for (size_t i = 0; i < changes.size(); i++) {
+        BOOST_CHECK_EQUAL(changes[i].sequence, start + i);
+        BOOST_CHECK(changes[i].txid == txs[i < 3 ? i : 1]->GetId());
+        BOOST_CHECK_EQUAL(changes[i].added, i < 3);
+    }
+
+    BOOST_CHECK(testPool.GetChangesSince(start + 3, changes));
+    BOOST_CHECK_EQUAL(changes.size(), 1U);
+    BOOST_CHECK(!changes[0].added);
+
+    // The journal is bounded, the oldest changes are dropped.
+    testPool.removeRecursive(*txs[0], MemPoolRemovalReason::CONFLICT);
+    BOOST_CHECK(!testPool.GetChangesSince(start, changes));
+    BOOST_CHECK(testPool.GetChangesSince(start + 1, changes));
+    BOOST_CHECK_EQUAL(changes.size(), 4U);
+    BOOST_CHECK(changes.back().txid == txs[0]->GetId());
+
+    // Clearing the mempool invalidates all the previous sequence numbers.
+    const uint64_t before_clear = testPool.GetSequence();
+    testPool.clear();
+    BOOST_CHECK(!testPool.GetChangesSince(before_clear, changes));
+    BOOST_CHECK(testPool.GetChangesSince(testPool.GetSequence(), changes));
+    BOOST_CHECK(changes.empty());
+
+    // The memory of the journal is part of the mempool usage.
+    CTxMemPool journalPool(0, 1000);
+    LOCK(journalPool.cs);
+    const size_t empty_usage = journalPool.DynamicMemoryUsage();
+    for (int i = 0; i < 1000; i++) {
+        journalPool.RecordChange(TxId(InsecureRand256()), false);
+    }
+    BOOST_CHECK(journalPool.DynamicMemoryUsage() >=
+                empty_usage + 1000 * sizeof(MempoolChange));
+
+    // Without a journal, the changes are only numbered.
+    CTxMemPool noJournalPool(0, 0);
+    LOCK(noJournalPool.cs);
+    const uint64_t sequence = noJournalPool.GetSequence();
+    BOOST_CHECK_EQUAL(noJournalPool.DynamicMemoryUsage(), 0);
+    BOOST_CHECK_EQUAL(noJournalPool.RecordChange(TxId(InsecureRand256()), true),
+                      sequence);
+    BOOST_CHECK_EQUAL(noJournalPool.GetSequence(), sequence + 1);
+    BOOST_CHECK_EQUAL(noJournalPool.DynamicMemoryUsage(), 0);
+    BOOST_CHECK(!noJournalPool.GetChangesSince(sequence, changes));
+}
+
 template <typename name>
 static void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder,
                       const std::string &testcase)
@@ -659,7 +739,9 @@ BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest) {
 }
 
 BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest) {
-    CTxMemPool pool;
+    // The limits below are relative to the size of the entries, without a
+    // journal growing as they are added and removed.
+    CTxMemPool pool(/* check_ratio */ 0, /* journal_size */ 0);
     LOCK2(cs_main, pool.cs);
     TestMemPoolEntryHelper entry;
     Amount feeIncrement = MEMPOOL_FULL_FEE_INCREMENT.GetFeePerK();
@@ -134,20 +134,20 @@ static void MerkleComputation(const std::vector<uint256> &leaves,
 }
 
 static std::vector<uint256>
-ComputeMerkleBranch(const std::vector<uint256> &leaves, uint32_t position) {
+ReferenceMerkleBranch(const std::vector<uint256> &leaves, uint32_t position) {
     std::vector<uint256> ret;
     MerkleComputation(leaves, nullptr, nullptr, position, &ret);
     return ret;
 }
 
-static std::vector<uint256> BlockMerkleBranch(const CBlock &block,
-                                              uint32_t position) {
+static std::vector<uint256> ReferenceBlockMerkleBranch(const CBlock &block,
+                                                       uint32_t position) {
     std::vector<uint256> leaves;
     leaves.resize(block.vtx.size());
     for (size_t s = 0; s < block.vtx.size(); s++) {
         leaves[s] = block.vtx[s]->GetHash();
     }
-    return ComputeMerkleBranch(leaves, position);
+    return ReferenceMerkleBranch(leaves, position);
 }
 
 // Older version of the merkle root computation code, for comparison.
@@ -290,6 +290,8 @@ BOOST_AUTO_TEST_CASE(merkle_test) {
                     std::vector<uint256> oldBranch =
                         BlockGetMerkleBranch(block, merkleTree, mtx);
                     BOOST_CHECK(oldBranch == newBranch);
+                    BOOST_CHECK(ReferenceBlockMerkleBranch(block, mtx) ==
+                                newBranch);
                     BOOST_CHECK(
                         ComputeMerkleRootFromBranch(block.vtx[mtx]->GetId(),
                                                     newBranch, mtx) == oldRoot);
@@ -299,6 +301,18 @@ BOOST_AUTO_TEST_CASE(merkle_test) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(merkle_test_branch_out_of_range) {
+    std::vector<uint256> leaves;
+    for (int i = 0; i < 5; i++) {
+        leaves.push_back(InsecureRand256());
+    }
+    BOOST_CHECK(ComputeMerkleBranch(leaves, 4) ==
+                ReferenceMerkleBranch(leaves, 4));
+    BOOST_CHECK(ComputeMerkleBranch(leaves, 5).empty());
+    BOOST_CHECK(ComputeMerkleBranch(leaves, 7).empty());
+    BOOST_CHECK(ComputeMerkleBranch({}, 0).empty());
+}
+
 BOOST_AUTO_TEST_CASE(merkle_test_empty_block) {
     bool mutated = false;
     CBlock block;
@@ -18,6 +18,7 @@
 #include <util/string.h>
 #include <version.h>
 
+#include <test/util/net.h>
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
@@ -26,6 +27,7 @@
 #include <cmath>
 #include <cstdint>
 #include <ios>
+#include <deque>
 #include <memory>
 #include <string>
 
@@ -919,4 +921,356 @@ BOOST_AUTO_TEST_CASE(avalanche_statistics) {
     }
 }
 
+/**
+ * Feed a message to the V1 deserializer in chunks of random sizes and check
+ * it comes out unchanged, its checksum verified or not.
+ */
+static void V1RoundTrip(const Config &config,
+                        V1TransportDeserializer &deserializer,
+                        const std::string &command,
+                        const std::vector<uint8_t> &data,
+                        bool corrupt_data = false) {
+    CSerializedNetMsg msg;
+    msg.m_type = command;
+    msg.data = data;
+    std::vector<uint8_t> wire;
+    V1TransportSerializer().prepareForTransport(config, msg, wire);
+    wire.insert(wire.end(), data.begin(), data.end());
+    if (corrupt_data) {
+        wire.back() ^= 1;
+    }
+
+    Span<const uint8_t> bytes(wire);
+    while (!bytes.empty()) {
+        BOOST_REQUIRE(!deserializer.Complete());
+        const size_t max_chunk = 1 + InsecureRandBits(InsecureRandBool() ? 4
+                                                                         : 20);
+        Span<const uint8_t> chunk =
+            bytes.first(std::min<size_t>(bytes.size(), max_chunk));
+        const size_t chunk_size = chunk.size();
+        BOOST_REQUIRE_GE(deserializer.Read(config, chunk), 0);
+        bytes = bytes.subspan(chunk_size - chunk.size());
+    }
+    BOOST_REQUIRE(deserializer.Complete());
+
+    CNetMessage received = deserializer.GetMessage(config, 0us);
+    BOOST_CHECK(received.m_valid_netmagic);
+    BOOST_CHECK(received.m_valid_header);
+    BOOST_CHECK_EQUAL(received.m_valid_checksum, !corrupt_data);
+    BOOST_CHECK_EQUAL(received.m_command, command);
+    BOOST_CHECK_EQUAL(received.m_message_size, data.size());
+    BOOST_CHECK_EQUAL(received.m_raw_message_size, wire.size());
+    if (!corrupt_data) {
+        BOOST_CHECK(std::equal(
+            received.m_recv.begin(), received.m_recv.end(), data.begin(),
+            data.end(), [](char a, uint8_t b) { return uint8_t(a) == b; }));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(v1_transport_checksum) {
+    const Config &config = GetConfig();
+    V1TransportDeserializer deserializer(Params().NetMagic(), SER_NETWORK,
+                                         INIT_PROTO_VERSION);
+
+    // The checksum is verified as the last byte arrives, including for
+    // empty messages which are complete with their header
+    V1RoundTrip(config, deserializer, NetMsgType::VERACK, {});
+    V1RoundTrip(config, deserializer, NetMsgType::PING,
+                g_insecure_rand_ctx.randbytes(8));
+    V1RoundTrip(config, deserializer, NetMsgType::PING,
+                g_insecure_rand_ctx.randbytes(8), /* corrupt_data */ true);
+
+    // Large enough for the receive buffer to grow several times
+    const std::vector<uint8_t> block =
+        g_insecure_rand_ctx.randbytes(3 * 1024 * 1024 + 1000);
+    V1RoundTrip(config, deserializer, NetMsgType::BLOCK, block);
+    V1RoundTrip(config, deserializer, NetMsgType::BLOCK, block,
+                /* corrupt_data */ true);
+    V1RoundTrip(config, deserializer, NetMsgType::PONG,
+                g_insecure_rand_ctx.randbytes(8));
+}
+
+static const uint8_t V2_K1[32] = {1};
+static const uint8_t V2_K2[32] = {2};
+
+/**
+ * Serialize a message with the V2 transport and feed the packets to the
+ * deserializer in chunks of random sizes.
+ */
+static void V2RoundTrip(const Config &config, TransportSerializer &serializer,
+                        TransportDeserializer &deserializer,
+                        const std::string &command,
+                        const std::vector<uint8_t> &data,
+                        bool valid_header = true) {
+    CSerializedNetMsg msg;
+    msg.m_type = command;
+    msg.data = data;
+    std::vector<uint8_t> header;
+    serializer.prepareForTransport(config, msg, header);
+    BOOST_CHECK(header.empty());
+
+    Span<const uint8_t> bytes(msg.data);
+    while (!bytes.empty()) {
+        BOOST_REQUIRE(!deserializer.Complete());
+        const size_t max_chunk = 1 + InsecureRandBits(InsecureRandBool() ? 4
+                                                                         : 20);
+        Span<const uint8_t> chunk =
+            bytes.first(std::min<size_t>(bytes.size(), max_chunk));
+        const size_t chunk_size = chunk.size();
+        BOOST_REQUIRE_GE(deserializer.Read(config, chunk), 0);
+        bytes = bytes.subspan(chunk_size - chunk.size());
+    }
+    BOOST_REQUIRE(deserializer.Complete());
+
+    CNetMessage received = deserializer.GetMessage(config, 0us);
+    BOOST_CHECK(received.m_valid_netmagic);
+    BOOST_CHECK_EQUAL(received.m_valid_header, valid_header);
+    BOOST_CHECK(received.m_valid_checksum);
+    BOOST_CHECK_EQUAL(received.m_command, command);
+    BOOST_CHECK_EQUAL(received.m_message_size, data.size());
+    BOOST_CHECK_EQUAL(received.m_raw_message_size, msg.data.size());
+    BOOST_CHECK(std::equal(received.m_recv.begin(), received.m_recv.end(),
+                           data.begin(), data.end(),
+                           [](char a, uint8_t b) { return uint8_t(a) == b; }));
+}
+
+BOOST_AUTO_TEST_CASE(v2_transport_roundtrip) {
+    const Config &config = GetConfig();
+    V2TransportSerializer serializer(V2_K1, sizeof(V2_K1), V2_K2,
+                                     sizeof(V2_K2));
+    V2TransportDeserializer deserializer(V2_K1, sizeof(V2_K1), V2_K2,
+                                         sizeof(V2_K2), SER_NETWORK,
+                                         INIT_PROTO_VERSION);
+
+    // Enough messages to go through several AAD keystream blocks
+    for (int i = 0; i < 50; ++i) {
+        V2RoundTrip(config, serializer, deserializer, NetMsgType::PING,
+                    g_insecure_rand_ctx.randbytes(8));
+        V2RoundTrip(config, serializer, deserializer, NetMsgType::VERACK, {});
+    }
+
+    // Messages larger than a packet are split
+    const std::vector<uint8_t> block =
+        g_insecure_rand_ctx.randbytes(V2_MAX_PACKET_PAYLOAD + 1000);
+    V2RoundTrip(config, serializer, deserializer, NetMsgType::BLOCK, block);
+    V2RoundTrip(config, serializer, deserializer, NetMsgType::PONG,
+                g_insecure_rand_ctx.randbytes(8));
+
+    // Commands that are not allowed this size are rejected once the message
+    // is complete, as with V1
+    V2RoundTrip(config, serializer, deserializer, NetMsgType::GETDATA,
+                g_insecure_rand_ctx.randbytes(MAX_PROTOCOL_MESSAGE_LENGTH + 1),
+                /* valid_header */ false);
+}
+
+BOOST_AUTO_TEST_CASE(v2_transport_tampering) {
+    const Config &config = GetConfig();
+    V2TransportSerializer serializer(V2_K1, sizeof(V2_K1), V2_K2,
+                                     sizeof(V2_K2));
+
+    CSerializedNetMsg msg;
+    msg.m_type = NetMsgType::PING;
+    msg.data = g_insecure_rand_ctx.randbytes(8);
+    std::vector<uint8_t> header;
+    serializer.prepareForTransport(config, msg, header);
+
+    // Any modified byte of the payload or of the MAC fails the MAC check
+    for (size_t i = CHACHA20_POLY1305_AEAD_AAD_LEN; i < msg.data.size(); ++i) {
+        V2TransportDeserializer deserializer(V2_K1, sizeof(V2_K1), V2_K2,
+                                             sizeof(V2_K2), SER_NETWORK,
+                                             INIT_PROTO_VERSION);
+        std::vector<uint8_t> tampered = msg.data;
+        tampered[i] ^= 1;
+        Span<const uint8_t> bytes(tampered);
+        BOOST_CHECK_EQUAL(deserializer.Read(config, bytes),
+                          CHACHA20_POLY1305_AEAD_AAD_LEN);
+        BOOST_CHECK_EQUAL(deserializer.Read(config, bytes), -1);
+    }
+
+    // So does a wrong key
+    V2TransportDeserializer deserializer(V2_K2, sizeof(V2_K2), V2_K1,
+                                         sizeof(V2_K1), SER_NETWORK,
+                                         INIT_PROTO_VERSION);
+    Span<const uint8_t> bytes(msg.data);
+    while (!bytes.empty()) {
+        const int ret = deserializer.Read(config, bytes);
+        if (ret < 0) {
+            break;
+        }
+    }
+    BOOST_CHECK(!deserializer.Complete());
+}
+
+BOOST_AUTO_TEST_CASE(v2_handshake_keys) {
+    const Config &config = GetConfig();
+    const CMessageHeader::MessageMagic &magic =
+        config.GetChainParams().NetMagic();
+    V2Handshake initiator(/* initiator */ true);
+    V2Handshake responder(/* initiator */ false);
+    const CPubKey initiator_pubkey = initiator.GetPubKey();
+    const CPubKey responder_pubkey = responder.GetPubKey();
+    BOOST_CHECK(initiator_pubkey.IsCompressed());
+    BOOST_REQUIRE(initiator.Derive(responder_pubkey, magic));
+    BOOST_REQUIRE(responder.Derive(initiator_pubkey, magic));
+
+    // Each direction uses its own keys
+    for (int i = 0; i < 10; ++i) {
+        V2RoundTrip(config, *initiator.MakeSerializer(),
+                    *responder.MakeDeserializer(), NetMsgType::PING,
+                    g_insecure_rand_ctx.randbytes(8));
+        V2RoundTrip(config, *responder.MakeSerializer(),
+                    *initiator.MakeDeserializer(), NetMsgType::PONG,
+                    g_insecure_rand_ctx.randbytes(8));
+    }
+    CSerializedNetMsg msg;
+    msg.m_type = NetMsgType::PING;
+    msg.data = g_insecure_rand_ctx.randbytes(8);
+    std::vector<uint8_t> header;
+    initiator.MakeSerializer()->prepareForTransport(config, msg, header);
+    auto check_rejected =
+        [&](std::unique_ptr<TransportDeserializer> deserializer) {
+            Span<const uint8_t> bytes(msg.data);
+            while (!bytes.empty() && deserializer->Read(config, bytes) >= 0) {
+            }
+            BOOST_CHECK(!deserializer->Complete());
+        };
+    check_rejected(initiator.MakeDeserializer());
+
+    // The keys depend on the network and on both public keys
+    V2Handshake other_network(/* initiator */ false);
+    CMessageHeader::MessageMagic other_magic = magic;
+    other_magic[0] ^= 1;
+    BOOST_REQUIRE(other_network.Derive(initiator_pubkey, other_magic));
+    check_rejected(other_network.MakeDeserializer());
+    V2Handshake other_responder(/* initiator */ false);
+    BOOST_REQUIRE(other_responder.Derive(initiator_pubkey, magic));
+    check_rejected(other_responder.MakeDeserializer());
+
+    // Only valid compressed public keys are accepted
+    CKey key;
+    key.MakeNewKey(/* fCompressed */ false);
+    const CPubKey uncompressed = key.GetPubKey();
+    BOOST_CHECK(!responder.Derive(uncompressed, magic));
+    std::vector<uint8_t> invalid(initiator_pubkey.begin(),
+                                 initiator_pubkey.end());
+    invalid[0] = 0x04;
+    BOOST_CHECK(!responder.Derive(invalid, magic));
+    invalid[0] = 0x02;
+    invalid.pop_back();
+    BOOST_CHECK(!responder.Derive(invalid, magic));
+    BOOST_CHECK(!responder.Derive({}, magic));
+}
+
+/** Pass the bytes queued by a node to its peer, as the sockets would. */
+static std::vector<uint8_t> Transfer(ConnmanTestMsg &connman, CNode &from,
+                                     CNode &to) {
+    std::deque<std::vector<uint8_t>> queued;
+    {
+        LOCK(from.cs_vSend);
+        queued.swap(from.vSendMsg);
+        from.nSendSize = 0;
+    }
+    std::vector<uint8_t> wire;
+    for (const std::vector<uint8_t> &bytes : queued) {
+        wire.insert(wire.end(), bytes.begin(), bytes.end());
+    }
+    bool complete;
+    connman.NodeReceiveMsgBytes(to, wire, complete);
+    return wire;
+}
+
+/** The commands of the messages a node received, in order. */
+static std::vector<std::string> Received(CNode &node) {
+    std::vector<std::string> commands;
+    LOCK(node.cs_vProcessMsg);
+    for (const CNetMessage &msg : node.vProcessMsg) {
+        BOOST_CHECK(msg.m_valid_checksum);
+        commands.push_back(msg.m_command);
+    }
+    node.vProcessMsg.clear();
+    return commands;
+}
+
+static bool IsV2Transport(CNode &node) {
+    CNodeStats stats;
+    node.copyStats(stats);
+    return stats.m_v2_transport;
+}
+
+BOOST_AUTO_TEST_CASE(v2_handshake_connection) {
+    const Config &config = GetConfig();
+    ConnmanTestMsg connman(config, 0x1337, 0x1337);
+    const ServiceFlags services = ServiceFlags(NODE_NETWORK | NODE_P2P_V2);
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    const CAddress addr(CService(ipv4Addr, 7777), services);
+    CNode outbound(0, services, INVALID_SOCKET, addr, 0, 0, 0, CAddress(), "",
+                   ConnectionType::OUTBOUND_FULL_RELAY, false);
+    CNode inbound(1, services, INVALID_SOCKET, addr, 1, 1, 1, CAddress(), "",
+                  ConnectionType::INBOUND, false);
+    auto make_msg = [](const std::string &command) {
+        CSerializedNetMsg msg;
+        msg.m_type = command;
+        msg.data = g_insecure_rand_ctx.randbytes(8);
+        return msg;
+    };
+    const std::vector<std::string> ping{NetMsgType::PING};
+    const std::vector<std::string> pong{NetMsgType::PONG};
+
+    // The handshake messages are not passed on for processing, and each side
+    // switches its transports right after them, in the middle of a read.
+    connman.StartV2Handshake(outbound);
+    connman.PushMessage(&outbound, make_msg(NetMsgType::PING));
+    Transfer(connman, outbound, inbound);
+    BOOST_CHECK(Received(inbound) == ping);
+    BOOST_CHECK(!IsV2Transport(inbound));
+
+    connman.PushMessage(&inbound, make_msg(NetMsgType::PONG));
+    Transfer(connman, inbound, outbound);
+    BOOST_CHECK(Received(outbound) == pong);
+    BOOST_CHECK(IsV2Transport(outbound));
+
+    connman.PushMessage(&outbound, make_msg(NetMsgType::PING));
+    Transfer(connman, outbound, inbound);
+    BOOST_CHECK(Received(inbound) == ping);
+    BOOST_CHECK(IsV2Transport(inbound));
+
+    // Both directions are encrypted from now on
+    const CMessageHeader::MessageMagic &magic =
+        config.GetChainParams().NetMagic();
+    for (int i = 0; i < 3; ++i) {
+        connman.PushMessage(&outbound, make_msg(NetMsgType::PING));
+        const std::vector<uint8_t> wire =
+            Transfer(connman, outbound, inbound);
+        BOOST_CHECK(!std::equal(magic.begin(), magic.end(), wire.begin()));
+        BOOST_CHECK(Received(inbound) == ping);
+        connman.PushMessage(&inbound, make_msg(NetMsgType::PONG));
+        Transfer(connman, inbound, outbound);
+        BOOST_CHECK(Received(outbound) == pong);
+    }
+
+    // A handshake message out of place disconnects the peer
+    CSerializedNetMsg encinit;
+    encinit.m_type = NetMsgType::ENCINIT;
+    const CPubKey pubkey = V2Handshake(true).GetPubKey();
+    encinit.data.assign(pubkey.begin(), pubkey.end());
+    connman.PushMessage(&outbound, std::move(encinit));
+    std::vector<uint8_t> wire;
+    WITH_LOCK(outbound.cs_vSend, wire = outbound.vSendMsg.front());
+    bool complete;
+    BOOST_CHECK(!inbound.ReceiveMsgBytes(config, wire, complete));
+
+    // A node which doesn't support the V2 transport ignores them, as any
+    // other unknown message.
+    CNode v1_inbound(2, NODE_NETWORK, INVALID_SOCKET, addr, 1, 1, 1,
+                     CAddress(), "", ConnectionType::INBOUND, false);
+    encinit = CSerializedNetMsg();
+    encinit.m_type = NetMsgType::ENCINIT;
+    encinit.data.assign(pubkey.begin(), pubkey.end());
+    BOOST_CHECK(connman.ReceiveMsgFrom(v1_inbound, encinit));
+    BOOST_CHECK(Received(v1_inbound) ==
+                std::vector<std::string>{NetMsgType::ENCINIT});
+    BOOST_CHECK(!IsV2Transport(v1_inbound));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
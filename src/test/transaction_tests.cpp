@@ -930,4 +930,74 @@ BOOST_AUTO_TEST_CASE(tx_getvalueout) {
     BOOST_CHECK_THROW(overflow_sum_tx.GetValueOut(), std::runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(sign_transaction_parallel) {
+    FillableSigningProvider keystore;
+    std::vector<CScript> scripts;
+    for (int i = 0; i < 4; ++i) {
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        scripts.push_back(GetScriptForDestination(PKHash(key.GetPubKey())));
+    }
+    CKey unknown_key;
+    unknown_key.MakeNewKey(true);
+
+    // Enough inputs to be signed on several threads, one of them spending a
+    // missing coin and one a coin we don't have the key for.
+    const size_t n_inputs = 4 * MIN_INPUTS_PER_SIGNING_THREAD;
+    const size_t missing_input = 7;
+    const size_t unknown_input = n_inputs - 3;
+    CMutableTransaction mtx;
+    std::map<COutPoint, Coin> coins;
+    for (size_t i = 0; i < n_inputs; ++i) {
+        const COutPoint outpoint(TxId(InsecureRand256()), 0);
+        mtx.vin.emplace_back(outpoint);
+        if (i == missing_input) {
+            continue;
+        }
+        const CScript script =
+            i == unknown_input
+                ? GetScriptForDestination(PKHash(unknown_key.GetPubKey()))
+                : scripts[i % scripts.size()];
+        coins.emplace(outpoint,
+                      Coin(CTxOut(int64_t(i + 1) * COIN, script), 1, false));
+    }
+    mtx.vout.emplace_back(COIN, scripts[0]);
+
+    CMutableTransaction signed_tx = mtx;
+    std::map<int, std::string> input_errors;
+    BOOST_CHECK(!SignTransaction(signed_tx, &keystore, coins,
+                                 SigHashType().withForkId(), input_errors));
+    BOOST_CHECK_EQUAL(input_errors.size(), 2U);
+    BOOST_CHECK_EQUAL(input_errors[missing_input],
+                      "Input not found or already spent");
+    BOOST_CHECK_EQUAL(input_errors[unknown_input],
+                      "Unable to sign input, invalid stack size (possibly "
+                      "missing key)");
+
+    // The signatures are the same as when signing the inputs one by one.
+    for (size_t i = 0; i < n_inputs; ++i) {
+        if (i == missing_input || i == unknown_input) {
+            BOOST_CHECK(signed_tx.vin[i].scriptSig.empty());
+            continue;
+        }
+        const CTxOut &txout = coins.at(mtx.vin[i].prevout).GetTxOut();
+        CMutableTransaction expected = mtx;
+        BOOST_CHECK(SignSignature(keystore, txout.scriptPubKey, expected, i,
+                                  txout.nValue, SigHashType().withForkId()));
+        BOOST_CHECK(signed_tx.vin[i].scriptSig == expected.vin[i].scriptSig);
+    }
+
+    // Signing again gives the same transaction, and errors are cleared for
+    // the inputs that get signed.
+    CMutableTransaction resigned_tx = mtx;
+    input_errors.clear();
+    input_errors[0] = "Error from another signing provider";
+    BOOST_CHECK(!SignTransaction(resigned_tx, &keystore, coins,
+                                 SigHashType().withForkId(), input_errors));
+    BOOST_CHECK_EQUAL(input_errors.size(), 2U);
+    BOOST_CHECK(CTransaction(resigned_tx).GetHash() ==
+                CTransaction(signed_tx).GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
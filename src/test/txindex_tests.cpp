@@ -4,9 +4,11 @@
 
 #include <index/txindex.h>
 
+#include <blockdb.h>
 #include <chainparams.h>
 #include <script/standard.h>
 #include <util/time.h>
+#include <validation.h>
 
 #include <test/util/setup_common.h>
 
@@ -79,4 +81,54 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup) {
     SyncWithValidationInterfaceQueue();
 }
 
+BOOST_FIXTURE_TEST_CASE(txindex_find_txs, TestChain100Setup) {
+    // A cache too small for all the coinbase transactions, so that lookups
+    // are served both from the cache and from disk.
+    TxIndex txindex(1 << 20, true, false, 16 << 10);
+    txindex.Start();
+
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!txindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // The coinbase of each block, most recent first, and an unknown txid.
+    std::vector<TxId> txids;
+    std::vector<BlockHash> block_hashes;
+    {
+        LOCK(cs_main);
+        for (int height = ::ChainActive().Height(); height > 0; --height) {
+            const CBlockIndex *pindex = ::ChainActive()[height];
+            CBlock block;
+            BOOST_REQUIRE(
+                ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+            txids.push_back(block.vtx[0]->GetId());
+            block_hashes.push_back(pindex->GetBlockHash());
+        }
+    }
+    txids.emplace_back(InsecureRand256());
+
+    for (int round = 0; round < 3; ++round) {
+        const auto results = txindex.FindTxs(txids);
+        BOOST_REQUIRE_EQUAL(results.size(), txids.size());
+        for (size_t i = 0; i + 1 < txids.size(); ++i) {
+            BOOST_REQUIRE(results[i].second);
+            BOOST_CHECK(results[i].second->GetId() == txids[i]);
+            BOOST_CHECK(results[i].first == block_hashes[i]);
+
+            CTransactionRef tx;
+            BlockHash block_hash;
+            BOOST_CHECK(txindex.FindTx(txids[i], block_hash, tx));
+            BOOST_CHECK(tx->GetId() == txids[i]);
+            BOOST_CHECK(block_hash == block_hashes[i]);
+        }
+        BOOST_CHECK(!results.back().second);
+    }
+
+    txindex.Stop();
+    SyncWithValidationInterfaceQueue();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
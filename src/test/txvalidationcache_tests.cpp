@@ -674,6 +674,31 @@ BOOST_AUTO_TEST_CASE(scriptcache_values) {
     // It would also be acceptable to overwrite, but if we ever come to a
     // situation where this matters then neither alternative is better.
     CHECK_CACHE_HAS(key1A, 42);
+
+    // The entries survive resizing the cache, while they are being migrated
+    // to the new table and after.
+    const CuckooCache::cache_stats before = GetScriptExecutionCacheStats();
+    const uint32_t size = ResizeScriptExecutionCache(size_t(64) << 20);
+    BOOST_CHECK_EQUAL(GetScriptExecutionCacheStats().size, size);
+    BOOST_CHECK_EQUAL(GetScriptExecutionCacheStats().migrating_size,
+                      before.size);
+    CHECK_CACHE_HAS(key1A, 42);
+    CHECK_CACHE_HAS(key1B, 0);
+    CHECK_CACHE_HAS(key2A, max_standard_sigchecks);
+    CHECK_CACHE_MISSING(key2B);
+
+    for (uint32_t i = 0; GetScriptExecutionCacheStats().migrating_size; ++i) {
+        AddKeyInScriptCache(ScriptCacheKey(CTransaction(tx1), i), 1);
+    }
+    CHECK_CACHE_HAS(key1A, 42);
+    CHECK_CACHE_HAS(key1B, 0);
+    CHECK_CACHE_HAS(key2A, max_standard_sigchecks);
+    CHECK_CACHE_MISSING(key2B);
+
+    const CuckooCache::cache_stats after = GetScriptExecutionCacheStats();
+    BOOST_CHECK_GT(after.hits, before.hits);
+    BOOST_CHECK_GT(after.misses, before.misses);
+    BOOST_CHECK_GT(after.inserts, before.inserts);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
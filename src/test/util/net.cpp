@@ -37,7 +37,8 @@ void ConnmanTestMsg::NodeReceiveMsgBytes(CNode &node,
 bool ConnmanTestMsg::ReceiveMsgFrom(CNode &node,
                                     CSerializedNetMsg &ser_msg) const {
     std::vector<uint8_t> ser_msg_header;
-    node.m_serializer->prepareForTransport(*config, ser_msg, ser_msg_header);
+    WITH_LOCK(node.cs_vSend, node.m_serializer->prepareForTransport(
+                                 *config, ser_msg, ser_msg_header));
 
     bool complete;
     NodeReceiveMsgBytes(node, ser_msg_header, complete);
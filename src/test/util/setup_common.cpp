@@ -9,6 +9,8 @@
 #include <config.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
 #include <crypto/sha256.h>
 #include <init.h>
 #include <interfaces/chain.h>
@@ -25,6 +27,8 @@
 #include <script/script_error.h>
 #include <script/scriptcache.h>
 #include <script/sigcache.h>
+#include <script/sign.h>
+#include <script/signingprovider.h>
 #include <streams.h>
 #include <txdb.h>
 #include <txmempool.h>
@@ -126,6 +130,8 @@ BasicTestingSetup::BasicTestingSetup(
     AppInitParameterInteraction(config, *m_node.args);
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    ChaCha20AutoDetect();
+    Poly1305AutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
@@ -244,6 +250,11 @@ TestingSetup::TestingSetup(const std::string &chainName,
 }
 
 TestChain100Setup::TestChain100Setup() {
+    // The blocks are timestamped with the mock time, so that the rules which
+    // activate at a given median time past, such as the replay protection,
+    // don't depend on the clock of the machine running the tests.
+    SetMockTime(1598887952);
+
     // Generate a 100-block chain:
     coinbaseKey.MakeNewKey(true);
     CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
@@ -296,6 +307,37 @@ CBlock TestChain100Setup::CreateAndProcessBlock(
     return block;
 }
 
+CMutableTransaction TestChain100Setup::CreateValidMempoolTransaction(
+    CTransactionRef input_transaction, uint32_t input_vout, int input_height,
+    const CKey &input_signing_key, const CScript &output_destination,
+    Amount output_amount, bool submit) {
+    const COutPoint outpoint_to_spend(input_transaction->GetId(), input_vout);
+    CMutableTransaction mempool_txn;
+    mempool_txn.vin.emplace_back(outpoint_to_spend);
+    mempool_txn.vout.emplace_back(output_amount, output_destination);
+
+    FillableSigningProvider keystore;
+    keystore.AddKey(input_signing_key);
+    std::map<COutPoint, Coin> input_coins;
+    input_coins.emplace(outpoint_to_spend,
+                        Coin(input_transaction->vout[input_vout], input_height,
+                             input_transaction->IsCoinBase()));
+    std::map<int, std::string> input_errors;
+    Assert(SignTransaction(mempool_txn, &keystore, input_coins,
+                           SigHashType().withForkId(), input_errors));
+
+    if (submit) {
+        LOCK(cs_main);
+        TxValidationState state;
+        Assert(AcceptToMemoryPool(::ChainstateActive(), GetConfig(),
+                                  *m_node.mempool, state,
+                                  MakeTransactionRef(mempool_txn),
+                                  /* bypass_limits */ false));
+    }
+
+    return mempool_txn;
+}
+
 TestChain100Setup::~TestChain100Setup() {}
 
 CTxMemPoolEntry
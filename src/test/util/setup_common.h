@@ -153,6 +153,19 @@ struct TestChain100Setup : public RegTestingSetup {
     CBlock CreateAndProcessBlock(const std::vector<CMutableTransaction> &txns,
                                  const CScript &scriptPubKey);
 
+    /**
+     * Create a transaction spending the output input_vout of
+     * input_transaction, which was mined at input_height, signed with
+     * input_signing_key and paying output_amount to output_destination.
+     *
+     * @param submit Whether to add the transaction to the mempool.
+     */
+    CMutableTransaction CreateValidMempoolTransaction(
+        CTransactionRef input_transaction, uint32_t input_vout,
+        int input_height, const CKey &input_signing_key,
+        const CScript &output_destination, Amount output_amount = COIN,
+        bool submit = true);
+
     ~TestChain100Setup();
 
     // For convenience, coinbase transactions.
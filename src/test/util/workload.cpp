@@ -0,0 +1,291 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/util/workload.h>
+
+#include <amount.h>
+#include <hash.h>
+#include <key.h>
+#include <script/sighashtype.h>
+#include <script/sign.h>
+#include <script/standard.h>
+#include <serialize.h>
+#include <version.h>
+
+#include <algorithm>
+#include <cassert>
+
+//! Number of keys owned by the generator, which bounds multisig_keys
+static constexpr int WORKLOAD_KEYS = 16;
+//! Fee rate of the generated transactions, above the default relay fee
+static constexpr Amount WORKLOAD_FEE_PER_BYTE = 2 * SATOSHI;
+//! Smallest output created, well above the dust threshold
+static constexpr Amount WORKLOAD_MIN_OUTPUT = 10000 * SATOSHI;
+//! Outputs created by Fanout() are large enough to be split a few times
+static constexpr Amount WORKLOAD_FANOUT_OUTPUT = 100 * WORKLOAD_MIN_OUTPUT;
+//! Keeps the fan out transactions well below the standard size limit
+static constexpr size_t WORKLOAD_FANOUT_MAX_OUTPUTS = 1000;
+//! Upper bound of the size of an input spending a P2PKH output
+static constexpr size_t P2PKH_INPUT_SIZE = 148;
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadMix &mix, uint64_t seed)
+    : m_mix(mix),
+      m_rng((CHashWriter(SER_GETHASH, 0) << seed << 'r').GetHash()) {
+    assert(mix.multisig_required >= 1 &&
+           mix.multisig_required <= mix.multisig_keys &&
+           mix.multisig_keys <= 15);
+    assert(mix.chain_length >= 1 && mix.consolidation_inputs >= 2);
+
+    std::vector<CPubKey> pubkeys;
+    for (int i = 0; i < WORKLOAD_KEYS; ++i) {
+        const uint256 secret = (CHashWriter(SER_GETHASH, 0) << seed << i)
+                                   .GetHash();
+        CKey key;
+        key.Set(secret.begin(), secret.end(), true);
+        assert(key.IsValid());
+        m_keystore.AddKey(key);
+        pubkeys.push_back(key.GetPubKey());
+        m_p2pkh_scripts.push_back(
+            GetScriptForDestination(PKHash(key.GetPubKey())));
+    }
+
+    pubkeys.resize(mix.multisig_keys);
+    const CScript redeem_script =
+        GetScriptForMultisig(mix.multisig_required, pubkeys);
+    m_keystore.AddCScript(redeem_script);
+    m_multisig_script = GetScriptForDestination(ScriptHash(redeem_script));
+    // Outpoint, sequence and script length, then the dummy element, the
+    // signatures and the redeem script.
+    m_multisig_input_size = 41 + 2 + mix.multisig_required * 73 +
+                            redeem_script.size() + 3;
+}
+
+WorkloadGenerator::Coin WorkloadGenerator::TakeCoin(std::vector<Coin> &coins) {
+    assert(!coins.empty());
+    const size_t pos = m_rng.randrange(coins.size());
+    std::swap(coins[pos], coins.back());
+    Coin coin = std::move(coins.back());
+    coins.pop_back();
+    return coin;
+}
+
+void WorkloadGenerator::AddOutputs(const CTransaction &tx,
+                                   std::vector<Coin> &coins) {
+    for (uint32_t i = 0; i < tx.vout.size(); ++i) {
+        coins.push_back({COutPoint(tx.GetId(), i), tx.vout[i]});
+    }
+}
+
+size_t WorkloadGenerator::EstimateInputSize(const CTxOut &txout) const {
+    return txout.scriptPubKey == m_multisig_script ? m_multisig_input_size
+                                                   : P2PKH_INPUT_SIZE;
+}
+
+const CScript &WorkloadGenerator::RandomP2PKHScript() {
+    return m_p2pkh_scripts[m_rng.randrange(m_p2pkh_scripts.size())];
+}
+
+void WorkloadGenerator::AddCoins(const CTransaction &tx) {
+    for (uint32_t i = 0; i < tx.vout.size(); ++i) {
+        const CTxOut &txout = tx.vout[i];
+        if (txout.scriptPubKey == m_multisig_script) {
+            m_multisig_coins.push_back({COutPoint(tx.GetId(), i), txout});
+        } else if (std::find(m_p2pkh_scripts.begin(), m_p2pkh_scripts.end(),
+                             txout.scriptPubKey) != m_p2pkh_scripts.end()) {
+            m_coins.push_back({COutPoint(tx.GetId(), i), txout});
+        }
+    }
+}
+
+void WorkloadGenerator::ConfirmPending() {
+    for (Coin &coin : m_pending) {
+        if (coin.txout.scriptPubKey == m_multisig_script) {
+            m_multisig_coins.push_back(std::move(coin));
+        } else {
+            m_coins.push_back(std::move(coin));
+        }
+    }
+    m_pending.clear();
+}
+
+bool WorkloadGenerator::Finalize(CMutableTransaction &mtx,
+                                 const std::vector<Coin> &inputs,
+                                 std::vector<CTransactionRef> &txs) {
+    size_t size = GetSerializeSize(mtx, PROTOCOL_VERSION);
+    for (const Coin &coin : inputs) {
+        size += EstimateInputSize(coin.txout);
+    }
+    mtx.vout.back().nValue -= int64_t(size) * WORKLOAD_FEE_PER_BYTE;
+    if (mtx.vout.back().nValue < WORKLOAD_MIN_OUTPUT) {
+        // The inputs are still unspent, keep them for later transactions.
+        m_pending.insert(m_pending.end(), inputs.begin(), inputs.end());
+        return false;
+    }
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        bool signed_ok =
+            SignSignature(m_keystore, inputs[i].txout.scriptPubKey, mtx, i,
+                          inputs[i].txout.nValue, SigHashType().withForkId());
+        assert(signed_ok);
+    }
+
+    txs.push_back(MakeTransactionRef(std::move(mtx)));
+    return true;
+}
+
+void WorkloadGenerator::GeneratePayment(std::vector<CTransactionRef> &txs) {
+    if (m_coins.empty()) {
+        return;
+    }
+    const Coin coin = TakeCoin(m_coins);
+    const Amount value = coin.txout.nValue;
+
+    CMutableTransaction mtx;
+    mtx.vin.emplace_back(coin.outpoint);
+    if (value >= 4 * WORKLOAD_MIN_OUTPUT) {
+        const Amount payment = value / 2;
+        mtx.vout.emplace_back(payment, RandomP2PKHScript());
+        mtx.vout.emplace_back(value - payment, RandomP2PKHScript());
+    } else {
+        mtx.vout.emplace_back(value, RandomP2PKHScript());
+    }
+    if (Finalize(mtx, {coin}, txs)) {
+        AddOutputs(*txs.back(), m_pending);
+    }
+}
+
+void WorkloadGenerator::GenerateChain(std::vector<CTransactionRef> &txs) {
+    if (m_coins.empty()) {
+        return;
+    }
+    Coin coin = TakeCoin(m_coins);
+    for (int i = 0; i < m_mix.chain_length; ++i) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(coin.outpoint);
+        mtx.vout.emplace_back(coin.txout.nValue, RandomP2PKHScript());
+        if (!Finalize(mtx, {coin}, txs)) {
+            // Finalize kept the last output of the chain as pending.
+            return;
+        }
+        coin = {COutPoint(txs.back()->GetId(), 0), txs.back()->vout[0]};
+    }
+    m_pending.push_back(std::move(coin));
+}
+
+void WorkloadGenerator::GenerateMultisig(std::vector<CTransactionRef> &txs) {
+    // Spend a multisig coin if there is one, otherwise create some.
+    const bool spend_multisig = !m_multisig_coins.empty();
+    if (!spend_multisig && m_coins.empty()) {
+        return;
+    }
+    const Coin coin = TakeCoin(spend_multisig ? m_multisig_coins : m_coins);
+    const Amount value = coin.txout.nValue;
+
+    CMutableTransaction mtx;
+    mtx.vin.emplace_back(coin.outpoint);
+    if (value >= 4 * WORKLOAD_MIN_OUTPUT) {
+        mtx.vout.emplace_back(value / 2, m_multisig_script);
+        mtx.vout.emplace_back(value - value / 2, spend_multisig
+                                                     ? RandomP2PKHScript()
+                                                     : m_multisig_script);
+    } else {
+        mtx.vout.emplace_back(value, RandomP2PKHScript());
+    }
+    if (Finalize(mtx, {coin}, txs)) {
+        AddOutputs(*txs.back(), m_pending);
+    }
+}
+
+void WorkloadGenerator::GenerateConsolidation(
+    std::vector<CTransactionRef> &txs) {
+    const size_t count =
+        std::min<size_t>(m_mix.consolidation_inputs, m_coins.size());
+    if (count < 2) {
+        return;
+    }
+
+    std::vector<Coin> inputs;
+    CMutableTransaction mtx;
+    Amount value = Amount::zero();
+    for (size_t i = 0; i < count; ++i) {
+        inputs.push_back(TakeCoin(m_coins));
+        mtx.vin.emplace_back(inputs.back().outpoint);
+        value += inputs.back().txout.nValue;
+    }
+    mtx.vout.emplace_back(value, RandomP2PKHScript());
+    if (Finalize(mtx, inputs, txs)) {
+        AddOutputs(*txs.back(), m_pending);
+    }
+}
+
+std::vector<CTransactionRef> WorkloadGenerator::Fanout(size_t n) {
+    std::vector<CTransactionRef> txs;
+    const uint32_t total_weight = m_mix.payments + m_mix.chains +
+                                  m_mix.multisig + m_mix.consolidations;
+
+    std::vector<Coin> small_coins;
+    size_t available = GetCoinsCount() + m_pending.size();
+    while (available < n && !m_coins.empty()) {
+        const Coin coin = TakeCoin(m_coins);
+        const size_t outputs = std::min<size_t>(
+            {WORKLOAD_FANOUT_MAX_OUTPUTS, n - available + 1,
+             size_t(coin.txout.nValue / WORKLOAD_FANOUT_OUTPUT)});
+        if (outputs < 2) {
+            small_coins.push_back(coin);
+            continue;
+        }
+
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(coin.outpoint);
+        const Amount output_value = coin.txout.nValue / int64_t(outputs);
+        for (size_t i = 0; i < outputs; ++i) {
+            const bool multisig =
+                total_weight > 0 &&
+                m_rng.randrange(total_weight) < m_mix.multisig;
+            mtx.vout.emplace_back(output_value, multisig ? m_multisig_script
+                                                         : RandomP2PKHScript());
+        }
+        mtx.vout.back().nValue +=
+            coin.txout.nValue - int64_t(outputs) * output_value;
+        if (Finalize(mtx, {coin}, txs)) {
+            AddOutputs(*txs.back(), m_pending);
+            available += outputs - 1;
+        }
+    }
+    m_coins.insert(m_coins.end(), small_coins.begin(), small_coins.end());
+    return txs;
+}
+
+std::vector<CTransactionRef> WorkloadGenerator::Generate(size_t target_size) {
+    std::vector<CTransactionRef> txs;
+    const uint32_t total_weight = m_mix.payments + m_mix.chains +
+                                  m_mix.multisig + m_mix.consolidations;
+    if (total_weight == 0) {
+        return txs;
+    }
+
+    size_t size = 0;
+    // Give up after a long series of kinds that can't be generated with the
+    // remaining coins.
+    int idle = 0;
+    while (size < target_size && GetCoinsCount() > 0 && idle < 100) {
+        const size_t before = txs.size();
+        uint32_t pick = m_rng.randrange(total_weight);
+        if (pick < m_mix.payments) {
+            GeneratePayment(txs);
+        } else if ((pick -= m_mix.payments) < m_mix.chains) {
+            GenerateChain(txs);
+        } else if ((pick -= m_mix.chains) < m_mix.multisig) {
+            GenerateMultisig(txs);
+        } else {
+            GenerateConsolidation(txs);
+        }
+
+        idle = txs.size() == before ? idle + 1 : 0;
+        for (size_t i = before; i < txs.size(); ++i) {
+            size += txs[i]->GetTotalSize();
+        }
+    }
+    return txs;
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TEST_UTIL_WORKLOAD_H
+#define BITCOIN_TEST_UTIL_WORKLOAD_H
+
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/script.h>
+#include <script/signingprovider.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Relative frequency of each kind of transaction produced by
+ * WorkloadGenerator::Generate, and their shape.
+ */
+struct WorkloadMix {
+    //! P2PKH payments with one input and two outputs
+    uint32_t payments{10};
+    //! Chains of one input, one output transactions spending each other
+    uint32_t chains{1};
+    //! Spends of m-of-n P2SH multisig outputs
+    uint32_t multisig{2};
+    //! Many input consolidations into a single output
+    uint32_t consolidations{1};
+
+    int chain_length{25};
+    int multisig_required{2};
+    int multisig_keys{3};
+    int consolidation_inputs{50};
+};
+
+/**
+ * Wallet-free generator of valid, standard transactions for load tests.
+ *
+ * The generator owns a set of deterministic keys and signs with the
+ * SigningProvider based code used by the raw transaction RPCs. It only spends
+ * confirmed coins, apart from the transactions of a chain, so that the
+ * generated transactions stay within the default mempool ancestor limits: the
+ * outputs it creates become spendable once ConfirmPending() is called after
+ * the transactions have been mined.
+ */
+class WorkloadGenerator {
+private:
+    struct Coin {
+        COutPoint outpoint;
+        CTxOut txout;
+    };
+
+    const WorkloadMix m_mix;
+    FastRandomContext m_rng;
+    FillableSigningProvider m_keystore;
+    std::vector<CScript> m_p2pkh_scripts;
+    CScript m_multisig_script;
+    size_t m_multisig_input_size;
+
+    std::vector<Coin> m_coins;
+    std::vector<Coin> m_multisig_coins;
+    std::vector<Coin> m_pending;
+
+    Coin TakeCoin(std::vector<Coin> &coins);
+    void AddOutputs(const CTransaction &tx, std::vector<Coin> &coins);
+    size_t EstimateInputSize(const CTxOut &txout) const;
+    const CScript &RandomP2PKHScript();
+
+    /**
+     * Sign tx spending inputs, with the fee deducted from the last output, and
+     * append it to txs. If the last output would be dust after the fee, the
+     * transaction is dropped and the inputs are added back to the pending
+     * coins.
+     */
+    bool Finalize(CMutableTransaction &mtx, const std::vector<Coin> &inputs,
+                  std::vector<CTransactionRef> &txs);
+
+    void GeneratePayment(std::vector<CTransactionRef> &txs);
+    void GenerateChain(std::vector<CTransactionRef> &txs);
+    void GenerateMultisig(std::vector<CTransactionRef> &txs);
+    void GenerateConsolidation(std::vector<CTransactionRef> &txs);
+
+public:
+    explicit WorkloadGenerator(const WorkloadMix &mix, uint64_t seed = 0);
+
+    /** The script to mine to in order to fund the generator. */
+    const CScript &GetCoinbaseScript() const { return m_p2pkh_scripts[0]; }
+
+    /**
+     * Make the outputs of tx paying to the generator spendable. Coinbase
+     * transactions must only be added once mature.
+     */
+    void AddCoins(const CTransaction &tx);
+
+    /** Make the outputs of the generated transactions spendable. */
+    void ConfirmPending();
+
+    size_t GetCoinsCount() const {
+        return m_coins.size() + m_multisig_coins.size();
+    }
+
+    /**
+     * Split the coins so that at least n coins are available once the
+     * returned transactions are confirmed. Part of the new coins are multisig
+     * outputs, according to the mix.
+     */
+    std::vector<CTransactionRef> Fanout(size_t n);
+
+    /**
+     * Transactions following the mix, with a total size of at least
+     * target_size bytes, in an order in which they can be submitted to the
+     * mempool. Fewer transactions are returned when the coins run out.
+     */
+    std::vector<CTransactionRef> Generate(size_t target_size);
+};
+
+#endif // BITCOIN_TEST_UTIL_WORKLOAD_H
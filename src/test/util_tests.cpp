@@ -20,6 +20,7 @@
 #include <util/string.h>
 #include <util/time.h>
 #include <util/vector.h>
+#include <util/workerpool.h>
 
 #include <test/util/setup_common.h>
 
@@ -27,7 +28,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
@@ -143,6 +146,23 @@ BOOST_AUTO_TEST_CASE(util_ParseHex) {
     // Stop parsing at invalid value
     result = ParseHex("1234 invalid 1234");
     BOOST_CHECK(result.size() == 2 && result[0] == 0x12 && result[1] == 0x34);
+
+    // Upper case digits, and spaces or invalid values within long runs of
+    // digits, which are decoded several bytes at a time
+    const std::string hex = HexStr(ParseHex_expected);
+    result = ParseHex(ToUpper(hex));
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(),
+                                  expected.begin(), expected.end());
+    for (size_t i = 0; i < hex.size(); ++i) {
+        std::string str = hex;
+        str.insert(i, " ");
+        result = ParseHex(str);
+        BOOST_CHECK_EQUAL(result.size(), i % 2 ? i / 2 : expected.size());
+        str[i] = 'g';
+        result = ParseHex(str);
+        BOOST_CHECK_EQUAL(result.size(), i / 2);
+        BOOST_CHECK(std::equal(result.begin(), result.end(), expected.begin()));
+    }
 }
 
 BOOST_AUTO_TEST_CASE(util_HexStr) {
@@ -162,6 +182,19 @@ BOOST_AUTO_TEST_CASE(util_HexStr) {
     std::vector<uint8_t> ParseHex_vec(ParseHex_expected, ParseHex_expected + 5);
 
     BOOST_CHECK_EQUAL(HexStr(ParseHex_vec), "04678afdb0");
+
+    std::vector<uint8_t> all_bytes;
+    std::string all_bytes_hex;
+    for (int i = 0; i < 256; ++i) {
+        all_bytes.push_back(i);
+        all_bytes_hex += strprintf("%02x", i);
+    }
+    BOOST_CHECK_EQUAL(HexStr(all_bytes), all_bytes_hex);
+    BOOST_CHECK(ParseHex(all_bytes_hex) == all_bytes);
+
+    std::string str = "0x";
+    AppendHexStr(str, all_bytes);
+    BOOST_CHECK_EQUAL(str, "0x" + all_bytes_hex);
 }
 
 BOOST_AUTO_TEST_CASE(util_Join) {
@@ -2635,4 +2668,36 @@ BOOST_AUTO_TEST_CASE(remove_prefix) {
     BOOST_CHECK_EQUAL(RemovePrefix("", ""), "");
 }
 
+BOOST_AUTO_TEST_CASE(worker_pool) {
+    WorkerPool pool("testpool", 4);
+    BOOST_CHECK_EQUAL(pool.Size(), 4);
+
+    // Every thread runs each job once, and the workers are reused.
+    for (int job = 0; job < 100; ++job) {
+        std::array<std::atomic<int>, 4> calls{};
+        std::atomic<int> next{0};
+        std::vector<int> done(1000, 0);
+        pool.Run([&](int n) {
+            ++calls[n];
+            for (int i = next++; i < int(done.size()); i = next++) {
+                ++done[i];
+            }
+        });
+        for (const auto &count : calls) {
+            BOOST_CHECK_EQUAL(count, 1);
+        }
+        BOOST_CHECK(std::all_of(done.begin(), done.end(),
+                                [](int count) { return count == 1; }));
+    }
+
+    // A pool of a single thread runs the jobs on the calling thread.
+    WorkerPool single("testpool", 1);
+    BOOST_CHECK_EQUAL(single.Size(), 1);
+    const std::thread::id caller = std::this_thread::get_id();
+    single.Run([&](int n) {
+        BOOST_CHECK_EQUAL(n, 0);
+        BOOST_CHECK(std::this_thread::get_id() == caller);
+    });
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,11 +5,16 @@
 #include <boost/test/unit_test.hpp>
 #include <consensus/validation.h>
 #include <primitives/block.h>
+#include <primitives/transaction.h>
 #include <scheduler.h>
 #include <test/util/setup_common.h>
 #include <util/check.h>
 #include <validationinterface.h>
 
+#include <chrono>
+#include <future>
+#include <vector>
+
 BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
 
 struct TestSubscriberNoop final : public CValidationInterface {
@@ -89,4 +94,177 @@ BOOST_AUTO_TEST_CASE(unregister_all_during_call) {
     BOOST_CHECK(destroyed);
 }
 
+class TestQueueSubscriber : public CValidationInterface {
+public:
+    int m_calls{0};
+    void TransactionAddedToMempool(const CTransactionRef &,
+                                   uint64_t) override {
+        ++m_calls;
+    }
+};
+
+static const ValidationQueueInfo &
+FindQueueInfo(const std::vector<ValidationQueueInfo> &infos,
+              const std::string &name) {
+    auto it = std::find_if(infos.begin(), infos.end(),
+                           [&](const auto &info) { return info.name == name; });
+    BOOST_REQUIRE(it != infos.end());
+    return *it;
+}
+
+// Each subscriber has its own bounded queue. No thread services the
+// scheduler, so the notifications stay queued until they are flushed.
+BOOST_FIXTURE_TEST_CASE(per_subscriber_queues, BasicTestingSetup) {
+    CScheduler scheduler;
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    GetMainSignals().SetQueueOptions(2, {"dropping", "index"});
+
+    TestQueueSubscriber waiting;
+    TestQueueSubscriber dropping;
+    TestQueueSubscriber index;
+    RegisterValidationInterface(&waiting, "waiting");
+    RegisterValidationInterface(&dropping, "dropping");
+    // A subscriber which can't miss notifications keeps waiting.
+    RegisterValidationInterface(&index, "index", /* allow_drop */ false);
+
+    const CTransactionRef tx = MakeTransactionRef(CMutableTransaction());
+    for (int i = 0; i < 4; ++i) {
+        GetMainSignals().TransactionAddedToMempool(tx, i);
+    }
+
+    auto infos = GetMainSignals().GetQueueInfo();
+    BOOST_CHECK_EQUAL(infos.size(), 3U);
+    {
+        const auto &info = FindQueueInfo(infos, "waiting");
+        BOOST_CHECK(info.policy == ValidationQueuePolicy::WAIT);
+        BOOST_CHECK_EQUAL(info.max_pending, 2U);
+        BOOST_CHECK_EQUAL(info.pending, 4U);
+        BOOST_CHECK_EQUAL(info.dropped, 0U);
+    }
+    {
+        const auto &info = FindQueueInfo(infos, "dropping");
+        BOOST_CHECK(info.policy == ValidationQueuePolicy::DROP);
+        BOOST_CHECK_EQUAL(info.pending, 2U);
+        BOOST_CHECK_EQUAL(info.dropped, 2U);
+    }
+    {
+        const auto &info = FindQueueInfo(infos, "index");
+        BOOST_CHECK(info.policy == ValidationQueuePolicy::WAIT);
+        BOOST_CHECK_EQUAL(info.pending, 4U);
+        BOOST_CHECK_EQUAL(info.dropped, 0U);
+    }
+
+    // The function runs after the notifications queued before it, in every
+    // queue.
+    int waiting_calls = -1;
+    int dropping_calls = -1;
+    CallFunctionInValidationInterfaceQueue([&] {
+        waiting_calls = waiting.m_calls;
+        dropping_calls = dropping.m_calls;
+    });
+    GetMainSignals().FlushBackgroundCallbacks();
+    BOOST_CHECK_EQUAL(waiting_calls, 4);
+    BOOST_CHECK_EQUAL(dropping_calls, 2);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0U);
+
+    infos = GetMainSignals().GetQueueInfo();
+    BOOST_CHECK_EQUAL(FindQueueInfo(infos, "waiting").processed, 4U);
+    BOOST_CHECK_EQUAL(FindQueueInfo(infos, "dropping").processed, 2U);
+
+    // Nothing is delivered once the subscriber is unregistered.
+    GetMainSignals().TransactionAddedToMempool(tx, 4);
+    UnregisterValidationInterface(&waiting);
+    UnregisterValidationInterface(&index);
+    GetMainSignals().FlushBackgroundCallbacks();
+    BOOST_CHECK_EQUAL(waiting.m_calls, 4);
+    BOOST_CHECK_EQUAL(dropping.m_calls, 3);
+    infos = GetMainSignals().GetQueueInfo();
+    BOOST_CHECK_EQUAL(infos.size(), 1U);
+    BOOST_CHECK_EQUAL(infos[0].name, "dropping");
+
+    UnregisterAllValidationInterfaces();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+}
+
+// The notifications left in the queue of an unregistered subscriber don't
+// keep it alive, as a wallet being unloaded waits for it to be released.
+BOOST_FIXTURE_TEST_CASE(unregister_with_queued_notifications,
+                        BasicTestingSetup) {
+    CScheduler scheduler;
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+
+    bool destroyed = false;
+    auto subscriber =
+        std::make_shared<TestInterface>(nullptr, [&] { destroyed = true; });
+    RegisterSharedValidationInterface(subscriber);
+    GetMainSignals().TransactionAddedToMempool(
+        MakeTransactionRef(CMutableTransaction()), 0);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 1U);
+
+    UnregisterSharedValidationInterface(subscriber);
+    subscriber.reset();
+    BOOST_CHECK(destroyed);
+
+    GetMainSignals().FlushBackgroundCallbacks();
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0U);
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+}
+
+class TestOrderSubscriber : public CValidationInterface {
+public:
+    std::function<void(uint64_t)> m_on_call;
+    std::vector<uint64_t> m_sequences;
+    void TransactionAddedToMempool(const CTransactionRef &,
+                                   uint64_t mempool_sequence) override {
+        m_sequences.push_back(mempool_sequence);
+        if (m_on_call) {
+            m_on_call(mempool_sequence);
+        }
+    }
+};
+
+// With worker threads, the subscribers are notified concurrently: one being
+// busy with a notification doesn't hold up the others. The notifications of
+// each subscriber are still delivered in order.
+BOOST_FIXTURE_TEST_CASE(worker_threads, BasicTestingSetup) {
+    CScheduler scheduler;
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    GetMainSignals().StartWorkerThreads(2);
+
+    std::promise<void> other_notified;
+    std::promise<bool> busy_done;
+    TestOrderSubscriber busy;
+    TestOrderSubscriber other;
+    busy.m_on_call = [&](uint64_t sequence) {
+        if (sequence == 0) {
+            busy_done.set_value(
+                other_notified.get_future().wait_for(std::chrono::seconds{
+                    10}) == std::future_status::ready);
+        }
+    };
+    other.m_on_call = [&](uint64_t sequence) {
+        if (sequence == 0) {
+            other_notified.set_value();
+        }
+    };
+    RegisterValidationInterface(&busy, "busy");
+    RegisterValidationInterface(&other, "other");
+
+    const CTransactionRef tx = MakeTransactionRef(CMutableTransaction());
+    for (int i = 0; i < 3; ++i) {
+        GetMainSignals().TransactionAddedToMempool(tx, i);
+    }
+    // The workers are stopped by the flush, so wait for the first
+    // notification of the busy subscriber to be done.
+    BOOST_CHECK(busy_done.get_future().get());
+    GetMainSignals().FlushBackgroundCallbacks();
+
+    const std::vector<uint64_t> expected{0, 1, 2};
+    BOOST_CHECK(busy.m_sequences == expected);
+    BOOST_CHECK(other.m_sequences == expected);
+
+    UnregisterAllValidationInterfaces();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -48,17 +48,18 @@ struct CoinEntry {
 } // namespace
 
 CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory,
-                           bool fWipe)
+                           bool fWipe, DBEngineType engine)
     : m_db(std::make_unique<CDBWrapper>(ldb_path, nCacheSize, fMemory, fWipe,
-                                        true)),
-      m_ldb_path(ldb_path), m_is_memory(fMemory) {}
+                                        true, engine)),
+      m_ldb_path(ldb_path), m_is_memory(fMemory), m_engine(engine) {}
 
 void CCoinsViewDB::ResizeCache(size_t new_cache_size) {
     // Have to do a reset first to get the original `m_db` state to release its
     // filesystem lock.
     m_db.reset();
     m_db = std::make_unique<CDBWrapper>(m_ldb_path, new_cache_size, m_is_memory,
-                                        /*fWipe*/ false, /*obfuscate*/ true);
+                                        /*fWipe*/ false, /*obfuscate*/ true,
+                                        m_engine);
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
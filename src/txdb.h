@@ -42,6 +42,8 @@ static constexpr int64_t MAX_BLOCK_DB_CACHE_MB = 2;
 static constexpr int64_t MAX_TX_INDEX_CACHE_MB = 1024;
 //! Max memory allocated to all block filter index caches combined in MiB.
 static constexpr int64_t MAX_FILTER_INDEX_CACHE_MB = 1024;
+//! Max memory allocated to the block statistics index cache (MiB)
+static constexpr int64_t MAX_BLOCK_STATS_INDEX_CACHE_MB = 64;
 //! Max memory allocated to coin DB specific cache (MiB)
 static constexpr int64_t MAX_COINS_DB_CACHE_MB = 8;
 
@@ -55,14 +57,17 @@ protected:
     std::unique_ptr<CDBWrapper> m_db;
     fs::path m_ldb_path;
     bool m_is_memory;
+    DBEngineType m_engine;
 
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will
      * be stored.
+     * @param[in] engine      Storage engine of the database.
      */
     explicit CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory,
-                          bool fWipe);
+                          bool fWipe,
+                          DBEngineType engine = DBEngineType::LEVELDB);
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
@@ -75,6 +80,7 @@ public:
     //! Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+    DBEngineStats GetDBStats() const { return m_db->GetStats(); }
 
     //! Dynamically alter the underlying leveldb cache size.
     void ResizeCache(size_t new_cache_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -24,15 +24,19 @@
 #include <version.h>
 
 #include <algorithm>
+#include <limits>
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef &_tx, const Amount _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
                                  bool _spendsCoinbase, int64_t _sigOpsCount,
                                  LockPoints lp)
-    : tx(_tx), nFee(_nFee), nTxSize(tx->GetTotalSize()),
-      nUsageSize(RecursiveDynamicUsage(tx)), nTime(_nTime),
-      entryHeight(_entryHeight), spendsCoinbase(_spendsCoinbase),
-      sigOpCount(_sigOpsCount), lockPoints(lp), m_epoch(0) {
+    : tx(_tx), nFee(_nFee), nTime(_nTime), lockPoints(lp),
+      nTxSize(tx->GetTotalSize()), nUsageSize(RecursiveDynamicUsage(tx)),
+      entryHeight(_entryHeight), sigOpCount(_sigOpsCount),
+      spendsCoinbase(_spendsCoinbase), m_epoch(0) {
+    // The sigchecks of a transaction are bounded by consensus.
+    assert(_sigOpsCount <= std::numeric_limits<int32_t>::max());
+
     nCountWithDescendants = 1;
     nSizeWithDescendants = GetTxSize();
     nSigOpCountWithDescendants = sigOpCount;
@@ -46,6 +50,35 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef &_tx, const Amount _nFee,
     nSigOpCountWithAncestors = sigOpCount;
 }
 
+size_t CTxMemPoolEntryLinks::DynamicMemoryUsage() const {
+    return memusage::DynamicUsage(m_links);
+}
+
+bool CTxMemPoolEntryLinks::insert(const CTxMemPoolEntry &entry) {
+    auto it = std::lower_bound(m_links.begin(), m_links.end(), &entry,
+                               CompareIteratorById());
+    if (it != m_links.end() && !CompareIteratorById()(&entry, *it)) {
+        return false;
+    }
+    m_links.insert(it, &entry);
+    return true;
+}
+
+bool CTxMemPoolEntryLinks::erase(const CTxMemPoolEntry &entry) {
+    auto it = std::lower_bound(m_links.begin(), m_links.end(), &entry,
+                               CompareIteratorById());
+    if (it == m_links.end() || CompareIteratorById()(&entry, *it)) {
+        return false;
+    }
+    m_links.erase(it);
+    return true;
+}
+
+size_t CTxMemPoolEntryLinks::count(const CTxMemPoolEntry &entry) const {
+    return std::binary_search(m_links.begin(), m_links.end(), &entry,
+                              CompareIteratorById());
+}
+
 size_t CTxMemPoolEntry::GetTxVirtualSize() const {
     return GetVirtualTransactionSize(nTxSize, sigOpCount);
 }
@@ -80,8 +113,10 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints &lp) {
 void CTxMemPool::UpdateForDescendants(txiter updateIt,
                                       cacheMap &cachedDescendants,
                                       const std::set<TxId> &setExclude) {
-    CTxMemPoolEntry::Children stageEntries, descendants;
-    stageEntries = updateIt->GetMemPoolChildrenConst();
+    const CTxMemPoolEntry::Children &children =
+        updateIt->GetMemPoolChildrenConst();
+    CTxMemPoolEntry::RefSet stageEntries(children.begin(), children.end());
+    CTxMemPoolEntry::RefSet descendants;
 
     while (!stageEntries.empty()) {
         const CTxMemPoolEntry &descendant = *stageEntries.begin();
@@ -189,7 +224,7 @@ bool CTxMemPool::CalculateMemPoolAncestors(
     uint64_t limitAncestorCount, uint64_t limitAncestorSize,
     uint64_t limitDescendantCount, uint64_t limitDescendantSize,
     std::string &errString, bool fSearchForParents /* = true */) const {
-    CTxMemPoolEntry::Parents staged_ancestors;
+    CTxMemPoolEntry::RefSet staged_ancestors;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -213,7 +248,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(
         // If we're not searching for parents, we require this to be an entry in
         // the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        staged_ancestors = it->GetMemPoolParentsConst();
+        const CTxMemPoolEntry::Parents &parents = it->GetMemPoolParentsConst();
+        staged_ancestors.insert(parents.begin(), parents.end());
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
@@ -381,8 +417,9 @@ void CTxMemPoolEntry::UpdateDescendantState(int64_t modifySize,
     nSizeWithDescendants += modifySize;
     assert(int64_t(nSizeWithDescendants) > 0);
     nModFeesWithDescendants += modifyFee;
-    nCountWithDescendants += modifyCount;
-    assert(int64_t(nCountWithDescendants) > 0);
+    const int64_t count = int64_t(nCountWithDescendants) + modifyCount;
+    assert(count > 0 && count <= std::numeric_limits<uint32_t>::max());
+    nCountWithDescendants = count;
     nSigOpCountWithDescendants += modifySigOpCount;
     assert(int64_t(nSigOpCountWithDescendants) >= 0);
 }
@@ -393,13 +430,20 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, Amount modifyFee,
     nSizeWithAncestors += modifySize;
     assert(int64_t(nSizeWithAncestors) > 0);
     nModFeesWithAncestors += modifyFee;
-    nCountWithAncestors += modifyCount;
-    assert(int64_t(nCountWithAncestors) > 0);
+    const int64_t count = int64_t(nCountWithAncestors) + modifyCount;
+    assert(count > 0 && count <= std::numeric_limits<uint32_t>::max());
+    nCountWithAncestors = count;
     nSigOpCountWithAncestors += modifySigOps;
     assert(int(nSigOpCountWithAncestors) >= 0);
 }
 
-CTxMemPool::CTxMemPool(int check_ratio) : m_check_ratio(check_ratio) {
+CTxMemPool::CTxMemPool(int check_ratio, size_t journal_size)
+    : m_check_ratio(check_ratio), m_journal_size(journal_size),
+      mapTx(indexed_transaction_set::ctor_args_list(),
+            slab_pool_allocator<CTxMemPoolEntry>(m_entry_pool)) {
+    m_empty_entry_pool_usage =
+        m_entry_pool.UsedBytes() + m_entry_pool.FreeBytes();
+    m_empty_journal_usage = memusage::DynamicUsage(m_journal);
     // lock free clear
     _clear();
 }
@@ -469,7 +513,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry,
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
     // We increment mempool sequence value no matter removal reason
     // even if not directly reported below.
-    uint64_t mempool_sequence = GetAndIncrementSequence();
+    uint64_t mempool_sequence = RecordChange(it->GetTx().GetId(), false);
 
     if (reason != MemPoolRemovalReason::BLOCK) {
         // Notify clients that a transaction has been removed from the mempool
@@ -500,8 +544,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(it->GetMemPoolParentsConst()) +
-                        memusage::DynamicUsage(it->GetMemPoolChildrenConst());
+    cachedInnerUsage -= it->GetMemPoolParentsConst().DynamicMemoryUsage() +
+                        it->GetMemPoolChildrenConst().DynamicMemoryUsage();
     mapTx.erase(it);
     nTransactionsUpdated++;
 }
@@ -685,6 +729,12 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef> &vtx,
 }
 
 void CTxMemPool::_clear() {
+    // The transactions are dropped without being journaled, make sure that
+    // clients tracking the mempool list it again.
+    if (!mapTx.empty()) {
+        ++m_sequence_number;
+    }
+    m_journal.clear();
     mapTx.clear();
     mapNextTx.clear();
     vTxHashes.clear();
@@ -751,10 +801,10 @@ void CTxMemPool::check(CChainState &active_chainstate) const {
         checkTotal += it->GetTxSize();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction &tx = it->GetTx();
-        innerUsage += memusage::DynamicUsage(it->GetMemPoolParentsConst()) +
-                      memusage::DynamicUsage(it->GetMemPoolChildrenConst());
+        innerUsage += it->GetMemPoolParentsConst().DynamicMemoryUsage() +
+                      it->GetMemPoolChildrenConst().DynamicMemoryUsage();
         bool fDependsWait = false;
-        CTxMemPoolEntry::Parents setParentCheck;
+        CTxMemPoolEntry::RefSet setParentCheck;
         for (const CTxIn &txin : tx.vin) {
             // Check that every mempool transaction's inputs refer to available
             // coins, or other mempool tx's.
@@ -806,7 +856,7 @@ void CTxMemPool::check(CChainState &active_chainstate) const {
         assert(it->GetModFeesWithAncestors() == nFeesCheck);
 
         // Check children against mapNextTx
-        CTxMemPoolEntry::Children setChildrenCheck;
+        CTxMemPoolEntry::RefSet setChildrenCheck;
         auto iter = mapNextTx.lower_bound(COutPoint(it->GetTx().GetId(), 0));
         uint64_t child_sizes = 0;
         int64_t child_sigop_counts = 0;
@@ -926,6 +976,31 @@ void CTxMemPool::queryHashes(std::vector<uint256> &vtxid) const {
     }
 }
 
+uint64_t CTxMemPool::RecordChange(const TxId &txid, bool added) {
+    AssertLockHeld(cs);
+    if (m_journal_size > 0) {
+        if (m_journal.size() >= m_journal_size) {
+            m_journal.pop_front();
+        }
+        m_journal.push_back({m_sequence_number, txid, added});
+    }
+    return m_sequence_number++;
+}
+
+bool CTxMemPool::GetChangesSince(uint64_t sequence,
+                                 std::vector<MempoolChange> &changes) const {
+    AssertLockHeld(cs);
+    // The journal has no gaps, so the changes are found by position.
+    const uint64_t journal_begin = m_sequence_number - m_journal.size();
+    if (sequence < journal_begin || sequence > m_sequence_number) {
+        return false;
+    }
+
+    changes.assign(m_journal.begin() + (sequence - journal_begin),
+                   m_journal.end());
+    return true;
+}
+
 static TxMempoolInfo
 GetInfo(CTxMemPool::indexed_transaction_set::const_iterator it) {
     return TxMempoolInfo{it->GetSharedTx(), it->GetTime(), it->GetFee(),
@@ -1084,14 +1159,17 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
-    // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no
-    // exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) +
-                                 12 * sizeof(void *)) *
-               mapTx.size() +
+    // The nodes and the bucket array of mapTx are allocated from the pool,
+    // which accounts for their exact size and for the freed nodes it keeps.
+    // The memory of the empty containers is left out, so that the usage is
+    // proportional to the number of entries and of journal changes.
+    return m_entry_pool.UsedBytes() + m_entry_pool.FreeBytes() -
+           m_empty_entry_pool_usage +
            memusage::DynamicUsage(mapNextTx) +
            memusage::DynamicUsage(mapDeltas) +
-           memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+           memusage::DynamicUsage(vTxHashes) +
+           memusage::DynamicUsage(m_journal) - m_empty_journal_usage +
+           cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveUnbroadcastTx(const TxId &txid, const bool unchecked) {
@@ -1161,21 +1239,21 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry) {
 
 void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add) {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Children s;
-    if (add && entry->GetMemPoolChildren().insert(*child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && entry->GetMemPoolChildren().erase(*child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Children &children = entry->GetMemPoolChildren();
+    const size_t usage = children.DynamicMemoryUsage();
+    if (add ? children.insert(*child) : children.erase(*child)) {
+        cachedInnerUsage += children.DynamicMemoryUsage();
+        cachedInnerUsage -= usage;
     }
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add) {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Parents s;
-    if (add && entry->GetMemPoolParents().insert(*parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && entry->GetMemPoolParents().erase(*parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Parents &parents = entry->GetMemPoolParents();
+    const size_t usage = parents.DynamicMemoryUsage();
+    if (add ? parents.insert(*parent) : parents.erase(*parent)) {
+        cachedInnerUsage += parents.DynamicMemoryUsage();
+        cachedInnerUsage -= usage;
     }
 }
 
@@ -1216,7 +1294,16 @@ void CTxMemPool::TrimToSize(size_t sizelimit,
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(Amount::zero());
-    while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
+    // The pool keeps the nodes of the evicted entries for the next ones, so
+    // evicting doesn't lower the memory it holds: stop as soon as the entries
+    // fit in the limit, the next entries will reuse the freed nodes. Each
+    // eviction also grows the journal, which is bounded on its own, so only
+    // its usage from before the trim is counted.
+    const size_t journal_usage = memusage::DynamicUsage(m_journal);
+    while (!mapTx.empty() &&
+           DynamicMemoryUsage() - m_entry_pool.FreeBytes() -
+                   memusage::DynamicUsage(m_journal) + journal_usage >
+               sizelimit) {
         indexed_transaction_set::index<descendant_score>::type::iterator it =
             mapTx.get<descendant_score>().begin();
 
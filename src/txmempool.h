@@ -10,8 +10,10 @@
 #include <coins.h>
 #include <core_memusage.h>
 #include <indirectmap.h>
+#include <prevector.h>
 #include <primitives/transaction.h>
 #include <salteduint256hasher.h>
+#include <support/allocators/pool.h>
 #include <sync.h>
 
 #include <boost/multi_index/hashed_index.hpp>
@@ -20,6 +22,9 @@
 #include <boost/multi_index_container.hpp>
 
 #include <atomic>
+#include <cstddef>
+#include <deque>
+#include <iterator>
 #include <map>
 #include <optional>
 #include <set>
@@ -39,6 +44,12 @@ extern RecursiveMutex cs_main;
  */
 static const uint32_t MEMPOOL_HEIGHT = 0x7FFFFFFF;
 
+/**
+ * Default number of additions and removals kept by the mempool for clients
+ * tracking it incrementally.
+ */
+static constexpr size_t DEFAULT_MEMPOOL_JOURNAL_SIZE = 100000;
+
 struct LockPoints {
     // Will be set to the blockchain height and median time past values that
     // would be necessary to satisfy all relative locktime constraints (BIP68)
@@ -66,6 +77,58 @@ struct CompareIteratorById {
     }
 };
 
+class CTxMemPoolEntry;
+
+/**
+ * The in-mempool parents or children of a mempool entry, sorted by txid in a
+ * flat array. Most transactions only have a couple of them, which are stored
+ * inline without any allocation.
+ */
+class CTxMemPoolEntryLinks {
+    typedef prevector<2, const CTxMemPoolEntry *> Links;
+    Links m_links;
+
+public:
+    class const_iterator {
+        Links::const_iterator m_it;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef const CTxMemPoolEntry value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const CTxMemPoolEntry *pointer;
+        typedef const CTxMemPoolEntry &reference;
+
+        explicit const_iterator(Links::const_iterator it) : m_it(it) {}
+        reference operator*() const { return **m_it; }
+        pointer operator->() const { return *m_it; }
+        const_iterator &operator++() {
+            ++m_it;
+            return *this;
+        }
+        const_iterator operator++(int) { return const_iterator(m_it++); }
+        bool operator==(const const_iterator &other) const {
+            return m_it == other.m_it;
+        }
+        bool operator!=(const const_iterator &other) const {
+            return m_it != other.m_it;
+        }
+    };
+    typedef const_iterator iterator;
+
+    const_iterator begin() const { return const_iterator(m_links.begin()); }
+    const_iterator end() const { return const_iterator(m_links.end()); }
+    size_t size() const { return m_links.size(); }
+    bool empty() const { return m_links.empty(); }
+    size_t DynamicMemoryUsage() const;
+
+    //! Returns whether the entry was not linked yet
+    bool insert(const CTxMemPoolEntry &entry);
+    //! Returns whether the entry was linked
+    bool erase(const CTxMemPoolEntry &entry);
+    size_t count(const CTxMemPoolEntry &entry) const;
+};
+
 /** \class CTxMemPoolEntry
  *
  * CTxMemPoolEntry stores data about the corresponding transaction, as well as
@@ -81,8 +144,10 @@ class CTxMemPoolEntry {
 public:
     typedef std::reference_wrapper<const CTxMemPoolEntry> CTxMemPoolEntryRef;
     // two aliases, should the types ever diverge
-    typedef std::set<CTxMemPoolEntryRef, CompareIteratorById> Parents;
-    typedef std::set<CTxMemPoolEntryRef, CompareIteratorById> Children;
+    typedef CTxMemPoolEntryLinks Parents;
+    typedef CTxMemPoolEntryLinks Children;
+    //! Set of entries, used to walk the links between them
+    typedef std::set<CTxMemPoolEntryRef, CompareIteratorById> RefSet;
 
 private:
     const CTransactionRef tx;
@@ -90,35 +155,42 @@ private:
     mutable Children m_children;
     //! Cached to avoid expensive parent-transaction lookups
     const Amount nFee;
-    //! ... and avoid recomputing tx size
-    const size_t nTxSize;
-    //! ... and total memory usage
-    const size_t nUsageSize;
+    //! Used for determining the priority of the transaction for mining in a
+    //! block
+    Amount feeDelta;
     //! Local time when entering the mempool
     const int64_t nTime;
+    //! Track the height and time at which tx was final
+    LockPoints lockPoints;
+
+    // The following fields are narrowed to 32 bits and grouped so that the
+    // entries, which dominate the memory usage of the mempool, have no
+    // padding.
+
+    //! ... and avoid recomputing tx size
+    const uint32_t nTxSize;
+    //! ... and total memory usage
+    const uint32_t nUsageSize;
     //! Chain height when entering the mempool
-    const unsigned int entryHeight;
-    //! keep track of transactions that spend a coinbase
-    const bool spendsCoinbase;
+    const uint32_t entryHeight;
     /**
      * Total sigop plus P2SH sigops count.
      * After the sigchecks activation we repurpose the 'sigops' tracking in
      * mempool/mining to actually track sigchecks instead. (Proper SigOps will
      * not need to be counted any more since it's getting deactivated.)
      */
-    const int64_t sigOpCount;
-    //! Used for determining the priority of the transaction for mining in a
-    //! block
-    Amount feeDelta;
-    //! Track the height and time at which tx was final
-    LockPoints lockPoints;
+    const int32_t sigOpCount;
+    //! number of in-mempool descendant transactions, including this one
+    uint32_t nCountWithDescendants;
+    //! number of in-mempool ancestor transactions, including this one
+    uint32_t nCountWithAncestors;
+    //! keep track of transactions that spend a coinbase
+    const bool spendsCoinbase;
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
     // descendants as well.
-    //! number of descendant transactions
-    uint64_t nCountWithDescendants;
-    //! ... and size
+    //! size of the descendant transactions
     uint64_t nSizeWithDescendants;
     //! ... and total fees (all including us)
     Amount nModFeesWithDescendants;
@@ -126,7 +198,6 @@ private:
     int64_t nSigOpCountWithDescendants;
 
     // Analogous statistics for ancestor transactions
-    uint64_t nCountWithAncestors;
     uint64_t nSizeWithAncestors;
     Amount nModFeesWithAncestors;
     int64_t nSigOpCountWithAncestors;
@@ -185,7 +256,7 @@ public:
     Children &GetMemPoolChildren() const { return m_children; }
 
     //! Index in mempool's vTxHashes
-    mutable size_t vTxHashesIdx;
+    mutable uint32_t vTxHashesIdx;
     //! epoch when last touched, useful for graph algorithms
     mutable uint64_t m_epoch;
 };
@@ -413,6 +484,14 @@ enum class MemPoolRemovalReason {
     REPLACED
 };
 
+/** A transaction added to or removed from the mempool. */
+struct MempoolChange {
+    //! Mempool sequence number of the change
+    uint64_t sequence;
+    TxId txid;
+    bool added;
+};
+
 class SaltedTxIdHasher : private SaltedUint256Hasher {
 public:
     SaltedTxIdHasher() : SaltedUint256Hasher() {}
@@ -518,6 +597,18 @@ private:
     // is added or removed from the mempool for any reason.
     mutable uint64_t m_sequence_number{1};
 
+    //! The last changes to the mempool, numbered up to m_sequence_number - 1
+    //! without gaps.
+    std::deque<MempoolChange> m_journal GUARDED_BY(cs);
+    const size_t m_journal_size;
+    //! Memory used by m_journal when empty
+    size_t m_empty_journal_usage;
+
+    //! Memory of the mapTx nodes, declared first to outlive mapTx
+    SlabPool m_entry_pool GUARDED_BY(cs);
+    //! Memory used by mapTx when empty
+    size_t m_empty_entry_pool_usage;
+
     void trackPackageRemoved(const CFeeRate &rate) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     bool m_is_loaded GUARDED_BY(cs){false};
@@ -545,7 +636,8 @@ public:
                              boost::multi_index::ordered_non_unique<
                                  boost::multi_index::tag<ancestor_score>,
                                  boost::multi_index::identity<CTxMemPoolEntry>,
-                                 CompareTxMemPoolEntryByAncestorFee>>>
+                                 CompareTxMemPoolEntryByAncestorFee>>,
+        slab_pool_allocator<CTxMemPoolEntry>>
         indexed_transaction_set;
 
     /**
@@ -616,8 +708,11 @@ public:
      *
      * @param[in] check_ratio is the ratio used to determine how often sanity
      *     checks will run.
+     * @param[in] journal_size is the number of changes kept for
+     *     GetChangesSince().
      */
-    CTxMemPool(int check_ratio = 0);
+    CTxMemPool(int check_ratio = 0,
+               size_t journal_size = DEFAULT_MEMPOOL_JOURNAL_SIZE);
     ~CTxMemPool();
 
     /**
@@ -829,15 +924,27 @@ public:
         return (m_unbroadcast_txids.count(txid) != 0);
     }
 
-    /** Guards this internal counter for external reporting */
-    uint64_t GetAndIncrementSequence() const EXCLUSIVE_LOCKS_REQUIRED(cs) {
-        return m_sequence_number++;
-    }
+    /**
+     * Number a transaction added to or removed from the mempool for external
+     * reporting, and record it in the journal.
+     */
+    uint64_t RecordChange(const TxId &txid, bool added)
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     uint64_t GetSequence() const EXCLUSIVE_LOCKS_REQUIRED(cs) {
         return m_sequence_number;
     }
 
+    /**
+     * Get the transactions added to and removed from the mempool from the
+     * given sequence number on, as returned by GetSequence(), in order.
+     * Returns false if the journal doesn't go back that far, in which case
+     * the whole mempool must be listed again.
+     */
+    bool GetChangesSince(uint64_t sequence,
+                         std::vector<MempoolChange> &changes) const
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
+
 private:
     /**
      * UpdateForDescendants is used by UpdateTransactionsFromBlock to update the
@@ -9,6 +9,7 @@
 #include <logging.h>
 #include <streams.h>
 
+#include <algorithm>
 #include <cassert>
 #include <map>
 #include <vector>
@@ -317,3 +318,126 @@ std::vector<bool> DecodeAsmap(fs::path path) {
     }
     return bits;
 }
+
+CompiledAsmap::CompiledAsmap(std::vector<bool> asmap)
+    : m_asmap(std::move(asmap)) {
+    // The sanity check guarantees that the instructions are contiguous and
+    // that jumps land on instruction boundaries, so the bytecode can be
+    // decoded linearly. Decoding stops at the zero padding.
+    struct Decoded {
+        uint32_t offset;
+        Instruction opcode;
+        uint32_t arg;
+    };
+    std::vector<Decoded> decoded;
+    std::vector<uint32_t> jump_targets;
+    const std::vector<bool>::const_iterator begin = m_asmap.begin(),
+                                            endpos = m_asmap.end();
+    std::vector<bool>::const_iterator pos = begin;
+    while (pos != endpos) {
+        const uint32_t offset = pos - begin;
+        const Instruction opcode = DecodeType(pos, endpos);
+        uint32_t arg = INVALID;
+        switch (opcode) {
+            case Instruction::RETURN:
+            case Instruction::DEFAULT:
+                arg = DecodeASN(pos, endpos);
+                break;
+            case Instruction::JUMP:
+                arg = DecodeJump(pos, endpos);
+                if (arg != INVALID) {
+                    arg += pos - begin;
+                    jump_targets.push_back(arg);
+                }
+                break;
+            case Instruction::MATCH:
+                arg = DecodeMatch(pos, endpos);
+                break;
+        }
+        if (arg == INVALID) {
+            break;
+        }
+        decoded.push_back({offset, opcode, arg});
+    }
+    std::sort(jump_targets.begin(), jump_targets.end());
+
+    // Indices of the compiled instructions, by position in decoded.
+    std::vector<uint32_t> indices;
+    indices.reserve(decoded.size());
+    for (const Decoded &instruction : decoded) {
+        if (instruction.opcode == Instruction::MATCH) {
+            const uint8_t len = CountBits(instruction.arg) - 1;
+            const uint64_t bits = instruction.arg & ((1U << len) - 1);
+            // Merge with the previous MATCH unless it is jumped over.
+            if (!m_ops.empty() &&
+                m_ops.back().opcode == uint8_t(Instruction::MATCH) &&
+                m_ops.back().match_len + len <= 64 &&
+                !std::binary_search(jump_targets.begin(), jump_targets.end(),
+                                    instruction.offset)) {
+                Op &prev = m_ops.back();
+                prev.match_bits = (prev.match_bits << len) | bits;
+                prev.match_len += len;
+                indices.push_back(m_ops.size() - 1);
+                continue;
+            }
+            m_ops.push_back({0, uint8_t(instruction.opcode), len, bits});
+        } else {
+            m_ops.push_back(
+                {instruction.arg, uint8_t(instruction.opcode), 0, 0});
+        }
+        indices.push_back(m_ops.size() - 1);
+    }
+
+    // Resolve the jump offsets.
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        if (decoded[i].opcode != Instruction::JUMP) {
+            continue;
+        }
+        const auto target =
+            std::lower_bound(decoded.begin(), decoded.end(), decoded[i].arg,
+                             [](const Decoded &d, uint32_t offset) {
+                                 return d.offset < offset;
+                             });
+        assert(target != decoded.end() && target->offset == decoded[i].arg);
+        m_ops[indices[i]].arg = indices[target - decoded.begin()];
+    }
+}
+
+uint32_t CompiledAsmap::Lookup(Span<const uint8_t> ip) const {
+    assert(ip.size() == 16 && !m_ops.empty());
+    const uint64_t high = ReadBE64(ip.data());
+    const uint64_t low = ReadBE64(ip.data() + 8);
+    // Returns the len bits of the address starting at bit pos.
+    auto get_bits = [&](int pos, int len) {
+        const uint64_t top = pos == 0 ? high
+                             : pos < 64
+                                 ? (high << pos) | (low >> (64 - pos))
+                                 : low << (pos - 64);
+        return top >> (64 - len);
+    };
+
+    int pos = 0;
+    uint32_t default_asn = 0;
+    size_t i = 0;
+    while (true) {
+        const Op &op = m_ops[i];
+        switch (Instruction(op.opcode)) {
+            case Instruction::RETURN:
+                return op.arg;
+            case Instruction::JUMP:
+                i = get_bits(pos++, 1) ? op.arg : i + 1;
+                break;
+            case Instruction::MATCH:
+                if (get_bits(pos, op.match_len) != op.match_bits) {
+                    return default_asn;
+                }
+                pos += op.match_len;
+                ++i;
+                break;
+            case Instruction::DEFAULT:
+                default_asn = op.arg;
+                ++i;
+                break;
+        }
+    }
+}
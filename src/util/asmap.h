@@ -6,6 +6,7 @@
 #define BITCOIN_UTIL_ASMAP_H
 
 #include <fs.h>
+#include <span.h>
 
 #include <cstdint>
 #include <vector>
@@ -17,4 +18,46 @@ bool SanityCheckASMap(const std::vector<bool> &asmap, int bits);
 /** Read asmap from provided binary file */
 std::vector<bool> DecodeAsmap(fs::path path);
 
+/**
+ * An asmap compiled for the lookup of 128-bit addresses.
+ *
+ * Interpret() decodes the bytecode bit by bit on every lookup. This decodes it
+ * once into an array of instructions with byte-aligned operands: jump offsets
+ * are resolved to instruction indices and runs of MATCH instructions are
+ * merged, so the address bits are compared up to 64 at a time.
+ */
+class CompiledAsmap {
+private:
+    struct Op {
+        //! RETURN and DEFAULT: the ASN. JUMP: the index of the instruction to
+        //! continue at when the next address bit is set.
+        uint32_t arg;
+        uint8_t opcode;
+        //! MATCH: the number of address bits to compare with match_bits.
+        uint8_t match_len;
+        uint64_t match_bits;
+    };
+
+    std::vector<bool> m_asmap;
+    std::vector<Op> m_ops;
+
+public:
+    CompiledAsmap() = default;
+    /** asmap must pass SanityCheckASMap(asmap, 128). */
+    explicit CompiledAsmap(std::vector<bool> asmap);
+
+    bool empty() const { return m_asmap.empty(); }
+
+    /** The asmap bytecode this was compiled from. */
+    const std::vector<bool> &GetBits() const { return m_asmap; }
+
+    size_t GetInstructionCount() const { return m_ops.size(); }
+
+    /**
+     * Same as Interpret() on the bits of ip, most significant bit of the first
+     * byte first. The asmap must not be empty.
+     */
+    uint32_t Lookup(Span<const uint8_t> ip) const;
+};
+
 #endif // BITCOIN_UTIL_ASMAP_H
@@ -14,6 +14,10 @@
 #include <cstring>
 #include <limits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 static const std::string CHARS_ALPHA_NUM =
     "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
 
@@ -84,10 +88,87 @@ bool IsHexNumber(const std::string &str) {
     return (str.size() > starting_location);
 }
 
+#if defined(__SSE2__)
+namespace {
+
+/** Convert 16 nibbles to their lower-case hexadecimal digits. */
+__m128i NibblesToHex(__m128i nibbles) {
+    const __m128i letters =
+        _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)),
+                      _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+/** Encode 16 bytes into 32 hexadecimal digits. */
+void EncodeHex16(const uint8_t *in, char *out) {
+    const __m128i bytes = _mm_loadu_si128((const __m128i *)in);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+    const __m128i lo = _mm_and_si128(bytes, mask);
+    _mm_storeu_si128((__m128i *)out, NibblesToHex(_mm_unpacklo_epi8(hi, lo)));
+    _mm_storeu_si128((__m128i *)(out + 16),
+                     NibblesToHex(_mm_unpackhi_epi8(hi, lo)));
+}
+
+/**
+ * Decode 16 hexadecimal digits of either case into 8 bytes, each held in the
+ * low byte of a 16 bits lane. Returns false if any of them is not a digit.
+ */
+bool DecodeHex8(const char *in, __m128i &out) {
+    const __m128i chars = _mm_loadu_si128((const __m128i *)in);
+    const __m128i digit =
+        _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                      _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    // Setting the 0x20 bit only maps 'A' to 'F' onto 'a' to 'f'.
+    const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    const __m128i letter =
+        _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                      _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xffff) {
+        return false;
+    }
+
+    const __m128i nibbles = _mm_or_si128(
+        _mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+        _mm_and_si128(letter,
+                      _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    // The first digit of a pair is the high nibble of the byte.
+    out = _mm_or_si128(
+        _mm_and_si128(_mm_slli_epi16(nibbles, 4), _mm_set1_epi16(0xf0)),
+        _mm_srli_epi16(nibbles, 8));
+    return true;
+}
+
+/** Decode 32 hexadecimal digits into 16 bytes, unless any is invalid. */
+bool DecodeHex16(const char *in, uint8_t *out) {
+    __m128i lo, hi;
+    if (!DecodeHex8(in, lo) || !DecodeHex8(in + 16, hi)) {
+        return false;
+    }
+    _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(lo, hi));
+    return true;
+}
+
+} // namespace
+#endif
+
 std::vector<uint8_t> ParseHex(const char *psz) {
     // convert hex dump to vector
     std::vector<uint8_t> vch;
+#if defined(__SSE2__)
+    const char *end = psz + strlen(psz);
+    vch.reserve((end - psz) / 2);
+#endif
     while (true) {
+#if defined(__SSE2__)
+        // Decode whole runs of digits 16 bytes at a time, and leave spaces,
+        // the end of the string and odd digits to the loop below.
+        uint8_t bytes[16];
+        while (end - psz >= 32 && DecodeHex16(psz, bytes)) {
+            vch.insert(vch.end(), bytes, bytes + sizeof(bytes));
+            psz += 32;
+        }
+#endif
         while (IsSpace(*psz)) {
             psz++;
         }
@@ -664,14 +745,26 @@ std::string Capitalize(std::string str) {
     return str;
 }
 
-std::string HexStr(const Span<const uint8_t> s) {
-    std::string rv;
+void AppendHexStr(std::string &str, const Span<const uint8_t> s) {
     static constexpr char hexmap[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
                                         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
-    rv.reserve(s.size() * 2);
-    for (uint8_t v : s) {
-        rv.push_back(hexmap[v >> 4]);
-        rv.push_back(hexmap[v & 15]);
+    const size_t offset = str.size();
+    str.resize(offset + s.size() * 2);
+    char *out = &str[offset];
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= s.size(); i += 16, out += 32) {
+        EncodeHex16(s.data() + i, out);
+    }
+#endif
+    for (; i < s.size(); ++i) {
+        *out++ = hexmap[s[i] >> 4];
+        *out++ = hexmap[s[i] & 15];
     }
+}
+
+std::string HexStr(const Span<const uint8_t> s) {
+    std::string rv;
+    AppendHexStr(rv, s);
     return rv;
 }
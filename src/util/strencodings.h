@@ -164,6 +164,11 @@ std::string HexStr(const Span<const uint8_t> s);
 inline std::string HexStr(const Span<const char> s) {
     return HexStr(MakeUCharSpan(s));
 }
+/**
+ * Append the lower-case hexadecimal encoding of a span of bytes to str, so
+ * callers building a larger string don't need a temporary one.
+ */
+void AppendHexStr(std::string &str, const Span<const uint8_t> s);
 
 /**
  * Format a paragraph of text to a fixed width, adding spaces for indentation to
@@ -0,0 +1,114 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_WORKERPOOL_H
+#define BITCOIN_UTIL_WORKERPOOL_H
+
+#include <sync.h>
+#include <tinyformat.h>
+#include <util/threadnames.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of threads which run the jobs passed to Run along with the
+ * calling thread. Each thread calls the job once with its own index, 0 being
+ * the calling thread, and the job is expected to share its work between them.
+ * The threads are started by the constructor and stopped by the destructor,
+ * so the pool is meant to be reused by several jobs.
+ */
+class WorkerPool {
+private:
+    //! Serializes the calls to Run
+    Mutex m_run_mutex;
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    //! The job being run, or nullptr
+    std::function<void(int)> m_job GUARDED_BY(m_mutex);
+    uint64_t m_job_id GUARDED_BY(m_mutex){0};
+    //! Number of workers which did not run the job yet
+    size_t m_pending GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_threads;
+
+    void ThreadWork(int n) {
+        uint64_t last_job_id = 0;
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                return m_stop || m_job_id != last_job_id;
+            });
+            if (m_stop) {
+                return;
+            }
+            last_job_id = m_job_id;
+            const std::function<void(int)> job = m_job;
+            {
+                REVERSE_LOCK(lock);
+                job(n);
+            }
+            if (--m_pending == 0) {
+                m_cond.notify_all();
+            }
+        }
+    }
+
+public:
+    /**
+     * Start num_threads - 1 worker threads, named thread_name.<index>, so that
+     * the jobs run on num_threads threads including the caller.
+     */
+    WorkerPool(const std::string &thread_name, int num_threads) {
+        for (int n = 1; n < num_threads; ++n) {
+            m_threads.emplace_back([this, thread_name, n]() {
+                util::ThreadRename(strprintf("%s.%i", thread_name, n));
+                ThreadWork(n);
+            });
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_cond.notify_all();
+        for (std::thread &thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    /** The number of threads running each job, including the caller. */
+    int Size() const { return m_threads.size() + 1; }
+
+    /**
+     * Run the job on the calling thread and on all the workers, and wait for
+     * all of them to return. The job must not throw.
+     */
+    void Run(const std::function<void(int)> &job) {
+        LOCK(m_run_mutex);
+        {
+            LOCK(m_mutex);
+            m_job = job;
+            m_pending = m_threads.size();
+            ++m_job_id;
+        }
+        m_cond.notify_all();
+        job(0);
+
+        WAIT_LOCK(m_mutex, lock);
+        m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+            return m_pending == 0;
+        });
+        m_job = nullptr;
+    }
+};
+
+#endif // BITCOIN_UTIL_WORKERPOOL_H
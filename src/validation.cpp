@@ -25,6 +25,7 @@
 #include <logging.h>
 #include <logging/timer.h>
 #include <minerfund.h>
+#include <node/segmentvalidation.h>
 #include <node/ui_interface.h>
 #include <policy/fees.h>
 #include <policy/mempool.h>
@@ -144,7 +145,7 @@ std::set<int> setDirtyFileInfo;
 
 BlockValidationOptions::BlockValidationOptions(const Config &config)
     : excessiveBlockSize(config.GetMaxBlockSize()), checkPoW(true),
-      checkMerkleRoot(true) {}
+      checkMerkleRoot(true), forceScriptChecks(false) {}
 
 CBlockIndex *BlockManager::LookupBlockIndex(const BlockHash &hash) {
     AssertLockHeld(cs_main);
@@ -405,6 +406,9 @@ private:
         // ConsensusScriptChecks
         const uint32_t m_next_block_script_verify_flags;
         int m_sig_checks_standard;
+
+        //! Mempool sequence number of the addition of the transaction
+        uint64_t m_mempool_sequence;
     };
 
     // Run the policy checks on a given transaction, excluding any script
@@ -710,8 +714,10 @@ bool MemPoolAccept::Finalize(ATMPArgs &args, Workspace &ws) {
     CTxMemPool::setEntries &setAncestors = ws.m_ancestors;
     std::unique_ptr<CTxMemPoolEntry> &entry = ws.m_entry;
 
-    // Store transaction in memory.
+    // Store transaction in memory. The addition is numbered right away, so
+    // that it comes before the evictions it causes.
     m_pool.addUnchecked(*entry, setAncestors);
+    ws.m_mempool_sequence = m_pool.RecordChange(txid, true);
 
     // Trim mempool and check if tx was trimmed.
     if (!bypass_limits) {
@@ -764,8 +770,8 @@ bool MemPoolAccept::AcceptSingleTransaction(const CTransactionRef &ptx,
         return false;
     }
 
-    GetMainSignals().TransactionAddedToMempool(
-        ptx, m_pool.GetAndIncrementSequence());
+    GetMainSignals().TransactionAddedToMempool(ptx,
+                                               workspace.m_mempool_sequence);
 
     return true;
 }
@@ -852,6 +858,59 @@ CTransactionRef GetTransaction(const CBlockIndex *const block_index,
     return nullptr;
 }
 
+std::vector<CTransactionRef>
+GetTransactions(const CBlockIndex *const block_index,
+                const CTxMemPool *const mempool, const std::vector<TxId> &txids,
+                const Consensus::Params &consensusParams,
+                std::vector<BlockHash> &hashBlocks) {
+    std::vector<CTransactionRef> txs(txids.size());
+    hashBlocks.assign(txids.size(), BlockHash());
+    if (block_index) {
+        // cs_main is only taken to look the block position up, not while the
+        // block is read.
+        CBlock block;
+        if (ReadBlockFromDisk(block, block_index, consensusParams)) {
+            std::map<TxId, size_t> positions;
+            for (size_t i = 0; i < block.vtx.size(); ++i) {
+                positions.emplace(block.vtx[i]->GetId(), i);
+            }
+            for (size_t i = 0; i < txids.size(); ++i) {
+                auto it = positions.find(txids[i]);
+                if (it != positions.end()) {
+                    txs[i] = block.vtx[it->second];
+                    hashBlocks[i] = block_index->GetBlockHash();
+                }
+            }
+        }
+        return txs;
+    }
+
+    std::vector<TxId> missing;
+    std::vector<size_t> missing_positions;
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < txids.size(); ++i) {
+            if (mempool) {
+                txs[i] = mempool->get(txids[i]);
+            }
+            if (!txs[i]) {
+                missing.push_back(txids[i]);
+                missing_positions.push_back(i);
+            }
+        }
+    }
+    // The transactions missing from the mempool are read from disk without
+    // holding cs_main.
+    if (g_txindex && !missing.empty()) {
+        auto found = g_txindex->FindTxs(missing);
+        for (size_t j = 0; j < found.size(); ++j) {
+            hashBlocks[missing_positions[j]] = found[j].first;
+            txs[missing_positions[j]] = std::move(found[j].second);
+        }
+    }
+    return txs;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // CBlock and CBlockIndex
@@ -895,9 +954,9 @@ Amount GetBlockSubsidy(int nHeight, const Consensus::Params &consensusParams) {
 }
 
 CoinsViews::CoinsViews(std::string ldb_name, size_t cache_size_bytes,
-                       bool in_memory, bool should_wipe)
+                       bool in_memory, bool should_wipe, DBEngineType engine)
     : m_dbview(GetDataDir() / ldb_name, cache_size_bytes, in_memory,
-               should_wipe),
+               should_wipe, engine),
       m_catcherview(&m_dbview) {}
 
 void CoinsViews::InitCache() {
@@ -910,12 +969,13 @@ CChainState::CChainState(CTxMemPool &mempool, BlockManager &blockman,
       m_from_snapshot_blockhash(from_snapshot_blockhash) {}
 
 void CChainState::InitCoinsDB(size_t cache_size_bytes, bool in_memory,
-                              bool should_wipe, std::string leveldb_name) {
+                              bool should_wipe, DBEngineType engine,
+                              std::string leveldb_name) {
     if (!m_from_snapshot_blockhash.IsNull()) {
         leveldb_name += "_" + m_from_snapshot_blockhash.ToString();
     }
-    m_coins_views = std::make_unique<CoinsViews>(leveldb_name, cache_size_bytes,
-                                                 in_memory, should_wipe);
+    m_coins_views = std::make_unique<CoinsViews>(
+        leveldb_name, cache_size_bytes, in_memory, should_wipe, engine);
 }
 
 void CChainState::InitCoinsCache(size_t cache_size_bytes) {
@@ -1706,7 +1766,7 @@ bool CChainState::ConnectBlock(const CBlock &block, BlockValidationState &state,
     }
 
     bool fScriptChecks = true;
-    if (!hashAssumeValid.IsNull()) {
+    if (!hashAssumeValid.IsNull() && !options.shouldForceScriptChecks()) {
         // We've been configured with the hash of a block which has been
         // externally verified to have a valid history. A suitable default value
         // is included with the software and updated from time to time. Because
@@ -2640,11 +2700,23 @@ bool CChainState::ConnectTip(const Config &config, BlockValidationState &state,
              (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO,
              nTimeFlush * MILLI / nBlocksTotal);
 
-    // Write the chain state to disk, if necessary.
+    // Write the chain state to disk, if necessary. The segment snapshots are
+    // taken from the coins database, which must be up to date, and written in
+    // the background.
+    const bool segment_snapshot = IsSegmentSnapshotHeight(pindexNew->nHeight);
     if (!FlushStateToDisk(config.GetChainParams(), state,
-                          FlushStateMode::IF_NEEDED)) {
+                          segment_snapshot ? FlushStateMode::ALWAYS
+                                           : FlushStateMode::IF_NEEDED)) {
         return false;
     }
+    if (segment_snapshot) {
+        std::string error;
+        if (!QueueSegmentSnapshot(CoinsDB(), *pindexNew, error)) {
+            LogPrintf("Failed to write the segment snapshot at height %d: "
+                      "%s\n",
+                      pindexNew->nHeight, error);
+        }
+    }
 
     int64_t nTime5 = GetTimeMicros();
     nTimeChainState += nTime5 - nTime4;
@@ -3024,14 +3096,6 @@ static bool NotifyHeaderTip(CChainState &chainstate) LOCKS_EXCLUDED(cs_main) {
     return fNotify;
 }
 
-static void LimitValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main) {
-    AssertLockNotHeld(cs_main);
-
-    if (GetMainSignals().CallbacksPending() > 10) {
-        SyncWithValidationInterfaceQueue();
-    }
-}
-
 bool CChainState::ActivateBestChain(const Config &config,
                                     BlockValidationState &state,
                                     std::shared_ptr<const CBlock> pblock) {
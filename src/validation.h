@@ -86,6 +86,7 @@ static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
 static const char *const DEFAULT_BLOCKFILTERINDEX = "0";
+static const bool DEFAULT_BLOCKSTATSINDEX = false;
 
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -183,6 +184,7 @@ private:
     uint64_t excessiveBlockSize;
     bool checkPoW : 1;
     bool checkMerkleRoot : 1;
+    bool forceScriptChecks : 1;
 
 public:
     // Do full validation by default
@@ -191,7 +193,7 @@ public:
                                     bool _checkPow = true,
                                     bool _checkMerkleRoot = true)
         : excessiveBlockSize(_excessiveBlockSize), checkPoW(_checkPow),
-          checkMerkleRoot(_checkMerkleRoot) {}
+          checkMerkleRoot(_checkMerkleRoot), forceScriptChecks(false) {}
 
     BlockValidationOptions withCheckPoW(bool _checkPoW = true) const {
         BlockValidationOptions ret = *this;
@@ -206,8 +208,20 @@ public:
         return ret;
     }
 
+    /**
+     * Check the scripts even if the block is an ancestor of the -assumevalid
+     * block.
+     */
+    BlockValidationOptions
+    withForceScriptChecks(bool _forceScriptChecks = true) const {
+        BlockValidationOptions ret = *this;
+        ret.forceScriptChecks = _forceScriptChecks;
+        return ret;
+    }
+
     bool shouldValidatePoW() const { return checkPoW; }
     bool shouldValidateMerkleRoot() const { return checkMerkleRoot; }
+    bool shouldForceScriptChecks() const { return forceScriptChecks; }
     uint64_t getExcessiveBlockSize() const { return excessiveBlockSize; }
 };
 
@@ -246,6 +260,21 @@ CTransactionRef GetTransaction(const CBlockIndex *const block_index,
                                const TxId &txid,
                                const Consensus::Params &consensusParams,
                                BlockHash &hashBlock);
+/**
+ * Return several transactions, as GetTransaction does, reading the block at
+ * block_index once or looking up the transactions missing from the mempool
+ * in g_txindex together. cs_main is not held while reading from disk.
+ *
+ * @param[out] hashBlocks      For each txid, the hash of the block the tx was
+ *                             found in, if any
+ * @returns                    For each txid, the tx if found, otherwise
+ *                             nullptr
+ */
+std::vector<CTransactionRef>
+GetTransactions(const CBlockIndex *const block_index,
+                const CTxMemPool *const mempool, const std::vector<TxId> &txids,
+                const Consensus::Params &consensusParams,
+                std::vector<BlockHash> &hashBlocks);
 Amount GetBlockSubsidy(int nHeight, const Consensus::Params &consensusParams);
 
 /**
@@ -689,7 +718,7 @@ public:
     //!
     //! All arguments forwarded onto CCoinsViewDB.
     CoinsViews(std::string ldb_name, size_t cache_size_bytes, bool in_memory,
-               bool should_wipe);
+               bool should_wipe, DBEngineType engine = DBEngineType::LEVELDB);
 
     //! Initialize the CCoinsViewCache member.
     void InitCache() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
@@ -773,6 +802,7 @@ public:
      * All parameters forwarded to CoinsViews.
      */
     void InitCoinsDB(size_t cache_size_bytes, bool in_memory, bool should_wipe,
+                     DBEngineType engine = DBEngineType::LEVELDB,
                      std::string leveldb_name = "chainstate");
 
     //! Initialize the in-memory coins cache (to be done after the health of the
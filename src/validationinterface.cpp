@@ -11,12 +11,87 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <scheduler.h>
+#include <tinyformat.h>
+#include <util/threadnames.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <future>
+#include <list>
+#include <set>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
 
+namespace {
+/**
+ * The queue of the notifications of one subscriber.
+ *
+ * The lanes are serviced by the background scheduler, which interleaves them
+ * one callback at a time: a subscriber with a backlog doesn't hold up the
+ * notifications of the others behind its own. When worker threads are
+ * started, the lanes acquired afterwards are serviced by them instead, so
+ * different subscribers are notified concurrently while the callbacks of each
+ * lane still run one at a time.
+ *
+ * The configuration and the statistics are reset when the lane is reused for
+ * another subscriber, under the MainSignalsInstance mutex.
+ */
+class ValidationLane {
+private:
+    SingleThreadedSchedulerClient m_client;
+
+    Mutex m_mutex;
+    //! Notified after each callback
+    std::condition_variable m_callback_done;
+
+public:
+    std::string m_name;
+    size_t m_max_pending{DEFAULT_VALIDATION_QUEUE_SIZE};
+    ValidationQueuePolicy m_policy{ValidationQueuePolicy::WAIT};
+    std::atomic<uint64_t> m_processed{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_waits{0};
+
+    explicit ValidationLane(CScheduler *pscheduler) : m_client(pscheduler) {}
+
+    /**
+     * Queue a callback. Returns false if the callback was dropped because the
+     * queue is full, which only happens with the DROP policy unless force is
+     * set.
+     */
+    bool Add(std::function<void()> func, bool force) {
+        if (!force && m_policy == ValidationQueuePolicy::DROP &&
+            m_client.CallbacksPending() >= m_max_pending) {
+            ++m_dropped;
+            return false;
+        }
+        m_client.AddToProcessQueue([this, func = std::move(func)] {
+            func();
+            LOCK(m_mutex);
+            m_callback_done.notify_all();
+        });
+        return true;
+    }
+
+    //! Block until there are less than max_pending callbacks queued.
+    void WaitForSpace(size_t max_pending) {
+        WAIT_LOCK(m_mutex, lock);
+        if (m_client.CallbacksPending() < max_pending) {
+            return;
+        }
+        ++m_waits;
+        m_callback_done.wait(lock, [&] {
+            return m_client.CallbacksPending() < max_pending;
+        });
+    }
+
+    size_t Pending() { return m_client.CallbacksPending(); }
+    void EmptyQueue() { m_client.EmptyQueue(); }
+};
+} // namespace
+
 //! The MainSignalsInstance manages a list of shared_ptr<CValidationInterface>
 //! callbacks.
 //!
@@ -24,35 +99,148 @@
 //! registered, and a std::list is to used to store the callbacks that are
 //! currently registered as well as any callbacks that are just unregistered
 //! and about to be deleted when they are done executing.
+//!
+//! Each subscriber gets its own lane, so the notifications of a subscriber are
+//! delivered in order but independently of the other subscribers.
 struct MainSignalsInstance {
 private:
     Mutex m_mutex;
-    //! List entries consist of a callback pointer and reference count. The
-    //! count is equal to the number of current executions of that entry, plus 1
-    //! if it's registered. It cannot be 0 because that would imply it is
-    //! unregistered and also not being executed (so shouldn't exist).
+    //! List entries consist of a callback pointer, the lane of the subscriber
+    //! and a reference count. The count is equal to the number of current
+    //! executions of that entry and of its notifications waiting in the lane,
+    //! plus 1 if it's registered. It cannot be 0 because that would imply it
+    //! is unregistered and also not being executed (so shouldn't exist).
     struct ListEntry {
         std::shared_ptr<CValidationInterface> callbacks;
+        ValidationLane *lane{nullptr};
+        bool registered{true};
         int count = 1;
     };
     std::list<ListEntry> m_list GUARDED_BY(m_mutex);
     std::unordered_map<CValidationInterface *, std::list<ListEntry>::iterator>
         m_map GUARDED_BY(m_mutex);
 
+    CScheduler *m_pscheduler;
+    //! Services the lanes acquired once the worker threads are started. It is
+    //! kept until the instance is destroyed, as the lanes point to it.
+    std::unique_ptr<CScheduler> m_worker_scheduler GUARDED_BY(m_mutex);
+    std::vector<std::thread> m_worker_threads GUARDED_BY(m_mutex);
+    //! The scheduler may still hold a task processing a lane after its last
+    //! callback, so the lanes are kept until the instance is destroyed and
+    //! the lanes of the unregistered subscribers are reused.
+    std::list<ValidationLane> m_lanes GUARDED_BY(m_mutex);
+    std::vector<ValidationLane *> m_free_lanes GUARDED_BY(m_mutex);
+
+    size_t m_max_pending GUARDED_BY(m_mutex){DEFAULT_VALIDATION_QUEUE_SIZE};
+    std::set<std::string> m_drop_names GUARDED_BY(m_mutex);
+
+    ValidationLane *AcquireLane(const std::string &name, bool allow_drop)
+        EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        ValidationLane *lane;
+        if (m_free_lanes.empty()) {
+            lane = &m_lanes.emplace_back(
+                m_worker_scheduler ? m_worker_scheduler.get() : m_pscheduler);
+        } else {
+            lane = m_free_lanes.back();
+            m_free_lanes.pop_back();
+        }
+        lane->m_name = name;
+        lane->m_max_pending = m_max_pending;
+        lane->m_policy = ValidationQueuePolicy::WAIT;
+        if (m_drop_names.count(name)) {
+            if (allow_drop) {
+                lane->m_policy = ValidationQueuePolicy::DROP;
+            } else {
+                LogPrintf("The validation notifications of %s can't be "
+                          "dropped, ignoring -validationqueuedrop\n",
+                          name);
+            }
+        }
+        lane->m_processed = 0;
+        lane->m_dropped = 0;
+        lane->m_waits = 0;
+        return lane;
+    }
+
+    void Release(std::list<ListEntry>::iterator it)
+        EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        if (!--it->count) {
+            m_free_lanes.push_back(it->lane);
+            m_list.erase(it);
+        }
+    }
+
+    void Unregister(std::list<ListEntry>::iterator it)
+        EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        it->registered = false;
+        // The notifications left in the lane skip the entry, so they must not
+        // keep the subscriber alive: a wallet being unloaded waits for its
+        // last reference to be released. The callbacks being run hold their
+        // own reference.
+        it->callbacks.reset();
+        Release(it);
+    }
+
 public:
-    // We are not allowed to assume the scheduler only runs in one thread,
-    // but must ensure all callbacks happen in-order, so we end up creating
-    // our own queue here :(
+    //! Runs the functions of CallFunctionInValidationInterfaceQueue, along
+    //! with the lanes.
     SingleThreadedSchedulerClient m_schedulerClient;
 
     explicit MainSignalsInstance(CScheduler *pscheduler)
-        : m_schedulerClient(pscheduler) {}
+        : m_pscheduler(pscheduler), m_schedulerClient(pscheduler) {}
+
+    ~MainSignalsInstance() { StopWorkers(); }
+
+    void StartWorkers(int num_threads) {
+        LOCK(m_mutex);
+        assert(!m_worker_scheduler);
+        m_worker_scheduler = std::make_unique<CScheduler>();
+        // The free lanes are bound to the background scheduler.
+        m_free_lanes.clear();
+        for (int n = 0; n < num_threads; ++n) {
+            m_worker_threads.emplace_back(
+                [scheduler = m_worker_scheduler.get(), n] {
+                    util::ThreadRename(strprintf("valnotify.%i", n));
+                    scheduler->serviceQueue();
+                });
+        }
+    }
+
+    //! Stop the worker threads. The callbacks they did not run stay queued
+    //! until EmptyQueues.
+    void StopWorkers() {
+        CScheduler *scheduler;
+        std::vector<std::thread> threads;
+        {
+            LOCK(m_mutex);
+            scheduler = m_worker_scheduler.get();
+            threads.swap(m_worker_threads);
+        }
+        if (!scheduler) {
+            return;
+        }
+        // The callbacks run by the workers take m_mutex, so it can't be held
+        // while waiting for them.
+        scheduler->stop();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
 
-    void Register(std::shared_ptr<CValidationInterface> callbacks) {
+    void SetQueueOptions(size_t max_pending,
+                         const std::vector<std::string> &drop_names) {
+        LOCK(m_mutex);
+        m_max_pending = max_pending;
+        m_drop_names = {drop_names.begin(), drop_names.end()};
+    }
+
+    void Register(std::shared_ptr<CValidationInterface> callbacks,
+                  const std::string &name, bool allow_drop) {
         LOCK(m_mutex);
         auto inserted = m_map.emplace(callbacks.get(), m_list.end());
         if (inserted.second) {
             inserted.first->second = m_list.emplace(m_list.end());
+            inserted.first->second->lane = AcquireLane(name, allow_drop);
         }
         inserted.first->second->callbacks = std::move(callbacks);
     }
@@ -61,38 +249,153 @@ public:
         LOCK(m_mutex);
         auto it = m_map.find(callbacks);
         if (it != m_map.end()) {
-            if (!--it->second->count) {
-                m_list.erase(it->second);
-            }
+            Unregister(it->second);
             m_map.erase(it);
         }
     }
 
     //! Clear unregisters every previously registered callback, erasing every
     //! map entry. After this call, the list may still contain callbacks that
-    //! are currently executing, but it will be cleared when they are done
-    //! executing.
+    //! are currently executing or have notifications queued, but it will be
+    //! cleared when they are done executing.
     void Clear() {
         LOCK(m_mutex);
         for (const auto &entry : m_map) {
-            if (!--entry.second->count) {
-                m_list.erase(entry.second);
-            }
+            Unregister(entry.second);
         }
         m_map.clear();
     }
 
+    //! Call f synchronously on every registered subscriber.
     template <typename F> void Iterate(F &&f) {
         WAIT_LOCK(m_mutex, lock);
         for (auto it = m_list.begin(); it != m_list.end();) {
+            if (!it->registered) {
+                ++it;
+                continue;
+            }
             ++it->count;
+            const std::shared_ptr<CValidationInterface> callbacks =
+                it->callbacks;
             {
                 REVERSE_LOCK(lock);
-                f(*it->callbacks);
+                f(*callbacks);
+            }
+            Release(it++);
+        }
+    }
+
+    //! Queue f in the lane of every registered subscriber. It is skipped if
+    //! the subscriber is unregistered by the time the lane gets to it.
+    template <typename F> void Enqueue(const F &f) {
+        LOCK(m_mutex);
+        for (const auto &entry : m_map) {
+            const auto it = entry.second;
+            ValidationLane *lane = it->lane;
+            ++it->count;
+            const bool queued = lane->Add(
+                [this, it, lane, f] {
+                    std::shared_ptr<CValidationInterface> callbacks;
+                    {
+                        LOCK(m_mutex);
+                        if (it->registered) {
+                            callbacks = it->callbacks;
+                        }
+                    }
+                    if (callbacks) {
+                        f(*callbacks);
+                        ++lane->m_processed;
+                    }
+                    LOCK(m_mutex);
+                    Release(it);
+                },
+                /* force */ false);
+            if (!queued) {
+                Release(it);
             }
-            it = --it->count ? std::next(it) : m_list.erase(it);
         }
     }
+
+    //! Call func once every callback queued so far in any lane is done.
+    void AddBarrier(std::function<void()> func) {
+        LOCK(m_mutex);
+        auto remaining =
+            std::make_shared<std::atomic<size_t>>(m_lanes.size() + 1);
+        auto barrier = [remaining,
+                        shared_func = std::make_shared<std::function<void()>>(
+                            std::move(func))] {
+            if (--*remaining == 0) {
+                (*shared_func)();
+            }
+        };
+        m_schedulerClient.AddToProcessQueue(barrier);
+        for (ValidationLane &lane : m_lanes) {
+            lane.Add(barrier, /* force */ true);
+        }
+    }
+
+    //! Block until the lanes of the subscribers with the WAIT policy are below
+    //! their bound.
+    void WaitForQueues() {
+        std::vector<std::pair<ValidationLane *, size_t>> full_lanes;
+        {
+            LOCK(m_mutex);
+            for (const auto &entry : m_map) {
+                ValidationLane *lane = entry.second->lane;
+                if (lane->m_policy == ValidationQueuePolicy::WAIT &&
+                    lane->Pending() >= lane->m_max_pending) {
+                    full_lanes.emplace_back(lane, lane->m_max_pending);
+                }
+            }
+        }
+        for (const auto &[lane, max_pending] : full_lanes) {
+            lane->WaitForSpace(max_pending);
+        }
+    }
+
+    std::vector<ValidationQueueInfo> GetQueueInfo() {
+        LOCK(m_mutex);
+        std::vector<ValidationQueueInfo> infos;
+        for (const ListEntry &entry : m_list) {
+            if (!entry.registered) {
+                continue;
+            }
+            const ValidationLane &lane = *entry.lane;
+            infos.push_back({lane.m_name, entry.lane->Pending(),
+                             lane.m_max_pending, lane.m_policy,
+                             lane.m_processed, lane.m_dropped, lane.m_waits});
+        }
+        return infos;
+    }
+
+    size_t CallbacksPending() {
+        LOCK(m_mutex);
+        size_t pending = m_schedulerClient.CallbacksPending();
+        for (ValidationLane &lane : m_lanes) {
+            pending += lane.Pending();
+        }
+        return pending;
+    }
+
+    //! Process the queued callbacks on the calling thread, the background
+    //! scheduler must have been stopped.
+    void EmptyQueues() {
+        StopWorkers();
+        std::vector<ValidationLane *> lanes;
+        do {
+            m_schedulerClient.EmptyQueue();
+            lanes.clear();
+            {
+                LOCK(m_mutex);
+                for (ValidationLane &lane : m_lanes) {
+                    lanes.push_back(&lane);
+                }
+            }
+            for (ValidationLane *lane : lanes) {
+                lane->EmptyQueue();
+            }
+        } while (CallbacksPending() > 0);
+    }
 };
 
 static CMainSignals g_signals;
@@ -108,7 +411,17 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 
 void CMainSignals::FlushBackgroundCallbacks() {
     if (m_internals) {
-        m_internals->m_schedulerClient.EmptyQueue();
+        m_internals->EmptyQueues();
+    }
+}
+
+void CMainSignals::StartWorkerThreads(int num_threads) {
+    m_internals->StartWorkers(num_threads);
+}
+
+void CMainSignals::StopWorkerThreads() {
+    if (m_internals) {
+        m_internals->StopWorkers();
     }
 }
 
@@ -116,7 +429,19 @@ size_t CMainSignals::CallbacksPending() {
     if (!m_internals) {
         return 0;
     }
-    return m_internals->m_schedulerClient.CallbacksPending();
+    return m_internals->CallbacksPending();
+}
+
+void CMainSignals::SetQueueOptions(size_t max_pending,
+                                   const std::vector<std::string> &drop_names) {
+    m_internals->SetQueueOptions(max_pending, drop_names);
+}
+
+std::vector<ValidationQueueInfo> CMainSignals::GetQueueInfo() {
+    if (!m_internals) {
+        return {};
+    }
+    return m_internals->GetQueueInfo();
 }
 
 CMainSignals &GetMainSignals() {
@@ -124,17 +449,19 @@ CMainSignals &GetMainSignals() {
 }
 
 void RegisterSharedValidationInterface(
-    std::shared_ptr<CValidationInterface> callbacks) {
+    std::shared_ptr<CValidationInterface> callbacks, const std::string &name,
+    bool allow_drop) {
     // Each connection captures the shared_ptr to ensure that each callback is
     // executed before the subscriber is destroyed. For more details see #18338.
-    g_signals.m_internals->Register(std::move(callbacks));
+    g_signals.m_internals->Register(std::move(callbacks), name, allow_drop);
 }
 
-void RegisterValidationInterface(CValidationInterface *callbacks) {
+void RegisterValidationInterface(CValidationInterface *callbacks,
+                                 const std::string &name, bool allow_drop) {
     // Create a shared_ptr with a no-op deleter - CValidationInterface lifecycle
     // is managed by the caller.
     RegisterSharedValidationInterface(
-        {callbacks, [](CValidationInterface *) {}});
+        {callbacks, [](CValidationInterface *) {}}, name, allow_drop);
 }
 
 void UnregisterSharedValidationInterface(
@@ -156,7 +483,7 @@ void UnregisterAllValidationInterfaces() {
 }
 
 void CallFunctionInValidationInterfaceQueue(std::function<void()> func) {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    g_signals.m_internals->AddBarrier(std::move(func));
 }
 
 void SyncWithValidationInterfaceQueue() {
@@ -167,6 +494,13 @@ void SyncWithValidationInterfaceQueue() {
     promise.get_future().wait();
 }
 
+void LimitValidationInterfaceQueue() {
+    AssertLockNotHeld(cs_main);
+    if (g_signals.m_internals) {
+        g_signals.m_internals->WaitForQueues();
+    }
+}
+
 // Use a macro instead of a function for conditional logging to prevent
 // evaluating arguments when logging is not enabled.
 //
@@ -175,9 +509,9 @@ void SyncWithValidationInterfaceQueue() {
     do {                                                                       \
         auto local_name = (name);                                              \
         LOG_EVENT("Enqueuing " fmt, local_name, __VA_ARGS__);                  \
-        m_internals->m_schedulerClient.AddToProcessQueue([=] {                 \
+        m_internals->Enqueue([=](CValidationInterface &callbacks) {            \
             LOG_EVENT(fmt, local_name, __VA_ARGS__);                           \
-            event();                                                           \
+            event(callbacks);                                                  \
         });                                                                    \
     } while (0)
 
@@ -191,10 +525,9 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew,
     // for the caller to invoke this signal in the same critical section where
     // the chain is updated
 
-    auto event = [pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->Iterate([&](CValidationInterface &callbacks) {
-            callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
-        });
+    auto event = [pindexNew, pindexFork,
+                  fInitialDownload](CValidationInterface &callbacks) {
+        callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     };
     ENQUEUE_AND_LOG_EVENT(
         event, "%s: new block hash=%s fork block hash=%s (in IBD=%s)", __func__,
@@ -205,10 +538,8 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew,
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &tx,
                                              uint64_t mempool_sequence) {
-    auto event = [tx, mempool_sequence, this] {
-        m_internals->Iterate([&](CValidationInterface &callbacks) {
-            callbacks.TransactionAddedToMempool(tx, mempool_sequence);
-        });
+    auto event = [tx, mempool_sequence](CValidationInterface &callbacks) {
+        callbacks.TransactionAddedToMempool(tx, mempool_sequence);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: txid=%s", __func__,
                           tx->GetHash().ToString());
@@ -217,11 +548,9 @@ void CMainSignals::TransactionAddedToMempool(const CTransactionRef &tx,
 void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef &tx,
                                                  MemPoolRemovalReason reason,
                                                  uint64_t mempool_sequence) {
-    auto event = [tx, reason, mempool_sequence, this] {
-        m_internals->Iterate([&](CValidationInterface &callbacks) {
-            callbacks.TransactionRemovedFromMempool(tx, reason,
-                                                    mempool_sequence);
-        });
+    auto event = [tx, reason,
+                  mempool_sequence](CValidationInterface &callbacks) {
+        callbacks.TransactionRemovedFromMempool(tx, reason, mempool_sequence);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: txid=%s", __func__,
                           tx->GetHash().ToString());
@@ -229,10 +558,8 @@ void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef &tx,
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock,
                                   const CBlockIndex *pindex) {
-    auto event = [pblock, pindex, this] {
-        m_internals->Iterate([&](CValidationInterface &callbacks) {
-            callbacks.BlockConnected(pblock, pindex);
-        });
+    auto event = [pblock, pindex](CValidationInterface &callbacks) {
+        callbacks.BlockConnected(pblock, pindex);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s block height=%d", __func__,
                           pblock->GetHash().ToString(), pindex->nHeight);
@@ -240,20 +567,16 @@ void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock,
 
 void CMainSignals::BlockDisconnected(
     const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
-    auto event = [pblock, pindex, this] {
-        m_internals->Iterate([&](CValidationInterface &callbacks) {
-            callbacks.BlockDisconnected(pblock, pindex);
-        });
+    auto event = [pblock, pindex](CValidationInterface &callbacks) {
+        callbacks.BlockDisconnected(pblock, pindex);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s", __func__,
                           pblock->GetHash().ToString());
 }
 
 void CMainSignals::ChainStateFlushed(const CBlockLocator &locator) {
-    auto event = [locator, this] {
-        m_internals->Iterate([&](CValidationInterface &callbacks) {
-            callbacks.ChainStateFlushed(locator);
-        });
+    auto event = [locator](CValidationInterface &callbacks) {
+        callbacks.ChainStateFlushed(locator);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s", __func__,
                           locator.IsNull() ? "null"
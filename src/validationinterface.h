@@ -9,8 +9,11 @@
 #include <primitives/transaction.h> // CTransaction(Ref)
 #include <sync.h>
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 extern RecursiveMutex cs_main;
 class BlockValidationState;
@@ -23,8 +26,44 @@ class uint256;
 class CScheduler;
 enum class MemPoolRemovalReason;
 
-/** Register subscriber */
-void RegisterValidationInterface(CValidationInterface *callbacks);
+/** Default for -validationqueuesize */
+static constexpr size_t DEFAULT_VALIDATION_QUEUE_SIZE = 10;
+
+/** Default for -validationthreads, 0 delivers on the background scheduler */
+static constexpr int DEFAULT_VALIDATION_THREADS = 0;
+/** Maximum number of validation notification worker threads */
+static constexpr int MAX_VALIDATION_THREADS = 16;
+
+/** What happens to the notifications of a subscriber whose queue is full. */
+enum class ValidationQueuePolicy {
+    //! LimitValidationInterfaceQueue waits for the subscriber to catch up
+    WAIT,
+    //! New notifications are dropped
+    DROP,
+};
+
+/** State of the notification queue of a subscriber. */
+struct ValidationQueueInfo {
+    std::string name;
+    size_t pending;
+    size_t max_pending;
+    ValidationQueuePolicy policy;
+    //! Notifications delivered to the subscriber
+    uint64_t processed;
+    uint64_t dropped;
+    //! Number of times LimitValidationInterfaceQueue waited for the queue
+    uint64_t waits;
+};
+
+/**
+ * Register subscriber. The name identifies its notification queue in
+ * getvalidationqueueinfo and -validationqueuedrop. A subscriber which must see
+ * every notification to stay consistent, like an index, is registered with
+ * allow_drop set to false and always uses the WAIT policy.
+ */
+void RegisterValidationInterface(CValidationInterface *callbacks,
+                                 const std::string &name = "unnamed",
+                                 bool allow_drop = true);
 /**
  * Unregister subscriber. DEPRECATED. This is not safe to use when the RPC
  * server or main message handler thread is running.
@@ -39,7 +78,8 @@ void UnregisterAllValidationInterfaces();
 // processed.
 /** Register subscriber */
 void RegisterSharedValidationInterface(
-    std::shared_ptr<CValidationInterface> callbacks);
+    std::shared_ptr<CValidationInterface> callbacks,
+    const std::string &name = "unnamed", bool allow_drop = true);
 /** Unregister subscriber */
 void UnregisterSharedValidationInterface(
     std::shared_ptr<CValidationInterface> callbacks);
@@ -65,6 +105,14 @@ void CallFunctionInValidationInterfaceQueue(std::function<void()> func);
  */
 void SyncWithValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main);
 
+/**
+ * Block until the notification queue of every subscriber with the WAIT policy
+ * has less notifications pending than its bound. This is how producers of
+ * notifications are slowed down to the pace of the subscribers, it must be
+ * called without holding any lock the subscribers may need.
+ */
+void LimitValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main);
+
 /**
  * Implement this to subscribe to events generated in validation
  *
@@ -72,13 +120,15 @@ void SyncWithValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main);
  * in the order in which the events were generated by validation.
  * Furthermore, each ValidationInterface() subscriber may assume that
  * callbacks effectively run in a single thread with single-threaded
- * memory consistency. That is, for a given ValidationInterface()
- * instantiation, each callback will complete before the next one is
- * invoked. This means, for example when a block is connected that the
- * UpdatedBlockTip() callback may depend on an operation performed in
- * the BlockConnected() callback without worrying about explicit
- * synchronization. No ordering should be assumed across
- * ValidationInterface() subscribers.
+ * memory consistency, even though they may run on different threads.
+ * That is, for a given ValidationInterface() instantiation, each callback
+ * will complete before the next one is invoked. This means, for example
+ * when a block is connected that the UpdatedBlockTip() callback may depend
+ * on an operation performed in the BlockConnected() callback without
+ * worrying about explicit synchronization. No ordering should be assumed
+ * across ValidationInterface() subscribers: each one has its own queue of
+ * notifications, and with -validationthreads the callbacks of different
+ * subscribers run concurrently.
  */
 class CValidationInterface {
 protected:
@@ -198,11 +248,12 @@ private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
     friend void ::RegisterSharedValidationInterface(
-        std::shared_ptr<CValidationInterface>);
+        std::shared_ptr<CValidationInterface>, const std::string &, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface *);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(
         std::function<void()> func);
+    friend void ::LimitValidationInterfaceQueue();
 
 public:
     /**
@@ -215,11 +266,33 @@ public:
      * background - these callbacks will now be dropped!
      */
     void UnregisterBackgroundSignalScheduler();
-    /** Call any remaining callbacks on the calling thread */
+    /**
+     * Deliver the notifications of the subscribers registered afterwards on
+     * num_threads worker threads instead of the background scheduler. The
+     * notifications of a subscriber are still delivered in order and one at a
+     * time, but several subscribers are notified concurrently.
+     */
+    void StartWorkerThreads(int num_threads);
+    /** Stop the worker threads, their remaining callbacks stay queued */
+    void StopWorkerThreads();
+    /**
+     * Call any remaining callbacks on the calling thread, after stopping the
+     * worker threads
+     */
     void FlushBackgroundCallbacks();
 
     size_t CallbacksPending();
 
+    /**
+     * Set the bound of the notification queues and the names of the
+     * subscribers whose notifications are dropped when their queue is full.
+     * Applies to the subscribers registered afterwards, the subscribers which
+     * don't allow their notifications to be dropped keep waiting.
+     */
+    void SetQueueOptions(size_t max_pending,
+                         const std::vector<std::string> &drop_names);
+    std::vector<ValidationQueueInfo> GetQueueInfo();
+
     void UpdatedBlockTip(const CBlockIndex *, const CBlockIndex *,
                          bool fInitialDownload);
     void TransactionAddedToMempool(const CTransactionRef &,
@@ -0,0 +1,99 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/blockscripts.h>
+
+#include <crypto/siphash.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <sync.h>
+
+#include <deque>
+#include <unordered_map>
+
+/**
+ * Number of blocks whose scripts are cached. The wallets lag behind each other
+ * by at most their notification queue, so this covers most of them.
+ */
+static constexpr size_t BLOCK_SCRIPTS_CACHE_SIZE = 16;
+
+namespace {
+class ScriptPtrHasher {
+private:
+    const uint64_t k0, k1;
+
+public:
+    ScriptPtrHasher()
+        : k0(GetRand(std::numeric_limits<uint64_t>::max())),
+          k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CScript *script) const {
+        return CSipHasher(k0, k1)
+            .Write(script->data(), script->size())
+            .Finalize();
+    }
+};
+
+struct ScriptPtrEqual {
+    bool operator()(const CScript *a, const CScript *b) const {
+        return *a == *b;
+    }
+};
+} // namespace
+
+BlockScripts::BlockScripts(const CBlock &block)
+    : m_block_hash(block.GetHash()) {
+    size_t num_outputs = 0;
+    for (const CTransactionRef &tx : block.vtx) {
+        num_outputs += tx->vout.size();
+    }
+
+    std::unordered_map<const CScript *, uint32_t, ScriptPtrHasher,
+                       ScriptPtrEqual>
+        scripts;
+    scripts.reserve(num_outputs);
+    m_output_scripts.reserve(num_outputs);
+    m_tx_offsets.reserve(block.vtx.size() + 1);
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        m_tx_offsets.push_back(m_output_scripts.size());
+        const std::vector<CTxOut> &vout = block.vtx[i]->vout;
+        for (size_t n = 0; n < vout.size(); ++n) {
+            const auto inserted =
+                scripts.emplace(&vout[n].scriptPubKey, m_first_outputs.size());
+            if (inserted.second) {
+                m_first_outputs.emplace_back(i, n);
+            }
+            m_output_scripts.push_back(inserted.first->second);
+        }
+    }
+    m_tx_offsets.push_back(m_output_scripts.size());
+}
+
+const CScript &BlockScripts::GetScript(const CBlock &block,
+                                       uint32_t script) const {
+    const auto &[tx_index, n] = m_first_outputs[script];
+    return block.vtx[tx_index]->vout[n].scriptPubKey;
+}
+
+std::shared_ptr<const BlockScripts> GetBlockScripts(const CBlock &block) {
+    static Mutex mutex;
+    static std::deque<std::shared_ptr<const BlockScripts>> cache
+        GUARDED_BY(mutex);
+
+    const BlockHash block_hash = block.GetHash();
+    // The lock is held while the scripts are computed, so the wallets notified
+    // of the same block concurrently wait for them instead of duplicating the
+    // work.
+    LOCK(mutex);
+    for (const auto &scripts : cache) {
+        if (scripts->GetBlockHash() == block_hash) {
+            return scripts;
+        }
+    }
+    cache.push_front(std::make_shared<const BlockScripts>(block));
+    if (cache.size() > BLOCK_SCRIPTS_CACHE_SIZE) {
+        cache.pop_back();
+    }
+    return cache.front();
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2021 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_BLOCKSCRIPTS_H
+#define BITCOIN_WALLET_BLOCKSCRIPTS_H
+
+#include <primitives/blockhash.h>
+#include <span.h>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class CBlock;
+class CScript;
+
+/**
+ * The distinct output scripts of a block.
+ *
+ * It is computed once per block and shared by all the wallets processing the
+ * block, so that each wallet checks whether a script is its own once rather
+ * than once per output paying it. It only holds positions in the block, which
+ * must be passed along to get the scripts back.
+ */
+class BlockScripts {
+private:
+    BlockHash m_block_hash;
+    //! The transaction and output indexes of the first output paying each
+    //! script
+    std::vector<std::pair<uint32_t, uint32_t>> m_first_outputs;
+    //! The script of each output of the block, in order
+    std::vector<uint32_t> m_output_scripts;
+    //! The offset of the outputs of each transaction in m_output_scripts,
+    //! followed by the total number of outputs
+    std::vector<size_t> m_tx_offsets;
+
+public:
+    explicit BlockScripts(const CBlock &block);
+
+    const BlockHash &GetBlockHash() const { return m_block_hash; }
+    size_t GetScriptCount() const { return m_first_outputs.size(); }
+
+    /** The script of the given index, block being the one it was built from */
+    const CScript &GetScript(const CBlock &block, uint32_t script) const;
+
+    /** The script indexes of the outputs of the transaction */
+    Span<const uint32_t> GetOutputScripts(size_t tx_index) const {
+        return Span<const uint32_t>(m_output_scripts)
+            .subspan(m_tx_offsets[tx_index],
+                     m_tx_offsets[tx_index + 1] - m_tx_offsets[tx_index]);
+    }
+};
+
+/**
+ * Return the BlockScripts of the block. The most recent blocks are cached, so
+ * the wallets notified of the same block share the same instance.
+ */
+std::shared_ptr<const BlockScripts> GetBlockScripts(const CBlock &block);
+
+#endif // BITCOIN_WALLET_BLOCKSCRIPTS_H
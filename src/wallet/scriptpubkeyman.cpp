@@ -4,8 +4,10 @@
 
 #include <chainparams.h>
 #include <config.h>
+#include <crypto/siphash.h>
 #include <key_io.h>
 #include <outputtype.h>
+#include <random.h>
 #include <script/descriptor.h>
 #include <script/sign.h>
 #include <util/bip32.h>
@@ -18,6 +20,16 @@
 //! and as a value. See BIP 32 for more details.
 const uint32_t BIP32_HARDENED_KEY_LIMIT = 0x80000000;
 
+ScriptPubKeyFilter::ScriptPubKeyFilter()
+    : m_k0(GetRand(std::numeric_limits<uint64_t>::max())),
+      m_k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+uint64_t ScriptPubKeyFilter::Hash(const CScript &script) const {
+    return CSipHasher(m_k0, m_k1)
+        .Write(script.data(), script.size())
+        .Finalize();
+}
+
 bool LegacyScriptPubKeyMan::GetNewDestination(const OutputType type,
                                               CTxDestination &dest,
                                               std::string &error) {
@@ -155,6 +167,9 @@ IsMineResult IsMineInner(const LegacyScriptPubKeyMan &keystore,
 } // namespace
 
 isminetype LegacyScriptPubKeyMan::IsMine(const CScript &script) const {
+    if (!WITH_LOCK(cs_KeyStore, return m_mine_filter.MayContain(script))) {
+        return ISMINE_NO;
+    }
     switch (IsMineInner(*this, script, IsMineSigVersion::TOP)) {
         case IsMineResult::INVALID:
         case IsMineResult::NO:
@@ -718,7 +733,12 @@ bool LegacyScriptPubKeyMan::LoadCScript(const CScript &redeemScript) {
         return true;
     }
 
-    return FillableSigningProvider::AddCScript(redeemScript);
+    if (!FillableSigningProvider::AddCScript(redeemScript)) {
+        return false;
+    }
+    WITH_LOCK(cs_KeyStore, m_mine_filter.insert(GetScriptForDestination(
+                               ScriptHash(redeemScript))));
+    return true;
 }
 
 void LegacyScriptPubKeyMan::LoadKeyMetadata(const CKeyID &keyID,
@@ -739,7 +759,11 @@ bool LegacyScriptPubKeyMan::AddKeyPubKeyInner(const CKey &key,
                                               const CPubKey &pubkey) {
     LOCK(cs_KeyStore);
     if (!m_storage.HasEncryptionKeys()) {
-        return FillableSigningProvider::AddKeyPubKey(key, pubkey);
+        if (!FillableSigningProvider::AddKeyPubKey(key, pubkey)) {
+            return false;
+        }
+        AddKeyToMineFilter(pubkey);
+        return true;
     }
 
     if (m_storage.IsLocked()) {
@@ -776,9 +800,16 @@ bool LegacyScriptPubKeyMan::AddCryptedKeyInner(
     assert(mapKeys.empty());
 
     mapCryptedKeys[vchPubKey.GetID()] = make_pair(vchPubKey, vchCryptedSecret);
+    AddKeyToMineFilter(vchPubKey);
     return true;
 }
 
+void LegacyScriptPubKeyMan::AddKeyToMineFilter(const CPubKey &pubkey) {
+    AssertLockHeld(cs_KeyStore);
+    m_mine_filter.insert(GetScriptForRawPubKey(pubkey));
+    m_mine_filter.insert(GetScriptForDestination(PKHash(pubkey)));
+}
+
 bool LegacyScriptPubKeyMan::AddCryptedKey(
     const CPubKey &vchPubKey, const std::vector<uint8_t> &vchCryptedSecret) {
     if (!AddCryptedKeyInner(vchPubKey, vchCryptedSecret)) {
@@ -836,6 +867,7 @@ bool LegacyScriptPubKeyMan::LoadWatchOnly(const CScript &dest) {
 bool LegacyScriptPubKeyMan::AddWatchOnlyInMem(const CScript &dest) {
     LOCK(cs_KeyStore);
     setWatchOnly.insert(dest);
+    m_mine_filter.insert(dest);
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey)) {
         mapWatchKeys[pubKey.GetID()] = pubKey;
@@ -1487,6 +1519,8 @@ bool LegacyScriptPubKeyMan::AddCScriptWithDB(WalletBatch &batch,
     if (!FillableSigningProvider::AddCScript(redeemScript)) {
         return false;
     }
+    WITH_LOCK(cs_KeyStore, m_mine_filter.insert(GetScriptForDestination(
+                               ScriptHash(redeemScript))));
     if (batch.WriteCScript(Hash160(redeemScript), redeemScript)) {
         m_storage.UnsetBlankWalletFlag(batch);
         return true;
@@ -1680,7 +1714,8 @@ bool DescriptorScriptPubKeyMan::GetNewDestination(const OutputType type,
 
 isminetype DescriptorScriptPubKeyMan::IsMine(const CScript &script) const {
     LOCK(cs_desc_man);
-    if (m_map_script_pub_keys.count(script) > 0) {
+    if (m_script_pub_key_filter.MayContain(script) &&
+        m_map_script_pub_keys.count(script) > 0) {
         return ISMINE_SPENDABLE;
     }
     return ISMINE_NO;
@@ -1830,6 +1865,7 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size) {
         // Add all of the scriptPubKeys to the scriptPubKey set
         for (const CScript &script : scripts_temp) {
             m_map_script_pub_keys[script] = i;
+            m_script_pub_key_filter.insert(script);
         }
         for (const auto &pk_pair : out_keys.pubkeys) {
             const CPubKey &pubkey = pk_pair.second;
@@ -2285,6 +2321,7 @@ void DescriptorScriptPubKeyMan::SetCache(const DescriptorCache &cache) {
                               i, m_map_script_pub_keys[script]));
             }
             m_map_script_pub_keys[script] = i;
+            m_script_pub_key_filter.insert(script);
         }
         for (const auto &pk_pair : out_keys.pubkeys) {
             const CPubKey &pubkey = pk_pair.second;
@@ -19,6 +19,7 @@
 #include <boost/signals2/signal.hpp>
 
 #include <unordered_map>
+#include <unordered_set>
 
 enum class OutputType;
 class CChainParams;
@@ -163,6 +164,29 @@ public:
     size_t operator()(const CKeyID &id) const { return id.GetUint64(0); }
 };
 
+/**
+ * The salted 64 bits hashes of a set of scriptPubKeys. It tells in constant
+ * time that a script is not in the set, so most scripts that are not ours are
+ * rejected before the full IsMine logic. A match may be a hash collision and
+ * must be confirmed by that logic.
+ */
+class ScriptPubKeyFilter {
+private:
+    const uint64_t m_k0, m_k1;
+    std::unordered_set<uint64_t> m_hashes;
+
+    uint64_t Hash(const CScript &script) const;
+
+public:
+    ScriptPubKeyFilter();
+
+    void insert(const CScript &script) { m_hashes.insert(Hash(script)); }
+    bool MayContain(const CScript &script) const {
+        return m_hashes.count(Hash(script)) > 0;
+    }
+    size_t size() const { return m_hashes.size(); }
+};
+
 /**
  * A class implementing ScriptPubKeyMan manages some (or all) scriptPubKeys used
  * in a wallet. It contains the scripts and keys related to the scriptPubKeys it
@@ -335,6 +359,13 @@ private:
     WatchOnlySet setWatchOnly GUARDED_BY(cs_KeyStore);
     WatchKeyMap mapWatchKeys GUARDED_BY(cs_KeyStore);
 
+    //! The scripts IsMine may consider ours: the P2PK and P2PKH scripts of the
+    //! keys, the P2SH scripts of the redeem scripts and the watch-only
+    //! scripts. The watch-only scripts that are removed are kept.
+    ScriptPubKeyFilter m_mine_filter GUARDED_BY(cs_KeyStore);
+    void AddKeyToMineFilter(const CPubKey &pubkey)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_KeyStore);
+
     int64_t nTimeFirstKey GUARDED_BY(cs_KeyStore) = 0;
 
     bool AddKeyPubKeyInner(const CKey &key, const CPubKey &pubkey);
@@ -667,6 +698,8 @@ private:
     using KeyMap = std::map<CKeyID, CKey>;
 
     ScriptPubKeyMap m_map_script_pub_keys GUARDED_BY(cs_desc_man);
+    //! The scripts of m_map_script_pub_keys, checked by IsMine first
+    ScriptPubKeyFilter m_script_pub_key_filter GUARDED_BY(cs_desc_man);
     PubKeyMap m_map_pubkeys GUARDED_BY(cs_desc_man);
     int32_t m_max_cached_index = -1;
 
@@ -41,4 +41,56 @@ BOOST_AUTO_TEST_CASE(CanProvide) {
     BOOST_CHECK(keyman.CanProvide(p2sh_script, data));
 }
 
+BOOST_AUTO_TEST_CASE(script_pub_key_filter) {
+    ScriptPubKeyFilter filter;
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript p2pkh = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const CScript p2pk = GetScriptForRawPubKey(key.GetPubKey());
+
+    BOOST_CHECK(!filter.MayContain(p2pkh));
+    filter.insert(p2pkh);
+    filter.insert(p2pkh);
+    BOOST_CHECK_EQUAL(filter.size(), 1U);
+    BOOST_CHECK(filter.MayContain(p2pkh));
+    BOOST_CHECK(!filter.MayContain(p2pk));
+    BOOST_CHECK(!filter.MayContain(CScript()));
+}
+
+// The scripts of the keys, redeem scripts and watch-only scripts loaded from
+// the database are known to IsMine, not only the ones added at runtime.
+BOOST_AUTO_TEST_CASE(IsMineLoaded) {
+    NodeContext node;
+    std::unique_ptr<interfaces::Chain> chain =
+        interfaces::MakeChain(node, Params());
+    CWallet wallet(chain.get(), "", CreateDummyWalletDatabase());
+    LegacyScriptPubKeyMan &keyman = *wallet.GetOrCreateLegacyScriptPubKeyMan();
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+    const CScript p2pkh = GetScriptForDestination(PKHash(pubkey));
+    const CScript p2pk = GetScriptForRawPubKey(pubkey);
+    const CScript p2sh = GetScriptForDestination(ScriptHash(p2pkh));
+    const CScript watched = CScript() << OP_1 << OP_DROP << OP_TRUE;
+
+    BOOST_CHECK_EQUAL(keyman.IsMine(p2pkh), ISMINE_NO);
+    BOOST_CHECK_EQUAL(keyman.IsMine(p2pk), ISMINE_NO);
+    BOOST_CHECK(keyman.LoadKey(key, pubkey));
+    BOOST_CHECK_EQUAL(keyman.IsMine(p2pkh), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(keyman.IsMine(p2pk), ISMINE_SPENDABLE);
+
+    BOOST_CHECK_EQUAL(keyman.IsMine(p2sh), ISMINE_NO);
+    BOOST_CHECK(keyman.LoadCScript(p2pkh));
+    BOOST_CHECK_EQUAL(keyman.IsMine(p2sh), ISMINE_SPENDABLE);
+
+    BOOST_CHECK_EQUAL(keyman.IsMine(watched), ISMINE_NO);
+    BOOST_CHECK(keyman.LoadWatchOnly(watched));
+    BOOST_CHECK_EQUAL(keyman.IsMine(watched), ISMINE_WATCH_ONLY);
+
+    // Bare multisig is never ours, even when all the keys are.
+    BOOST_CHECK_EQUAL(keyman.IsMine(GetScriptForMultisig(1, {pubkey})),
+                      ISMINE_NO);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
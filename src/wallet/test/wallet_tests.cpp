@@ -27,6 +27,7 @@
 #include <cstdint>
 #include <future>
 #include <memory>
+#include <set>
 #include <vector>
 
 extern RecursiveMutex cs_wallets;
@@ -815,11 +816,13 @@ BOOST_FIXTURE_TEST_CASE(CreateWallet, TestChain100Setup) {
         BOOST_CHECK_EQUAL(wallet->mapWallet.count(mempool_tx.GetId()), 1U);
     }
 
-    // Unblock notification queue and make sure stale blockConnected and
-    // transactionAddedToMempool events are processed
+    // Unblock notification queue. The stale blockConnected and
+    // transactionAddedToMempool events were queued for the subscribers
+    // registered when they were sent, so they are not delivered to the
+    // reloaded wallet which already found the transactions when loading.
     promise.set_value();
     SyncWithValidationInterfaceQueue();
-    BOOST_CHECK_EQUAL(addtx_count, 4);
+    BOOST_CHECK_EQUAL(addtx_count, 2);
 
     TestUnloadWallet(std::move(wallet));
 
@@ -870,6 +873,65 @@ BOOST_FIXTURE_TEST_CASE(CreateWallet, TestChain100Setup) {
     TestUnloadWallet(std::move(wallet));
 }
 
+// The wallet only syncs the transactions of a connected block which pay one
+// of its scripts or spend one of its outputs.
+BOOST_FIXTURE_TEST_CASE(block_connected_involved_txs, TestChain100Setup) {
+    auto chain = interfaces::MakeChain(m_node, Params());
+    auto wallet = TestLoadWallet(*chain);
+    CKey key;
+    key.MakeNewKey(true);
+    AddKey(*wallet, key);
+    const CScript our_script = GetScriptForRawPubKey(key.GetPubKey());
+    const CScript other_script =
+        GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // Mature the second coinbase.
+    CreateAndProcessBlock({}, other_script);
+
+    const CMutableTransaction to_other =
+        TestSimpleSpend(*m_coinbase_txns[0], 0, coinbaseKey, other_script);
+    CMutableTransaction to_us =
+        TestSimpleSpend(*m_coinbase_txns[1], 0, coinbaseKey, our_script);
+    const CBlock block = CreateAndProcessBlock({to_other, to_us}, other_script);
+    // The transactions of a block are sorted by txid, so the spend of to_us is
+    // mined in the next block to make sure the wallet knows its parent.
+    const CMutableTransaction from_us =
+        TestSimpleSpend(CTransaction(to_us), 0, key, other_script);
+    CreateAndProcessBlock({from_us}, other_script);
+    SyncWithValidationInterfaceQueue();
+
+    {
+        LOCK(wallet->cs_wallet);
+        BOOST_CHECK_EQUAL(wallet->mapWallet.count(to_other.GetId()), 0U);
+        BOOST_CHECK_EQUAL(wallet->mapWallet.count(to_us.GetId()), 1U);
+        BOOST_CHECK_EQUAL(wallet->mapWallet.count(from_us.GetId()), 1U);
+        BOOST_CHECK_EQUAL(wallet->mapWallet.count(block.vtx[0]->GetId()), 0U);
+    }
+
+    // The coinbase and the transactions paying the other script share it.
+    const auto scripts = GetBlockScripts(block);
+    BOOST_CHECK(scripts == GetBlockScripts(block));
+    std::set<CScript> distinct_scripts;
+    for (const CTransactionRef &tx : block.vtx) {
+        for (const CTxOut &txout : tx->vout) {
+            distinct_scripts.insert(txout.scriptPubKey);
+        }
+    }
+    BOOST_CHECK(distinct_scripts.count(other_script));
+    BOOST_CHECK(distinct_scripts.count(our_script));
+    BOOST_CHECK_EQUAL(scripts->GetScriptCount(), distinct_scripts.size());
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const Span<const uint32_t> outputs = scripts->GetOutputScripts(i);
+        BOOST_REQUIRE_EQUAL(outputs.size(), block.vtx[i]->vout.size());
+        for (size_t n = 0; n < outputs.size(); ++n) {
+            BOOST_CHECK(scripts->GetScript(block, outputs[n]) ==
+                        block.vtx[i]->vout[n].scriptPubKey);
+        }
+    }
+
+    TestUnloadWallet(std::move(wallet));
+}
+
 BOOST_FIXTURE_TEST_CASE(ZapSelectTx, TestChain100Setup) {
     auto chain = interfaces::MakeChain(m_node, Params());
     auto wallet = TestLoadWallet(*chain);
@@ -6,7 +6,10 @@
 
 #include <chainparams.h>
 #include <interfaces/chain.h>
+#include <key.h>
 #include <node/context.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
 #include <wallet/wallet.h>
 
 #include <test/util/setup_common.h>
@@ -128,4 +131,47 @@ BOOST_AUTO_TEST_CASE(no_dest_fails) {
     BOOST_CHECK(!batch.WriteDestData(dst, "key", "value"));
 }
 
+BOOST_AUTO_TEST_CASE(load_preloaded_records) {
+    WalletBatch batch(m_wallet.GetDBHandle());
+
+    // Enough transactions and keys to be preloaded on several threads.
+    std::vector<TxId> txids;
+    std::vector<CPubKey> pubkeys;
+    for (size_t i = 0; i < 2 * WALLET_LOAD_MIN_RECORDS_PER_THREAD; ++i) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(COutPoint(TxId(InsecureRand256()), 0));
+        mtx.vout.emplace_back(int64_t(i + 1) * SATOSHI, CScript() << OP_TRUE);
+        CWalletTx wtx(&m_wallet, MakeTransactionRef(mtx));
+        wtx.nTimeReceived = i;
+        wtx.nOrderPos = i;
+        BOOST_CHECK(batch.WriteTx(wtx));
+        txids.push_back(wtx.GetId());
+
+        CKey key;
+        key.MakeNewKey(true);
+        BOOST_CHECK(batch.WriteKey(key.GetPubKey(), key.GetPrivKey(),
+                                   CKeyMetadata(i)));
+        pubkeys.push_back(key.GetPubKey());
+    }
+
+    auto w = LoadWallet(batch);
+    LOCK(w->cs_wallet);
+    BOOST_CHECK_EQUAL(w->mapWallet.size(), txids.size());
+    for (size_t i = 0; i < txids.size(); ++i) {
+        const CWalletTx &wtx = w->mapWallet.at(txids[i]);
+        BOOST_CHECK(wtx.GetId() == txids[i]);
+        BOOST_CHECK_EQUAL(wtx.nTimeReceived, i);
+        BOOST_CHECK_EQUAL(wtx.nOrderPos, i);
+        BOOST_CHECK_EQUAL(wtx.tx->vout[0].nValue, int64_t(i + 1) * SATOSHI);
+    }
+
+    LegacyScriptPubKeyMan *spk_man = w->GetLegacyScriptPubKeyMan();
+    BOOST_REQUIRE(spk_man);
+    for (const CPubKey &pubkey : pubkeys) {
+        CKey key;
+        BOOST_CHECK(spk_man->GetKey(pubkey.GetID(), key));
+        BOOST_CHECK(key.VerifyPubKey(pubkey));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1349,15 +1349,56 @@ void CWallet::transactionRemovedFromMempool(const CTransactionRef &tx,
     }
 }
 
+bool CWallet::IsInvolvedInBlockTx(
+    const CBlock &block, const BlockScripts &scripts, size_t tx_index,
+    std::vector<std::optional<bool>> &is_mine) const {
+    AssertLockHeld(cs_wallet);
+    const CTransaction &tx = *block.vtx[tx_index];
+    if (mapWallet.count(tx.GetId())) {
+        return true;
+    }
+    // The inputs spending a wallet output (IsFromMe) or conflicting with a
+    // wallet transaction.
+    for (const CTxIn &txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.GetTxId()) ||
+            mapTxSpends.count(txin.prevout)) {
+            return true;
+        }
+    }
+    for (const uint32_t script : scripts.GetOutputScripts(tx_index)) {
+        if (!is_mine[script]) {
+            is_mine[script] =
+                IsMine(scripts.GetScript(block, script)) != ISMINE_NO;
+        }
+        if (*is_mine[script]) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void CWallet::blockConnected(const CBlock &block, int height) {
     const BlockHash &block_hash = block.GetHash();
+    // Shared with the other wallets notified of the block.
+    const std::shared_ptr<const BlockScripts> scripts = GetBlockScripts(block);
     LOCK(cs_wallet);
 
     m_last_block_processed_height = height;
     m_last_block_processed = block_hash;
+    std::vector<std::optional<bool>> is_mine(scripts->GetScriptCount());
     for (size_t index = 0; index < block.vtx.size(); index++) {
-        SyncTransaction(block.vtx[index], {CWalletTx::Status::CONFIRMED, height,
-                                           block_hash, int(index)});
+        if (IsInvolvedInBlockTx(block, *scripts, index, is_mine)) {
+            SyncTransaction(block.vtx[index],
+                            {CWalletTx::Status::CONFIRMED, height, block_hash,
+                             int(index)});
+            // Syncing the transaction may top up the keypool, so the scripts
+            // that were not ours are checked again.
+            for (std::optional<bool> &mine : is_mine) {
+                if (mine == false) {
+                    mine.reset();
+                }
+            }
+        }
         transactionRemovedFromMempool(block.vtx[index],
                                       MemPoolRemovalReason::BLOCK,
                                       0 /* mempool_sequence */);
@@ -4467,7 +4508,10 @@ CWallet::Create(interfaces::Chain &chain, const std::string &name,
     // wallet state is correct after notifications delivery. This is temporary
     // until rescan and notifications delivery are unified under same interface.
     walletInstance->m_chain_notifications_handler =
-        walletInstance->chain().handleNotifications(walletInstance);
+        walletInstance->chain().handleNotifications(
+            walletInstance, walletInstance->GetName().empty()
+                                ? "wallet"
+                                : "wallet " + walletInstance->GetName());
 
     int rescan_height = 0;
     if (!gArgs.GetBoolArg("-rescan", false)) {
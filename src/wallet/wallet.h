@@ -21,6 +21,7 @@
 #include <util/translation.h>
 #include <util/ui_change_type.h>
 #include <validationinterface.h>
+#include <wallet/blockscripts.h>
 #include <wallet/coinselection.h>
 #include <wallet/crypter.h>
 #include <wallet/rpcwallet.h>
@@ -437,7 +438,19 @@ public:
     }
 
     template <typename Stream> void Unserialize(Stream &s) {
+        CTransactionRef tx_in;
+        s >> tx_in;
+        Unserialize(s, std::move(tx_in));
+    }
+
+    /**
+     * Unserialize the fields following the transaction, which has been
+     * deserialized separately (the wallet loader does it on several threads).
+     */
+    template <typename Stream>
+    void Unserialize(Stream &s, CTransactionRef tx_in) {
         Init();
+        tx = std::move(tx_in);
 
         //! Used to be vMerkleBranch
         std::vector<uint256> dummy_vector1;
@@ -446,7 +459,7 @@ public:
         //! Used to be fSpent
         bool dummy_bool;
         int serializedIndex;
-        s >> tx >> m_confirm.hashBlock >> dummy_vector1 >> serializedIndex >>
+        s >> m_confirm.hashBlock >> dummy_vector1 >> serializedIndex >>
             dummy_vector2 >> mapValue >> vOrderForm >> fTimeReceivedIsTxTime >>
             nTimeReceived >> fFromMe >> dummy_bool;
 
@@ -760,6 +773,17 @@ private:
                          CWalletTx::Confirmation confirm, bool update_tx = true)
         EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * Whether SyncTransaction may do anything with the transaction at tx_index
+     * of a connected block: it is already in the wallet, pays one of our
+     * scripts or spends an output the wallet knows about. is_mine caches the
+     * IsMine answer of each distinct output script of the block.
+     */
+    bool IsInvolvedInBlockTx(const CBlock &block, const BlockScripts &scripts,
+                             size_t tx_index,
+                             std::vector<std::optional<bool>> &is_mine) const
+        EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     std::atomic<uint64_t> m_wallet_flags{0};
 
     bool SetAddressBookWithDB(WalletBatch &batch, const CTxDestination &address,
@@ -16,10 +16,14 @@
 #include <util/system.h>
 #include <util/time.h>
 #include <util/translation.h>
+#include <util/workerpool.h>
 #include <wallet/bdb.h>
 #include <wallet/wallet.h>
 
+#include <algorithm>
 #include <atomic>
+#include <map>
+#include <optional>
 
 namespace DBKeys {
 const std::string ACENTRY{"acentry"};
@@ -294,10 +298,111 @@ public:
     CWalletScanState() {}
 };
 
+/**
+ * The expensive part of a record, deserialized and checked ahead of
+ * ReadKeyValue without accessing the wallet so that the records of a batch
+ * can be preloaded on several threads.
+ */
+struct CWalletPreloadedRecord {
+    //! Transaction of a TX record
+    CTransactionRef tx;
+    //! Size of the serialized transaction, at the start of the value
+    size_t tx_size{0};
+    //! Private key of a plaintext key record, checked against its public key
+    CKey key;
+};
+
+/**
+ * Load the private key of a plaintext key record, checked against the public
+ * key with the hash of both or, if there is no hash, by deriving the public
+ * key.
+ */
+static bool LoadPrivKey(const CPubKey &pubkey, const CPrivKey &pkey,
+                        const uint256 &hash, bool hash_required, CKey &key,
+                        std::string &strErr) {
+    bool fSkipCheck = false;
+
+    if (hash_required || !hash.IsNull()) {
+        // hash pubkey/privkey to accelerate wallet load
+        std::vector<uint8_t> vchKey;
+        vchKey.reserve(pubkey.size() + pkey.size());
+        vchKey.insert(vchKey.end(), pubkey.begin(), pubkey.end());
+        vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
+
+        if (Hash(vchKey) != hash) {
+            strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
+            return false;
+        }
+
+        fSkipCheck = true;
+    }
+
+    if (!key.Load(pkey, pubkey, fSkipCheck)) {
+        strErr = "Error reading wallet database: CPrivKey corrupt";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Preload a record of the given type. Records which fail to preload are left
+ * to ReadKeyValue, which reports the error.
+ */
+static void PreloadRecord(const CDataStream &ssKeyIn,
+                          const CDataStream &ssValueIn,
+                          const std::string &strType,
+                          CWalletPreloadedRecord &preloaded) {
+    try {
+        CDataStream ssKey(ssKeyIn);
+        CDataStream ssValue(ssValueIn);
+        if (strType == DBKeys::TX) {
+            CTransactionRef tx;
+            ssValue >> tx;
+            preloaded.tx_size = ssValueIn.size() - ssValue.size();
+            preloaded.tx = std::move(tx);
+        } else if (strType == DBKeys::KEY ||
+                   strType == DBKeys::WALLETDESCRIPTORKEY) {
+            const bool descriptor = strType == DBKeys::WALLETDESCRIPTORKEY;
+            std::string type;
+            ssKey >> type;
+            if (descriptor) {
+                uint256 desc_id;
+                ssKey >> desc_id;
+            }
+            CPubKey pubkey;
+            ssKey >> pubkey;
+            if (!pubkey.IsValid()) {
+                return;
+            }
+
+            CPrivKey pkey;
+            uint256 hash;
+            ssValue >> pkey;
+            if (descriptor) {
+                ssValue >> hash;
+            } else {
+                try {
+                    ssValue >> hash;
+                } catch (...) {
+                }
+            }
+
+            CKey key;
+            std::string strErr;
+            if (LoadPrivKey(pubkey, pkey, hash, descriptor, key, strErr)) {
+                preloaded.key = key;
+            }
+        }
+    } catch (...) {
+        preloaded = CWalletPreloadedRecord();
+    }
+}
+
 static bool ReadKeyValue(CWallet *pwallet, CDataStream &ssKey,
                          CDataStream &ssValue, CWalletScanState &wss,
                          std::string &strType, std::string &strErr,
-                         const KeyFilterFn &filter_fn = nullptr)
+                         const KeyFilterFn &filter_fn = nullptr,
+                         const CWalletPreloadedRecord *preloaded = nullptr)
     EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet) {
     try {
         // Unserialize
@@ -331,7 +436,12 @@ static bool ReadKeyValue(CWallet *pwallet, CDataStream &ssKey,
             // callback fills with transaction metadata.
             auto fill_wtx = [&](CWalletTx &wtx, bool new_tx) {
                 assert(new_tx);
-                ssValue >> wtx;
+                if (preloaded && preloaded->tx) {
+                    ssValue.ignore(preloaded->tx_size);
+                    wtx.Unserialize(ssValue, preloaded->tx);
+                } else {
+                    ssValue >> wtx;
+                }
                 if (wtx.GetId() != txid) {
                     return false;
                 }
@@ -401,26 +511,10 @@ static bool ReadKeyValue(CWallet *pwallet, CDataStream &ssKey,
             } catch (...) {
             }
 
-            bool fSkipCheck = false;
-
-            if (!hash.IsNull()) {
-                // hash pubkey/privkey to accelerate wallet load
-                std::vector<uint8_t> vchKey;
-                vchKey.reserve(vchPubKey.size() + pkey.size());
-                vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
-                vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
-
-                if (Hash(vchKey) != hash) {
-                    strErr = "Error reading wallet database: CPubKey/CPrivKey "
-                             "corrupt";
-                    return false;
-                }
-
-                fSkipCheck = true;
-            }
-
-            if (!key.Load(pkey, vchPubKey, fSkipCheck)) {
-                strErr = "Error reading wallet database: CPrivKey corrupt";
+            if (preloaded && preloaded->key.IsValid()) {
+                key = preloaded->key;
+            } else if (!LoadPrivKey(vchPubKey, pkey, hash,
+                                    /* hash_required */ false, key, strErr)) {
                 return false;
             }
             if (!pwallet->GetOrCreateLegacyScriptPubKeyMan()->LoadKey(
@@ -695,20 +789,10 @@ static bool ReadKeyValue(CWallet *pwallet, CDataStream &ssKey,
             ssValue >> pkey;
             ssValue >> hash;
 
-            // hash pubkey/privkey to accelerate wallet load
-            std::vector<uint8_t> to_hash;
-            to_hash.reserve(pubkey.size() + pkey.size());
-            to_hash.insert(to_hash.end(), pubkey.begin(), pubkey.end());
-            to_hash.insert(to_hash.end(), pkey.begin(), pkey.end());
-
-            if (Hash(to_hash) != hash) {
-                strErr =
-                    "Error reading wallet database: CPubKey/CPrivKey corrupt";
-                return false;
-            }
-
-            if (!key.Load(pkey, pubkey, true)) {
-                strErr = "Error reading wallet database: CPrivKey corrupt";
+            if (preloaded && preloaded->key.IsValid()) {
+                key = preloaded->key;
+            } else if (!LoadPrivKey(pubkey, pkey, hash,
+                                    /* hash_required */ true, key, strErr)) {
                 return false;
             }
             wss.m_descriptor_keys.insert(
@@ -760,6 +844,28 @@ bool ReadKeyValue(CWallet *pwallet, CDataStream &ssKey, CDataStream &ssValue,
                         filter_fn);
 }
 
+/** A record read from the wallet database, loaded in batches. */
+struct CWalletRecord {
+    CDataStream key{SER_DISK, CLIENT_VERSION};
+    CDataStream value{SER_DISK, CLIENT_VERSION};
+    std::string type;
+    CWalletPreloadedRecord preloaded;
+};
+
+/** Time spent loading the records of a type, in microseconds. */
+struct CWalletRecordStats {
+    unsigned int count{0};
+    //! Summed over the preloading threads
+    int64_t preload_time{0};
+    int64_t load_time{0};
+};
+
+struct CWalletLoadStats {
+    int64_t read_time{0};
+    int threads{1};
+    std::map<std::string, CWalletRecordStats> types;
+};
+
 bool WalletBatch::IsKeyType(const std::string &strType) {
     return (strType == DBKeys::KEY || strType == DBKeys::MASTER_KEY ||
             strType == DBKeys::CRYPTED_KEY);
@@ -767,6 +873,7 @@ bool WalletBatch::IsKeyType(const std::string &strType) {
 
 DBErrors WalletBatch::LoadWallet(CWallet *pwallet) {
     CWalletScanState wss;
+    CWalletLoadStats stats;
     bool fNoncriticalErrors = false;
     DBErrors result = DBErrors::LOAD_OK;
 
@@ -786,46 +893,117 @@ DBErrors WalletBatch::LoadWallet(CWallet *pwallet) {
             return DBErrors::CORRUPT;
         }
 
-        while (true) {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            bool complete;
-            bool ret = m_batch->ReadAtCursor(ssKey, ssValue, complete);
-            if (complete) {
-                break;
+        // The records are loaded in batches: the transactions and keys of a
+        // batch are deserialized and checked on several threads, then all the
+        // records are loaded into the wallet in database order.
+        // The worker threads are started by the first batch large enough to
+        // use them and reused by the next ones.
+        const int max_threads =
+            std::max(1, std::min(GetNumCores(), MAX_WALLET_LOAD_THREADS));
+        std::optional<WorkerPool> workers;
+        std::vector<CWalletRecord> records;
+        bool complete = false;
+        while (!complete) {
+            const int64_t read_start = GetTimeMicros();
+            records.clear();
+            while (records.size() < WALLET_LOAD_BATCH_SIZE) {
+                // Read next record
+                CWalletRecord record;
+                bool ret =
+                    m_batch->ReadAtCursor(record.key, record.value, complete);
+                if (complete) {
+                    break;
+                }
+                if (!ret) {
+                    m_batch->CloseCursor();
+                    pwallet->WalletLogPrintf(
+                        "Error reading next record from wallet database\n");
+                    return DBErrors::CORRUPT;
+                }
+                try {
+                    CDataStream(record.key) >> record.type;
+                } catch (...) {
+                    // Left to ReadKeyValue to report
+                }
+                records.push_back(std::move(record));
             }
-            if (!ret) {
-                m_batch->CloseCursor();
-                pwallet->WalletLogPrintf(
-                    "Error reading next record from wallet database\n");
-                return DBErrors::CORRUPT;
+            stats.read_time += GetTimeMicros() - read_start;
+
+            const int num_threads = std::max<int>(
+                1, std::min<size_t>(max_threads,
+                                    records.size() /
+                                        WALLET_LOAD_MIN_RECORDS_PER_THREAD));
+            stats.threads = std::max(stats.threads, num_threads);
+            std::vector<std::map<std::string, CWalletRecordStats>>
+                preload_stats(num_threads);
+            auto preload = [&](int n) {
+                if (n >= num_threads) {
+                    return;
+                }
+                const size_t begin = records.size() * n / num_threads;
+                const size_t end = records.size() * (n + 1) / num_threads;
+                for (size_t i = begin; i < end; ++i) {
+                    CWalletRecord &record = records[i];
+                    if (record.type != DBKeys::TX &&
+                        record.type != DBKeys::KEY &&
+                        record.type != DBKeys::WALLETDESCRIPTORKEY) {
+                        continue;
+                    }
+                    const int64_t start = GetTimeMicros();
+                    PreloadRecord(record.key, record.value, record.type,
+                                  record.preloaded);
+                    preload_stats[n][record.type].preload_time +=
+                        GetTimeMicros() - start;
+                }
+            };
+            if (num_threads > 1) {
+                if (!workers) {
+                    workers.emplace("walletload", max_threads);
+                }
+                workers->Run(preload);
+            } else {
+                preload(0);
+            }
+            for (const auto &thread_stats : preload_stats) {
+                for (const auto &type_stats : thread_stats) {
+                    stats.types[type_stats.first].preload_time +=
+                        type_stats.second.preload_time;
+                }
             }
 
-            // Try to be tolerant of single corrupt records:
-            std::string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr)) {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType) || strType == DBKeys::DEFAULTKEY) {
-                    result = DBErrors::CORRUPT;
-                } else if (strType == DBKeys::FLAGS) {
-                    // Reading the wallet flags can only fail if unknown flags
-                    // are present.
-                    result = DBErrors::TOO_NEW;
-                } else {
-                    // Leave other errors alone, if we try to fix them we might
-                    // make things worse. But do warn the user there is
-                    // something wrong.
-                    fNoncriticalErrors = true;
-                    if (strType == DBKeys::TX) {
-                        // Rescan if there is a bad transaction record:
-                        gArgs.SoftSetBoolArg("-rescan", true);
+            for (CWalletRecord &record : records) {
+                // Try to be tolerant of single corrupt records:
+                const int64_t start = GetTimeMicros();
+                std::string strType, strErr;
+                bool loaded =
+                    ReadKeyValue(pwallet, record.key, record.value, wss,
+                                 strType, strErr, nullptr, &record.preloaded);
+                CWalletRecordStats &type_stats = stats.types[strType];
+                ++type_stats.count;
+                type_stats.load_time += GetTimeMicros() - start;
+                if (!loaded) {
+                    // losing keys is considered a catastrophic error, anything
+                    // else we assume the user can live with:
+                    if (IsKeyType(strType) || strType == DBKeys::DEFAULTKEY) {
+                        result = DBErrors::CORRUPT;
+                    } else if (strType == DBKeys::FLAGS) {
+                        // Reading the wallet flags can only fail if unknown
+                        // flags are present.
+                        result = DBErrors::TOO_NEW;
+                    } else {
+                        // Leave other errors alone, if we try to fix them we
+                        // might make things worse. But do warn the user there
+                        // is something wrong.
+                        fNoncriticalErrors = true;
+                        if (strType == DBKeys::TX) {
+                            // Rescan if there is a bad transaction record:
+                            gArgs.SoftSetBoolArg("-rescan", true);
+                        }
                     }
                 }
-            }
-            if (!strErr.empty()) {
-                pwallet->WalletLogPrintf("%s\n", strErr);
+                if (!strErr.empty()) {
+                    pwallet->WalletLogPrintf("%s\n", strErr);
+                }
             }
         }
     } catch (...) {
@@ -833,6 +1011,17 @@ DBErrors WalletBatch::LoadWallet(CWallet *pwallet) {
     }
     m_batch->CloseCursor();
 
+    pwallet->WalletLogPrintf(
+        "Wallet records read in %dms, preloaded on up to %d threads\n",
+        stats.read_time / 1000, stats.threads);
+    for (const auto &type_stats : stats.types) {
+        pwallet->WalletLogPrintf(
+            "Loaded %u '%s' records: preloaded in %dms, loaded in %dms\n",
+            type_stats.second.count, type_stats.first,
+            type_stats.second.preload_time / 1000,
+            type_stats.second.load_time / 1000);
+    }
+
     // Set the active ScriptPubKeyMans
     for (auto spk_man_pair : wss.m_active_external_spks) {
         pwallet->LoadActiveScriptPubKeyMan(
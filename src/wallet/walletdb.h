@@ -32,6 +32,12 @@
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
+//! Number of records read from the database and loaded into the wallet at once
+static const size_t WALLET_LOAD_BATCH_SIZE = 20000;
+//! Maximum number of threads preloading the records of a batch
+static const int MAX_WALLET_LOAD_THREADS = 16;
+//! Smaller batches are preloaded on fewer threads
+static const size_t WALLET_LOAD_MIN_RECORDS_PER_THREAD = 500;
 
 struct CBlockLocator;
 class CKeyPool;
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the segment snapshots and verifychainsegments."""
+
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+from test_framework.wallet import MiniWallet
+
+SNAPSHOT_INTERVAL = 50
+
+
+class SegmentValidationTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+        self.extra_args = [
+            ["-segmentsnapshotinterval={}".format(SNAPSHOT_INTERVAL)]]
+
+    def snapshot_path(self, height):
+        return os.path.join(self.nodes[0].datadir, self.chain, "segments",
+                            "utxo-{}.dat".format(height))
+
+    def run_test(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+        wallet.generate(10)
+        node.generate(100)
+        for _ in range(15):
+            wallet.send_self_transfer(from_node=node)
+            wallet.send_self_transfer(from_node=node)
+            node.generate(1)
+        assert_equal(node.getblockcount(), 125)
+
+        self.log.info("The node writes a snapshot every interval")
+        self.wait_until(lambda: os.path.isfile(self.snapshot_path(50)))
+        self.wait_until(lambda: os.path.isfile(self.snapshot_path(100)))
+        assert not os.path.exists(self.snapshot_path(125))
+
+        self.log.info("The chain is validated in segments between snapshots")
+        muhash = node.gettxoutsetinfo("muhash")['muhash']
+        result = node.verifychainsegments()
+        assert_equal(result['valid'], True)
+        assert_equal(result['height'], 125)
+        assert_equal(result['muhash'], muhash)
+        assert 'error' not in result
+        segments = result['segments']
+        assert_equal([(s['start_height'], s['end_height']) for s in segments],
+                     [(0, 50), (50, 100), (100, 125)])
+        for prev, segment in zip(segments, segments[1:]):
+            assert_equal(prev['end_muhash'], segment['start_muhash'])
+        assert_equal(segments[-1]['end_muhash'], muhash)
+        assert_equal(node.verifychainsegments(1), result)
+        assert_raises_rpc_error(-8, "The number of threads must be positive",
+                                node.verifychainsegments, 0)
+
+        self.log.info("A snapshot that doesn't match the chain is detected")
+        with open(self.snapshot_path(100), 'r+b') as f:
+            f.seek(-1, os.SEEK_END)
+            last = f.read(1)
+            f.seek(-1, os.SEEK_END)
+            f.write(bytes([last[0] ^ 0xff]))
+        result = node.verifychainsegments()
+        assert_equal(result['valid'], False)
+        assert_equal(result['error'],
+                     "The UTXO set at height 100 does not match the snapshot")
+        assert_equal(result['segments'][1]['end_muhash'],
+                     segments[1]['end_muhash'])
+        assert result['segments'][2]['start_muhash'] != \
+            segments[2]['start_muhash']
+
+        self.log.info("So is a truncated snapshot")
+        with open(self.snapshot_path(50), 'r+b') as f:
+            f.truncate(os.path.getsize(self.snapshot_path(50)) - 10)
+        result = node.verifychainsegments()
+        assert_equal(result['valid'], False)
+        assert result['error'].startswith("Segment [50, 100]: ")
+        assert 'error' in result['segments'][1]
+
+        self.log.info("Snapshots are rewritten when the blocks are connected")
+        os.remove(self.snapshot_path(50))
+        os.remove(self.snapshot_path(100))
+        blockhash = node.getblockhash(100)
+        node.invalidateblock(blockhash)
+        node.reconsiderblock(blockhash)
+        assert_equal(node.getblockcount(), 125)
+        self.wait_until(lambda: os.path.isfile(self.snapshot_path(100)))
+        result = node.verifychainsegments()
+        assert_equal(result['valid'], True)
+        assert_equal([(s['start_height'], s['end_height'])
+                      for s in result['segments']], [(0, 100), (100, 125)])
+
+        self.log.info("Only the last snapshots are kept")
+        self.restart_node(0, extra_args=self.extra_args[0] +
+                          ["-segmentsnapshotkeep=1"])
+        node.generate(25)
+        self.wait_until(lambda: os.path.isfile(self.snapshot_path(150)))
+        self.wait_until(lambda: not os.path.exists(self.snapshot_path(100)))
+        result = node.verifychainsegments()
+        assert_equal(result['valid'], True)
+        assert_equal([(s['start_height'], s['end_height'])
+                      for s in result['segments']], [(0, 150)])
+
+
+if __name__ == '__main__':
+    SegmentValidationTest().main()
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Run a synthetic workload through mempool acceptance, relay and block
+validation.
+
+The transactions follow the mix of test_framework.workload and are signed
+without a wallet. The default size is small so the test is fast; use
+--blocksize and --blocks to measure throughput with large blocks, e.g.
+
+    feature_workload.py --blocksize=32000000 --blocks=3
+
+The excessive block size and the block max size of the nodes are raised as
+needed.
+"""
+
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.messages import ToHex
+from test_framework.util import assert_equal
+from test_framework.workload import WorkloadGenerator
+
+DEFAULT_MAX_BLOCK_SIZE = 32000000
+# Rough average size of the generated transactions per coin they spend
+WORKLOAD_BYTES_PER_COIN = 200
+
+
+class WorkloadTest(BitcoinTestFramework):
+    def add_options(self, parser):
+        parser.add_argument(
+            "--blocksize", dest="blocksize", type=int, default=100000,
+            help="Size of the transactions of each block (default: %(default)s)")
+        parser.add_argument(
+            "--blocks", dest="blocks", type=int, default=2,
+            help="Number of workload blocks (default: %(default)s)")
+
+    def set_test_params(self):
+        self.num_nodes = 2
+        # Leave room for the transaction completing the last kind of the mix.
+        max_size = self.options.blocksize + 1000000
+        self.extra_args = [[
+            "-blockmaxsize={}".format(max_size),
+            "-excessiveblocksize={}".format(
+                max(max_size, DEFAULT_MAX_BLOCK_SIZE)),
+            "-maxmempool={}".format(max(300, 4 * max_size // 1000000)),
+            # signrawtransactionwithkey doesn't sign for replay protection,
+            # keep it inactive regardless of the clock.
+            "-replayprotectionactivationtime=2000000000",
+        ]] * self.num_nodes
+
+    def mine_all(self, node):
+        """Mine blocks until the mempool is empty."""
+        while node.getmempoolinfo()['size'] > 0:
+            node.generatetodescriptor(
+                1, "raw({})".format(self.gen.coinbase_script().hex()))
+        self.sync_blocks()
+
+    def fund(self):
+        node = self.nodes[0]
+        coins = (self.options.blocks * self.options.blocksize //
+                 WORKLOAD_BYTES_PER_COIN)
+        self.log.info("Fund the generator with {} coins".format(coins))
+        self.gen.fund(coins // 1000 + 2)
+        while self.gen.coins_count() < coins:
+            txs = self.gen.fanout(coins)
+            assert txs
+            for tx in txs:
+                node.sendrawtransaction(ToHex(tx))
+            self.mine_all(node)
+            self.gen.confirm_pending()
+        self.sync_blocks()
+
+    def run_test(self):
+        node = self.nodes[0]
+        self.gen = WorkloadGenerator(node)
+        self.fund()
+
+        for i in range(self.options.blocks):
+            txs = self.gen.generate(self.options.blocksize)
+            size = sum(len(tx.serialize()) for tx in txs)
+            self.log.info(
+                "Block {}: {} transactions, {} bytes".format(i, len(txs), size))
+
+            start = time.time()
+            for tx in txs:
+                node.sendrawtransaction(ToHex(tx))
+            elapsed = time.time() - start
+            self.log.info("  mempool acceptance: {:.0f} tx/s".format(
+                len(txs) / elapsed))
+            assert_equal(node.getmempoolinfo()['size'], len(txs))
+
+            start = time.time()
+            self.sync_mempools()
+            self.log.info("  relay: {:.0f} tx/s".format(
+                len(txs) / (time.time() - start)))
+
+            start = time.time()
+            blockhash = node.generatetodescriptor(
+                1, "raw({})".format(self.gen.coinbase_script().hex()))[0]
+            self.sync_blocks()
+            self.log.info("  block assembly and propagation: {:.3f}s".format(
+                time.time() - start))
+
+            block = node.getblock(blockhash)
+            assert_equal(len(block['tx']), len(txs) + 1)
+            for n in self.nodes:
+                assert_equal(n.getmempoolinfo()['size'], 0)
+            self.gen.confirm_pending()
+
+
+if __name__ == '__main__':
+    WorkloadTest().main()
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test tracking the mempool incrementally with getmempoolchanges."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+from test_framework.wallet import MiniWallet
+
+
+class MempoolChangesTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def run_test(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+        wallet.generate(5)
+        node.generate(100)
+
+        snapshot = node.getrawmempool(mempool_sequence=True)
+        assert_equal(snapshot['txids'], [])
+        seq = snapshot['mempool_sequence']
+        assert_equal(node.getmempoolchanges(seq),
+                     {'added': [], 'removed': [], 'mempool_sequence': seq})
+
+        self.log.info("Transactions added to the mempool are reported")
+        txids = [wallet.send_self_transfer(from_node=node)['txid']
+                 for _ in range(3)]
+        changes = node.getmempoolchanges(seq)
+        assert_equal(changes['added'], txids)
+        assert_equal(changes['removed'], [])
+        assert_equal(changes['mempool_sequence'], seq + 3)
+        assert_equal(
+            node.getrawmempool(mempool_sequence=True)['mempool_sequence'],
+            changes['mempool_sequence'])
+
+        self.log.info("Transactions mined in a block are reported as removed")
+        blockhash = node.generate(1)[0]
+        changes = node.getmempoolchanges(changes['mempool_sequence'])
+        assert_equal(sorted(changes['removed']), sorted(txids))
+        assert_equal(changes['added'], [])
+
+        self.log.info(
+            "Transactions added then removed in the meantime are omitted")
+        assert_equal(node.getmempoolchanges(seq),
+                     {'added': [], 'removed': [],
+                      'mempool_sequence': changes['mempool_sequence']})
+
+        self.log.info("Transactions of a disconnected block are added back")
+        node.invalidateblock(blockhash)
+        changes = node.getmempoolchanges(changes['mempool_sequence'])
+        assert_equal(sorted(changes['added']), sorted(txids))
+        assert_equal(sorted(node.getrawmempool()), sorted(txids))
+
+        self.log.info("Unknown sequence numbers are rejected")
+        assert_raises_rpc_error(
+            -1, "are not available, use getrawmempool",
+            node.getmempoolchanges, changes['mempool_sequence'] + 1)
+        assert_raises_rpc_error(
+            -8, "Negative mempool sequence", node.getmempoolchanges, -1)
+
+
+if __name__ == '__main__':
+    MempoolChangesTest().main()
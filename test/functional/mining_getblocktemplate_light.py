@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test getblocktemplate in light mode and submitblocklight.
+
+In light mode the template only contains the merkle branch of the coinbase
+and a template id. The solved block is submitted as a header and a coinbase,
+and the node rebuilds the full block from its template cache.
+"""
+
+from test_framework.blocktools import create_block, create_coinbase
+from test_framework.messages import (
+    CBlock,
+    hash256,
+    ser_uint256,
+    uint256_from_str,
+)
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+from test_framework.wallet import MiniWallet
+
+
+def merkle_root_from_branch(leaf, branch):
+    """Compute the merkle root from the coinbase (leftmost leaf) hash."""
+    h = ser_uint256(leaf)
+    for sibling in branch:
+        h = hash256(h + bytes.fromhex(sibling)[::-1])
+    return uint256_from_str(h)
+
+
+class GetBlockTemplateLightTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+
+    def run_test(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+        wallet.generate(10)
+        node.generate(100)
+        self.sync_all()
+
+        self.log.info("Light template matches the full template")
+        txids = [wallet.send_self_transfer(from_node=node)['txid']
+                 for _ in range(5)]
+        full_tmpl = node.getblocktemplate()
+        tmpl = node.getblocktemplate({'mode': 'light'})
+        assert 'transactions' not in tmpl
+        assert_equal(len(tmpl['templateid']), 64)
+        assert_equal(sorted(t['txid'] for t in full_tmpl['transactions']),
+                     sorted(txids))
+        for key in ['previousblockhash', 'coinbasevalue', 'height', 'bits']:
+            assert_equal(tmpl[key], full_tmpl[key])
+
+        # 6 leaves: 3 levels
+        assert_equal(len(tmpl['merkle']), 3)
+        coinbase = create_coinbase(tmpl['height'])
+        leaves = [ser_uint256(coinbase.sha256)] + \
+            [bytes.fromhex(t['txid'])[::-1] for t in full_tmpl['transactions']]
+        assert_equal(CBlock().get_merkle_root(leaves),
+                     merkle_root_from_branch(coinbase.sha256, tmpl['merkle']))
+
+        self.log.info("Submit a block built from the light template")
+        block = create_block(coinbase=coinbase, tmpl=tmpl)
+        block.hashMerkleRoot = merkle_root_from_branch(
+            block.vtx[0].sha256, tmpl['merkle'])
+        block.solve()
+        hexdata = block.serialize()[:80].hex() + block.vtx[0].serialize().hex()
+
+        assert_raises_rpc_error(-8, "Block template not found",
+                                node.submitblocklight, hexdata, "00" * 32)
+        assert_raises_rpc_error(-22, "Block decode failed",
+                                node.submitblocklight, hexdata[:100],
+                                tmpl['templateid'])
+
+        assert_equal(node.submitblocklight(hexdata, tmpl['templateid']), None)
+        assert_equal(node.getbestblockhash(), block.hash)
+        assert_equal(sorted(node.getblock(block.hash)['tx'][1:]),
+                     sorted(txids))
+        assert_equal(node.getrawmempool(), [])
+        self.sync_all()
+
+        assert_equal(node.submitblocklight(hexdata, tmpl['templateid']),
+                     "duplicate")
+
+        self.log.info("Light template without transactions")
+        tmpl = node.getblocktemplate({'mode': 'light'})
+        assert 'transactions' not in tmpl
+        assert_equal(tmpl['merkle'], [])
+        assert_equal(tmpl['previousblockhash'], block.hash)
+
+
+if __name__ == '__main__':
+    GetBlockTemplateLightTest().main()
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the negotiation of the encrypted transport (-v2transport)."""
+
+from test_framework.messages import NODE_P2P_V2
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+
+class V2TransportTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+        self.extra_args = [["-v2transport"], ["-v2transport"], []]
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def transport_types(self, node):
+        return [peer["transport_protocol_type"]
+                for peer in node.getpeerinfo()]
+
+    def run_test(self):
+        self.log.info("Check the service bit is only set with -v2transport")
+        for node, enabled in zip(self.nodes, [True, True, False]):
+            services = int(node.getnetworkinfo()["localservices"], 16)
+            assert_equal(bool(services & NODE_P2P_V2), enabled)
+
+        self.log.info("Check two nodes with -v2transport switch to it")
+        self.connect_nodes(0, 1)
+        self.wait_until(lambda: self.transport_types(self.nodes[0]) == ["v2"])
+        self.wait_until(lambda: self.transport_types(self.nodes[1]) == ["v2"])
+
+        self.log.info("Check the connection works over the encrypted transport")
+        self.nodes[0].generate(10)
+        self.sync_blocks(self.nodes[0:2])
+        self.nodes[1].ping()
+        self.wait_until(lambda: all(
+            "pingtime" in peer for peer in self.nodes[1].getpeerinfo()))
+
+        self.log.info("Check the other node can initiate it too")
+        self.disconnect_nodes(0, 1)
+        self.connect_nodes(1, 0)
+        self.wait_until(lambda: self.transport_types(self.nodes[0]) == ["v2"])
+        self.nodes[1].generate(10)
+        self.sync_blocks(self.nodes[0:2])
+
+        self.log.info("Check a node without -v2transport stays on V1")
+        self.connect_nodes(2, 0)
+        self.connect_nodes(1, 2)
+        self.sync_blocks()
+        assert_equal(self.transport_types(self.nodes[2]), ["v1", "v1"])
+        assert_equal(sorted(self.transport_types(self.nodes[0])),
+                     ["v1", "v2"])
+        assert_equal(sorted(self.transport_types(self.nodes[1])),
+                     ["v1", "v2"])
+
+
+if __name__ == '__main__':
+    V2TransportTest().main()
@@ -60,6 +60,7 @@ class BlockchainTest(BitcoinTestFramework):
         self._test_getblockchaininfo()
         self._test_getchaintxstats()
         self._test_gettxoutsetinfo()
+        self._test_getdbstats()
         self._test_getblockheader()
         self._test_getdifficulty()
         self._test_getnetworkhashps()
@@ -293,6 +294,23 @@ class BlockchainTest(BitcoinTestFramework):
                                 node.gettxoutsetinfo,
                                 "foohash")
 
+    def _test_getdbstats(self):
+        self.log.info("Test getdbstats")
+        node = self.nodes[0]
+
+        res = node.getdbstats()
+        for db in ['chainstate', 'blockindex']:
+            stats = res[db]
+            assert_equal([level['level'] for level in stats['levels']],
+                         list(range(7)))
+            for level in stats['levels']:
+                assert level['subcompactions'] >= level['compactions']
+                assert level['compaction_time'] >= 0
+            # Nothing wrote fast enough to be held back
+            for stall in ['slowdown', 'memtable_wait', 'level0_wait']:
+                assert_equal(stats[stall + 's'], 0)
+                assert_equal(stats[stall + '_time'], 0)
+
     def _test_getblockheader(self):
         node = self.nodes[0]
 
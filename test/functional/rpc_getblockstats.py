@@ -192,6 +192,49 @@ class GetblockstatsTest(BitcoinTestFramework):
                                 'getblockstats hash_or_height ( stats )',
                                 self.nodes[0].getblockstats)
 
+        self.log.info('Test getblockstatsrange')
+        self.check_stats_range()
+
+        self.log.info('Test getblockstats with the block stats index')
+        self.restart_node(0, extra_args=['-blockstatsindex'])
+        self.wait_until(lambda: self.nodes[0].getindexinfo(
+            'blockstatsindex')['blockstatsindex']['synced'])
+        for i in range(self.max_stat_pos + 1):
+            assert_equal(self.nodes[0].getblockstats(
+                hash_or_height=self.start_height + i), self.expected_stats[i])
+        self.check_stats_range()
+
+    def check_stats_range(self):
+        node = self.nodes[0]
+        tip = self.start_height + self.max_stat_pos
+        assert_equal(node.getblockstatsrange(
+            self.start_height, tip), self.expected_stats)
+
+        # The whole chain, the genesis block has no undo data
+        stats = node.getblockstatsrange(1, tip, ['height', 'txs'])
+        assert_equal(stats, [node.getblockstats(h, ['height', 'txs'])
+                             for h in range(1, tip + 1)])
+        assert_raises_rpc_error(-1, "Can't read undo data from disk",
+                                node.getblockstats, 0)
+        assert_raises_rpc_error(-1, "Can't read undo data from disk",
+                                node.getblockstatsrange, 0, tip)
+
+        for stat in ['minfee', 'utxo_size_inc']:
+            assert_equal(node.getblockstatsrange(self.start_height, tip, [stat]),
+                         [{stat: s[stat]} for s in self.expected_stats])
+
+        assert_raises_rpc_error(-8, 'Start height -1 is negative',
+                                node.getblockstatsrange, -1, tip)
+        assert_raises_rpc_error(-8, 'End height {} is before start height {}'.format(
+            tip - 1, tip), node.getblockstatsrange, tip, tip - 1)
+        assert_raises_rpc_error(-8, 'End height {} after current tip {}'.format(
+            tip + 1, tip), node.getblockstatsrange, 0, tip + 1)
+        assert_raises_rpc_error(-8, 'Invalid selected statistic asdfghjkl',
+                                node.getblockstatsrange, self.start_height, tip,
+                                ['asdfghjkl'])
+        assert_raises_rpc_error(-8, 'Range of 10001 blocks exceeds the maximum of 10000',
+                                node.getblockstatsrange, 0, 10000)
+
 
 if __name__ == '__main__':
     GetblockstatsTest().main()
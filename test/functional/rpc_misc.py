@@ -56,6 +56,25 @@ class RpcMiscTest(BitcoinTestFramework):
         assert_raises_rpc_error(-8, "unknown mode foobar",
                                 node.getmemoryinfo, mode="foobar")
 
+        self.log.info("test the cache stats of getmemoryinfo")
+        for name in ["sigcache", "scriptcache"]:
+            cache = node.getmemoryinfo()[name]
+            assert_greater_than(cache['size'], 0)
+            assert_equal(cache['migrating'], 0)
+            for counter in ['hits', 'misses', 'inserts', 'evictions']:
+                assert_greater_than_or_equal(cache[counter], 0)
+
+        self.log.info("test setsigcachesize")
+        sizes = node.setsigcachesize(1, 2)
+        assert_greater_than(sizes['scriptcache'], sizes['sigcache'])
+        memory = node.getmemoryinfo()
+        for name in ["sigcache", "scriptcache"]:
+            assert_equal(memory[name]['size'], sizes[name])
+            assert_greater_than(memory[name]['migrating'], 0)
+        assert_equal(list(node.setsigcachesize(sigcachesize=4).keys()),
+                     ['sigcache'])
+        assert_equal(node.setsigcachesize(), {})
+
         self.log.info("test logging")
         assert_equal(node.logging()['qt'], True)
         node.logging(exclude=['qt'])
@@ -92,6 +111,20 @@ class RpcMiscTest(BitcoinTestFramework):
         # Specifying an unknown index name returns an empty result
         assert_equal(node.getindexinfo("foo"), {})
 
+        self.log.info("test getvalidationqueueinfo")
+        self.restart_node(0, ["-txindex", "-validationqueuesize=5",
+                              "-validationqueuedrop=txindex"])
+        node.generate(1)
+        node.syncwithvalidationinterfacequeue()
+        queues = {q["name"]: q for q in node.getvalidationqueueinfo()}
+        assert "peerman" in queues
+        for name, queue in queues.items():
+            assert_equal(queue["max_pending"], 5)
+            assert_equal(queue["policy"],
+                         "drop" if name == "txindex" else "wait")
+            assert_greater_than_or_equal(
+                queue["processed"] + queue["dropped"], 1)
+
 
 if __name__ == '__main__':
     RpcMiscTest().main()
@@ -325,6 +325,30 @@ class RawTransactionsTest(BitcoinTestFramework):
             "ZZZ0000000000000000000000000000000000000000000000000000000000000")
         assert_raises_rpc_error(-5, "Block hash not found", self.nodes[0].getrawtransaction,
                                 tx, True, "0000000000000000000000000000000000000000000000000000000000000000")
+        # Several transactions can be looked up at once, with or without a
+        # block hash, and missing ones are null.
+        coinbase1 = self.nodes[0].getblock(block1)['tx'][0]
+        coinbase2 = self.nodes[0].getblock(block2)['tx'][0]
+        unknown = "00" * 32
+        gottxs = self.nodes[0].getrawtransaction(
+            [tx, unknown, coinbase2, coinbase1], True)
+        assert_equal([t['txid'] for t in gottxs if t is not None],
+                     [tx, coinbase2, coinbase1])
+        assert_equal(gottxs[1], None)
+        assert_equal(gottxs[0]['blockhash'], block1)
+        assert_equal(gottxs[2]['blockhash'], block2)
+        assert_equal(self.nodes[0].getrawtransaction([coinbase1, tx]),
+                     [self.nodes[0].getrawtransaction(coinbase1),
+                      self.nodes[0].getrawtransaction(tx)])
+        gottxs = self.nodes[0].getrawtransaction(
+            [tx, coinbase2, coinbase1], True, block1)
+        assert_equal(gottxs[0]['txid'], tx)
+        assert_equal(gottxs[0]['in_active_chain'], True)
+        assert_equal(gottxs[1], None)
+        assert_equal(gottxs[2]['txid'], coinbase1)
+        assert_equal(self.nodes[0].getrawtransaction([]), [])
+        assert_raises_rpc_error(-8, "At most 1000 transaction ids can be passed",
+                                self.nodes[0].getrawtransaction, [tx] * 1001)
         # Undo the blocks and check in_active_chain
         self.nodes[0].invalidateblock(block1)
         gottx = self.nodes[0].getrawtransaction(
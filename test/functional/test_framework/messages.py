@@ -58,6 +58,7 @@ NODE_BLOOM = (1 << 2)
 NODE_COMPACT_FILTERS = (1 << 6)
 NODE_NETWORK_LIMITED = (1 << 10)
 NODE_AVALANCHE = (1 << 24)
+NODE_P2P_V2 = (1 << 25)
 
 MSG_TX = 1
 MSG_BLOCK = 2
@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Wallet-free generator of chain and mempool traffic for load tests.
+
+This is the functional test counterpart of src/test/util/workload.h. The
+transactions are signed by the node with signrawtransactionwithkey, so no
+wallet is needed.
+"""
+
+import hashlib
+import random
+from decimal import Decimal
+
+from test_framework.cdefs import COINBASE_MATURITY
+from test_framework.key import ECKey
+from test_framework.messages import XEC, COutPoint, CTransaction, CTxIn, CTxOut, FromHex, ToHex
+from test_framework.script import (
+    OP_CHECKMULTISIG,
+    OP_CHECKSIG,
+    OP_DUP,
+    OP_EQUAL,
+    OP_EQUALVERIFY,
+    OP_HASH160,
+    CScript,
+    CScriptOp,
+    hash160,
+)
+from test_framework.wallet_util import bytes_to_wif
+
+# Number of keys owned by the generator, which bounds multisig_keys
+WORKLOAD_KEYS = 16
+# Fee rate of the generated transactions, in satoshis per byte
+WORKLOAD_FEE_PER_BYTE = 2
+# Smallest output created, in satoshis
+WORKLOAD_MIN_OUTPUT = 10000
+# Outputs created by fanout() are large enough to be split a few times
+WORKLOAD_FANOUT_OUTPUT = 100 * WORKLOAD_MIN_OUTPUT
+WORKLOAD_FANOUT_MAX_OUTPUTS = 1000
+# Upper bound of the size of an input spending a P2PKH output
+P2PKH_INPUT_SIZE = 148
+
+
+class WorkloadMix:
+    """Relative frequency of each kind of transaction, and their shape."""
+
+    def __init__(self, *, payments=10, chains=1, multisig=2, consolidations=1,
+                 chain_length=25, multisig_required=2, multisig_keys=3,
+                 consolidation_inputs=50):
+        assert 1 <= multisig_required <= multisig_keys <= 15
+        assert chain_length >= 1 and consolidation_inputs >= 2
+        self.payments = payments
+        self.chains = chains
+        self.multisig = multisig
+        self.consolidations = consolidations
+        self.chain_length = chain_length
+        self.multisig_required = multisig_required
+        self.multisig_keys = multisig_keys
+        self.consolidation_inputs = consolidation_inputs
+
+
+class WorkloadGenerator:
+    """Generate valid, standard transactions following a WorkloadMix.
+
+    Only confirmed coins are spent, apart from the transactions of a chain:
+    the outputs of the generated transactions become spendable once
+    confirm_pending() is called after they have been mined.
+    """
+
+    def __init__(self, node, mix=None, seed=0):
+        self.node = node
+        self.mix = mix or WorkloadMix()
+        self.rng = random.Random(seed)
+
+        self.privkeys = []
+        self.p2pkh_scripts = []
+        pubkeys = []
+        for i in range(WORKLOAD_KEYS):
+            key = ECKey()
+            key.set(hashlib.sha256(
+                "workload {} {}".format(seed, i).encode()).digest(), True)
+            self.privkeys.append(bytes_to_wif(key.get_bytes()))
+            pubkey = key.get_pubkey().get_bytes()
+            pubkeys.append(pubkey)
+            self.p2pkh_scripts.append(CScript(
+                [OP_DUP, OP_HASH160, hash160(pubkey), OP_EQUALVERIFY,
+                 OP_CHECKSIG]))
+
+        self.redeem_script = CScript(
+            [CScriptOp.encode_op_n(self.mix.multisig_required)] +
+            pubkeys[:self.mix.multisig_keys] +
+            [CScriptOp.encode_op_n(self.mix.multisig_keys), OP_CHECKMULTISIG])
+        self.multisig_script = CScript(
+            [OP_HASH160, hash160(self.redeem_script), OP_EQUAL])
+        self.multisig_input_size = (41 + 2 + self.mix.multisig_required * 73 +
+                                    len(self.redeem_script) + 3)
+
+        self.coins = []
+        self.multisig_coins = []
+        self.pending = []
+
+    def coinbase_script(self):
+        return self.p2pkh_scripts[0]
+
+    def coins_count(self):
+        return len(self.coins) + len(self.multisig_coins)
+
+    def fund(self, num_blocks):
+        """Mine num_blocks mature coinbases to the generator."""
+        blocks = self.node.generatetodescriptor(
+            num_blocks + COINBASE_MATURITY,
+            "raw({})".format(self.coinbase_script().hex()))
+        for blockhash in blocks[:num_blocks]:
+            self.add_coins(self.node.getblock(blockhash, 2)['tx'][0])
+
+    def add_coins(self, tx):
+        """Make the outputs of tx, as decoded by the node, spendable."""
+        for out in tx['vout']:
+            coin = (COutPoint(int(tx['txid'], 16), out['n']),
+                    CTxOut(int(out['value'] * XEC),
+                           bytes.fromhex(out['scriptPubKey']['hex'])))
+            if coin[1].scriptPubKey == self.multisig_script:
+                self.multisig_coins.append(coin)
+            elif coin[1].scriptPubKey in self.p2pkh_scripts:
+                self.coins.append(coin)
+
+    def confirm_pending(self):
+        for coin in self.pending:
+            if coin[1].scriptPubKey == self.multisig_script:
+                self.multisig_coins.append(coin)
+            else:
+                self.coins.append(coin)
+        self.pending = []
+
+    def _take_coin(self, coins):
+        pos = self.rng.randrange(len(coins))
+        coins[pos], coins[-1] = coins[-1], coins[pos]
+        return coins.pop()
+
+    def _random_p2pkh_script(self):
+        return self.rng.choice(self.p2pkh_scripts)
+
+    def _finalize(self, tx, inputs, txs):
+        """Sign tx with the fee deducted from the last output and append it to
+        txs. Return the signed transaction, or None if the fee is too high."""
+        size = len(tx.serialize())
+        for _, txout in inputs:
+            size += (self.multisig_input_size
+                     if txout.scriptPubKey == self.multisig_script
+                     else P2PKH_INPUT_SIZE)
+        tx.vout[-1].nValue -= size * WORKLOAD_FEE_PER_BYTE
+        if tx.vout[-1].nValue < WORKLOAD_MIN_OUTPUT:
+            return None
+
+        prevtxs = []
+        for outpoint, txout in inputs:
+            prevtx = {
+                'txid': "{:064x}".format(outpoint.hash),
+                'vout': outpoint.n,
+                'scriptPubKey': txout.scriptPubKey.hex(),
+                'amount': Decimal(txout.nValue) / XEC,
+            }
+            if txout.scriptPubKey == self.multisig_script:
+                prevtx['redeemScript'] = self.redeem_script.hex()
+            prevtxs.append(prevtx)
+        signed = self.node.signrawtransactionwithkey(
+            ToHex(tx), self.privkeys, prevtxs)
+        assert signed['complete'], signed
+        tx = FromHex(CTransaction(), signed['hex'])
+        tx.rehash()
+        txs.append(tx)
+        return tx
+
+    def _add_outputs(self, tx, coins):
+        for i, txout in enumerate(tx.vout):
+            coins.append((COutPoint(tx.sha256, i), txout))
+
+    def _payment(self, txs):
+        if not self.coins:
+            return
+        coin = self._take_coin(self.coins)
+        value = coin[1].nValue
+        tx = CTransaction()
+        tx.vin.append(CTxIn(coin[0]))
+        if value >= 4 * WORKLOAD_MIN_OUTPUT:
+            tx.vout.append(CTxOut(value // 2, self._random_p2pkh_script()))
+            tx.vout.append(CTxOut(value - value // 2,
+                                  self._random_p2pkh_script()))
+        else:
+            tx.vout.append(CTxOut(value, self._random_p2pkh_script()))
+        tx = self._finalize(tx, [coin], txs)
+        if tx:
+            self._add_outputs(tx, self.pending)
+
+    def _chain(self, txs):
+        if not self.coins:
+            return
+        coin = self._take_coin(self.coins)
+        for _ in range(self.mix.chain_length):
+            tx = CTransaction()
+            tx.vin.append(CTxIn(coin[0]))
+            tx.vout.append(CTxOut(coin[1].nValue, self._random_p2pkh_script()))
+            tx = self._finalize(tx, [coin], txs)
+            if not tx:
+                return
+            coin = (COutPoint(tx.sha256, 0), tx.vout[0])
+        self.pending.append(coin)
+
+    def _multisig(self, txs):
+        # Spend a multisig coin if there is one, otherwise create some.
+        spend_multisig = bool(self.multisig_coins)
+        if not spend_multisig and not self.coins:
+            return
+        coin = self._take_coin(
+            self.multisig_coins if spend_multisig else self.coins)
+        value = coin[1].nValue
+        tx = CTransaction()
+        tx.vin.append(CTxIn(coin[0]))
+        if value >= 4 * WORKLOAD_MIN_OUTPUT:
+            tx.vout.append(CTxOut(value // 2, self.multisig_script))
+            tx.vout.append(CTxOut(
+                value - value // 2,
+                self._random_p2pkh_script() if spend_multisig
+                else self.multisig_script))
+        else:
+            tx.vout.append(CTxOut(value, self._random_p2pkh_script()))
+        tx = self._finalize(tx, [coin], txs)
+        if tx:
+            self._add_outputs(tx, self.pending)
+
+    def _consolidation(self, txs):
+        count = min(self.mix.consolidation_inputs, len(self.coins))
+        if count < 2:
+            return
+        inputs = [self._take_coin(self.coins) for _ in range(count)]
+        tx = CTransaction()
+        tx.vin = [CTxIn(outpoint) for outpoint, _ in inputs]
+        tx.vout.append(CTxOut(sum(txout.nValue for _, txout in inputs),
+                              self._random_p2pkh_script()))
+        tx = self._finalize(tx, inputs, txs)
+        if tx:
+            self._add_outputs(tx, self.pending)
+
+    def fanout(self, n):
+        """Split the coins so that at least n coins are available once the
+        returned transactions are confirmed."""
+        txs = []
+        total_weight = (self.mix.payments + self.mix.chains +
+                        self.mix.multisig + self.mix.consolidations)
+        small_coins = []
+        available = self.coins_count() + len(self.pending)
+        while available < n and self.coins:
+            coin = self._take_coin(self.coins)
+            outputs = min(WORKLOAD_FANOUT_MAX_OUTPUTS, n - available + 1,
+                          coin[1].nValue // WORKLOAD_FANOUT_OUTPUT)
+            if outputs < 2:
+                small_coins.append(coin)
+                continue
+
+            tx = CTransaction()
+            tx.vin.append(CTxIn(coin[0]))
+            output_value = coin[1].nValue // outputs
+            for _ in range(outputs):
+                multisig = (total_weight > 0 and
+                            self.rng.randrange(total_weight) < self.mix.multisig)
+                tx.vout.append(CTxOut(
+                    output_value,
+                    self.multisig_script if multisig
+                    else self._random_p2pkh_script()))
+            tx.vout[-1].nValue += coin[1].nValue - outputs * output_value
+            tx = self._finalize(tx, [coin], txs)
+            if tx:
+                self._add_outputs(tx, self.pending)
+                available += outputs - 1
+            else:
+                available -= 1
+        self.coins.extend(small_coins)
+        return txs
+
+    def generate(self, target_size):
+        """Transactions following the mix, with a total size of at least
+        target_size bytes, in an order in which they can be submitted to the
+        mempool. Fewer transactions are returned when the coins run out."""
+        txs = []
+        kinds = [
+            (self.mix.payments, self._payment),
+            (self.mix.chains, self._chain),
+            (self.mix.multisig, self._multisig),
+            (self.mix.consolidations, self._consolidation),
+        ]
+        total_weight = sum(weight for weight, _ in kinds)
+        if total_weight == 0:
+            return txs
+
+        size = 0
+        # Give up after a long series of kinds that can't be generated with
+        # the remaining coins.
+        idle = 0
+        while size < target_size and self.coins_count() > 0 and idle < 100:
+            before = len(txs)
+            pick = self.rng.randrange(total_weight)
+            for weight, kind in kinds:
+                if pick < weight:
+                    kind(txs)
+                    break
+                pick -= weight
+            idle = idle + 1 if len(txs) == before else 0
+            size += sum(len(tx.serialize()) for tx in txs[before:])
+        return txs